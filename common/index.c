@@ -23,17 +23,24 @@
 #include <assert.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 
 /* Memory library */
 #include "mem.h"
 
+/* checksum of the binary format */
+#include "hash.h"
+
 /* Data Structures */
 #include "hashtable.h"
 #include "counters.h"
 #include "set.h"
+#include "postings.h"
 
 /* file handler */
 #include "file.h"
+#include "mapfile.h"
 
 /* word handler */
 #include "word.h"
@@ -41,17 +48,275 @@
 /* self */
 #include "index.h"
 
+/************** Local types **************/
+/* one run being merged by index_mergeRuns: its current line and word */
+typedef struct run {
+  FILE* fp;                   // the run file
+  file_reader_t* reader;      // reads lines from it, a buffer at a time
+  const char* line;           // current line, or NULL at end; valid until the next
+  size_t len;                 // length of the line
+  size_t wordLen;             // length of the word that starts it
+} run_t;
+
+/* where the sections of a binary index file lie */
+typedef struct layout {
+  uint64_t nWords;            // dictionary entries
+  uint64_t nPostings;         // postings, all words
+  const unsigned char* dict;  // the dictionary
+  const unsigned char* blocks;  // the block index ...
+  uint64_t nBlocks;           // ... of this many blocks of words
+  const unsigned char* terms; // the words, front-coded
+  size_t termsSize;           // bytes of them
+  const unsigned char* postings;  // the postings
+  size_t postingsSize;        // bytes of postings
+  int firstDoc, lastDoc;      // the smallest and largest docIDs; 0 if none
+  const unsigned char* docs;  // the document table
+  uint32_t nDocs;             // its entries ...
+  int docsFirst;              // ... for docIDs docsFirst, docsFirst+1, ...
+  uint64_t docsKept;          // the documents it holds ...
+  uint64_t docsTokens;        // ... and the words indexed from them
+  const char* urls;           // the URLs
+  size_t urlsSize;            // bytes in the URL pool
+  const unsigned char* maxima;  // each word's first maxima entry ...
+  uint64_t nMaxima;           // ... of this many after them
+  const unsigned char* positions;  // the positions' offsets, a word each; NULL if none ...
+  size_t positionsSize;       // ... and the bytes of positions after them
+} layout_t;
+
+/* a binary index file, read in place (index_open) */
+typedef struct mapped {
+  mapfile_t* map;             // the file
+  layout_t layout;            // its sections
+  counters_t** ctrs;          // ctrs[i]: word i's postings, once found
+} mapped_t;
+
+/* a walk through the front-coded words of a binary index, in order */
+typedef struct termreader {
+  const layout_t* layout;     // the file's sections
+  uint64_t i;                 // the next word
+  size_t pos;                 // where it starts in the terms
+  char* word;                 // the word last read, null-terminated ...
+  size_t len;                 // ... its length ...
+  size_t size;                // ... and room for it
+} termreader_t;
+
+/*
+ * a word's positions, as index_insertAt records them
+ * (in the file's format: see the positions section, above)
+ */
+typedef struct positions {
+  unsigned char* bytes;
+  size_t len;                   // bytes used ...
+  size_t size;                  // ... and room for them
+  int docID;                    // the document of the last position recorded ...
+  int last;                     // ... and its place there
+} positions_t;
+
+/*
+ * the most a run of postings can score: its largest count, and its
+ * shortest document (see the maxima section, below)
+ */
+typedef struct blockmax {
+  int last;                     // the run's last docID
+  int maxCount;                 // its largest count
+  int minTokens;                // the fewest words indexed from any of its documents
+} blockmax_t;
+
+/* a walk through a word's postings, and their maxima (index_cursor) */
+struct index_cursor {
+  postings_reader_t* reader;    // a mapped word's packed postings; NULL if unpacked
+  int* docIDs;                  // the block last unpacked, or every posting ...
+  int* counts;
+  int n;                        // ... n of them
+  int k;                        // the current posting; n at the end
+  bool done;                    // the reader has no more blocks
+  blockmax_t* blocks;           // the maxima of each block of POSTINGS_BLOCK postings ...
+  int nBlocks;                  // ... how many ...
+  int block;                    // ... and the first that may hold the current posting
+  blockmax_t all;               // the maxima of the whole list
+};
+
+/* a walk through a word's positions, document by document (index_positions) */
+struct index_positions {
+  int* docIDs;                  // the word's postings ...
+  int* counts;
+  int n;                        // ... of n documents
+  const unsigned char* bytes;   // its positions
+  size_t size;                  // bytes of them
+  int k;                        // the next posting ...
+  size_t pos;                   // ... and where its positions start
+  int* places;                  // the positions in the last document found
+  int room;                     // room in places[]
+};
+
+/*
+ * the binary index format, all integers little-endian:
+ *
+ *   header, HEADER_SIZE bytes:
+ *     0  magic "TSEINDEX"        32  dictionary offset
+ *     8  version                 40  postings offset
+ *    12  header size             48  file size
+ *    16  number of words         56  checksum: hash_wy, seed 0,
+ *    24  number of postings          of every byte after the header
+ *                                64  smallest docID; 0 if none
+ *                                68  largest docID; 0 if none
+ *                                72  document table offset
+ *                                80  number of table entries
+ *                                84  docID of the first entry
+ *                                88  positions offset; 0 if none
+ *                                96  documents in the table
+ *                               104  words indexed from them
+ *                               112  maxima offset
+ *   dictionary, one ENTRY_SIZE entry per word, in strcmp order:
+ *     0  offset of the word's postings in the postings section
+ *     8  number of postings
+ *   block index: for each block of DICT_BLOCK words, in order,
+ *     the offset of its first word in the terms, 4 bytes;
+ *   terms: the words, in the same order, front-coded a block at a time:
+ *     each is a varint of the bytes it shares with the word before
+ *     -- 0 for the first of a block, which is thus whole --
+ *     a varint of the bytes that follow, and those bytes;
+ *   postings: for each word in turn, its postings list packed by
+ *     postings_encode, with the codec postings_codecFor picks for its
+ *     length -- a skip table of its blocks' last docIDs and offsets,
+ *     if it has more than one, then docIDs as gaps, then counts, in
+ *     blocks of POSTINGS_BLOCK, as varints or bit-packed -- up to where
+ *     the next word's begins, or the document table;
+ *   document table, one DOC_SIZE entry for each docID from the first,
+ *   to the last the index holds:
+ *     0  offset of the document's URL in the URL pool; NO_URL if none
+ *     4  crawl depth              8  words indexed
+ *    12  bytes of HTML
+ *   URL pool: the URLs, each null-terminated, up to the maxima;
+ *   maxima: for each word, in dictionary order, the 8-byte number
+ *     of its first entry among the MAX_SIZE entries that follow,
+ *     up to the positions or the end of the file; a word has an entry
+ *     for its whole postings list, then, if the list has more than one
+ *     block of POSTINGS_BLOCK postings, one for each block in turn:
+ *     0  last docID               4  largest count
+ *     8  fewest words indexed from any of its documents;
+ *        0 if the document table lacks one
+ *   positions, if the index keeps them (index_newPositional()):
+ *     for each word, in dictionary order, the 8-byte offset of its
+ *     positions in the bytes that follow, which run to the end of the file;
+ *     a word's positions are, for each of its postings in order,
+ *     as many as its count -- the word's places in the document,
+ *     counting every word of the page from 0 -- as varints: the first,
+ *     then each one's gap from the one before, less one.
+ */
+static const char INDEX_MAGIC[8] = "TSEINDEX";
+static const uint32_t INDEX_VERSION = 10;
+static const size_t HEADER_SIZE = 120;
+static const size_t ENTRY_SIZE = 12;
+static const int DICT_BLOCK = 16;     // words a block of the dictionary
+static const size_t DOC_SIZE = 16;
+static const size_t MAX_SIZE = 12;
+static const uint32_t NO_URL = UINT32_MAX;
+static const int MIN_SLOTS = 200;     // hashtable slots of a new index
+
 /******** Static function prototypes *********/
 static void printWord(void* arg, const char* key, void* item);
 static void printCounts(void* arg, int key, int count);
 static void deleteCounter(void* arg);
+static void deletePositions(void* arg);
+static void mergePositions(void* arg, const char* key, void* item);
+static void growPositions(positions_t* positions, const size_t more);
+static const char* checkPositions(const layout_t* layout, const uint64_t i);
+static const char* checkMaxima(const layout_t* layout, const uint64_t i);
+static int wordMaxima(index_t* docs, const int* docIDs, const int* counts, const int n, blockmax_t* blocks, blockmax_t* all);
+static void putMaxima(unsigned char* entry, const blockmax_t* max);
+static void getMaxima(const unsigned char* entry, blockmax_t* max);
+static void mergeWord(void* arg, const char* key, void* item);
+static void countWord(void* arg, const char* key, void* item);
+static void collectWord(void* arg, const char* key, void* item);
+static int compareWords(const void* a, const void* b);
+static bool runNext(run_t* run);
+static int runCompare(const run_t* runs, const int a, const int b);
+static void heapDown(const run_t* runs, int* heap, const int size, int i);
+static void mergeCount(void* arg, int key, int count);
+static bool parseInt(const char** p, const char* end, int* value);
+static index_t* index_sized(const int nSlots);
+static index_t* loadBinary(const unsigned char* data, const size_t size, const char* indexFileName);
+static const char* readLayout(const unsigned char* data, const size_t size, const bool checksum, layout_t* layout);
+static const char* checkEntry(const layout_t* layout, const uint64_t i);
+static counters_t* decodeWord(const layout_t* layout, const uint64_t i, int* keys, int* counts);
+static counters_t* mappedCounters(mapped_t* mapped, const uint64_t i);
+static bool findWord(const layout_t* layout, const char* word, uint64_t* i);
+static bool findBlock(const layout_t* layout, const char* word, const size_t wordLen, uint64_t* blocks);
+static void expandWord(void* arg, const char* key, void* item);
+static bool matchPattern(const char* pattern, const char* word);
+static bool readTerm(const layout_t* layout, size_t* pos, uint32_t* shared, const unsigned char** bytes, uint32_t* len);
+static int compareTerm(const char* word, const size_t wordLen, const unsigned char* bytes, const uint32_t len, size_t* common);
+static void termsStart(termreader_t* reader, const layout_t* layout, const uint64_t block);
+static const char* termsNext(termreader_t* reader);
+static void termsEnd(termreader_t* reader);
+static size_t putVarint(unsigned char* p, uint32_t value);
+static bool getVarint(const unsigned char* data, const size_t size, size_t* pos, uint32_t* value);
+static counters_t* seekWord(const layout_t* layout, const uint64_t i, counters_t* ctrs);
+static void seekCount(void* arg, int key, int count);
+static void rangeWord(void* arg, const char* key, void* item);
+static void rangeCount(void* arg, int key, int count);
+static bool readDoc(const layout_t* layout, const uint32_t i, index_doc_t* doc);
+static void sortDocs(index_t* index);
+static int compareDocs(const void* a, const void* b);
+static void saveCount(void* arg, int key, int count);
+static void put32(unsigned char* p, const uint32_t value);
+static void put64(unsigned char* p, const uint64_t value);
+static uint32_t get32(const unsigned char* p);
+static uint64_t get64(const unsigned char* p);
 // static void rankPages(void* arg, int key, int value);
 
 
 
 /************** Struct types **************/
+/* a word and its counters, for sorting */
+typedef struct wordentry {
+  const char* word;
+  counters_t* ctrs;
+} wordentry_t;
+
+/* where index_save puts the next posting of a word, to be packed */
+typedef struct postings {
+  int* docIDs;
+  int* counts;
+} postings_t;
+
+/* where index_intersect stands in a word's postings, and what it has found */
+typedef struct seeker {
+  postings_reader_t* reader;    // the word's postings
+  int docIDs[POSTINGS_BLOCK];   // the block last unpacked ...
+  int counts[POSTINGS_BLOCK];
+  int n;                        // ... of n postings; 0 before any, or once done
+  int k;                        // the first in it not below the last docID sought
+  bool done;                    // the postings are all below the docIDs sought
+  int* keys;                    // the docIDs in both, so far ...
+  int* found;                   // ... and their smaller counts
+  int size;                     // how many
+} seeker_t;
+
+/* what index_expand is looking for, and whom to tell */
+typedef struct expander {
+  const char* pattern;
+  void* arg;
+  void (*itemfunc)(void* arg, const char* key, void* item);
+  int count;                    // words matched so far
+} expander_t;
+
+/* a document's entry in an index's document table */
+typedef struct docentry {
+  int docID;
+  index_doc_t doc;      // its URL is in the index's arena
+} docentry_t;
+
 typedef struct index {
-  hashtable_t* ht;
+  hashtable_t* ht;      // the words and their counters; NULL if mapped
+  mem_arena_t* arena;   // holds the hashtable's words, freed all at once
+  mapped_t* mapped;     // the file, if opened by index_open; else NULL
+  docentry_t* docs;     // the document table, if not mapped; NULL if empty
+  int nDocs;            // its entries ...
+  int docSlots;         // ... and room for them
+  bool docsSorted;      // whether the entries are in docID order
+  hashtable_t* pos;     // each word's positions_t, if kept and not mapped; else NULL
 } index_t;
 
 
@@ -69,13 +334,55 @@ typedef struct index {
  */
 index_t* 
 index_new()
+{
+  return index_sized(MIN_SLOTS);
+}
+
+/**
+ * @function: index_newPositional()
+ * @brief: see index.h for documentation.
+ * 
+ * Returns:
+ * @return index_t*: pointer to created index_t* object.
+ */
+index_t*
+index_newPositional()
+{
+  index_t* index = index_sized(MIN_SLOTS);
+  index->pos = hashtable_new_arena(MIN_SLOTS, index->arena);
+  assert(index->pos != NULL);
+  return index;
+}
+
+/**
+ * @function: index_sized()
+ * @brief: static helper function for index_new and loadBinary:
+ * creates an empty index whose hashtable has nSlots slots.
+ * 
+ * @param nSlots: number of hashtable slots.
+ * 
+ * Returns:
+ * @return index_t*: pointer to created index_t* object.
+ */
+static index_t*
+index_sized(const int nSlots)
 {
   // allocate memory for the index object.
   index_t* index = mem_malloc_assert(sizeof(index_t), "mem alloc for index failed.");
 
-  // initialize the hashtable to store items in the index.
-  index->ht = hashtable_new(200);
+  /*
+   * initialize the hashtable to store items in the index;
+   * its sets, nodes and word copies come from the index's arena,
+   * so deleting the index frees them in a handful of calls.
+   */
+  index->arena = mem_assert(mem_arena_new(0), "mem alloc for index arena failed.");
+  index->ht = hashtable_new_arena(nSlots, index->arena);
   assert(index->ht != NULL);
+  index->mapped = NULL;
+  index->docs = NULL;
+  index->nDocs = index->docSlots = 0;
+  index->docsSorted = true;
+  index->pos = NULL;
 
   // return pointer to the index.
   return index;
@@ -95,7 +402,7 @@ index_new()
 void
 index_insert(index_t* index, char* word, int docID)
 {
-  assert(index != NULL);
+  assert(index != NULL && index->mapped == NULL);
   /*
    * if counters already exist for the word,
    * get and update it.
@@ -104,15 +411,55 @@ index_insert(index_t* index, char* word, int docID)
    * update it with current instance, 
    * and insert into the index.
    */ 
+  size_t len = strlen(word);     // hash the word without re-scanning it
   counters_t* ctrs;
-  if ((ctrs = hashtable_find(index->ht, word)) != NULL) {
+  if ((ctrs = hashtable_find_len(index->ht, word, len)) != NULL) {
     counters_add(ctrs, docID);
   }
   else {
     ctrs = counters_new();
     counters_add(ctrs, docID);
-    hashtable_insert(index->ht, word, ctrs);
+    hashtable_insert_len(index->ht, word, len, ctrs);
+  }
+}
+
+/**
+ * @function: index_insertAt()
+ * @brief: see index.h for full documentation.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object.
+ * @param word: word to enter into index.
+ * @param docID: document where word was found.
+ * @param position: the word's place in the document.
+ * 
+ * Returns: none.
+ */
+void
+index_insertAt(index_t* index, char* word, int docID, int position)
+{
+  index_insert(index, word, docID);
+  if (index->pos == NULL) {
+    return;
+  }
+
+  size_t len = strlen(word);
+  positions_t* positions;
+  if ( (positions = hashtable_find_len(index->pos, word, len)) == NULL) {
+    positions = mem_malloc_assert(sizeof(positions_t), "mem alloc for positions failed.");
+    positions->size = 16;
+    positions->bytes = mem_malloc_assert(positions->size, "mem alloc for positions failed.");
+    positions->len = 0;
+    positions->docID = -1;
+    hashtable_insert_len(index->pos, word, len, positions);
   }
+
+  /* the first place in a document as it is; the others, as gaps */
+  uint32_t gap = (positions->docID == docID) ? position - positions->last - 1 : position;
+  growPositions(positions, 5);
+  positions->len += putVarint(positions->bytes + positions->len, gap);
+  positions->docID = docID;
+  positions->last = position;
 }
 
 /**
@@ -136,275 +483,2466 @@ index_find(index_t* index, char* word)
    * return whatever matches the word in the hashtable.
    * if word does not exist, hashtable_find returns NULL.
    */
-  return hashtable_find(index->ht, word);
-}
+  if (index->mapped == NULL) {
+    return hashtable_find(index->ht, word);
+  }
 
+  /* a mapped index: binary search of the sorted dictionary */
+  uint64_t i;
+  if (!findWord(&index->mapped->layout, word, &i)) {
+    return NULL;
+  }
+  return mappedCounters(index->mapped, i);
+}
 
 /**
- * @function: index_set
+ * @function: index_count
  * @brief: see index.h for full documentation.
  * 
- * @param index: pointer to a valid index object.
- * @param word: word to be inserted.
- * @param docID: document ID where word was found.
- * @param count: pre-determined count of word in the document ID.
+ * @param index: the index wherein to search.
+ * @param word: the word to search for.
+ * 
+ * Returns:
+ * @return: the number of documents in the word's postings; 0 if none.
  */
-void
-index_set(index_t* index, char* word, int docID, int count)
+int
+index_count(index_t* index, char* word)
 {
   assert(index != NULL && word != NULL);
 
-  counters_t* ctrs;
-  if ((ctrs = hashtable_find(index->ht, word)) != NULL) {
-    counters_set(ctrs, docID, count);
+  if (index->mapped == NULL) {
+    counters_t* ctrs = hashtable_find(index->ht, word);
+    return (ctrs == NULL) ? 0 : counters_size(ctrs);
   }
-  else {
-    ctrs = counters_new();
-    counters_set(ctrs, docID, count);
-    hashtable_insert(index->ht, word, ctrs);
+
+  /* the count is in the word's dictionary entry */
+  layout_t* layout = &index->mapped->layout;
+  uint64_t i;
+  if (!findWord(layout, word, &i) || checkEntry(layout, i) != NULL) {
+    return 0;
   }
+  return get32(layout->dict + i * ENTRY_SIZE + 8);
 }
 
 /**
- * @function: index_iterate()
+ * @function: index_intersect
  * @brief: see index.h for full documentation.
  * 
- * Inputs:
- * @param index: pointer to an index object.
- * @param arg: pointer to an argument, e.g. a file.
- * @param itemfunc: pointer to a function.
+ * @param index: the index wherein to search.
+ * @param word: the word whose postings to intersect with.
+ * @param ctrs: the counters to intersect.
  * 
- * Returns: none.
+ * Returns:
+ * @return: new counters of the docIDs in both.
+ * @return: NULL -> out of memory.
  */
-void 
-index_iterate(index_t* index, void* arg, 
-void (*itemfunc)(void* arg, const char* key, void* item))
+counters_t*
+index_intersect(index_t* index, char* word, counters_t* ctrs)
 {
-  assert(index != NULL);
-  
-  /*
-   * Get hashtable in index, 
-   * if hashtable is NULL do nothing.
-   */
-  hashtable_t* ht = index->ht;
-  if (ht != NULL) {
+  assert(index != NULL && word != NULL && ctrs != NULL);
 
-    // call hashtable_iterate() over the hashtable.
-    hashtable_iterate(ht, arg, itemfunc);
+  if (index->mapped == NULL) {
+    counters_t* wordCtrs = hashtable_find(index->ht, word);
+    return (wordCtrs == NULL) ? counters_new() : counters_intersect(ctrs, wordCtrs);
   }
+
+  /* a mapped index: use the word's counters if unpacked already, else seek */
+  layout_t* layout = &index->mapped->layout;
+  uint64_t i;
+  if (!findWord(layout, word, &i) || checkEntry(layout, i) != NULL) {
+    return counters_new();
+  }
+  if (index->mapped->ctrs[i] != NULL) {
+    return counters_intersect(ctrs, index->mapped->ctrs[i]);
+  }
+  return seekWord(layout, i, ctrs);
 }
 
+
 /**
- * @function: index_print()
+ * @function: index_expand
  * @brief: see index.h for full documentation.
  * 
- * Inputs:
- * @param index: pointer to an index object
- * @param fp: pointer to a file.
+ * @param index: the index wherein to search.
+ * @param pattern: the word, with '*' for any run of characters.
+ * @param arg: passed to itemfunc.
+ * @param itemfunc: called on each matching word and its counters.
  * 
- * Returns: none.
+ * Returns:
+ * @return int: the number of words matched.
  */
-void 
-index_print (index_t* index, FILE* fp)
+int
+index_expand(index_t* index, const char* pattern, void* arg,
+             void (*itemfunc)(void* arg, const char* key, void* item))
 {
-  assert(index != NULL);
-  assert(fp != NULL);
+  assert(index != NULL && pattern != NULL && itemfunc != NULL);
+
+  expander_t expander = { pattern, arg, itemfunc, 0 };
+  if (index->mapped == NULL) {
+    // a hashtable has no order: test every word
+    hashtable_iterate(index->ht, &expander, expandWord);
+    return expander.count;
+  }
 
-  // iterate over the index object with printWord
-  index_iterate(index, fp, printWord);
+  /*
+   * the words that start with the pattern's prefix are together in the
+   * sorted dictionary: from the block before the first, read on until one does not
+   */
+  const layout_t* layout = &index->mapped->layout;
+  const char* star = strchr(pattern, '*');
+  size_t prefixLen = (star != NULL) ? (size_t) (star - pattern) : strlen(pattern);
+  uint64_t block;
+  if (!findBlock(layout, pattern, prefixLen, &block)) {
+    return 0;
+  }
+  termreader_t reader;
+  termsStart(&reader, layout, block > 0 ? block - 1 : 0);
+  const char* word;
+  while ( (word = termsNext(&reader)) != NULL) {
+    int cmp = strncmp(word, pattern, prefixLen);
+    if (cmp > 0) {
+      break;                            // past the prefix
+    }
+    counters_t* ctrs;
+    if (cmp == 0 && (ctrs = mappedCounters(index->mapped, reader.i - 1)) != NULL) {
+      expandWord(&expander, word, ctrs);
+    }
+  }
+  termsEnd(&reader);
+  return expander.count;
 }
 
 /**
- * @function: index_delete()
+ * @function: index_positions
  * @brief: see index.h for full documentation.
  * 
- * Inputs:
- * @param index: pointer to an index object to be deleted.
+ * The word's postings come from index_find(); its positions, from the
+ * mapped file, or the index's own, which are not read until now.
  * 
- * Returns: none.
+ * @param index: the index wherein to search.
+ * @param word: the word whose positions to walk.
+ * 
+ * Returns:
+ * @return index_positions_t*: the walk, before the word's first document.
+ * @return NULL: the index keeps no positions, or has no such word.
  */
-void 
-index_delete(index_t* index)
+index_positions_t*
+index_positions(index_t* index, char* word)
 {
-  assert(index != NULL);
-  /*
-   * call hashtable_delete() for the hashtable in the index,
-   * with the deleter for counters.
-   */
-  hashtable_delete(index->ht, deleteCounter);
+  assert(index != NULL && word != NULL);
 
-  // free the memory allocated to the index object.
-  mem_free(index);
+  const unsigned char* bytes;
+  size_t size;
+  if (index->mapped != NULL) {
+    layout_t* layout = &index->mapped->layout;
+    uint64_t i;
+    if (layout->positions == NULL || !findWord(layout, word, &i)
+        || checkPositions(layout, i) != NULL) {
+      return NULL;
+    }
+    uint64_t offset = get64(layout->positions + i * 8);
+    uint64_t end = (i + 1 < layout->nWords) ? get64(layout->positions + i * 8 + 8) : layout->positionsSize;
+    bytes = layout->positions + layout->nWords * 8 + offset;
+    size = end - offset;
+  }
+  else {
+    positions_t* positions;
+    if (index->pos == NULL || (positions = hashtable_find(index->pos, word)) == NULL) {
+      return NULL;
+    }
+    bytes = positions->bytes;
+    size = positions->len;
+  }
+
+  counters_t* ctrs;
+  if ( (ctrs = index_find(index, word)) == NULL) {
+    return NULL;
+  }
+  index_positions_t* walk = mem_malloc_assert(sizeof(index_positions_t), "mem alloc for positions failed.");
+  walk->n = counters_size(ctrs);
+  walk->docIDs = mem_malloc_assert((walk->n + 1) * sizeof(int), "mem alloc for positions failed.");
+  walk->counts = mem_malloc_assert((walk->n + 1) * sizeof(int), "mem alloc for positions failed.");
+  postings_t postings = { walk->docIDs, walk->counts };
+  counters_iterate(ctrs, &postings, saveCount);
+  walk->bytes = bytes;
+  walk->size = size;
+  walk->k = 0;
+  walk->pos = 0;
+  walk->room = 16;
+  walk->places = mem_malloc_assert(walk->room * sizeof(int), "mem alloc for positions failed.");
+  return walk;
 }
 
 /**
- * @function: index_load
- * @brief: See index.h for full documentation.
+ * @function: index_positionsIn
+ * @brief: see index.h for full documentation.
  * 
- * Inputs:
- * @param pageDirectory: page directory to search for saved webpages
+ * @param walk: the walk, from index_positions().
+ * @param docID: the document; above any asked for before.
+ * @param n: where to save how many positions there are.
  * 
- * Outputs:
- * @return index_t*: a pointer to the created index struct
- * @return NULL: Error reading from file, creating struct, or some other error occurred.
+ * Returns:
+ * @return const int*: the word's positions in the document, increasing.
+ * @return NULL: the word is not in the document, or its positions are corrupt.
  */
-index_t*
-index_load(const char* indexFileName)
+const int*
+index_positionsIn(index_positions_t* walk, const int docID, int* n)
 {
-
-  /*
-   * if error opening file, return NULL
-   */
-  FILE* indexFile;
-  if ( (indexFile = fopen(indexFileName, "r")) == NULL) {
-    fprintf(stderr, "Error accessing index file: '%s'\n", indexFileName);
-    return NULL;
+  assert(walk != NULL && n != NULL);
+  *n = 0;
+
+  /* skip the documents before docID, and their positions */
+  uint32_t gap;
+  while (walk->k < walk->n && walk->docIDs[walk->k] < docID) {
+    for (int j = 0; j < walk->counts[walk->k]; j++) {
+      if (!getVarint(walk->bytes, walk->size, &walk->pos, &gap)) {
+        walk->k = walk->n;              // corrupt: no more documents
+        return NULL;
+      }
+    }
+    walk->k++;
   }
-  /* log progress */
-  // logProgress(0, "output", output);
-
-  /*
-   * If error initializing index, return NULL
-   */
-  index_t* index;
-  if ( (index = index_new()) == NULL) {
-    fclose(indexFile);
+  if (walk->k == walk->n || walk->docIDs[walk->k] != docID) {
     return NULL;
   }
 
-  char* rawText = NULL;       // track text found from source file
-  char* foundWord = NULL;     // track actual words that are found
-  int docID; int count;       // track document ID and counts that are found 
-  int pos = 0;                // track position ([x]'th word) in current sentence
-
-  while ( (rawText = file_readWord(indexFile) ) != NULL) {
-    
-    /* if word has alphabetical characters */
-    if (isalpha(rawText[0]) != 0) {
-
-      /* free previously found word */
-      if (foundWord != NULL) {
-        mem_free(foundWord);
-      }
-
-      //reset position to zero
-      pos = 0;
-
-      // normalize the word
-      normalizeWord(rawText);
-
-      // allocate word, copy text found
-      foundWord = mem_calloc_assert(strlen(rawText), 2*sizeof(char), "Error allocating memory for found word.");
-
-      // copy found word
-      strcpy(foundWord, rawText);
-
-      /* log progress */
-      // logProgress(2, "word", foundWord);
-
-      // increment position in sentence.
-      pos++;
-    }
-    else if (pos % 2 == 1) {
-      
-      // parse document ID
-      docID = atoi(rawText);
-
-      // increment position in sentence.
-      pos++;
+  /* the document's positions: the first as it is, the others as gaps */
+  int count = walk->counts[walk->k++];
+  if (count > walk->room) {
+    while (count > walk->room) {
+      walk->room *= 2;
     }
-    /* if count value, insert pair into index */
-    else {
-      
-      // parse count
-      count = atoi(rawText);
-
-      // insert word, document ID, count into the index
-      index_set(index, foundWord, docID, count);
-
-      // increment position in the sentence
-      pos++;
+    mem_free(walk->places);
+    walk->places = mem_malloc_assert(walk->room * sizeof(int), "mem alloc for positions failed.");
+  }
+  int64_t place = -1;
+  for (int j = 0; j < count; j++) {
+    if (!getVarint(walk->bytes, walk->size, &walk->pos, &gap) || (place += (int64_t) gap + 1) > INT32_MAX) {
+      walk->k = walk->n;
+      return NULL;
     }
-
-    /* free the raw text */
-    mem_free(rawText);
+    walk->places[j] = (int) place;
   }
+  *n = count;
+  return walk->places;
+}
 
-  /*
-   * at end of document (if read was successful), 
-   * free last found valid word 
-   */
-  if (foundWord != NULL) {
-    mem_free(foundWord);
+/**
+ * @function: index_positionsDelete
+ * @brief: see index.h for full documentation.
+ */
+void
+index_positionsDelete(index_positions_t* walk)
+{
+  if (walk != NULL) {
+    mem_free(walk->docIDs);
+    mem_free(walk->counts);
+    mem_free(walk->places);
+    mem_free(walk);
   }
+}
 
-  // close the file
-  fclose(indexFile);
-
-  /* return re-created index */
-  return index;
-
-} /* end of index_load() */
+/**
+ * @function: index_cursor
+ * @brief: see index.h for full documentation.
+ * 
+ * A mapped word's postings are unpacked a block at a time, as the cursor
+ * reaches them, and its maxima read from the file's maxima section;
+ * should they be bad, its postings are unpacked whole, as index_find()
+ * does, and their maxima worked out from them.
+ * 
+ * @param index: the index wherein to search.
+ * @param word: the word whose postings to walk.
+ * 
+ * Returns:
+ * @return index_cursor_t*: the cursor, at the word's first posting.
+ * @return NULL: the index has no such word.
+ */
+index_cursor_t*
+index_cursor(index_t* index, char* word)
+{
+  assert(index != NULL && word != NULL);
 
+  if (index->mapped == NULL) {
+    counters_t* ctrs = hashtable_find(index->ht, word);
+    return (ctrs == NULL) ? NULL : index_cursorOver(index, ctrs);
+  }
 
+  layout_t* layout = &index->mapped->layout;
+  uint64_t i;
+  if (!findWord(layout, word, &i) || checkEntry(layout, i) != NULL) {
+    return NULL;
+  }
+  if (checkMaxima(layout, i) != NULL) {
+    counters_t* ctrs = mappedCounters(index->mapped, i);
+    return (ctrs == NULL) ? NULL : index_cursorOver(index, ctrs);
+  }
 
+  /* the word's postings, a block at a time, and its maxima: the whole list's, then each block's */
+  const unsigned char* entry = layout->dict + i * ENTRY_SIZE;
+  uint64_t offset = get64(entry);
+  uint64_t end = (i + 1 < layout->nWords) ? get64(entry + ENTRY_SIZE) : layout->postingsSize;
+  int count = get32(entry + 8);
+  index_cursor_t* cursor = mem_malloc_assert(sizeof(index_cursor_t), "mem alloc for cursor failed.");
+  cursor->reader = mem_assert(postings_reader_new(layout->postings + offset, end - offset, count), "mem alloc for cursor failed.");
+  cursor->docIDs = mem_malloc_assert(POSTINGS_BLOCK * sizeof(int), "mem alloc for cursor failed.");
+  cursor->counts = mem_malloc_assert(POSTINGS_BLOCK * sizeof(int), "mem alloc for cursor failed.");
+  cursor->n = cursor->k = 0;
+  cursor->done = false;
+
+  const unsigned char* maxima = layout->maxima + layout->nWords * 8 + get64(layout->maxima + i * 8) * MAX_SIZE;
+  getMaxima(maxima, &cursor->all);
+  cursor->nBlocks = (count > POSTINGS_BLOCK) ? (count + POSTINGS_BLOCK - 1) / POSTINGS_BLOCK : 1;
+  cursor->blocks = mem_malloc_assert(cursor->nBlocks * sizeof(blockmax_t), "mem alloc for cursor failed.");
+  for (int b = 0; b < cursor->nBlocks; b++) {
+    getMaxima(cursor->nBlocks > 1 ? maxima + (b + 1) * MAX_SIZE : maxima, &cursor->blocks[b]);
+  }
+  cursor->block = 0;
 
-/********** Static functions definitions ************/
+  index_cursorSeek(cursor, INT_MIN);
+  return cursor;
+}
 
 /**
- * @function: printCounts()
- * @brief: static helper function to print counters_t objects.
+ * @function: index_cursorOver
+ * @brief: see index.h for full documentation.
  * 
- * Inputs:
- * @param arg: pointer to an object expected to be file. 
- * @param key: key from counter
- * @param count: value associated to key in counter.
+ * @param index: the index whose document table gives the documents' lengths.
+ * @param ctrs: the postings to walk; copied.
+ * 
+ * Returns:
+ * @return index_cursor_t*: the cursor, at the first posting.
  */
-static void
-printCounts(void* arg, int key, int count)
+index_cursor_t*
+index_cursorOver(index_t* index, counters_t* ctrs)
 {
-  assert(arg != NULL);
+  assert(index != NULL && ctrs != NULL);
+
+  int count = counters_size(ctrs);
+  index_cursor_t* cursor = mem_malloc_assert(sizeof(index_cursor_t), "mem alloc for cursor failed.");
+  cursor->reader = NULL;
+  cursor->docIDs = mem_malloc_assert((count + 1) * sizeof(int), "mem alloc for cursor failed.");
+  cursor->counts = mem_malloc_assert((count + 1) * sizeof(int), "mem alloc for cursor failed.");
+  postings_t postings = { cursor->docIDs, cursor->counts };
+  counters_iterate(ctrs, &postings, saveCount);
+  cursor->n = count;
+  cursor->k = 0;
+  cursor->done = true;
+  cursor->blocks = mem_malloc_assert((count / POSTINGS_BLOCK + 1) * sizeof(blockmax_t), "mem alloc for cursor failed.");
+  cursor->nBlocks = wordMaxima(index, cursor->docIDs, cursor->counts, count, cursor->blocks, &cursor->all);
+  cursor->block = 0;
+  return cursor;
+}
 
-  FILE* fp;
-  if ( (fp = (FILE*) arg) != NULL) {
+/**
+ * @function: index_cursorDoc
+ * @brief: see index.h for full documentation.
+ * 
+ * @param cursor: the cursor.
+ * @param count: where to save the posting's count; 0 at the end.
+ * 
+ * Returns:
+ * @return int: the current posting's docID; INT_MAX at the end.
+ */
+int
+index_cursorDoc(index_cursor_t* cursor, int* count)
+{
+  assert(cursor != NULL && count != NULL);
 
-    // print the key -- count pairs to file. 
-    fprintf(fp, " %d %d", key, count);
+  if (cursor->k >= cursor->n) {
+    *count = 0;
+    return INT_MAX;
   }
+  *count = cursor->counts[cursor->k];
+  return cursor->docIDs[cursor->k];
 }
 
 /**
- * @function: printWord
- * @brief: static helper function to print words
- * and call printCounts for their respective counters.
+ * @function: index_cursorSeek
+ * @brief: see index.h for full documentation.
  * 
- * Inputs:
- * @param arg: pointer to an object, expected to be a file.
- * @param key: key in set -- word
- * @param item: pointer to object associated to key; expected type counters-t
+ * The blocks that end below target are passed over by their maxima;
+ * a mapped word's, by its skip table, without unpacking them.
  * 
- * Returns: none.
+ * @param cursor: the cursor.
+ * @param target: the docID to seek.
  */
-static void
-printWord(void* arg, const char* key, void* item)
+void
+index_cursorSeek(index_cursor_t* cursor, const int target)
 {
-  assert(arg != NULL);
+  assert(cursor != NULL);
 
-  FILE* fp;
-  if ((fp = (FILE*) arg) != NULL) {
-    // print the key (word) to file
-    fprintf(fp, "%s", key);
+  while (cursor->block < cursor->nBlocks && cursor->blocks[cursor->block].last < target) {
+    cursor->block++;
+  }
+
+  /* unpacked: start from the first posting of the block, if it is ahead */
+  if (cursor->reader == NULL) {
+    long start = (long) cursor->block * POSTINGS_BLOCK;
+    if (cursor->k < start) {
+      cursor->k = (start < cursor->n) ? (int) start : cursor->n;
+    }
+  }
+  while (cursor->k < cursor->n && cursor->docIDs[cursor->k] < target) {
+    cursor->k++;
+  }
+
+  /* packed: unpack the block holding the first docID at or above target, if any */
+  while (cursor->k == cursor->n && !cursor->done) {
+    postings_reader_seek(cursor->reader, target);
+    int n = postings_reader_next(cursor->reader, cursor->docIDs, cursor->counts);
+    cursor->n = (n > 0) ? n : 0;
+    cursor->k = 0;
+    cursor->done = (n <= 0);
+    while (cursor->k < cursor->n && cursor->docIDs[cursor->k] < target) {
+      cursor->k++;
+    }
+  }
+}
+
+/**
+ * @function: index_cursorMax
+ * @brief: see index.h for full documentation.
+ * 
+ * @param cursor: the cursor.
+ * @param minTokens: where to save the fewest words indexed from any
+ * of the postings' documents.
+ * 
+ * Returns:
+ * @return int: the largest count of all the postings.
+ */
+int
+index_cursorMax(index_cursor_t* cursor, int* minTokens)
+{
+  assert(cursor != NULL && minTokens != NULL);
+
+  *minTokens = cursor->all.minTokens;
+  return cursor->all.maxCount;
+}
+
+/**
+ * @function: index_cursorBlock
+ * @brief: see index.h for full documentation.
+ * 
+ * @param cursor: the cursor.
+ * @param target: a docID, no lower than any sought.
+ * @param maxCount: where to save the block's largest count.
+ * @param minTokens: where to save the fewest words indexed from any of its documents.
+ * 
+ * Returns:
+ * @return int: the last docID of the block; INT_MAX if no posting is at or above target.
+ */
+int
+index_cursorBlock(index_cursor_t* cursor, const int target, int* maxCount, int* minTokens)
+{
+  assert(cursor != NULL && maxCount != NULL && minTokens != NULL);
+
+  int b = cursor->block;
+  while (b < cursor->nBlocks && cursor->blocks[b].last < target) {
+    b++;
+  }
+  if (b == cursor->nBlocks) {
+    *maxCount = *minTokens = 0;
+    return INT_MAX;
+  }
+  *maxCount = cursor->blocks[b].maxCount;
+  *minTokens = cursor->blocks[b].minTokens;
+  return cursor->blocks[b].last;
+}
+
+/**
+ * @function: index_cursorDelete
+ * @brief: see index.h for full documentation.
+ */
+void
+index_cursorDelete(index_cursor_t* cursor)
+{
+  if (cursor != NULL) {
+    postings_reader_delete(cursor->reader);
+    mem_free(cursor->docIDs);
+    mem_free(cursor->counts);
+    mem_free(cursor->blocks);
+    mem_free(cursor);
+  }
+}
+
+/**
+ * @function: index_docRange
+ * @brief: see index.h for full documentation.
+ * 
+ * @param index: the index.
+ * @param first: where to save the smallest docID.
+ * @param last: where to save the largest docID.
+ * 
+ * Returns:
+ * @return true: the index holds some postings.
+ * @return false: it holds none; *first and *last are 0.
+ */
+bool
+index_docRange(index_t* index, int* first, int* last)
+{
+  assert(index != NULL && first != NULL && last != NULL);
+
+  if (index->mapped != NULL) {
+    /* saved in the header */
+    *first = index->mapped->layout.firstDoc;
+    *last = index->mapped->layout.lastDoc;
+  }
+  else {
+    int range[2] = { 0, 0 };
+    index_iterate(index, range, rangeWord);
+    for (int i = 0; i < index->nDocs; i++) {
+      rangeCount(range, index->docs[i].docID, 0);
+    }
+    *first = range[0];
+    *last = range[1];
+  }
+  return *last > 0;
+}
+
+/**
+ * @function: index_setDoc
+ * @brief: see index.h for full documentation.
+ * 
+ * @param index: pointer to a valid index object, not mapped.
+ * @param docID: the document.
+ * @param doc: what to record of it; its URL is copied.
+ */
+void
+index_setDoc(index_t* index, const int docID, const index_doc_t* doc)
+{
+  assert(index != NULL && doc != NULL && index->mapped == NULL && docID > 0);
+
+  if (index->nDocs == index->docSlots) {
+    index->docSlots = 2 * index->docSlots + 16;
+    docentry_t* docs = mem_malloc_assert(index->docSlots * sizeof(docentry_t), "mem alloc for document table failed.");
+    if (index->docs != NULL) {
+      memcpy(docs, index->docs, index->nDocs * sizeof(docentry_t));
+      mem_free(index->docs);
+    }
+    index->docs = docs;
+  }
+
+  docentry_t* entry = &index->docs[index->nDocs++];
+  entry->docID = docID;
+  entry->doc = *doc;
+  entry->doc.url = mem_arena_strdup(index->arena, doc->url != NULL ? doc->url : "");
+  if (index->nDocs > 1 && docID <= index->docs[index->nDocs - 2].docID) {
+    index->docsSorted = false;
+  }
+}
+
+/**
+ * @function: index_getDoc
+ * @brief: see index.h for full documentation.
+ * 
+ * @param index: pointer to a valid index object.
+ * @param docID: the document.
+ * @param doc: where to save what is recorded of it.
+ * 
+ * Returns:
+ * @return true: the document is in the table.
+ * @return false: it is not; *doc is unchanged.
+ */
+bool
+index_getDoc(index_t* index, const int docID, index_doc_t* doc)
+{
+  assert(index != NULL && doc != NULL);
+
+  /* a mapped index: the entry for docID is where docID says */
+  if (index->mapped != NULL) {
+    const layout_t* layout = &index->mapped->layout;
+    if (docID < layout->docsFirst || (int64_t) docID - layout->docsFirst >= layout->nDocs) {
+      return false;
+    }
+    return readDoc(layout, docID - layout->docsFirst, doc);
+  }
+
+  /* else binary-search the table, sorted */
+  sortDocs(index);
+  int lo = 0, hi = index->nDocs - 1;
+  while (lo <= hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (index->docs[mid].docID < docID) {
+      lo = mid + 1;
+    }
+    else if (index->docs[mid].docID > docID) {
+      hi = mid - 1;
+    }
+    else {
+      *doc = index->docs[mid].doc;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @function: index_docStats
+ * @brief: see index.h for full documentation.
+ * 
+ * @param index: the index.
+ * @param nDocs: where to save how many documents its table holds.
+ * @param nTokens: where to save how many words were indexed from them.
+ */
+void
+index_docStats(index_t* index, long* nDocs, long* nTokens)
+{
+  assert(index != NULL && nDocs != NULL && nTokens != NULL);
+
+  if (index->mapped != NULL) {
+    /* saved in the header */
+    *nDocs = (long) index->mapped->layout.docsKept;
+    *nTokens = (long) index->mapped->layout.docsTokens;
+    return;
+  }
+  *nDocs = index->nDocs;
+  *nTokens = 0;
+  for (int i = 0; i < index->nDocs; i++) {
+    *nTokens += index->docs[i].doc.tokens;
+  }
+}
+
+
+/**
+ * @function: index_set
+ * @brief: see index.h for full documentation.
+ * 
+ * @param index: pointer to a valid index object.
+ * @param word: word to be inserted.
+ * @param docID: document ID where word was found.
+ * @param count: pre-determined count of word in the document ID.
+ */
+void
+index_set(index_t* index, char* word, int docID, int count)
+{
+  assert(index != NULL && word != NULL && index->mapped == NULL);
+
+  size_t len = strlen(word);     // hash the word without re-scanning it
+  counters_t* ctrs;
+  if ((ctrs = hashtable_find_len(index->ht, word, len)) != NULL) {
+    counters_set(ctrs, docID, count);
+  }
+  else {
+    ctrs = counters_new();
+    counters_set(ctrs, docID, count);
+    hashtable_insert_len(index->ht, word, len, ctrs);
+  }
+}
+
+/**
+ * @function: index_iterate()
+ * @brief: see index.h for full documentation.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object.
+ * @param arg: pointer to an argument, e.g. a file.
+ * @param itemfunc: pointer to a function.
+ * 
+ * Returns: none.
+ */
+void 
+index_iterate(index_t* index, void* arg, 
+void (*itemfunc)(void* arg, const char* key, void* item))
+{
+  assert(index != NULL);
+  
+  /*
+   * Get hashtable in index, 
+   * if hashtable is NULL do nothing.
+   */
+  hashtable_t* ht = index->ht;
+  if (ht != NULL) {
+
+    // call hashtable_iterate() over the hashtable.
+    hashtable_iterate(ht, arg, itemfunc);
+  }
+  else if (index->mapped != NULL) {
+
+    // a mapped index: each word of the dictionary, in order.
+    termreader_t reader;
+    termsStart(&reader, &index->mapped->layout, 0);
+    const char* word;
+    while ( (word = termsNext(&reader)) != NULL) {
+      counters_t* ctrs;
+      if ( (ctrs = mappedCounters(index->mapped, reader.i - 1)) != NULL) {
+        itemfunc(arg, word, ctrs);
+      }
+    }
+    termsEnd(&reader);
+  }
+}
+
+/**
+ * @function: index_print()
+ * @brief: see index.h for full documentation.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object
+ * @param fp: pointer to a file.
+ * 
+ * Returns: none.
+ */
+void 
+index_print (index_t* index, FILE* fp)
+{
+  assert(index != NULL);
+  assert(fp != NULL);
+
+  // print the words in sorted order, so the same index prints the same file
+  index_printSorted(index, fp);
+}
+
+/**
+ * @function: index_merge()
+ * @brief: see index.h for full documentation.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object to merge into.
+ * @param part: pointer to an index object to merge from, and delete.
+ * 
+ * Returns: none.
+ */
+void
+index_merge(index_t* index, index_t* part)
+{
+  assert(index != NULL && part != NULL);
+  assert(index->mapped == NULL && part->mapped == NULL);
+
+  /*
+   * move each word's counters into index (or fold them into its own);
+   * either way part's counters are used up,
+   * so its hashtable is deleted without deleting its items.
+   */
+  hashtable_iterate(part->ht, index, mergeWord);
+  hashtable_delete(part->ht, NULL);
+
+  /*
+   * the positions: part's follow index's, word by word, as its postings do;
+   * kept only if both indexes keep them
+   */
+  if (index->pos != NULL && part->pos != NULL) {
+    hashtable_iterate(part->pos, index, mergePositions);
+    hashtable_delete(part->pos, NULL);
+  }
+  else {
+    if (index->pos != NULL) {
+      hashtable_delete(index->pos, deletePositions);
+      index->pos = NULL;
+    }
+    if (part->pos != NULL) {
+      hashtable_delete(part->pos, deletePositions);
+    }
+  }
+
+  /* the document table: copied, since its URLs are in part's arena */
+  for (int i = 0; i < part->nDocs; i++) {
+    index_setDoc(index, part->docs[i].docID, &part->docs[i].doc);
+  }
+  if (part->docs != NULL) {
+    mem_free(part->docs);
+  }
+  mem_arena_delete(part->arena);
+  mem_free(part);
+}
+
+/**
+ * @function: index_printSorted()
+ * @brief: see index.h for full documentation.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object
+ * @param fp: pointer to a file.
+ * 
+ * Returns: none.
+ */
+void
+index_printSorted(index_t* index, FILE* fp)
+{
+  assert(index != NULL);
+  assert(fp != NULL);
+
+  /* a mapped index iterates in dictionary order already */
+  if (index->mapped != NULL) {
+    index_iterate(index, fp, printWord);
+    return;
+  }
+
+  /* gather the words and their counters into an array */
+  int nWords = 0;
+  index_iterate(index, &nWords, countWord);
+  wordentry_t* entries = mem_malloc_assert((nWords + 1) * sizeof(wordentry_t), "mem alloc for sorted words failed.");
+  wordentry_t* next = entries;
+  index_iterate(index, &next, collectWord);
+
+  /* sort by word and print in that order */
+  qsort(entries, nWords, sizeof(wordentry_t), compareWords);
+  for (int i = 0; i < nWords; i++) {
+    printWord(fp, entries[i].word, entries[i].ctrs);
+  }
+
+  mem_free(entries);
+}
+
+/**
+ * @function: index_save()
+ * @brief: see index.h for full documentation.
+ * 
+ * The postings are packed first, since the dictionary holds their offsets;
+ * then the file is laid out in one buffer, so that the checksum
+ * -- which must precede the bytes it covers -- can go in the header,
+ * and written in one call.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object
+ * @param fp: pointer to a file.
+ * 
+ * Returns:
+ * @return true: the index was written.
+ * @return false: error writing the file.
+ */
+bool
+index_save(index_t* index, FILE* fp)
+{
+  assert(index != NULL);
+  assert(fp != NULL);
+
+  /* gather the words and their counters, in sorted order */
+  int nWords = 0;
+  index_iterate(index, &nWords, countWord);
+  wordentry_t* entries = mem_malloc_assert((nWords + 1) * sizeof(wordentry_t), "mem alloc for sorted words failed.");
+  wordentry_t* next = entries;
+  index_iterate(index, &next, collectWord);
+  qsort(entries, nWords, sizeof(wordentry_t), compareWords);
+
+  /* size the dictionary, the words, before front-coding, and their maxima */
+  size_t wordsSize = 0;
+  uint64_t nPostings = 0;
+  size_t packedMax = 0;
+  int maxCount = 0;
+  size_t nMaxima = 0;
+  for (int i = 0; i < nWords; i++) {
+    int count = counters_size(entries[i].ctrs);
+    wordsSize += strlen(entries[i].word);
+    nPostings += count;
+    packedMax += postings_maxBytes(count);
+    maxCount = (count > maxCount) ? count : maxCount;
+    nMaxima += 1 + ((count > POSTINGS_BLOCK) ? (count + POSTINGS_BLOCK - 1) / POSTINGS_BLOCK : 0);
+  }
+
+  /*
+   * pack each word's postings, end to end, and note the maxima of each
+   * block of them, from the document table saved with them -- none,
+   * for an index from index_open(), which saves none
+   */
+  int* keys = mem_malloc_assert((maxCount + 1) * sizeof(int), "mem alloc for postings failed.");
+  int* counts = mem_malloc_assert((maxCount + 1) * sizeof(int), "mem alloc for postings failed.");
+  unsigned char* packed = mem_malloc_assert(packedMax + 1, "mem alloc for postings failed.");
+  size_t* packedOffsets = mem_malloc_assert((nWords + 1) * sizeof(size_t), "mem alloc for postings failed.");
+  blockmax_t* blocks = mem_malloc_assert((maxCount / POSTINGS_BLOCK + 1) * sizeof(blockmax_t), "mem alloc for maxima failed.");
+  unsigned char* maxima = mem_malloc_assert(nWords * 8 + nMaxima * MAX_SIZE + 1, "mem alloc for maxima failed.");
+  size_t packedSize = 0, maximaSize = 0;
+  int firstDoc = 0, lastDoc = 0;
+  for (int i = 0; i < nWords; i++) {
+    postings_t postings = { keys, counts };
+    counters_iterate(entries[i].ctrs, &postings, saveCount);
+    packedOffsets[i] = packedSize;
+    int count = counters_size(entries[i].ctrs);
+    packedSize += postings_encode(postings_codecFor(count), keys, counts, count, packed + packedSize);
+    if (count > 0) {
+      firstDoc = (firstDoc == 0 || keys[0] < firstDoc) ? keys[0] : firstDoc;
+      lastDoc = (keys[count - 1] > lastDoc) ? keys[count - 1] : lastDoc;
+    }
+
+    blockmax_t all;
+    int nBlocks = wordMaxima(index->mapped == NULL ? index : NULL, keys, counts, count, blocks, &all);
+    put64(maxima + i * 8, maximaSize);
+    putMaxima(maxima + nWords * 8 + maximaSize * MAX_SIZE, &all);
+    maximaSize++;
+    for (int b = 0; b < nBlocks && nBlocks > 1; b++) {
+      putMaxima(maxima + nWords * 8 + maximaSize * MAX_SIZE, &blocks[b]);
+      maximaSize++;
+    }
+  }
+
+  /* the document table covers its docIDs, first to last, in order */
+  sortDocs(index);
+  size_t nDocs = 0, urlsSize = 0;
+  int docsFirst = 0;
+  uint64_t docsTokens = 0;
+  if (index->nDocs > 0) {
+    docsFirst = index->docs[0].docID;
+    nDocs = (size_t) index->docs[index->nDocs - 1].docID - docsFirst + 1;
+    for (int i = 0; i < index->nDocs; i++) {
+      urlsSize += strlen(index->docs[i].doc.url) + 1;
+      docsTokens += index->docs[i].doc.tokens;
+    }
+    firstDoc = (firstDoc == 0 || docsFirst < firstDoc) ? docsFirst : firstDoc;
+    lastDoc = (index->docs[index->nDocs - 1].docID > lastDoc) ? index->docs[index->nDocs - 1].docID : lastDoc;
+  }
+
+  /*
+   * front-code the words, a block at a time: each word as the bytes
+   * it shares with the word before, and the rest -- sorted words share
+   * long prefixes -- except the first of a block, whole,
+   * so that a lookup can start at any block
+   */
+  int nBlocks = (nWords + DICT_BLOCK - 1) / DICT_BLOCK;
+  unsigned char* terms = mem_malloc_assert(wordsSize + 10 * (size_t) nWords + 1, "mem alloc for dictionary failed.");
+  uint32_t* blockOffsets = mem_malloc_assert((nBlocks + 1) * sizeof(uint32_t), "mem alloc for dictionary failed.");
+  size_t termsSize = 0;
+  for (int i = 0; i < nWords; i++) {
+    const char* word = entries[i].word;
+    size_t shared = 0;
+    if (i % DICT_BLOCK == 0) {
+      blockOffsets[i / DICT_BLOCK] = termsSize;
+    }
+    else {
+      const char* last = entries[i - 1].word;
+      while (word[shared] != '\0' && word[shared] == last[shared]) {
+        shared++;
+      }
+    }
+    size_t len = strlen(word + shared);
+    termsSize += putVarint(terms + termsSize, shared);
+    termsSize += putVarint(terms + termsSize, len);
+    memcpy(terms + termsSize, word + shared, len);
+    termsSize += len;
+  }
+
+  size_t dictOffset = HEADER_SIZE;
+  size_t blocksOffset = dictOffset + nWords * ENTRY_SIZE;
+  size_t termsOffset = blocksOffset + nBlocks * 4;
+  size_t postingsOffset = termsOffset + termsSize;
+  size_t docsOffset = postingsOffset + packedSize;
+  size_t urlsOffset = docsOffset + nDocs * DOC_SIZE;
+
+  size_t maximaOffset = urlsOffset + urlsSize;
+
+  /* the positions, if kept: an offset a word, then each word's in turn */
+  size_t positionsOffset = 0, positionsSize = 0;
+  if (index->pos != NULL) {
+    positionsOffset = maximaOffset + nWords * 8 + nMaxima * MAX_SIZE;
+    positionsSize = nWords * 8;
+    for (int i = 0; i < nWords; i++) {
+      positions_t* positions = hashtable_find(index->pos, entries[i].word);
+      positionsSize += (positions != NULL) ? positions->len : 0;
+    }
+  }
+  size_t fileSize = maximaOffset + nWords * 8 + nMaxima * MAX_SIZE + positionsSize;
+  unsigned char* buf = mem_calloc_assert(fileSize, 1, "mem alloc for index file failed.");
+
+  /* the dictionary, the block index, the words, and the postings */
+  for (int i = 0; i < nWords; i++) {
+    unsigned char* entry = buf + dictOffset + i * ENTRY_SIZE;
+    put64(entry, packedOffsets[i]);
+    put32(entry + 8, counters_size(entries[i].ctrs));
+  }
+  for (int b = 0; b < nBlocks; b++) {
+    put32(buf + blocksOffset + b * 4, blockOffsets[b]);
+  }
+  memcpy(buf + termsOffset, terms, termsSize);
+  memcpy(buf + postingsOffset, packed, packedSize);
+
+  /* the document table, and the URL pool; docIDs it lacks have no URL */
+  for (size_t i = 0; i < nDocs; i++) {
+    put32(buf + docsOffset + i * DOC_SIZE, NO_URL);
+  }
+  size_t urlOffset = 0;
+  for (int i = 0; i < index->nDocs; i++) {
+    const index_doc_t* doc = &index->docs[i].doc;
+    unsigned char* entry = buf + docsOffset + (size_t) (index->docs[i].docID - docsFirst) * DOC_SIZE;
+    size_t len = strlen(doc->url);
+    put32(entry, urlOffset);
+    put32(entry + 4, doc->depth);
+    put32(entry + 8, doc->tokens);
+    put32(entry + 12, doc->bytes);
+    memcpy(buf + urlsOffset + urlOffset, doc->url, len + 1);
+    urlOffset += len + 1;
+  }
+
+  memcpy(buf + maximaOffset, maxima, nWords * 8 + nMaxima * MAX_SIZE);
+
+  if (index->pos != NULL) {
+    size_t offset = 0;
+    unsigned char* bytes = buf + positionsOffset + nWords * 8;
+    for (int i = 0; i < nWords; i++) {
+      positions_t* positions = hashtable_find(index->pos, entries[i].word);
+      put64(buf + positionsOffset + i * 8, offset);
+      if (positions != NULL) {
+        memcpy(bytes + offset, positions->bytes, positions->len);
+        offset += positions->len;
+      }
+    }
+  }
+
+  /* the header, last, since it holds the checksum of the rest */
+  memcpy(buf, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  put32(buf + 8, INDEX_VERSION);
+  put32(buf + 12, HEADER_SIZE);
+  put64(buf + 16, nWords);
+  put64(buf + 24, nPostings);
+  put64(buf + 32, dictOffset);
+  put64(buf + 40, postingsOffset);
+  put64(buf + 48, fileSize);
+  put32(buf + 64, firstDoc);
+  put32(buf + 68, lastDoc);
+  put64(buf + 72, docsOffset);
+  put32(buf + 80, nDocs);
+  put32(buf + 84, docsFirst);
+  put64(buf + 88, positionsOffset);
+  put64(buf + 96, index->nDocs);
+  put64(buf + 104, docsTokens);
+  put64(buf + 112, maximaOffset);
+  put64(buf + 56, hash_wy(buf + HEADER_SIZE, fileSize - HEADER_SIZE, 0));
+
+  bool ok = fwrite(buf, 1, fileSize, fp) == fileSize;
+
+  mem_free(buf);
+  mem_free(maxima);
+  mem_free(blocks);
+  mem_free(blockOffsets);
+  mem_free(terms);
+  mem_free(packedOffsets);
+  mem_free(packed);
+  mem_free(counts);
+  mem_free(keys);
+  mem_free(entries);
+  return ok;
+}
+
+/**
+ * @function: index_mergeRuns()
+ * @brief: see index.h for full documentation.
+ * 
+ * Keeps the runs in a binary min-heap, ordered by current word
+ * and, for equal words, by position in runFiles;
+ * each step takes the smallest word and the postings of every run
+ * that has it, copying the postings text through unparsed.
+ * 
+ * Inputs:
+ * @param runFiles: paths to the runs, in order.
+ * @param nRuns: number of runs.
+ * @param fp: pointer to the file wherein to write the merged index.
+ * 
+ * Returns:
+ * @return true: the runs were merged.
+ * @return false: a run could not be opened; nothing was written.
+ */
+bool
+index_mergeRuns(char** runFiles, const int nRuns, FILE* fp)
+{
+  assert(runFiles != NULL && fp != NULL);
+
+  /*
+   * open every run; they are read through buffers, not mapped,
+   * so that merging runs larger than memory stays within it.
+   */
+  run_t* runs = mem_calloc_assert(nRuns + 1, sizeof(run_t), "mem alloc for runs failed.");
+  int* heap = mem_malloc_assert((nRuns + 1) * sizeof(int), "mem alloc for run heap failed.");
+  bool ok = true;
+  for (int i = 0; i < nRuns && ok; i++) {
+    if ( (runs[i].fp = fopen(runFiles[i], "r")) == NULL) {
+      fprintf(stderr, "Error accessing run file: '%s'\n", runFiles[i]);
+      ok = false;
+    }
+    else {
+      runs[i].reader = mem_assert(file_reader_new(runs[i].fp), "mem alloc for run reader failed.");
+    }
+  }
+
+  size_t wordSize = 64;                   // capacity of word[]
+  char* word = mem_malloc_assert(wordSize, "mem alloc for merged word failed.");
+
+  if (ok) {
+    /* heap of the runs that have a line */
+    int size = 0;
+    for (int i = 0; i < nRuns; i++) {
+      if (runNext(&runs[i])) {
+        heap[size++] = i;
+      }
+    }
+    for (int i = size/2 - 1; i >= 0; i--) {
+      heapDown(runs, heap, size, i);
+    }
+
+    /*
+     * take the smallest word, and its postings from every run that has it;
+     * the word is copied, since a run's line goes when the run advances.
+     */
+    while (size > 0) {
+      run_t* first = &runs[heap[0]];
+      size_t wordLen = first->wordLen;
+      if (wordLen > wordSize) {
+        while (wordLen > wordSize) {
+          wordSize *= 2;
+        }
+        mem_free(word);
+        word = mem_malloc_assert(wordSize, "mem alloc for merged word failed.");
+      }
+      memcpy(word, first->line, wordLen);
+      fwrite(word, 1, wordLen, fp);
+
+      while (size > 0) {
+        run_t* run = &runs[heap[0]];
+        if (run->wordLen != wordLen || memcmp(run->line, word, wordLen) != 0) {
+          break;
+        }
+        fwrite(run->line + wordLen, 1, run->len - wordLen, fp);
+
+        if (!runNext(run)) {
+          heap[0] = heap[--size];
+        }
+        heapDown(runs, heap, size, 0);
+      }
+      fputc('\n', fp);
+    }
+  }
+
+  /* close every run */
+  for (int i = 0; i < nRuns; i++) {
+    file_reader_delete(runs[i].reader);
+    if (runs[i].fp != NULL) {
+      fclose(runs[i].fp);
+    }
+  }
+  mem_free(word);
+  mem_free(heap);
+  mem_free(runs);
+  return ok;
+}
+
+/**
+ * @function: index_delete()
+ * @brief: see index.h for full documentation.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object to be deleted.
+ * 
+ * Returns: none.
+ */
+void 
+index_delete(index_t* index)
+{
+  assert(index != NULL);
+
+  /* a mapped index: the counters it decoded, and the file */
+  if (index->mapped != NULL) {
+    mapped_t* mapped = index->mapped;
+    for (uint64_t i = 0; i < mapped->layout.nWords; i++) {
+      if (mapped->ctrs[i] != NULL) {
+        counters_delete(mapped->ctrs[i]);
+      }
+    }
+    mem_free(mapped->ctrs);
+    mapfile_close(mapped->map);
+    mem_free(mapped);
+    mem_free(index);
+    return;
+  }
+
+  /*
+   * call hashtable_delete() for the hashtable in the index,
+   * with the deleter for counters.
+   */
+  hashtable_delete(index->ht, deleteCounter);
+  if (index->pos != NULL) {
+    hashtable_delete(index->pos, deletePositions);
+  }
+
+  // free the document table; its URLs are in the arena.
+  if (index->docs != NULL) {
+    mem_free(index->docs);
+  }
+
+  // free the words and nodes of the hashtable, all at once.
+  mem_arena_delete(index->arena);
+
+  // free the memory allocated to the index object.
+  mem_free(index);
+}
+
+/**
+ * @function: index_load
+ * @brief: See index.h for full documentation.
+ * 
+ * Inputs:
+ * @param pageDirectory: page directory to search for saved webpages
+ * 
+ * Outputs:
+ * @return index_t*: a pointer to the created index struct
+ * @return NULL: Error reading from file, creating struct, or some other error occurred.
+ */
+index_t*
+index_load(const char* indexFileName)
+{
+
+  /*
+   * if error opening file, return NULL;
+   * the index file is mapped (or, failing that, read) into memory whole.
+   */
+  mapfile_t* indexMap;
+  if ( (indexMap = mapfile_open(indexFileName)) == NULL) {
+    fprintf(stderr, "Error accessing index file: '%s'\n", indexFileName);
+    return NULL;
+  }
+  mapfile_advise(indexMap, MAPFILE_SEQUENTIAL);
+  /* log progress */
+  // logProgress(0, "output", output);
+
+  /* a binary index starts with its magic number; a text one, with a word */
+  const unsigned char* data = (const unsigned char*) mapfile_data(indexMap);
+  size_t size = mapfile_size(indexMap);
+  if (size >= sizeof(INDEX_MAGIC) && memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0) {
+    index_t* index = loadBinary(data, size, indexFileName);
+    mapfile_close(indexMap);
+    return index;
+  }
+
+  /*
+   * If error initializing index, return NULL
+   */
+  index_t* index;
+  if ( (index = index_new()) == NULL) {
+    mapfile_close(indexMap);
+    return NULL;
+  }
+
+  /*
+   * each line is a word followed by (docID, count) pairs;
+   * read it as a slice of the mapped file, and parse it in place.
+   * The slice is read-only and not null-terminated, so the word
+   * is copied out (and normalized) into a buffer of our own.
+   */
+  file_reader_t* reader;
+  if ( (reader = file_reader_newMem(mapfile_data(indexMap),
+                                    mapfile_size(indexMap))) == NULL) {
+    index_delete(index);
+    mapfile_close(indexMap);
+    return NULL;
+  }
+
+  size_t wordSize = 64;                   // capacity of word[]
+  char* word = mem_malloc_assert(wordSize, "index_load word");
+
+  char* line;
+  size_t len;
+  while ( (line = file_reader_line(reader, &len)) != NULL) {
+    const char* end = line + len;
+
+    // the word runs up to the first space
+    const char* space = memchr(line, ' ', len);
+    size_t wordLen = (space != NULL) ? (size_t) (space - line) : len;
+
+    /* skip lines that do not start with a word */
+    if (wordLen == 0 || isalpha(line[0]) == 0) {
+      continue;
+    }
+
+    // copy and normalize the word
+    if (wordLen + 1 > wordSize) {
+      while (wordLen + 1 > wordSize) {
+        wordSize *= 2;
+      }
+      mem_free(word);
+      word = mem_malloc_assert(wordSize, "index_load word");
+    }
+    memcpy(word, line, wordLen);
+    word[wordLen] = '\0';
+    normalizeWord(word);
+
+    /* log progress */
+    // logProgress(2, "word", word);
+
+    /* insert each (document ID, count) pair into the index */
+    const char* rest = line + wordLen;
+    int docID, count;
+    while (parseInt(&rest, end, &docID) && parseInt(&rest, end, &count)) {
+      index_set(index, word, docID, count);
+    }
+  }
+
+  mem_free(word);
+  file_reader_delete(reader);
+
+  // unmap the file
+  mapfile_close(indexMap);
+
+  /* return re-created index */
+  return index;
+
+} /* end of index_load() */
+
+/**
+ * @function: index_open
+ * @brief: See index.h for full documentation.
+ * 
+ * Opening checks only the header, in constant time;
+ * each dictionary entry is checked when a lookup first reaches it.
+ * 
+ * Inputs:
+ * @param indexFileName: path to the index file.
+ * 
+ * Outputs:
+ * @return index_t*: a pointer to the index struct
+ * @return NULL: Error reading from file, or the file is not a valid index.
+ */
+index_t*
+index_open(const char* indexFileName)
+{
+  mapfile_t* indexMap;
+  if ( (indexMap = mapfile_open(indexFileName)) == NULL) {
+    fprintf(stderr, "Error accessing index file: '%s'\n", indexFileName);
+    return NULL;
+  }
+
+  /* a text index is loaded as index_load would */
+  const unsigned char* data = (const unsigned char*) mapfile_data(indexMap);
+  size_t size = mapfile_size(indexMap);
+  if (size < sizeof(INDEX_MAGIC) || memcmp(data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+    mapfile_close(indexMap);
+    return index_load(indexFileName);
+  }
+
+  layout_t layout;
+  const char* error;
+  if ( (error = readLayout(data, size, false, &layout)) != NULL) {
+    fprintf(stderr, "Error reading index file: '%s': %s\n", indexFileName, error);
+    mapfile_close(indexMap);
+    return NULL;
+  }
+
+  // lookups go wherever the query words lead
+  mapfile_advise(indexMap, MAPFILE_RANDOM);
+
+  index_t* index = mem_malloc_assert(sizeof(index_t), "mem alloc for index failed.");
+  index->ht = NULL;
+  index->arena = NULL;
+  index->docs = NULL;
+  index->nDocs = index->docSlots = 0;
+  index->docsSorted = true;
+  index->pos = NULL;
+  index->mapped = mem_malloc_assert(sizeof(mapped_t), "mem alloc for mapped index failed.");
+  index->mapped->map = indexMap;
+  index->mapped->layout = layout;
+  index->mapped->ctrs = mem_calloc_assert(layout.nWords + 1, sizeof(counters_t*), "mem alloc for index counters failed.");
+  return index;
+}
+
+
+
+
+/********** Static functions definitions ************/
+
+/**
+ * @function: printCounts()
+ * @brief: static helper function to print counters_t objects.
+ * 
+ * Inputs:
+ * @param arg: pointer to an object expected to be file. 
+ * @param key: key from counter
+ * @param count: value associated to key in counter.
+ */
+static void
+printCounts(void* arg, int key, int count)
+{
+  assert(arg != NULL);
+
+  FILE* fp;
+  if ( (fp = (FILE*) arg) != NULL) {
+
+    // print the key -- count pairs to file. 
+    fprintf(fp, " %d %d", key, count);
+  }
+}
+
+/**
+ * @function: printWord
+ * @brief: static helper function to print words
+ * and call printCounts for their respective counters.
+ * 
+ * Inputs:
+ * @param arg: pointer to an object, expected to be a file.
+ * @param key: key in set -- word
+ * @param item: pointer to object associated to key; expected type counters-t
+ * 
+ * Returns: none.
+ */
+static void
+printWord(void* arg, const char* key, void* item)
+{
+  assert(arg != NULL);
+
+  FILE* fp;
+  if ((fp = (FILE*) arg) != NULL) {
+    // print the key (word) to file
+    fprintf(fp, "%s", key);
+
+    /*
+     * iterate over the counters with the file
+     * and the function to print counts.
+     */
+    counters_t* ctrs = (counters_t*) item;
+    counters_iterate(ctrs, fp, printCounts);
+
+    // print a new line.
+    fprintf(fp, "\n");
+  }
+}
+
+/**
+ * @function: parseInt()
+ * @brief: static helper function to parse a non-negative decimal integer,
+ * after any spaces, from text that is not null-terminated.
+ * 
+ * Inputs:
+ * @param p: pointer to the current position in the text; advanced past
+ *           the integer on success.
+ * @param end: end of the text.
+ * @param value: where to store the integer.
+ * 
+ * Returns:
+ * @return true: an integer was parsed.
+ * @return false: no digits before the end of the text, or a non-digit.
+ */
+static bool
+parseInt(const char** p, const char* end, int* value)
+{
+  const char* q = *p;
+
+  // skip spaces
+  while (q < end && *q == ' ') {
+    q++;
+  }
+
+  // accumulate digits
+  if (q == end || !isdigit((unsigned char) *q)) {
+    return false;
+  }
+  int n = 0;
+  while (q < end && isdigit((unsigned char) *q)) {
+    n = 10 * n + (*q++ - '0');
+  }
+
+  *value = n;
+  *p = q;
+  return true;
+}
+
+/**
+ * @function: mergeWord()
+ * @brief: static helper function for index_merge:
+ * moves one word's counters into the index,
+ * or, if the index already has the word, appends them to its counters.
+ * 
+ * Inputs:
+ * @param arg: pointer to the index merged into.
+ * @param key: the word.
+ * @param item: the word's counters in the index merged from.
+ */
+static void
+mergeWord(void* arg, const char* key, void* item)
+{
+  index_t* index = (index_t*) arg;
+  counters_t* ctrs = (counters_t*) item;
+
+  size_t len = strlen(key);
+  counters_t* existing;
+  if ((existing = hashtable_find_len(index->ht, key, len)) != NULL) {
+    counters_iterate(ctrs, existing, mergeCount);
+    counters_delete(ctrs);
+  }
+  else {
+    hashtable_insert_len(index->ht, key, len, ctrs);
+  }
+}
+
+/**
+ * @function: mergeCount()
+ * @brief: static helper function for mergeWord: sets one count.
+ * 
+ * Inputs:
+ * @param arg: pointer to the counters to set the count in.
+ * @param key: document ID.
+ * @param count: count in that document.
+ */
+static void
+mergeCount(void* arg, int key, int count)
+{
+  counters_set((counters_t*) arg, key, count);
+}
+
+/**
+ * @function: countWord()
+ * @brief: static helper function for index_printSorted: counts one word.
+ * 
+ * @param arg: pointer to the int count.
+ */
+static void
+countWord(void* arg, const char* key, void* item)
+{
+  (*(int*) arg)++;
+}
+
+/**
+ * @function: collectWord()
+ * @brief: static helper function for index_printSorted:
+ * saves one word and its counters at the next free entry.
+ * 
+ * @param arg: pointer to the pointer to the next free entry.
+ * @param key: the word.
+ * @param item: the word's counters.
+ */
+static void
+collectWord(void* arg, const char* key, void* item)
+{
+  wordentry_t** next = (wordentry_t**) arg;
+  (*next)->word = key;
+  (*next)->ctrs = (counters_t*) item;
+  (*next)++;
+}
+
+/**
+ * @function: compareWords()
+ * @brief: static helper function for qsort: orders entries by word.
+ */
+static int
+compareWords(const void* a, const void* b)
+{
+  return strcmp(((const wordentry_t*) a)->word, ((const wordentry_t*) b)->word);
+}
+
+/**
+ * @function: runNext()
+ * @brief: static helper function for index_mergeRuns:
+ * advances a run to its next line that starts with a word.
+ * 
+ * @param run: pointer to the run.
+ * 
+ * Returns:
+ * @return true: the run has a current line.
+ * @return false: the run is used up.
+ */
+static bool
+runNext(run_t* run)
+{
+  char* line;
+  size_t len;
+  while ( (line = file_reader_line(run->reader, &len)) != NULL) {
+    const char* space = memchr(line, ' ', len);
+    size_t wordLen = (space != NULL) ? (size_t) (space - line) : len;
+    if (wordLen > 0) {
+      run->line = line;
+      run->len = len;
+      run->wordLen = wordLen;
+      return true;
+    }
+  }
+  run->line = NULL;
+  return false;
+}
+
+/**
+ * @function: runCompare()
+ * @brief: static helper function for index_mergeRuns:
+ * orders two runs by current word, then by position.
+ * 
+ * @param runs: the array of runs.
+ * @param a: index of one run.
+ * @param b: index of the other.
+ * 
+ * Returns:
+ * @return int: negative, zero or positive as run a comes before, with, or after run b.
+ */
+static int
+runCompare(const run_t* runs, const int a, const int b)
+{
+  size_t lenA = runs[a].wordLen, lenB = runs[b].wordLen;
+  int cmp = memcmp(runs[a].line, runs[b].line, (lenA < lenB) ? lenA : lenB);
+  if (cmp == 0 && lenA != lenB) {
+    cmp = (lenA < lenB) ? -1 : 1;       // a prefix comes first, as in strcmp
+  }
+  return (cmp != 0) ? cmp : a - b;
+}
+
+/**
+ * @function: heapDown()
+ * @brief: static helper function for index_mergeRuns:
+ * moves heap[i] down until neither child comes before it.
+ * 
+ * @param runs: the array of runs.
+ * @param heap: the heap of run indexes.
+ * @param size: number of entries in the heap.
+ * @param i: the entry to move.
+ */
+static void
+heapDown(const run_t* runs, int* heap, const int size, int i)
+{
+  for (;;) {
+    int least = i;
+    int left = 2*i + 1, right = 2*i + 2;
+    if (left < size && runCompare(runs, heap[left], heap[least]) < 0) {
+      least = left;
+    }
+    if (right < size && runCompare(runs, heap[right], heap[least]) < 0) {
+      least = right;
+    }
+    if (least == i) {
+      return;
+    }
+    int swap = heap[i];
+    heap[i] = heap[least];
+    heap[least] = swap;
+    i = least;
+  }
+}
+
+/**
+ * @function: saveCount()
+ * @brief: static helper function for index_save:
+ * puts one posting in the arrays to be packed, and moves on to the next.
+ * 
+ * @param arg: pointer to the postings_t cursor.
+ * @param key: document ID.
+ * @param count: count in that document.
+ */
+static void
+saveCount(void* arg, int key, int count)
+{
+  postings_t* postings = (postings_t*) arg;
+  *postings->docIDs++ = key;
+  *postings->counts++ = count;
+}
+
+/**
+ * @function: loadBinary()
+ * @brief: static helper function for index_load:
+ * checks a binary index file and builds the index it holds.
+ * The word count is known up front, so the hashtable is sized to it,
+ * and each word's postings unpack in docID order,
+ * so its counters are built from them in one step.
+ * 
+ * Inputs:
+ * @param data: the file's bytes.
+ * @param size: the file's size.
+ * @param indexFileName: the file's name, for error messages.
+ * 
+ * Returns:
+ * @return index_t*: a pointer to the created index struct
+ * @return NULL: the file is not a valid binary index, of this version.
+ */
+static index_t*
+loadBinary(const unsigned char* data, const size_t size, const char* indexFileName)
+{
+  /* check the header, and every dictionary entry */
+  layout_t layout;
+  const char* error = readLayout(data, size, true, &layout);
+  uint32_t maxCount = 0;
+  for (uint64_t i = 0; i < layout.nWords && error == NULL; i++) {
+    error = checkEntry(&layout, i);
+    uint32_t count = get32(layout.dict + i * ENTRY_SIZE + 8);
+    maxCount = (count > maxCount) ? count : maxCount;
+  }
+
+  if (error != NULL) {
+    fprintf(stderr, "Error reading index file: '%s': %s\n", indexFileName, error);
+    return NULL;
+  }
+
+  /* build the index, a word at a time, unpacking its postings into keys[] and counts[] */
+  index_t* index = index_sized(layout.nWords > (uint64_t) MIN_SLOTS ? (int) layout.nWords : MIN_SLOTS);
+  int* keys = mem_malloc_assert((maxCount + 1) * sizeof(int), "mem alloc for postings failed.");
+  int* counts = mem_malloc_assert((maxCount + 1) * sizeof(int), "mem alloc for postings failed.");
+  if (layout.positions != NULL) {
+    index->pos = hashtable_new_arena(layout.nWords > (uint64_t) MIN_SLOTS ? (int) layout.nWords : MIN_SLOTS, index->arena);
+  }
+  termreader_t reader;
+  termsStart(&reader, &layout, 0);
+  const char* word;
+  while ( (word = termsNext(&reader)) != NULL) {
+
+    /* postings that do not unpack mean a corrupt file: skip the word */
+    counters_t* ctrs;
+    if ( (ctrs = decodeWord(&layout, reader.i - 1, keys, counts)) == NULL) {
+      fprintf(stderr, "Error reading index file: '%s': bad postings for '%s'\n", indexFileName, word);
+      continue;
+    }
+    else if (!hashtable_insert_len(index->ht, word, reader.len, ctrs)) {
+      counters_delete(ctrs);        // a repeated word; keep the first
+      continue;
+    }
+
+    /* its positions, copied; bad ones mean none for the index */
+    if (index->pos != NULL) {
+      if (checkPositions(&layout, reader.i - 1) != NULL) {
+        fprintf(stderr, "Error reading index file: '%s': bad positions for '%s'\n", indexFileName, word);
+        hashtable_delete(index->pos, deletePositions);
+        index->pos = NULL;
+        continue;
+      }
+      const unsigned char* table = layout.positions + (reader.i - 1) * 8;
+      uint64_t offset = get64(table);
+      uint64_t end = (reader.i < layout.nWords) ? get64(table + 8) : layout.positionsSize;
+      positions_t* positions = mem_malloc_assert(sizeof(positions_t), "mem alloc for positions failed.");
+      positions->size = end - offset + 1;
+      positions->bytes = mem_malloc_assert(positions->size, "mem alloc for positions failed.");
+      positions->len = end - offset;
+      positions->docID = -1;
+      memcpy(positions->bytes, layout.positions + layout.nWords * 8 + offset, positions->len);
+      hashtable_insert_len(index->pos, word, reader.len, positions);
+    }
+  }
+  if (reader.i < layout.nWords) {
+    fprintf(stderr, "Error reading index file: '%s': bad dictionary words\n", indexFileName);
+  }
+  termsEnd(&reader);
+
+  mem_free(keys);
+  mem_free(counts);
+
+  /* the document table */
+  for (uint32_t i = 0; i < layout.nDocs; i++) {
+    index_doc_t doc;
+    if (readDoc(&layout, i, &doc)) {
+      index_setDoc(index, layout.docsFirst + i, &doc);
+    }
+  }
+  return index;
+}
+
+/**
+ * @function: readLayout()
+ * @brief: static helper function for loadBinary and index_open:
+ * checks the header of a binary index file, and finds its sections.
+ * 
+ * Inputs:
+ * @param data: the file's bytes, starting with the magic number.
+ * @param size: the file's size.
+ * @param checksum: whether to check the checksum too, which reads the whole file.
+ * @param layout: where to save the sections.
+ * 
+ * Returns:
+ * @return NULL: the header is good.
+ * @return const char*: what is wrong with it.
+ */
+static const char*
+readLayout(const unsigned char* data, const size_t size, const bool checksum, layout_t* layout)
+{
+  if (size < HEADER_SIZE) {
+    return "truncated header";
+  }
+  if (get32(data + 8) != INDEX_VERSION || get32(data + 12) != HEADER_SIZE) {
+    return "unsupported version";
+  }
+
+  uint64_t nWords = get64(data + 16);
+  uint64_t nPostings = get64(data + 24);
+  uint64_t dictOffset = get64(data + 32);
+  uint64_t postingsOffset = get64(data + 40);
+  if (get64(data + 48) != size) {
+    return "wrong size";
+  }
+  uint64_t nBlocks = (nWords + DICT_BLOCK - 1) / DICT_BLOCK;
+  if (dictOffset < HEADER_SIZE || dictOffset > size
+      || nWords > (size - dictOffset) / ENTRY_SIZE
+      || postingsOffset < dictOffset + nWords * ENTRY_SIZE + nBlocks * 4
+      || postingsOffset > size
+      || nWords >= INT32_MAX) {
+    return "bad section offsets";
+  }
+
+  layout->nWords = nWords;
+  layout->nPostings = nPostings;
+  layout->dict = data + dictOffset;
+  layout->blocks = layout->dict + nWords * ENTRY_SIZE;
+  layout->nBlocks = nBlocks;
+  layout->terms = layout->blocks + nBlocks * 4;
+  layout->termsSize = postingsOffset - (dictOffset + nWords * ENTRY_SIZE + nBlocks * 4);
+  layout->postings = data + postingsOffset;
+  layout->firstDoc = get32(data + 64);
+  layout->lastDoc = get32(data + 68);
+  if (layout->firstDoc < 0 || layout->lastDoc < layout->firstDoc) {
+    return "bad docID range";
+  }
+
+  /* the document table ends the postings, and the URL pool the file */
+  uint64_t docsOffset = get64(data + 72);
+  layout->nDocs = get32(data + 80);
+  layout->docsFirst = get32(data + 84);
+  if (docsOffset < postingsOffset || docsOffset > size
+      || layout->nDocs > (size - docsOffset) / DOC_SIZE
+      || layout->docsFirst < 0
+      || (int64_t) layout->docsFirst + layout->nDocs - 1 > INT32_MAX) {
+    return "bad document table";
+  }
+  layout->docsKept = get64(data + 96);
+  layout->docsTokens = get64(data + 104);
+  if (layout->docsKept > layout->nDocs) {
+    return "bad document table";
+  }
+  layout->postingsSize = docsOffset - postingsOffset;
+  layout->docs = data + docsOffset;
+  layout->urls = (const char*) layout->docs + layout->nDocs * DOC_SIZE;
+
+  /* the maxima end the URL pool; the positions, if any, end the maxima, and the file */
+  uint64_t maximaOffset = get64(data + 112);
+  if (maximaOffset < docsOffset + layout->nDocs * DOC_SIZE || maximaOffset > size
+      || nWords > (size - maximaOffset) / 8) {
+    return "bad maxima";
+  }
+  uint64_t positionsOffset = get64(data + 88);
+  uint64_t maximaEnd = size;
+  layout->positions = NULL;
+  layout->positionsSize = 0;
+  if (positionsOffset != 0) {
+    if (positionsOffset < maximaOffset + nWords * 8 || positionsOffset > size
+        || nWords > (size - positionsOffset) / 8) {
+      return "bad positions";
+    }
+    layout->positions = data + positionsOffset;
+    layout->positionsSize = size - (positionsOffset + nWords * 8);
+    maximaEnd = positionsOffset;
+  }
+  layout->maxima = data + maximaOffset;
+  layout->nMaxima = (maximaEnd - (maximaOffset + nWords * 8)) / MAX_SIZE;
+  layout->urlsSize = maximaOffset - (docsOffset + layout->nDocs * DOC_SIZE);
+  if (layout->urlsSize > 0 && layout->urls[layout->urlsSize - 1] != '\0') {
+    return "bad URL pool";
+  }
+
+  if (checksum && get64(data + 56) != hash_wy(data + HEADER_SIZE, size - HEADER_SIZE, 0)) {
+    return "bad checksum";
+  }
+  return NULL;
+}
+
+/**
+ * @function: checkEntry()
+ * @brief: static helper function: checks dictionary entry i --
+ * its postings within the postings section, ending where the next word's begin;
+ * its word is checked as it is read (readTerm()).
+ * 
+ * Returns:
+ * @return NULL: the entry is good.
+ * @return const char*: what is wrong with it.
+ */
+static const char*
+checkEntry(const layout_t* layout, const uint64_t i)
+{
+  const unsigned char* entry = layout->dict + i * ENTRY_SIZE;
+  uint64_t offset = get64(entry);
+  uint64_t end = (i + 1 < layout->nWords) ? get64(entry + ENTRY_SIZE) : layout->postingsSize;
+  uint32_t count = get32(entry + 8);
+  if (offset > end || end > layout->postingsSize
+      || count > layout->nPostings || count > INT32_MAX) {
+    return "bad dictionary entry";
+  }
+  return NULL;
+}
+
+/**
+ * @function: decodeWord()
+ * @brief: static helper function for loadBinary and mappedCounters:
+ * unpacks the postings of word i, block by block, into keys[] and counts[],
+ * and builds its counters from them.
+ * 
+ * Inputs:
+ * @param layout: the sections of the file.
+ * @param i: the word's dictionary entry, already checked.
+ * @param keys: room for the word's docIDs.
+ * @param counts: room for their counts.
+ * 
+ * Returns:
+ * @return counters_t*: the word's counters.
+ * @return NULL: the postings do not unpack to the entry's count, in order.
+ */
+static counters_t*
+decodeWord(const layout_t* layout, const uint64_t i, int* keys, int* counts)
+{
+  const unsigned char* entry = layout->dict + i * ENTRY_SIZE;
+  uint64_t offset = get64(entry);
+  uint64_t end = (i + 1 < layout->nWords) ? get64(entry + ENTRY_SIZE) : layout->postingsSize;
+  int count = get32(entry + 8);
+  if (!postings_decode(layout->postings + offset, end - offset, count, keys, counts)) {
+    return NULL;
+  }
+  return counters_newSorted(keys, counts, count);
+}
+
+/**
+ * @function: readDoc()
+ * @brief: static helper function for a binary index:
+ * reads entry i of the document table, checking it as it goes.
+ * 
+ * Inputs:
+ * @param layout: the sections of the file.
+ * @param i: the entry, below layout->nDocs.
+ * @param doc: where to save it; its URL points into the file.
+ * 
+ * Returns:
+ * @return true: the entry is good.
+ * @return false: it has no URL -- no document has its docID -- or is bad.
+ */
+static bool
+readDoc(const layout_t* layout, const uint32_t i, index_doc_t* doc)
+{
+  const unsigned char* entry = layout->docs + (size_t) i * DOC_SIZE;
+  uint32_t url = get32(entry);
+  if (url == NO_URL || url >= layout->urlsSize
+      || get32(entry + 4) > INT32_MAX || get32(entry + 8) > INT32_MAX
+      || get32(entry + 12) > INT32_MAX) {
+    return false;
+  }
+  doc->url = layout->urls + url;      // the pool ends in a null, so the URL does
+  doc->depth = get32(entry + 4);
+  doc->tokens = get32(entry + 8);
+  doc->bytes = get32(entry + 12);
+  return true;
+}
+
+/**
+ * @function: sortDocs()
+ * @brief: static helper function: puts an index's document table
+ * in docID order, unless it is already.
+ */
+static void
+sortDocs(index_t* index)
+{
+  if (!index->docsSorted) {
+    qsort(index->docs, index->nDocs, sizeof(docentry_t), compareDocs);
+    index->docsSorted = true;
+  }
+}
+
+/**
+ * @function: compareDocs()
+ * @brief: static helper function for sortDocs, used by qsort:
+ * orders document table entries by docID.
+ */
+static int
+compareDocs(const void* a, const void* b)
+{
+  int x = ((const docentry_t*) a)->docID, y = ((const docentry_t*) b)->docID;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @function: rangeWord()
+ * @brief: static helper function for index_docRange, used by index_iterate:
+ * widens the docID range to take in a word's postings.
+ * 
+ * Inputs:
+ * @param arg: the range so far, int[2]: smallest, largest; 0 if none.
+ * @param key: the word.
+ * @param item: its counters.
+ */
+static void
+rangeWord(void* arg, const char* key, void* item)
+{
+  counters_iterate((counters_t*) item, arg, rangeCount);
+}
 
-    /*
-     * iterate over the counters with the file
-     * and the function to print counts.
-     */
-    counters_t* ctrs = (counters_t*) item;
-    counters_iterate(ctrs, fp, printCounts);
+/**
+ * @function: rangeCount()
+ * @brief: static helper function for rangeWord, used by counters_iterate.
+ * 
+ * Inputs:
+ * @param arg: the range so far, int[2].
+ * @param key: a docID.
+ * @param count: its count.
+ */
+static void
+rangeCount(void* arg, int key, int count)
+{
+  int* range = (int*) arg;
+  if (range[0] == 0 || key < range[0]) {
+    range[0] = key;
+  }
+  if (key > range[1]) {
+    range[1] = key;
+  }
+}
 
-    // print a new line.
-    fprintf(fp, "\n");
+/**
+ * @function: findWord()
+ * @brief: static helper function for a mapped index:
+ * finds the last block whose first word is at most word (findBlock()),
+ * then scans that block's front-coded words.
+ * The scan keeps how much of word the word last read matches,
+ * so it compares only the bytes a word does not share with the one before,
+ * and rebuilds none of them.
+ * 
+ * Inputs:
+ * @param layout: the sections of the file.
+ * @param word: the word to search for.
+ * @param i: where to save the word's dictionary entry.
+ * 
+ * Returns:
+ * @return true: the word is in the dictionary, at *i.
+ * @return false: it is not, or a corrupt entry was met on the way.
+ */
+static bool
+findWord(const layout_t* layout, const char* word, uint64_t* i)
+{
+  size_t wordLen = strlen(word);
+  uint64_t block;
+  if (!findBlock(layout, word, wordLen, &block) || block == 0) {
+    return false;                       // corrupt, or before the first word
+  }
+  block--;
+
+  /*
+   * each word of the block, from its first, which is whole and at most word;
+   * every word read before the one sought is below it
+   */
+  uint32_t shared, len;
+  const unsigned char* bytes;
+  size_t pos = get32(layout->blocks + block * 4);
+  size_t match = 0;
+  uint64_t end = (block + 1) * DICT_BLOCK < layout->nWords ? (block + 1) * DICT_BLOCK : layout->nWords;
+  for (uint64_t k = block * DICT_BLOCK; k < end; k++) {
+    if (!readTerm(layout, &pos, &shared, &bytes, &len)) {
+      return false;
+    }
+    if (shared < match) {
+      return false;       // it differs from word where the last matched: it is beyond word
+    }
+    if (shared > match) {
+      continue;           // it agrees with the last where that fell below word
+    }
+    size_t common;
+    int cmp = compareTerm(word + match, wordLen - match, bytes, len, &common);
+    if (cmp == 0) {
+      *i = k;
+      return true;
+    }
+    else if (cmp < 0) {
+      return false;
+    }
+    match += common;
+  }
+  return false;
+}
+
+/**
+ * @function: findBlock()
+ * @brief: static helper function for a mapped index:
+ * binary-searches the block index, comparing word with the first word
+ * of each block, which is whole.
+ * 
+ * Inputs:
+ * @param layout: the sections of the file.
+ * @param word: the word to search for, of wordLen bytes.
+ * @param blocks: where to save how many blocks start at or below word.
+ * 
+ * Returns:
+ * @return true: the blocks were counted.
+ * @return false: a corrupt block was met on the way.
+ */
+static bool
+findBlock(const layout_t* layout, const char* word, const size_t wordLen, uint64_t* blocks)
+{
+  uint64_t lo = 0, hi = layout->nBlocks;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    size_t pos = get32(layout->blocks + mid * 4);
+    uint32_t shared, len;
+    const unsigned char* bytes;
+    if (!readTerm(layout, &pos, &shared, &bytes, &len) || shared != 0) {
+      return false;
+    }
+    size_t common;
+    if (compareTerm(word, wordLen, bytes, len, &common) < 0) {
+      hi = mid;
+    }
+    else {
+      lo = mid + 1;
+    }
+  }
+  *blocks = lo;
+  return true;
+}
+
+/**
+ * @function: expandWord()
+ * @brief: static helper function for index_expand, used by hashtable_iterate:
+ * passes a word and its counters on to the caller's itemfunc if it matches.
+ * 
+ * Inputs:
+ * @param arg: pointer to the expander_t.
+ * @param key: the word.
+ * @param item: its counters.
+ */
+static void
+expandWord(void* arg, const char* key, void* item)
+{
+  expander_t* expander = (expander_t*) arg;
+  if (matchPattern(expander->pattern, key)) {
+    expander->itemfunc(expander->arg, key, item);
+    expander->count++;
+  }
+}
+
+/**
+ * @function: matchPattern()
+ * @brief: static helper function for expandWord:
+ * whether word matches pattern, in which each '*' matches any run of
+ * characters, none included. On a mismatch after a '*', that '*' takes
+ * one more character and the match resumes, so the work is at most
+ * the product of the two lengths.
+ */
+static bool
+matchPattern(const char* pattern, const char* word)
+{
+  const char* star = NULL;        // the last '*' met ...
+  const char* resume = NULL;      // ... and where in word it has matched up to
+  while (*word != '\0') {
+    if (*pattern == '*') {
+      star = pattern++;
+      resume = word;
+    }
+    else if (*pattern == *word) {
+      pattern++;
+      word++;
+    }
+    else if (star != NULL) {
+      pattern = star + 1;
+      word = ++resume;
+    }
+    else {
+      return false;
+    }
+  }
+  while (*pattern == '*') {
+    pattern++;
+  }
+  return *pattern == '\0';
+}
+
+/**
+ * @function: readTerm()
+ * @brief: static helper function for a mapped index:
+ * reads the front-coded word at *pos in the terms, checking it stays within them.
+ * 
+ * Inputs:
+ * @param layout: the sections of the file.
+ * @param pos: where the word starts; saved where the next one does.
+ * @param shared: where to save how many bytes it shares with the word before.
+ * @param bytes: where to save the bytes that follow ...
+ * @param len: ... and how many.
+ * 
+ * Returns:
+ * @return true: the word is good.
+ * @return false: it is corrupt.
+ */
+static bool
+readTerm(const layout_t* layout, size_t* pos, uint32_t* shared, const unsigned char** bytes, uint32_t* len)
+{
+  if (!getVarint(layout->terms, layout->termsSize, pos, shared)
+      || !getVarint(layout->terms, layout->termsSize, pos, len)
+      || *len > layout->termsSize - *pos
+      || memchr(layout->terms + *pos, '\0', *len) != NULL) {
+    return false;
+  }
+  *bytes = layout->terms + *pos;
+  *pos += *len;
+  return true;
+}
+
+/**
+ * @function: compareTerm()
+ * @brief: static helper function for findWord and findBlock:
+ * compares word with len bytes of a word in the terms, as strcmp would.
+ * 
+ * Inputs:
+ * @param word: the word, of wordLen bytes.
+ * @param bytes: the other word's bytes, of len bytes.
+ * @param common: where to save how many bytes they share.
+ * 
+ * Returns:
+ * @return int: below, at or above 0, as word is below, equal to or above the other.
+ */
+static int
+compareTerm(const char* word, const size_t wordLen, const unsigned char* bytes, const uint32_t len, size_t* common)
+{
+  size_t n = 0;
+  while (n < wordLen && n < len && (unsigned char) word[n] == bytes[n]) {
+    n++;
+  }
+  *common = n;
+  if (n < wordLen && n < len) {
+    return (unsigned char) word[n] - bytes[n];
+  }
+  return (wordLen > n) - (len > n);
+}
+
+/**
+ * @function: termsStart()
+ * @brief: static helper function for a binary index:
+ * starts a walk through its words, in order, from the first word of a block.
+ */
+static void
+termsStart(termreader_t* reader, const layout_t* layout, const uint64_t block)
+{
+  reader->layout = layout;
+  reader->i = block * DICT_BLOCK;
+  reader->pos = 0;
+  reader->size = 64;
+  reader->word = mem_malloc_assert(reader->size, "mem alloc for dictionary word failed.");
+  reader->len = 0;
+}
+
+/**
+ * @function: termsNext()
+ * @brief: static helper function for a binary index:
+ * rebuilds the next word of the walk from the one before;
+ * reader->i - 1 is then its dictionary entry.
+ * 
+ * Returns:
+ * @return const char*: the word; valid until the next call.
+ * @return NULL: the words are done, or the next is corrupt.
+ */
+static const char*
+termsNext(termreader_t* reader)
+{
+  const layout_t* layout = reader->layout;
+  if (reader->i >= layout->nWords) {
+    return NULL;
+  }
+  if (reader->i % DICT_BLOCK == 0) {
+    reader->pos = get32(layout->blocks + reader->i / DICT_BLOCK * 4);
+  }
+
+  uint32_t shared, len;
+  const unsigned char* bytes;
+  if (!readTerm(layout, &reader->pos, &shared, &bytes, &len) || shared > reader->len
+      || (reader->i % DICT_BLOCK == 0 && shared != 0)) {
+    return NULL;
+  }
+
+  /* room for the word: the shared bytes are kept, the rest copied in */
+  if ((size_t) shared + len + 1 > reader->size) {
+    while ((size_t) shared + len + 1 > reader->size) {
+      reader->size *= 2;
+    }
+    char* word = mem_malloc_assert(reader->size, "mem alloc for dictionary word failed.");
+    memcpy(word, reader->word, shared);
+    mem_free(reader->word);
+    reader->word = word;
+  }
+  memcpy(reader->word + shared, bytes, len);
+  reader->len = shared + len;
+  reader->word[reader->len] = '\0';
+  reader->i++;
+  return reader->word;
+}
+
+/**
+ * @function: termsEnd()
+ * @brief: static helper function: ends a walk through the words.
+ */
+static void
+termsEnd(termreader_t* reader)
+{
+  mem_free(reader->word);
+}
+
+/**
+ * @function: seekWord()
+ * @brief: static helper function for index_intersect:
+ * intersects ctrs with the packed postings of word i, seeking through
+ * them for each docID of ctrs in increasing order; only the blocks
+ * that might hold one of those docIDs are unpacked.
+ * Postings that turn out corrupt end the intersection there.
+ * 
+ * Inputs:
+ * @param layout: the sections of the file.
+ * @param i: the word's dictionary entry, already checked.
+ * @param ctrs: the counters to intersect.
+ * 
+ * Returns:
+ * @return counters_t*: new counters of the docIDs in both.
+ * @return NULL: out of memory.
+ */
+static counters_t*
+seekWord(const layout_t* layout, const uint64_t i, counters_t* ctrs)
+{
+  const unsigned char* entry = layout->dict + i * ENTRY_SIZE;
+  uint64_t offset = get64(entry);
+  uint64_t end = (i + 1 < layout->nWords) ? get64(entry + ENTRY_SIZE) : layout->postingsSize;
+  int count = get32(entry + 8);
+
+  seeker_t* seeker = mem_malloc_assert(sizeof(seeker_t), "mem alloc for seeker failed.");
+  seeker->reader = postings_reader_new(layout->postings + offset, end - offset, count);
+  seeker->n = seeker->k = seeker->size = 0;
+  seeker->done = (seeker->reader == NULL);
+  seeker->keys = mem_malloc_assert((counters_size(ctrs) + 1) * sizeof(int), "mem alloc for postings failed.");
+  seeker->found = mem_malloc_assert((counters_size(ctrs) + 1) * sizeof(int), "mem alloc for postings failed.");
+
+  /* counters iterate in increasing docID order, so the reader only moves forward */
+  counters_iterate(ctrs, seeker, seekCount);
+  counters_t* result = counters_newSorted(seeker->keys, seeker->found, seeker->size);
+
+  postings_reader_delete(seeker->reader);
+  mem_free(seeker->keys);
+  mem_free(seeker->found);
+  mem_free(seeker);
+  return result;
+}
+
+/**
+ * @function: seekCount()
+ * @brief: static helper function for seekWord, used by counters_iterate:
+ * looks for one docID in the word's postings, unpacking the block
+ * that would hold it if the block last unpacked ends below it.
+ * 
+ * Inputs:
+ * @param arg: pointer to the seeker_t.
+ * @param key: a docID of the counters being intersected.
+ * @param count: its count.
+ */
+static void
+seekCount(void* arg, int key, int count)
+{
+  seeker_t* seeker = (seeker_t*) arg;
+  if (seeker->done || count <= 0) {
+    return;
+  }
+
+  if (seeker->n == 0 || seeker->docIDs[seeker->n - 1] < key) {
+    postings_reader_seek(seeker->reader, key);
+    seeker->n = postings_reader_next(seeker->reader, seeker->docIDs, seeker->counts);
+    seeker->k = 0;
+    if (seeker->n <= 0) {
+      seeker->n = 0;
+      seeker->done = true;              // no more postings, or corrupt ones
+      return;
+    }
+  }
+
+  while (seeker->k < seeker->n && seeker->docIDs[seeker->k] < key) {
+    seeker->k++;
+  }
+  if (seeker->k < seeker->n && seeker->docIDs[seeker->k] == key && seeker->counts[seeker->k] > 0) {
+    int wordCount = seeker->counts[seeker->k];
+    seeker->keys[seeker->size] = key;
+    seeker->found[seeker->size++] = (count < wordCount) ? count : wordCount;
+  }
+}
+
+/**
+ * @function: mappedCounters()
+ * @brief: static helper function for a mapped index:
+ * the counters of word i, unpacked from the mapped file
+ * the first time the word is looked up, and kept until index_delete.
+ * 
+ * Returns:
+ * @return counters_t*: the word's counters.
+ * @return NULL: the word's dictionary entry or postings are corrupt.
+ */
+static counters_t*
+mappedCounters(mapped_t* mapped, const uint64_t i)
+{
+  if (mapped->ctrs[i] == NULL && checkEntry(&mapped->layout, i) == NULL) {
+    int count = get32(mapped->layout.dict + i * ENTRY_SIZE + 8);
+    int* keys = mem_malloc_assert((count + 1) * sizeof(int), "mem alloc for postings failed.");
+    int* counts = mem_malloc_assert((count + 1) * sizeof(int), "mem alloc for postings failed.");
+    mapped->ctrs[i] = decodeWord(&mapped->layout, i, keys, counts);
+    mem_free(keys);
+    mem_free(counts);
+  }
+  return mapped->ctrs[i];
+}
+
+/**
+ * @function: put32()
+ * @brief: static helper function: stores a 4-byte integer, little-endian.
+ */
+static void
+put32(unsigned char* p, const uint32_t value)
+{
+  for (int i = 0; i < 4; i++) {
+    p[i] = (unsigned char) (value >> (8 * i));
+  }
+}
+
+/**
+ * @function: put64()
+ * @brief: static helper function: stores an 8-byte integer, little-endian.
+ */
+static void
+put64(unsigned char* p, const uint64_t value)
+{
+  put32(p, (uint32_t) value);
+  put32(p + 4, (uint32_t) (value >> 32));
+}
+
+/**
+ * @function: get32()
+ * @brief: static helper function: reads a 4-byte integer, little-endian.
+ */
+static uint32_t
+get32(const unsigned char* p)
+{
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8
+         | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/**
+ * @function: get64()
+ * @brief: static helper function: reads an 8-byte integer, little-endian.
+ */
+static uint64_t
+get64(const unsigned char* p)
+{
+  return (uint64_t) get32(p) | (uint64_t) get32(p + 4) << 32;
+}
+
+/**
+ * @function: putVarint()
+ * @brief: static helper function: stores an integer as a varint --
+ * seven bits a byte, low bits first, the high bit set on all but the last.
+ * 
+ * Returns:
+ * @return size_t: the bytes stored, 1 to 5.
+ */
+static size_t
+putVarint(unsigned char* p, uint32_t value)
+{
+  size_t n = 0;
+  while (value >= 0x80) {
+    p[n++] = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  p[n++] = (unsigned char) value;
+  return n;
+}
+
+/**
+ * @function: getVarint()
+ * @brief: static helper function: reads a varint at data[*pos],
+ * not past data[size - 1], and moves *pos past it.
+ * 
+ * Returns:
+ * @return true: the varint was read.
+ * @return false: it runs off the end, or past 32 bits.
+ */
+static bool
+getVarint(const unsigned char* data, const size_t size, size_t* pos, uint32_t* value)
+{
+  uint32_t result = 0;
+  for (int shift = 0; shift < 35 && *pos < size; shift += 7) {
+    unsigned char byte = data[(*pos)++];
+    if (shift == 28 && byte > 0x0F) {
+      return false;
+    }
+    result |= (uint32_t) (byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
   }
+  return false;
 }
 
 /**
@@ -425,6 +2963,186 @@ deleteCounter(void* arg)
   counters_delete(ctrs);
 }
 
+/**
+ * @function: deletePositions()
+ * @brief: static helper function to free a positions_t.
+ * 
+ * @param arg: pointer to the positions_t.
+ */
+static void
+deletePositions(void* arg)
+{
+  positions_t* positions = (positions_t*) arg;
+  mem_free(positions->bytes);
+  mem_free(positions);
+}
+
+/**
+ * @function: mergePositions()
+ * @brief: static helper function for index_merge, used by hashtable_iterate:
+ * appends a word's positions to index's, or moves them in if it has none --
+ * as mergeWord does its counters.
+ * 
+ * Inputs:
+ * @param arg: pointer to the index to merge into.
+ * @param key: the word.
+ * @param item: its positions_t, from the part being merged.
+ */
+static void
+mergePositions(void* arg, const char* key, void* item)
+{
+  index_t* index = (index_t*) arg;
+  positions_t* more = (positions_t*) item;
+  positions_t* positions;
+  if ( (positions = hashtable_find(index->pos, key)) == NULL) {
+    hashtable_insert(index->pos, key, more);
+    return;
+  }
+  growPositions(positions, more->len);
+  memcpy(positions->bytes + positions->len, more->bytes, more->len);
+  positions->len += more->len;
+  positions->docID = more->docID;
+  positions->last = more->last;
+  deletePositions(more);
+}
+
+/**
+ * @function: growPositions()
+ * @brief: static helper function: makes room for more bytes of positions,
+ * doubling the room as needed.
+ */
+static void
+growPositions(positions_t* positions, const size_t more)
+{
+  if (positions->len + more > positions->size) {
+    while (positions->len + more > positions->size) {
+      positions->size *= 2;
+    }
+    unsigned char* bytes = mem_malloc_assert(positions->size, "mem alloc for positions failed.");
+    memcpy(bytes, positions->bytes, positions->len);
+    mem_free(positions->bytes);
+    positions->bytes = bytes;
+  }
+}
+
+/**
+ * @function: checkPositions()
+ * @brief: static helper function: checks that the positions of word i
+ * lie within the positions section, ending where the next word's begin.
+ * 
+ * Returns:
+ * @return NULL: they do.
+ * @return const char*: what is wrong with them.
+ */
+static const char*
+checkPositions(const layout_t* layout, const uint64_t i)
+{
+  const unsigned char* table = layout->positions + i * 8;
+  uint64_t offset = get64(table);
+  uint64_t end = (i + 1 < layout->nWords) ? get64(table + 8) : layout->positionsSize;
+  if (offset > end || end > layout->positionsSize) {
+    return "bad positions";
+  }
+  return NULL;
+}
+
+/**
+ * @function: checkMaxima()
+ * @brief: static helper function: checks that the maxima of word i
+ * -- an entry for its list, and one for each block if it has more than one --
+ * lie within the maxima section, and are each within range.
+ * 
+ * Returns:
+ * @return NULL: they do.
+ * @return const char*: what is wrong with them.
+ */
+static const char*
+checkMaxima(const layout_t* layout, const uint64_t i)
+{
+  uint64_t first = get64(layout->maxima + i * 8);
+  uint32_t count = get32(layout->dict + i * ENTRY_SIZE + 8);
+  uint64_t n = 1 + ((count > POSTINGS_BLOCK) ? ((uint64_t) count + POSTINGS_BLOCK - 1) / POSTINGS_BLOCK : 0);
+  if (first > layout->nMaxima || n > layout->nMaxima - first) {
+    return "bad maxima";
+  }
+  const unsigned char* entry = layout->maxima + layout->nWords * 8 + first * MAX_SIZE;
+  for (uint64_t j = 0; j < n; j++, entry += MAX_SIZE) {
+    if (get32(entry) > INT32_MAX || get32(entry + 4) > INT32_MAX || get32(entry + 8) > INT32_MAX) {
+      return "bad maxima";
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @function: wordMaxima()
+ * @brief: static helper function for index_save and index_cursorOver:
+ * works out the maxima of a word's postings, block by block,
+ * and of all of them.
+ * 
+ * Inputs:
+ * @param docs: the index whose document table gives the documents'
+ * lengths; NULL if none does.
+ * @param docIDs: the postings' docIDs, in order ...
+ * @param counts: ... and their counts ...
+ * @param n: ... n of them.
+ * @param blocks: room for n / POSTINGS_BLOCK + 1 blocks' maxima.
+ * @param all: where to save the maxima of all the postings.
+ * 
+ * Returns:
+ * @return int: the number of blocks; one, for an empty list.
+ */
+static int
+wordMaxima(index_t* docs, const int* docIDs, const int* counts, const int n, blockmax_t* blocks, blockmax_t* all)
+{
+  int nBlocks = (n > 0) ? (n + POSTINGS_BLOCK - 1) / POSTINGS_BLOCK : 1;
+  all->last = all->maxCount = 0;
+  all->minTokens = INT32_MAX;
+  for (int b = 0; b < nBlocks; b++) {
+    blockmax_t* block = &blocks[b];
+    int end = (b + 1) * POSTINGS_BLOCK < n ? (b + 1) * POSTINGS_BLOCK : n;
+    block->last = (end > 0) ? docIDs[end - 1] : 0;
+    block->maxCount = 0;
+    block->minTokens = INT32_MAX;
+    for (int j = b * POSTINGS_BLOCK; j < end; j++) {
+      index_doc_t doc;
+      int tokens = (docs != NULL && index_getDoc(docs, docIDs[j], &doc)) ? doc.tokens : 0;
+      block->maxCount = (counts[j] > block->maxCount) ? counts[j] : block->maxCount;
+      block->minTokens = (tokens < block->minTokens) ? tokens : block->minTokens;
+    }
+    block->minTokens = (end > 0) ? block->minTokens : 0;
+    all->last = block->last;
+    all->maxCount = (block->maxCount > all->maxCount) ? block->maxCount : all->maxCount;
+    all->minTokens = (block->minTokens < all->minTokens) ? block->minTokens : all->minTokens;
+  }
+  return nBlocks;
+}
+
+/**
+ * @function: putMaxima()
+ * @brief: static helper function: stores an entry of the maxima section.
+ */
+static void
+putMaxima(unsigned char* entry, const blockmax_t* max)
+{
+  put32(entry, max->last);
+  put32(entry + 4, max->maxCount);
+  put32(entry + 8, max->minTokens);
+}
+
+/**
+ * @function: getMaxima()
+ * @brief: static helper function: reads an entry of the maxima section,
+ * already checked (checkMaxima()).
+ */
+static void
+getMaxima(const unsigned char* entry, blockmax_t* max)
+{
+  max->last = get32(entry);
+  max->maxCount = get32(entry + 4);
+  max->minTokens = get32(entry + 8);
+}
+
 // /**
 //  * @function: rankPages
 //  * @brief: static helper function to compare and rank keys in a counters object
@@ -28,6 +28,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <string.h>
+#include <limits.h>
 
 /* Memory library */
 #include "mem.h"
@@ -48,6 +49,20 @@
 /* opaque struct */
 typedef struct index index_t;
 
+/* a walk through a word's positions (opaque; see index_positions()) */
+typedef struct index_positions index_positions_t;
+
+/* a walk through a word's postings, with their maxima (opaque; see index_cursor()) */
+typedef struct index_cursor index_cursor_t;
+
+/* what an index records of a document, besides its words */
+typedef struct index_doc {
+  const char* url;      // the page's URL
+  int depth;            // its depth in the crawl
+  int tokens;           // the words indexed from it
+  int bytes;            // the size of its HTML
+} index_doc_t;
+
 /**
  * @function: index_new()
  * @brief: Creates a new index_t object.
@@ -64,6 +79,17 @@ typedef struct index index_t;
  */
 index_t* index_new();
 
+/**
+ * @function: index_newPositional()
+ * @brief: creates a new index_t object, as index_new(), that also keeps
+ * the positions of its words in each document: those index_insertAt()
+ * records. index_save() writes them beside the postings, and
+ * index_positions() walks them, for phrase queries.
+ * 
+ * Returns:
+ * @return index_t*: pointer to created index_t* object.
+ */
+index_t* index_newPositional();
 
 /**
  * @function: index_insert()
@@ -82,6 +108,25 @@ index_t* index_new();
  */
 void index_insert(index_t* index, char* word, int docID);
 
+/**
+ * @function: index_insertAt()
+ * @brief: inserts word and document ID into the index, as index_insert(),
+ * and, if the index keeps positions (index_newPositional()), the word's
+ * place in the document: its number among all the page's words, from 0.
+ * A document's words must be inserted together, in increasing position,
+ * and documents in increasing docID order, as the postings are kept.
+ * The positions are kept as varint gaps, a few bits each.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object.
+ * @param word: word to enter into index.
+ * @param docID: document where word was found.
+ * @param position: the word's place in the document.
+ * 
+ * Returns: none.
+ */
+void index_insertAt(index_t* index, char* word, int docID, int position);
+
 /**
  * @function: index_set
  * @brief: sets the docID entry for specified word to the provided count.
@@ -112,7 +157,8 @@ void index_iterate(index_t* index, void* arg, void (*itemfunc)(void* arg, const
 /**
  * @function: index_print()
  * @brief: prints out the data inside provided index in a specific format.
- * -> each word is printed on a new line.
+ * -> each word is printed on a new line, in sorted (strcmp) order,
+ *    so that the same index always prints the same file.
  * -> for each word, the document ID and counts
  *    are printed alternating each other on the line.
  * 
@@ -124,6 +170,71 @@ void index_iterate(index_t* index, void* arg, void (*itemfunc)(void* arg, const
  */
 void index_print (index_t* index, FILE* fp);
 
+/**
+ * @function: index_printSorted()
+ * @brief: prints the index in the format and order of index_print()
+ * -- the order index_mergeRuns() expects of its runs.
+ * The words of an index from index_open() are in that order already;
+ * others' are sorted first.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object
+ * @param fp: pointer to a file.
+ * 
+ * Returns: none.
+ */
+void index_printSorted(index_t* index, FILE* fp);
+
+/**
+ * @function: index_save()
+ * @brief: writes the index to a file in the binary index format:
+ * a versioned header, a dictionary of the words in sorted (strcmp) order
+ * with the offset of each word's postings -- the words front-coded,
+ * each as the bytes it shares with the word before and the rest,
+ * in blocks that each start with a whole word, for binary search --
+ * and the postings --
+ * each word's docIDs, delta-encoded, and their counts,
+ * packed by the postings module (postings.h): as varints for short lists,
+ * bit-packed in blocks, about a byte a posting, for long ones --
+ * and the document table (index_setDoc()), an entry per docID --
+ * and each word's maxima (see index_cursor()), for its whole list
+ * and for each block of its postings --
+ * and, if the index keeps them, its words' positions: an index from
+ * index_open() is saved without them.
+ * The header holds a checksum of everything after it,
+ * and the document table's statistics (index_docStats()).
+ * index_load() reads either format; see index.c for the layout.
+ * 
+ * Inputs:
+ * @param index: pointer to an index object
+ * @param fp: pointer to a file, opened for writing.
+ * 
+ * Returns:
+ * @return true: the index was written.
+ * @return false: error writing the file.
+ */
+bool index_save(index_t* index, FILE* fp);
+
+/**
+ * @function: index_mergeRuns()
+ * @brief: k-way merges index files printed by index_printSorted()
+ * into one index file, holding only a buffer of each in memory.
+ * A word in several runs gets one line, with the postings of each run
+ * in the order the runs are given; so runs built from consecutive
+ * docID ranges, given in range order, merge into the index
+ * that one index_printSorted() of all the documents would print.
+ * 
+ * Inputs:
+ * @param runFiles: paths to the runs, in order.
+ * @param nRuns: number of runs.
+ * @param fp: pointer to the file wherein to write the merged index.
+ * 
+ * Returns:
+ * @return true: the runs were merged.
+ * @return false: a run could not be opened; nothing was written.
+ */
+bool index_mergeRuns(char** runFiles, const int nRuns, FILE* fp);
+
 /**
  * @function: index_find
  * @brief: searches for a key in the index. 
@@ -137,6 +248,296 @@ void index_print (index_t* index, FILE* fp);
  */
 counters_t* index_find(index_t* index, char* word);
 
+/**
+ * @function: index_count
+ * @brief: counts the documents that hold a word, without unpacking
+ * its postings on a mapped index -- so a query can take its rarest
+ * word first.
+ * 
+ * @param index: the index wherein to search.
+ * @param word: the word to search for.
+ * 
+ * Returns:
+ * @return: the number of documents in the word's postings; 0 if none.
+ */
+int index_count(index_t* index, char* word);
+
+/**
+ * @function: index_intersect
+ * @brief: intersects counters with a word's postings,
+ * keeping, for each docID in both, the smaller count
+ * (as counters_intersect()).
+ * On a mapped index it seeks through the word's packed postings
+ * for each docID of ctrs in turn, skipping the blocks between
+ * without unpacking them, so a few docIDs against a long list
+ * cost a few blocks, not the list; the word's counters are not kept.
+ * Otherwise, or if index_find() has already unpacked the word,
+ * it is counters_intersect() of ctrs and the word's counters.
+ * 
+ * @param index: the index wherein to search.
+ * @param word: the word whose postings to intersect with.
+ * @param ctrs: the counters to intersect; unchanged.
+ * 
+ * Returns:
+ * @return: new counters, empty if the word is not in the index;
+ * the caller must counters_delete() them.
+ * @return: NULL -> out of memory.
+ */
+counters_t* index_intersect(index_t* index, char* word, counters_t* ctrs);
+
+/**
+ * @function: index_expand
+ * @brief: finds the words that match a pattern -- a word in which
+ * each '*' stands for any run of characters, none included, so that
+ * "comput*" matches "compute" and "computing" -- and calls itemfunc
+ * on each, with its counters, as index_iterate() does.
+ * The characters before the first '*' bound the search: an index from
+ * index_open() seeks its sorted dictionary to the first word they begin,
+ * and reads on only while words do, so the work is proportional
+ * to the words with that prefix, not to the dictionary;
+ * any other index tests each of its words.
+ * 
+ * @param index: the index wherein to search.
+ * @param pattern: the word, with '*' for any run of characters.
+ * @param arg: passed to itemfunc.
+ * @param itemfunc: called on each matching word (in strcmp order,
+ * for an index from index_open()) and its counters, which stay the index's.
+ * 
+ * Returns:
+ * @return int: the number of words matched.
+ */
+int index_expand(index_t* index, const char* pattern, void* arg,
+                 void (*itemfunc)(void* arg, const char* key, void* item));
+
+/**
+ * @function: index_positions
+ * @brief: starts a walk through a word's positions, document by document,
+ * in docID order (see index_positionsIn()).
+ * Positions are read only by these calls: an index from index_open()
+ * leaves them in the mapped file, untouched by other lookups.
+ * 
+ * @param index: the index wherein to search; not to be changed during the walk.
+ * @param word: the word whose positions to walk.
+ * 
+ * Returns:
+ * @return index_positions_t*: the walk; the caller must index_positionsDelete() it.
+ * @return NULL: the index keeps no positions, or has no such word.
+ */
+index_positions_t* index_positions(index_t* index, char* word);
+
+/**
+ * @function: index_positionsIn
+ * @brief: the walk's word's positions in a document -- its places among
+ * the page's words, from 0, in increasing order; as many as its count there.
+ * The walk only moves forward: each call must ask for a document
+ * beyond the last, and skips the positions of the documents between.
+ * 
+ * @param walk: the walk, from index_positions().
+ * @param docID: the document; above any asked for before.
+ * @param n: where to save how many positions there are; 0 if none.
+ * 
+ * Returns:
+ * @return const int*: the positions; valid until the next call.
+ * @return NULL: the word is not in the document, or its positions are corrupt.
+ */
+const int* index_positionsIn(index_positions_t* walk, const int docID, int* n);
+
+/**
+ * @function: index_positionsDelete
+ * @brief: ends a walk through a word's positions; ignores NULL.
+ */
+void index_positionsDelete(index_positions_t* walk);
+
+/**
+ * @function: index_cursor
+ * @brief: starts a walk through a word's postings, in docID order,
+ * that can skip ahead -- for a query that wants only the best documents,
+ * and can tell, from the most the postings ahead might add to a score,
+ * which it need not look at (dynamic pruning: WAND, Block-Max WAND).
+ * Besides the postings, the walk knows their maxima: the largest count
+ * among them and the fewest words indexed from any of their documents
+ * (index_setDoc()), for the whole list and for each block of
+ * POSTINGS_BLOCK postings -- the numbers a score's upper bound is made of,
+ * whatever the scoring. A binary index keeps them in the file
+ * (index_save()); an index from index_open() reads them there,
+ * and unpacks a block of postings only when the walk stops in it.
+ * 
+ * @param index: the index wherein to search; not to be changed during the walk.
+ * @param word: the word whose postings to walk.
+ * 
+ * Returns:
+ * @return index_cursor_t*: the walk, at the word's first posting;
+ * the caller must index_cursorDelete() it.
+ * @return NULL: the index has no such word.
+ */
+index_cursor_t* index_cursor(index_t* index, char* word);
+
+/**
+ * @function: index_cursorOver
+ * @brief: starts a walk, as index_cursor(), through postings of the
+ * caller's -- those a pattern or a phrase matches, say -- working out
+ * their maxima from them, and the index's document table.
+ * 
+ * @param index: the index the postings are from.
+ * @param ctrs: the postings; copied, so they may be deleted meanwhile.
+ * 
+ * Returns:
+ * @return index_cursor_t*: the walk, at the first posting;
+ * the caller must index_cursorDelete() it.
+ */
+index_cursor_t* index_cursorOver(index_t* index, counters_t* ctrs);
+
+/**
+ * @function: index_cursorDoc
+ * @brief: the walk's current posting.
+ * 
+ * @param cursor: the walk.
+ * @param count: where to save the posting's count; 0 at the end.
+ * 
+ * Returns:
+ * @return int: the posting's docID; INT_MAX once the postings are done.
+ */
+int index_cursorDoc(index_cursor_t* cursor, int* count);
+
+/**
+ * @function: index_cursorSeek
+ * @brief: moves the walk to its first posting at or above a docID.
+ * The walk only moves forward: a target at or below the current
+ * posting leaves it there. Whole blocks of postings below the target
+ * are passed over unread.
+ * 
+ * @param cursor: the walk.
+ * @param target: the docID to seek.
+ */
+void index_cursorSeek(index_cursor_t* cursor, const int target);
+
+/**
+ * @function: index_cursorMax
+ * @brief: the maxima of all the walk's postings.
+ * 
+ * @param cursor: the walk.
+ * @param minTokens: where to save the fewest words indexed from any
+ * of their documents; 0 if the document table lacks one.
+ * 
+ * Returns:
+ * @return int: the largest count among them.
+ */
+int index_cursorMax(index_cursor_t* cursor, int* minTokens);
+
+/**
+ * @function: index_cursorBlock
+ * @brief: the maxima of the block of postings holding the first
+ * docID at or above target, without moving the walk or unpacking
+ * the block: the block-max bound of a document up to the block's end.
+ * 
+ * @param cursor: the walk.
+ * @param target: a docID, no lower than the walk's current posting.
+ * @param maxCount: where to save the block's largest count.
+ * @param minTokens: where to save the fewest words indexed from any
+ * of its documents; 0 if the document table lacks one.
+ * 
+ * Returns:
+ * @return int: the block's last docID; INT_MAX, and maxima of 0,
+ * if no posting is at or above target.
+ */
+int index_cursorBlock(index_cursor_t* cursor, const int target, int* maxCount, int* minTokens);
+
+/**
+ * @function: index_cursorDelete
+ * @brief: ends a walk through a word's postings; ignores NULL.
+ */
+void index_cursorDelete(index_cursor_t* cursor);
+
+/**
+ * @function: index_docRange
+ * @brief: finds the smallest and largest docIDs in the index's postings
+ * and document table.
+ * An index opened from a binary file (index_open) has them in its
+ * header, so this costs nothing, however big the index;
+ * otherwise every posting is visited.
+ * 
+ * @param index: the index.
+ * @param first: where to save the smallest docID.
+ * @param last: where to save the largest docID.
+ * 
+ * Returns:
+ * @return true: the index holds some postings or documents.
+ * @return false: it holds none; *first and *last are 0.
+ */
+bool index_docRange(index_t* index, int* first, int* last);
+
+/**
+ * @function: index_setDoc
+ * @brief: records a document in the index's document table:
+ * its URL, depth, and sizes, so that a querier can print a result
+ * without loading the page.
+ * The table is saved with the index in the binary format
+ * (index_save()), not the text format, and moved by index_merge().
+ * 
+ * @param index: pointer to a valid index object, not opened by index_open().
+ * @param docID: the document's ID, > 0.
+ * @param doc: what to record; the URL is copied.
+ */
+void index_setDoc(index_t* index, const int docID, const index_doc_t* doc);
+
+/**
+ * @function: index_getDoc
+ * @brief: looks a document up in the index's document table.
+ * A binary index opened by index_open() holds an entry for every docID
+ * from its first to its last, so this reads the one entry, in O(1),
+ * whatever the size of the index or of the page;
+ * otherwise the table is binary-searched.
+ * 
+ * @param index: the index.
+ * @param docID: the document's ID.
+ * @param doc: where to save the entry; its URL belongs to the index,
+ * valid until index_delete().
+ * 
+ * Returns:
+ * @return true: the document is in the table.
+ * @return false: it is not -- as none is, in a text index.
+ */
+bool index_getDoc(index_t* index, const int docID, index_doc_t* doc);
+
+/**
+ * @function: index_docStats
+ * @brief: counts the documents in the index's document table,
+ * and the words indexed from them (their tokens, summed):
+ * the collection statistics a ranking such as BM25 needs,
+ * with a word's document frequency, index_count().
+ * An index opened from a binary file (index_open) has them in its
+ * header, so this costs nothing, however big the index;
+ * otherwise the table is visited.
+ * 
+ * @param index: the index.
+ * @param nDocs: where to save the number of documents; 0 for a text index.
+ * @param nTokens: where to save the number of words indexed from them.
+ */
+void index_docStats(index_t* index, long* nDocs, long* nTokens);
+
+/**
+ * @function: index_merge()
+ * @brief: moves every posting of one index, and its document table, into another,
+ * then deletes the emptied index.
+ * Words new to index are added in the order part iterates them,
+ * and their counters are moved over, not copied;
+ * the postings of words index already holds are appended to its counters.
+ * Positions are merged the same way if both indexes keep them;
+ * if only one does, the merged index keeps none.
+ * 
+ * Merging indexes built from consecutive docID ranges, in range order,
+ * gives the same index -- and the same index_print() output --
+ * as inserting every document into one index in docID order.
+ * 
+ * Inputs:
+ * @param index: pointer to a valid index object, to merge into.
+ * @param part: pointer to a valid index object, to merge from;
+ * deleted by the call.
+ * 
+ * Returns: none.
+ */
+void index_merge(index_t* index, index_t* part);
+
 /**
  * @function: index_delete()
  * @brief: Deletes an index object created using index_new().
@@ -154,6 +555,10 @@ void index_delete(index_t* index);
  * @function: index_load
  * @brief: receives an address to a saved index file and loads the data into an index_t struct.
  * The file must be available for reading. 
+ * It may be in the text format of index_print()
+ * or the binary format of index_save(); a binary file
+ * is recognized by its magic number, and rejected if its version
+ * is not this one's or its checksum does not match.
  * 
  * Inputs:
  * @param pageDirectory: page directory to search for saved webpages
@@ -164,6 +569,33 @@ void index_delete(index_t* index);
  */
 index_t* index_load(const char* indexFileName);
 
+/**
+ * @function: index_open
+ * @brief: opens an index file read-only, for lookups.
+ * A binary index (see index_save()) is mapped into memory, not loaded:
+ * opening it takes about the same time whatever its size,
+ * index_find() binary-searches the mapped dictionary, then scans a block
+ * of its front-coded words, and unpacks the word's
+ * mapped postings into counters, and processes that open the same
+ * file share its pages through the page cache.
+ * A text index is loaded as by index_load().
+ * 
+ * Opening checks the header but not the checksum,
+ * which would read the whole file; index_load() checks both.
+ * The index may be searched, iterated, printed and saved,
+ * but not changed: index_insert(), index_set() and index_merge()
+ * must not be given it. Nor may several threads call index_find() at once,
+ * since it keeps the counters it unpacks until index_delete().
+ * 
+ * Inputs:
+ * @param indexFileName: path to the index file.
+ * 
+ * Outputs:
+ * @return index_t*: a pointer to the index struct; free with index_delete().
+ * @return NULL: Error reading from file, or the file is not a valid index.
+ */
+index_t* index_open(const char* indexFileName);
+
 // int** index_rank(index_t* index, char* word, char* indexFileName);
 
 
@@ -20,6 +20,7 @@
 
 /* file IO */
 #include "file.h"
+#include "mapfile.h"
 
 /* memory */
 #include "mem.h"
@@ -119,24 +120,33 @@ pagedir_check(char* dirName)
 webpage_t*
 pagedir_load(const char* path)
 {
-  FILE* fp;
+  mapfile_t* map;
+
+  /* if file maps (or reads) successfully, load the webpage */
+  if ((map = mapfile_open(path)) != NULL) {
 
-  /* if file opens successfully, load the webpage */
-  if ((fp = fopen(path, "r")) != NULL) {
+    // read it through a reader over the mapping, copying out what we keep
+    file_reader_t* reader = file_reader_newMem(mapfile_data(map),
+                                               mapfile_size(map));
+    size_t len;
     
     // load url
-    char* url = file_readLine(fp);
+    char* line = file_reader_line(reader, &len);
+    char* url = file_reader_copy(line, len);
     
     // load page depth where crawler found page
-    char* pageDepth = file_readLine(fp);
-    int depth = atoi(pageDepth);
-    mem_free(pageDepth);
+    line = file_reader_line(reader, &len);
+    char* pageDepth = file_reader_copy(line, len);
+    int depth = (pageDepth != NULL) ? atoi(pageDepth) : 0;
+    free(pageDepth);
 
     // load page HTML
-    char* html = file_readUntil(fp, NULL);
+    char* rest = file_reader_rest(reader, &len);
+    char* html = file_reader_copy(rest, len);
 
-    // close the file
-    fclose(fp);
+    // unmap the file
+    file_reader_delete(reader);
+    mapfile_close(map);
 
     // return pointer to a reconstructed webpage.
     return webpage_new(url, depth, html);
@@ -151,8 +161,9 @@ pagedir_load(const char* path)
 
 /**
  * @function: pagedir_count
- * @brief: counts the number of valid webpages
- * saved in a page directory
+ * @brief: counts the webpage files saved in a page directory:
+ * 1, 2, ... up to the first missing docID.
+ * The files are opened, not loaded, so this is cheap next to indexing them.
  * 
  * DISCLAIMER: This function does not check for validity of the directory
  * as a crawler directory.
@@ -160,45 +171,39 @@ pagedir_load(const char* path)
  * 
  * @param pageDirectory: path to a valid crawler directory
  * 
- * @return int: number of valid pages in the crawler directory
+ * @return int: number of page files in the crawler directory
  */
 int
 pagedir_count(const char* pageDirectory)
 {
+  return pagedir_lastFrom(pageDirectory, 1);
+}
+
+/**
+ * @brief see pagedir.h for documentation
+ */
+int
+pagedir_lastFrom(const char* pageDirectory, const int first)
+{
+  size_t len = strlen(pageDirectory);
+  const char* slash = (len > 0 && pageDirectory[len-1] == '/') ? "" : "/";
 
   /*
-   * Step through docID's from 1
+   * Step through docID's from first
    * since docID's are assigned incrementally by the crawler.
    * Once a non-existent file is reached, break.
    */
-  for (int docID=1; ; docID++) {
-
-    // Initialize extension.
-    char extension[20];
-
-    // Create extension (varies on presence/absence of a slash at end) 
-    if (pageDirectory[strlen(pageDirectory)-1] == '/') {
-      sprintf(extension, "%d", docID);
-    }
-    else {
-      sprintf(extension, "%s%d", "/", docID);
-    }
+  for (int docID=first; ; docID++) {
 
-    // append extension
-    char directory[strlen(pageDirectory) + strlen(extension)];
-    sprintf(directory, "%s%s", pageDirectory, extension);
+    // file path: directory, slash if needed, docID
+    char filepath[len + 20];
+    sprintf(filepath, "%s%s%d", pageDirectory, slash, docID);
 
-    // load webpage from address. If null, break loop.
-    webpage_t* page;
-    if ((page = pagedir_load(directory)) != NULL) {
-
-      // delete the page
-      webpage_delete(page);
-    }
-
-    // once pages are out of range, return last successful page ID
-    else {
+    // once pages are out of range, return last page ID found
+    FILE* fp;
+    if ((fp = fopen(filepath, "r")) == NULL) {
       return docID-1;
     }
+    fclose(fp);
   }
-}
\ No newline at end of file
+}
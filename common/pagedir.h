@@ -81,8 +81,9 @@ webpage_t* pagedir_load(const char* filepath);
 
 /**
  * @function: pagedir_count
- * @brief: counts the number of valid webpages
- * saved in a page directory
+ * @brief: counts the webpage files saved in a page directory:
+ * 1, 2, ... up to the first missing docID.
+ * The files are opened, not loaded.
  * 
  * DISCLAIMER: This function does not check for validity of the directory
  * as a crawler directory.
@@ -90,8 +91,21 @@ webpage_t* pagedir_load(const char* filepath);
  * 
  * @param pageDirectory: path to a valid crawler directory
  * 
- * @return int: number of valid pages in the crawler directory
+ * @return int: number of page files in the crawler directory
  */
 int pagedir_count(const char* pageDirectory);
 
+/**
+ * @function: pagedir_lastFrom
+ * @brief: finds the last of the webpage files saved from a docID on:
+ * first, first+1, ... up to the first missing docID --
+ * the pages a crawl has added since the index reached first-1.
+ * 
+ * @param pageDirectory: path to a valid crawler directory
+ * @param first: the docID to start from, >= 1.
+ * 
+ * @return int: the last docID found; first-1 if page first is missing.
+ */
+int pagedir_lastFrom(const char* pageDirectory, const int first);
+
 #endif /*__PAGEDIR_H */
@@ -0,0 +1,741 @@
+/**
+ * @file segments.c
+ * @author Amittai J. Wekesa (@siavava)
+ * @brief: an index as immutable segments listed by a manifest;
+ * opens snapshots of them, adds segments, and merges them.
+ *
+ * Functionality is exported through segments.h
+ *
+ * The manifest, "INDEX.segments", is text:
+ *
+ *   segments <version> <next generation>
+ *   <generation> <bytes>
+ *   ...
+ *
+ * one line for each segment after the base, oldest first.
+ *
+ * @version 0.2
+ * @date 2021-05-22
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/*********** Header Files ************/
+
+#define _POSIX_C_SOURCE 200809L   // nanosleep
+
+/* Standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+/* Memory library */
+#include "mem.h"
+
+/* index */
+#include "index.h"
+
+/* self */
+#include "segments.h"
+
+/************** Local types **************/
+
+/* a snapshot: the open segments, base first */
+struct segments {
+  index_t** indexes;
+  int size;
+};
+
+/* the manifest: the segments after the base, oldest first */
+typedef struct manifest {
+  int next;                     // generation of the next new segment
+  int n;                        // segments listed
+  int* gens;                    // their generations
+  long* bytes;                  // their sizes
+} manifest_t;
+
+/************** Local constants **************/
+
+static const int MANIFEST_VERSION = 1;
+
+/* segments below this many bytes are all of the lowest tier */
+static const long TIER_BYTES = 64 * 1024;
+
+/* times to re-read the manifest, should merges remove what it lists */
+static const int OPEN_TRIES = 8;
+
+/* times to try the lock a writer holds only while it publishes, and the pause between */
+static const int LOCK_TRIES = 1000;
+static const struct timespec LOCK_PAUSE = { 0, 10 * 1000 * 1000 };   // 10 ms
+
+/********** Static functions prototypes ************/
+
+static char* fileName(const char* indexFileName, const char* suffix, const int gen);
+static bool readManifest(const char* indexFileName, manifest_t* manifest);
+static bool writeManifest(const char* indexFileName, manifest_t* manifest);
+static bool sameManifest(manifest_t* a, manifest_t* b);
+static void growManifest(manifest_t* manifest, const int size);
+static void freeManifest(manifest_t* manifest);
+static segments_t* openSnapshot(const char* indexFileName, manifest_t* manifest);
+static long saveSegment(const char* indexFileName, index_t* index, const int gen);
+static int findMerge(manifest_t* manifest, const int factor);
+static int tier(const long bytes, const int factor);
+static int mergeRun(const char* indexFileName, const int factor);
+static bool lock(const char* indexFileName, const char* suffix, const int tries);
+static void unlock(const char* indexFileName, const char* suffix);
+
+
+/********** Exported functions definitions ************/
+
+/**
+ * @function: segments_open
+ * @brief: see segments.h for full documentation.
+ */
+segments_t*
+segments_open(const char* indexFileName)
+{
+  assert(indexFileName != NULL);
+
+  for (int try = 0; try < OPEN_TRIES; try++) {
+    manifest_t manifest;
+    if (!readManifest(indexFileName, &manifest)) {
+      return NULL;
+    }
+    segments_t* segments = openSnapshot(indexFileName, &manifest);
+    if (segments != NULL) {
+      freeManifest(&manifest);
+      return segments;
+    }
+
+    /* a listed segment would not open: retry only if a merge replaced it */
+    manifest_t now;
+    bool changed = readManifest(indexFileName, &now) && !sameManifest(&manifest, &now);
+    freeManifest(&now);
+    freeManifest(&manifest);
+    if (!changed) {
+      return NULL;
+    }
+  }
+  fprintf(stderr, "Error opening '%s': its segments keep changing\n", indexFileName);
+  return NULL;
+}
+
+/**
+ * @function: segments_size
+ * @brief: see segments.h for full documentation.
+ */
+int
+segments_size(segments_t* segments)
+{
+  assert(segments != NULL);
+  return segments->size;
+}
+
+/**
+ * @function: segments_get
+ * @brief: see segments.h for full documentation.
+ */
+index_t*
+segments_get(segments_t* segments, const int i)
+{
+  assert(segments != NULL);
+  return (i >= 0 && i < segments->size) ? segments->indexes[i] : NULL;
+}
+
+/**
+ * @function: segments_lastDocID
+ * @brief: see segments.h for full documentation.
+ */
+int
+segments_lastDocID(segments_t* segments)
+{
+  assert(segments != NULL);
+
+  int lastDocID = 0;
+  for (int i = 0; i < segments->size; i++) {
+    int first, last;
+    if (index_docRange(segments->indexes[i], &first, &last) && last > lastDocID) {
+      lastDocID = last;
+    }
+  }
+  return lastDocID;
+}
+
+/**
+ * @function: segments_getDoc
+ * @brief: see segments.h for full documentation.
+ */
+bool
+segments_getDoc(segments_t* segments, const int docID, index_doc_t* doc)
+{
+  assert(segments != NULL && doc != NULL);
+
+  /* the newest segments first: a document is in one only */
+  for (int i = segments->size - 1; i >= 0; i--) {
+    if (index_getDoc(segments->indexes[i], docID, doc)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @function: segments_docStats
+ * @brief: see segments.h for full documentation.
+ */
+void
+segments_docStats(segments_t* segments, long* nDocs, long* nTokens)
+{
+  assert(segments != NULL && nDocs != NULL && nTokens != NULL);
+
+  *nDocs = *nTokens = 0;
+  for (int i = 0; i < segments->size; i++) {
+    long docs, tokens;
+    index_docStats(segments->indexes[i], &docs, &tokens);
+    *nDocs += docs;
+    *nTokens += tokens;
+  }
+}
+
+/**
+ * @function: segments_delete
+ * @brief: see segments.h for full documentation.
+ */
+void
+segments_delete(segments_t* segments)
+{
+  if (segments != NULL) {
+    for (int i = 0; i < segments->size; i++) {
+      index_delete(segments->indexes[i]);
+    }
+    mem_free(segments->indexes);
+    mem_free(segments);
+  }
+}
+
+/**
+ * @function: segments_add
+ * @brief: see segments.h for full documentation.
+ */
+bool
+segments_add(const char* indexFileName, index_t* segment)
+{
+  assert(indexFileName != NULL && segment != NULL);
+
+  if (!lock(indexFileName, ".lock", LOCK_TRIES)) {
+    return false;
+  }
+  manifest_t manifest;
+  bool added = false;
+  if (readManifest(indexFileName, &manifest)) {
+    int gen = manifest.next;
+    long bytes = saveSegment(indexFileName, segment, gen);
+    if (bytes >= 0) {
+      /* publish it: a manifest of one more segment */
+      growManifest(&manifest, manifest.n + 1);
+      manifest.gens[manifest.n] = gen;
+      manifest.bytes[manifest.n] = bytes;
+      manifest.n++;
+      manifest.next++;
+      if ( !(added = writeManifest(indexFileName, &manifest))) {
+        char* name = fileName(indexFileName, ".seg", gen);
+        remove(name);
+        mem_free(name);
+      }
+    }
+    freeManifest(&manifest);
+  }
+  unlock(indexFileName, ".lock");
+  return added;
+}
+
+/**
+ * @function: segments_merge
+ * @brief: see segments.h for full documentation.
+ */
+int
+segments_merge(const char* indexFileName, const int factor)
+{
+  assert(indexFileName != NULL && factor >= 2);
+
+  /* one merger at a time; updates go on meanwhile */
+  if (!lock(indexFileName, ".merging", 1)) {
+    return -1;
+  }
+
+  /* merge, a run at a time, until no run is due */
+  int merges = 0, merged;
+  while ( (merged = mergeRun(indexFileName, factor)) > 0) {
+    merges++;
+  }
+  if (merged < 0) {
+    merges = -1;
+  }
+
+  unlock(indexFileName, ".merging");
+  return merges;
+}
+
+
+/********** Static functions definitions ************/
+
+/**
+ * @function: fileName()
+ * @brief: static helper function naming the files beside an index:
+ * "INDEX<suffix>", followed by gen if it is positive.
+ *
+ * Returns:
+ * @return char*: the name; the caller must mem_free() it.
+ */
+static char*
+fileName(const char* indexFileName, const char* suffix, const int gen)
+{
+  char* name = mem_malloc_assert(strlen(indexFileName) + strlen(suffix) + 20, "mem alloc for segment name failed.");
+  if (gen > 0) {
+    sprintf(name, "%s%s%d", indexFileName, suffix, gen);
+  }
+  else {
+    sprintf(name, "%s%s", indexFileName, suffix);
+  }
+  return name;
+}
+
+/**
+ * @function: readManifest()
+ * @brief: static helper function reading an index's manifest;
+ * an index without one has no segments but its base.
+ *
+ * Inputs:
+ * @param indexFileName: path to the base index file.
+ * @param manifest: where to read it into; freeManifest() it after.
+ *
+ * Returns:
+ * @return true: the manifest was read.
+ * @return false: it could not be read, or is malformed;
+ * manifest is left empty.
+ */
+static bool
+readManifest(const char* indexFileName, manifest_t* manifest)
+{
+  manifest->next = 1;
+  manifest->n = 0;
+  manifest->gens = NULL;
+  manifest->bytes = NULL;
+
+  char* name = fileName(indexFileName, ".segments", 0);
+  FILE* fp = fopen(name, "r");
+  if (fp == NULL) {
+    bool none = (errno == ENOENT);
+    if (!none) {
+      fprintf(stderr, "Error reading '%s'\n", name);
+    }
+    mem_free(name);
+    return none;
+  }
+
+  int version;
+  bool ok = (fscanf(fp, "segments %d %d", &version, &manifest->next) == 2
+             && version == MANIFEST_VERSION && manifest->next >= 1);
+  int size = 0;
+  int gen;
+  long bytes;
+  while (ok && fscanf(fp, "%d %ld", &gen, &bytes) == 2) {
+    if (gen < 1 || gen >= manifest->next || bytes < 0) {
+      ok = false;
+      break;
+    }
+    if (manifest->n == size) {
+      size = 2 * size + 8;
+      growManifest(manifest, size);
+    }
+    manifest->gens[manifest->n] = gen;
+    manifest->bytes[manifest->n] = bytes;
+    manifest->n++;
+  }
+  ok = ok && feof(fp);
+  fclose(fp);
+
+  if (!ok) {
+    fprintf(stderr, "Error reading '%s': not a segment manifest\n", name);
+    freeManifest(manifest);
+  }
+  mem_free(name);
+  return ok;
+}
+
+/**
+ * @function: writeManifest()
+ * @brief: static helper function publishing a manifest:
+ * it is written under a temporary name, then renamed over the old one,
+ * so a reader sees the old manifest or the new, never part of one.
+ *
+ * Returns:
+ * @return true: the manifest was published.
+ * @return false: error writing it; the old one stands.
+ */
+static bool
+writeManifest(const char* indexFileName, manifest_t* manifest)
+{
+  char* name = fileName(indexFileName, ".segments", 0);
+  char* temp = fileName(indexFileName, ".segments.tmp", 0);
+
+  bool ok = false;
+  FILE* fp = fopen(temp, "w");
+  if (fp != NULL) {
+    ok = fprintf(fp, "segments %d %d\n", MANIFEST_VERSION, manifest->next) > 0;
+    for (int i = 0; i < manifest->n && ok; i++) {
+      ok = fprintf(fp, "%d %ld\n", manifest->gens[i], manifest->bytes[i]) > 0;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    ok = ok && rename(temp, name) == 0;
+  }
+  if (!ok) {
+    fprintf(stderr, "Error writing '%s'\n", name);
+    remove(temp);
+  }
+
+  mem_free(name);
+  mem_free(temp);
+  return ok;
+}
+
+/**
+ * @function: sameManifest()
+ * @brief: static helper function: do two manifests list the same segments?
+ */
+static bool
+sameManifest(manifest_t* a, manifest_t* b)
+{
+  return a->n == b->n
+    && (a->n == 0 || memcmp(a->gens, b->gens, a->n * sizeof(int)) == 0);
+}
+
+/**
+ * @function: growManifest()
+ * @brief: static helper function making room in a manifest's lists
+ * for size segments.
+ */
+static void
+growManifest(manifest_t* manifest, const int size)
+{
+  int* gens = mem_malloc_assert(size * sizeof(int), "mem alloc for manifest failed.");
+  long* bytes = mem_malloc_assert(size * sizeof(long), "mem alloc for manifest failed.");
+  if (manifest->gens != NULL) {
+    memcpy(gens, manifest->gens, manifest->n * sizeof(int));
+    memcpy(bytes, manifest->bytes, manifest->n * sizeof(long));
+    mem_free(manifest->gens);
+    mem_free(manifest->bytes);
+  }
+  manifest->gens = gens;
+  manifest->bytes = bytes;
+}
+
+/**
+ * @function: freeManifest()
+ * @brief: static helper function freeing a manifest's lists.
+ */
+static void
+freeManifest(manifest_t* manifest)
+{
+  if (manifest->gens != NULL) {
+    mem_free(manifest->gens);
+    mem_free(manifest->bytes);
+  }
+  manifest->gens = NULL;
+  manifest->bytes = NULL;
+  manifest->n = 0;
+}
+
+/**
+ * @function: openSnapshot()
+ * @brief: static helper function opening the base
+ * and the segments a manifest lists.
+ *
+ * Returns:
+ * @return segments_t*: the snapshot.
+ * @return NULL: a file would not open; nothing is left open.
+ */
+static segments_t*
+openSnapshot(const char* indexFileName, manifest_t* manifest)
+{
+  segments_t* segments = mem_malloc_assert(sizeof(segments_t), "mem alloc for segments failed.");
+  segments->indexes = mem_calloc_assert(manifest->n + 1, sizeof(index_t*), "mem alloc for segments failed.");
+  segments->size = 0;
+
+  for (int i = 0; i <= manifest->n; i++) {
+    index_t* index;
+    if (i == 0) {
+      index = index_open(indexFileName);
+    }
+    else {
+      char* name = fileName(indexFileName, ".seg", manifest->gens[i-1]);
+      index = index_open(name);
+      mem_free(name);
+    }
+    if (index == NULL) {
+      segments_delete(segments);
+      return NULL;
+    }
+    segments->indexes[segments->size++] = index;
+  }
+  return segments;
+}
+
+/**
+ * @function: saveSegment()
+ * @brief: static helper function saving an index (see index_save())
+ * as segment gen: to a temporary file, then renamed into place.
+ * The temporary file is named for gen, too, as a merge may save a segment
+ * while an update saves another.
+ *
+ * Returns:
+ * @return long: the segment's size in bytes.
+ * @return -1: error writing it; no file is left.
+ */
+static long
+saveSegment(const char* indexFileName, index_t* index, const int gen)
+{
+  char* name = fileName(indexFileName, ".seg", gen);
+  char* temp = fileName(indexFileName, ".seg.tmp", gen);
+
+  long bytes = -1;
+  FILE* fp = fopen(temp, "w");
+  if (fp != NULL) {
+    bool saved = index_save(index, fp);
+    bytes = ftell(fp);
+    saved = (fclose(fp) == 0) && saved;
+    if (!saved || rename(temp, name) != 0) {
+      bytes = -1;
+    }
+  }
+  if (bytes < 0) {
+    fprintf(stderr, "Error writing '%s'\n", name);
+    remove(temp);
+  }
+
+  mem_free(name);
+  mem_free(temp);
+  return bytes;
+}
+
+/**
+ * @function: findMerge()
+ * @brief: static helper function for the merge policy:
+ * finds factor neighbouring segments of one tier, in the lowest tier
+ * that has such a run -- so merges cascade up the tiers,
+ * as carries do up the digits of a counter.
+ *
+ * Returns:
+ * @return int: position in the manifest of the run's first segment.
+ * @return -1: no merge is due.
+ */
+static int
+findMerge(manifest_t* manifest, const int factor)
+{
+  int best = -1, bestTier = INT_MAX;
+  int runStart = 0;
+  for (int i = 1; i <= manifest->n; i++) {
+    int t = tier(manifest->bytes[runStart], factor);
+    if (i == manifest->n || tier(manifest->bytes[i], factor) != t) {
+      if (i - runStart >= factor && t < bestTier) {
+        best = runStart;
+        bestTier = t;
+      }
+      runStart = i;
+    }
+  }
+  return best;
+}
+
+/**
+ * @function: tier()
+ * @brief: static helper function: a segment's tier --
+ * 0 below TIER_BYTES, then one more for each factor times as many.
+ */
+static int
+tier(const long bytes, const int factor)
+{
+  int t = 0;
+  for (long limit = TIER_BYTES; bytes >= limit; limit *= factor) {
+    t++;
+    if (limit > LONG_MAX / factor) {
+      break;
+    }
+  }
+  return t;
+}
+
+/**
+ * @function: mergeRun()
+ * @brief: static helper function merging the run of factor segments
+ * that findMerge() picks into a new segment, and publishing the manifest
+ * with it in their place; then removing them.
+ * The segments are loaded and merged in order, so each word's postings
+ * stay in docID order.
+ *
+ * The lock is held only to pick the run and reserve the new segment's
+ * generation, and again to publish it: segments never change, so the
+ * merging itself goes on while updates add segments after the run.
+ * Only the one merger (see segments_merge) removes segments,
+ * so the run is still in the manifest, whole, when it is published.
+ *
+ * Returns:
+ * @return int: 1 once merged; 0 if no merge is due.
+ * @return -1: error reading or writing segments, or the lock stayed taken;
+ * nothing was published.
+ */
+static int
+mergeRun(const char* indexFileName, const int factor)
+{
+  /* pick the run, and reserve a generation for the merged segment */
+  if (!lock(indexFileName, ".lock", LOCK_TRIES)) {
+    return -1;
+  }
+  manifest_t manifest;
+  int first = -1, gen = 0;
+  int* oldGens = NULL;
+  bool read = readManifest(indexFileName, &manifest), reserved = false;
+  if (read && (first = findMerge(&manifest, factor)) >= 0) {
+    oldGens = mem_malloc_assert(factor * sizeof(int), "mem alloc for manifest failed.");
+    memcpy(oldGens, manifest.gens + first, factor * sizeof(int));
+    gen = manifest.next++;
+    reserved = writeManifest(indexFileName, &manifest);
+  }
+  freeManifest(&manifest);
+  unlock(indexFileName, ".lock");
+  if (!read || (first >= 0 && !reserved)) {
+    if (oldGens != NULL) {
+      mem_free(oldGens);
+    }
+    return -1;
+  }
+  if (first < 0) {
+    return 0;
+  }
+
+  /* merge them, unlocked */
+  index_t* merged = NULL;
+  bool loaded = true;
+  for (int i = 0; i < factor && loaded; i++) {
+    char* name = fileName(indexFileName, ".seg", oldGens[i]);
+    index_t* segment = index_load(name);
+    mem_free(name);
+    if (segment == NULL) {
+      loaded = false;
+    }
+    else if (merged == NULL) {
+      merged = segment;
+    }
+    else {
+      index_merge(merged, segment);
+    }
+  }
+  long bytes = loaded ? saveSegment(indexFileName, merged, gen) : -1;
+  if (merged != NULL) {
+    index_delete(merged);
+  }
+  if (bytes < 0) {
+    mem_free(oldGens);
+    return -1;
+  }
+
+  /*
+   * publish the manifest as it is now -- updates may have added
+   * segments after the run meanwhile -- with the run replaced
+   * by the merged segment
+   */
+  bool published = false;
+  if (lock(indexFileName, ".lock", LOCK_TRIES)) {
+    if (readManifest(indexFileName, &manifest)) {
+      int at = 0;
+      while (at < manifest.n && manifest.gens[at] != oldGens[0]) {
+        at++;
+      }
+      if (at + factor <= manifest.n
+          && memcmp(manifest.gens + at, oldGens, factor * sizeof(int)) == 0) {
+        manifest.gens[at] = gen;
+        manifest.bytes[at] = bytes;
+        for (int i = at + 1; i + factor - 1 < manifest.n; i++) {
+          manifest.gens[i] = manifest.gens[i + factor - 1];
+          manifest.bytes[i] = manifest.bytes[i + factor - 1];
+        }
+        manifest.n -= factor - 1;
+        published = writeManifest(indexFileName, &manifest);
+      }
+      freeManifest(&manifest);
+    }
+    unlock(indexFileName, ".lock");
+  }
+
+  /*
+   * once it is published, no new snapshot holds the merged segments,
+   * and open ones keep their files open (mapped) after removal;
+   * if it is not, the new segment goes instead.
+   */
+  if (published) {
+    for (int i = 0; i < factor; i++) {
+      char* name = fileName(indexFileName, ".seg", oldGens[i]);
+      remove(name);
+      mem_free(name);
+    }
+  }
+  else {
+    char* name = fileName(indexFileName, ".seg", gen);
+    remove(name);
+    mem_free(name);
+  }
+  mem_free(oldGens);
+  return published ? 1 : -1;
+}
+
+/**
+ * @function: lock()
+ * @brief: static helper function taking one of the index's lock files,
+ * "INDEX<suffix>", created only if it does not exist:
+ * "INDEX.lock", held by a writer while it publishes a manifest,
+ * or "INDEX.merging", held by the merger throughout.
+ * A lock that is taken is tried again, tries times in all,
+ * LOCK_PAUSE apart.
+ * A writer that dies holding it leaves it behind;
+ * it must then be removed by hand.
+ *
+ * Returns:
+ * @return true: this process holds the lock.
+ * @return false: another does, or it could not be created.
+ */
+static bool
+lock(const char* indexFileName, const char* suffix, const int tries)
+{
+  char* name = fileName(indexFileName, suffix, 0);
+  FILE* fp;
+  int tried = 1;
+  while ( (fp = fopen(name, "wx")) == NULL && errno == EEXIST && tried++ < tries) {
+    nanosleep(&LOCK_PAUSE, NULL);
+  }
+  if (fp == NULL) {
+    fprintf(stderr, "Error locking '%s': is another indexer updating or merging it?\n", name);
+  }
+  else {
+    fclose(fp);
+  }
+  mem_free(name);
+  return fp != NULL;
+}
+
+/**
+ * @function: unlock()
+ * @brief: static helper function releasing one of the index's lock files.
+ */
+static void
+unlock(const char* indexFileName, const char* suffix)
+{
+  char* name = fileName(indexFileName, suffix, 0);
+  remove(name);
+  mem_free(name);
+}
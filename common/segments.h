@@ -0,0 +1,167 @@
+/**
+ * @file segments.h
+ * @author Amittai J. Wekesa (@siavava)
+ * @brief: exports functionality from segments.c --
+ * an index kept as immutable segments, listed by a manifest.
+ *
+ * An index file "INDEX" is the base segment. Documents crawled later
+ * go into further segments, "INDEX.seg<gen>": binary indexes
+ * (see index_save()), each with a dictionary and postings of its own,
+ * numbered by a generation that is never reused.
+ * The manifest, "INDEX.segments", lists them, oldest first,
+ * with each one's size; an INDEX without one is a single segment.
+ *
+ * Segments are written once and never changed: an update writes
+ * a new segment, a merge writes one segment in place of several,
+ * and either then publishes a new manifest, by renaming it over the old.
+ * A reader opens the segments one manifest lists and keeps them open,
+ * so it sees one point-in-time snapshot of the index
+ * whatever is published meanwhile.
+ *
+ * Each segment holds docIDs beyond every docID of the segments before it,
+ * so a document's postings are all in one segment, and a query over the
+ * whole index is the union of the query over each segment.
+ *
+ * Only one process at a time may add segments, or publish a merge:
+ * each takes the lock file "INDEX.lock", waiting a few seconds
+ * for another to release it before failing. A merge holds it only
+ * to pick the segments it merges and to publish the result, so updates
+ * go on while it merges; one merger at a time holds "INDEX.merging".
+ *
+ * @version 0.2
+ * @date 2021-05-22
+ *
+ * @copyright Copyright (c) 2021
+ */
+
+#ifndef __SEGMENTS_H
+#define __SEGMENTS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "index.h"
+
+typedef struct segments segments_t;
+
+/**
+ * @function: segments_open
+ * @brief: opens a snapshot of an index: the base and the segments
+ * its manifest lists, each with index_open() -- a binary file is
+ * mapped, so opening costs about the same whatever the segments' size.
+ * Should a merge remove a listed segment before it is opened,
+ * the new manifest is read and its segments opened instead.
+ *
+ * @param indexFileName: path to the base index file.
+ *
+ * Returns:
+ * @return segments_t*: the segments, base first, then the others in order;
+ * the caller must segments_delete() them.
+ * @return NULL: the manifest or a segment could not be read.
+ */
+segments_t* segments_open(const char* indexFileName);
+
+/**
+ * @function: segments_size
+ * @brief: counts the segments of the snapshot, base included.
+ */
+int segments_size(segments_t* segments);
+
+/**
+ * @function: segments_get
+ * @brief: returns segment i: 0 is the base; the others follow in order.
+ * The index is read-only, as from index_open().
+ *
+ * Returns:
+ * @return index_t*: the segment's index.
+ * @return NULL: there is no segment i.
+ */
+index_t* segments_get(segments_t* segments, const int i);
+
+/**
+ * @function: segments_lastDocID
+ * @brief: finds the largest docID in any segment,
+ * from the segments' headers, without reading their postings
+ * -- so new documents can be indexed from the one after it.
+ *
+ * Returns:
+ * @return int: the largest docID; 0 if the segments are all empty.
+ */
+int segments_lastDocID(segments_t* segments);
+
+/**
+ * @function: segments_getDoc
+ * @brief: looks a document up in the document tables of the segments
+ * (see index_getDoc()): O(1) for each binary segment.
+ *
+ * @param segments: the snapshot.
+ * @param docID: the document's ID.
+ * @param doc: where to save its entry; valid until segments_delete().
+ *
+ * Returns:
+ * @return true: a segment has the document in its table.
+ * @return false: none has -- a text index, say.
+ */
+bool segments_getDoc(segments_t* segments, const int docID, index_doc_t* doc);
+
+/**
+ * @function: segments_docStats
+ * @brief: the documents in the document tables of the segments,
+ * and the words indexed from them (see index_docStats()), summed:
+ * from the segments' headers, for binary segments.
+ *
+ * @param segments: the snapshot.
+ * @param nDocs: where to save the number of documents.
+ * @param nTokens: where to save the number of words indexed from them.
+ */
+void segments_docStats(segments_t* segments, long* nDocs, long* nTokens);
+
+/**
+ * @function: segments_delete
+ * @brief: closes every segment of the snapshot; ignores NULL.
+ */
+void segments_delete(segments_t* segments);
+
+/**
+ * @function: segments_add
+ * @brief: saves an index as a new segment of indexFileName,
+ * after all the others, and publishes it in a new manifest.
+ *
+ * @param indexFileName: path to the base index file.
+ * @param segment: the index of the new documents, whose docIDs must all
+ * be beyond segments_lastDocID().
+ *
+ * Returns:
+ * @return true: the segment was added.
+ * @return false: the index is locked, or error writing;
+ * nothing was published.
+ */
+bool segments_add(const char* indexFileName, index_t* segment);
+
+/**
+ * @function: segments_merge
+ * @brief: the merge policy, log-structured and tiered: a segment's tier
+ * is its size, in bytes, on a scale of powers of factor;
+ * whenever factor neighbouring segments share a tier,
+ * they are merged into one, a tier up, and so on until none do.
+ * So small segments are merged often and cheaply, large ones rarely,
+ * and an index of n bytes has O(factor * log n) segments.
+ * The base is never merged: merges cost what the new documents do.
+ *
+ * Readers are never blocked; a snapshot opened before a merge
+ * keeps the segments it opened, even once they are removed.
+ * Nor are updates, but while the manifest is published:
+ * segments_add() may add segments after those being merged.
+ *
+ * @param indexFileName: path to the base index file.
+ * @param factor: segments per merge, and ratio of tier sizes; at least 2.
+ *
+ * Returns:
+ * @return int: the number of merges done; 0 if none was due.
+ * @return -1: another merger is running, the lock stayed taken,
+ * or error reading or writing segments;
+ * the merges published before the error stand.
+ */
+int segments_merge(const char* indexFileName, const int factor);
+
+#endif // __SEGMENTS_H
@@ -0,0 +1,586 @@
+/*
+ * segmentstest - behaviour test for segments: updates and merges
+ *
+ * usage:
+ *   segmentstest [nPages]
+ *
+ * Writes nPages synthetic pages, of words drawn from a small vocabulary,
+ * to a crawler directory under /tmp, and indexes them all at once into
+ * a "full" index, as a rebuild would.
+ *
+ * updates: indexes the first quarter of the pages into a base index,
+ *   and the rest, in ranges of uneven size, into segments, one
+ *   segments_add at a time; after each, the manifest must list one more
+ *   segment, and a snapshot must answer queries -- single words and
+ *   conjunctions -- and look up documents as the full index does,
+ *   up to the last docID added.
+ * merges: merges those segments, as "indexer --merge" does; the manifest
+ *   must then be shorter by factor-1 segments a merge, and hold no run
+ *   of factor segments of one tier. A snapshot opened before the merge,
+ *   whose segments are now removed, and one opened after, must both
+ *   still answer as the full index does.
+ * merges during updates: one thread merges, over and over, while another
+ *   adds segments; every add and merge must succeed, and the snapshot
+ *   after must answer as the full index does.
+ *
+ * `make segmentstest` builds it with -fsanitize=address,undefined.
+ * Prints PASS or FAIL lines; exits non-zero on any failure.
+ *
+ * Amittai J. Wekesa, May 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "mem.h"
+#include "webpage.h"
+#include "counters.h"
+#include "index.h"
+#include "segments.h"
+#include "pagedir.h"
+#include "word.h"
+
+/**************** file-local global types ****************/
+/* the merger of testMergesDuringUpdates */
+typedef struct merger {
+  const char* indexFileName;
+  atomic_bool done;             // the updates are over
+  int merges;                   // merges done
+  bool failed;                  // a segments_merge failed
+} merger_t;
+
+/**************** file-local global variables ****************/
+static int nPages = 400;
+static const int nWords = 300;          // the vocabulary
+static const int nQueries = 200;
+static const int FACTOR = 4;            // as the indexer's MERGE_FACTOR
+static const long TIER_BYTES = 64 * 1024;   // as segments.c
+static char dir[] = "/tmp/segmentstest.XXXXXX";
+
+/**************** local functions ****************/
+static bool testUpdates(index_t* full);
+static bool testMergesDuringUpdates(index_t* full);
+static void* mergeWorker(void* arg);
+static void makePages(void);
+static index_t* indexPages(const int first, const int last);
+static bool saveIndex(index_t* index, const char* name);
+static char* indexName(const char* name);
+static void makeWord(const int i, char* word);
+static bool sameAnswers(segments_t* segments, index_t* full, const int last);
+static void answerSegments(segments_t* segments, char** words, const int n, int* count);
+static void answerIndex(index_t* index, char** words, const int n, int* count);
+static void answerCounts(void* arg, const int docID, const int count);
+static bool sameDocs(segments_t* segments, index_t* full, const int last);
+static bool manifestSizes(const char* indexFileName, long* bytes, const int max, int* n, int* next);
+static int tier(const long bytes);
+static bool mergeDue(const long* bytes, const int n);
+static void removeIndex(const char* indexFileName);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 2 || (argc > 1 && sscanf(argv[1], "%d", &nPages) != 1)
+      || nPages < 40) {
+    fprintf(stderr, "usage: %s [nPages>=40]\n", argv[0]);
+    exit(1);
+  }
+  srand(2021);
+
+  if (mkdtemp(dir) == NULL || !pagedir_init(dir)) {
+    fprintf(stderr, "FAIL: cannot make a page directory under /tmp\n");
+    exit(2);
+  }
+  makePages();
+
+  /* the full index, rebuilt from every page, to answer as */
+  char* fullName = indexName("full");
+  index_t* built = indexPages(1, nPages);
+  bool ok = saveIndex(built, fullName);
+  index_delete(built);
+  index_t* full = ok ? index_open(fullName) : NULL;
+  if (full == NULL) {
+    fprintf(stderr, "FAIL: cannot save and open the full index\n");
+    exit(2);
+  }
+
+  ok = testUpdates(full);
+  ok = testMergesDuringUpdates(full) && ok;
+
+  /* clean up */
+  index_delete(full);
+  remove(fullName);
+  mem_free(fullName);
+  for (int docID = 1; docID <= nPages; docID++) {
+    char page[sizeof(dir) + 20];
+    sprintf(page, "%s/%d", dir, docID);
+    remove(page);
+  }
+  char crawler[sizeof(dir) + 20];
+  sprintf(crawler, "%s/.crawler", dir);
+  remove(crawler);
+  rmdir(dir);
+
+  if (mem_net() != 0 || mem_bytes() != 0) {
+    mem_report(stdout, "FAIL: leaked");
+    ok = false;
+  }
+  return ok ? 0 : 2;
+}
+
+/**************** testUpdates ****************/
+/* a base, then segments of uneven size; then they are merged */
+static bool
+testUpdates(index_t* full)
+{
+  char* name = indexName("index");
+  bool ok = true;
+
+  /* the base: the first quarter */
+  int last = nPages / 4;
+  index_t* base = indexPages(1, last);
+  if (!saveIndex(base, name)) {
+    printf("FAIL: updates: cannot save the base index\n");
+    ok = false;
+  }
+  index_delete(base);
+
+  /* the rest, in ranges of uneven size: one segment each */
+  segments_t* before = NULL;
+  int beforeLast = 0;
+  int nAdded = 0;
+  while (ok && last < nPages) {
+    int size = 1 + rand() % (nPages / 10);
+    int first = last + 1;
+    last = (last + size < nPages) ? last + size : nPages;
+
+    index_t* segment = indexPages(first, last);
+    if (!segments_add(name, segment)) {
+      printf("FAIL: updates: segments_add of docIDs %d-%d\n", first, last);
+      ok = false;
+    }
+    index_delete(segment);
+    nAdded++;
+
+    segments_t* segments = segments_open(name);
+    if (segments == NULL || segments_size(segments) != nAdded + 1
+        || segments_lastDocID(segments) != last) {
+      printf("FAIL: updates: after adding docIDs %d-%d, the snapshot holds "
+             "%d segments up to docID %d, not %d up to %d\n", first, last,
+             segments != NULL ? segments_size(segments) : -1,
+             segments != NULL ? segments_lastDocID(segments) : -1,
+             nAdded + 1, last);
+      ok = false;
+    }
+    else {
+      ok = sameAnswers(segments, full, last) && sameDocs(segments, full, last) && ok;
+    }
+
+    /* keep one snapshot from halfway, to read across the merge */
+    if (before == NULL && segments != NULL && last >= nPages / 2) {
+      before = segments;
+      beforeLast = last;
+    }
+    else {
+      segments_delete(segments);
+    }
+  }
+
+  /* merge them: the manifest must shrink as the tiers say */
+  long bytes[nAdded + 1];
+  int n = 0, next = 0;
+  int merges = ok ? segments_merge(name, FACTOR) : -1;
+  if (merges < 0) {
+    printf("FAIL: updates: segments_merge\n");
+    ok = false;
+  }
+  else if (!manifestSizes(name, bytes, nAdded + 1, &n, &next)) {
+    printf("FAIL: updates: cannot read the manifest after merging\n");
+    ok = false;
+  }
+  else if (n > nAdded || n != nAdded - (FACTOR - 1) * merges || mergeDue(bytes, n)) {
+    printf("FAIL: updates: %d merges left %d of %d segments%s\n", merges, n, nAdded,
+           (n <= nAdded && mergeDue(bytes, n)) ? ", with a merge still due" : "");
+    ok = false;
+  }
+
+  /* both snapshots must answer as the full index does */
+  if (ok && before != NULL) {
+    ok = sameAnswers(before, full, beforeLast) && sameDocs(before, full, beforeLast);
+  }
+  segments_delete(before);
+  segments_t* after = ok ? segments_open(name) : NULL;
+  if (ok && (after == NULL || segments_size(after) != n + 1)) {
+    printf("FAIL: updates: the snapshot after merging holds %d segments, not %d\n",
+           after != NULL ? segments_size(after) : -1, n + 1);
+    ok = false;
+  }
+  if (ok) {
+    ok = sameAnswers(after, full, nPages) && sameDocs(after, full, nPages);
+  }
+  segments_delete(after);
+
+  if (ok) {
+    printf("PASS: updates, %d segments, merged by %d merges into %d\n", nAdded, merges, n);
+  }
+  removeIndex(name);
+  mem_free(name);
+  return ok;
+}
+
+/**************** testMergesDuringUpdates ****************/
+/* one thread merges while this one adds segments */
+static bool
+testMergesDuringUpdates(index_t* full)
+{
+  char* name = indexName("concurrent");
+  bool ok = true;
+
+  int last = nPages / 4;
+  index_t* base = indexPages(1, last);
+  if (!saveIndex(base, name)) {
+    printf("FAIL: merges during updates: cannot save the base index\n");
+    ok = false;
+  }
+  index_delete(base);
+
+  merger_t merger = { name, false, 0, false };
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, mergeWorker, &merger) != 0) {
+    printf("FAIL: merges during updates: cannot start the merger\n");
+    removeIndex(name);
+    mem_free(name);
+    return false;
+  }
+
+  /* small segments, so merges are due all along */
+  int nAdded = 0;
+  while (ok && last < nPages) {
+    int first = last + 1;
+    last = (last + 8 < nPages) ? last + 8 : nPages;
+    index_t* segment = indexPages(first, last);
+    if (!segments_add(name, segment)) {
+      printf("FAIL: merges during updates: segments_add of docIDs %d-%d\n", first, last);
+      ok = false;
+    }
+    index_delete(segment);
+    nAdded++;
+  }
+  atomic_store(&merger.done, true);
+  pthread_join(thread, NULL);
+
+  if (merger.failed) {
+    printf("FAIL: merges during updates: segments_merge, after %d merges\n", merger.merges);
+    ok = false;
+  }
+
+  /* whatever was merged when, the snapshot must hold every page */
+  long bytes[nAdded + 1];
+  int n = 0, next = 0;
+  segments_t* segments = ok ? segments_open(name) : NULL;
+  if (ok && (segments == NULL || segments_lastDocID(segments) != nPages
+             || !manifestSizes(name, bytes, nAdded + 1, &n, &next)
+             || n > nAdded || n != nAdded - (FACTOR - 1) * merger.merges || mergeDue(bytes, n))) {
+    printf("FAIL: merges during updates: %d segments added and %d merges "
+           "left a manifest of %d\n", nAdded, merger.merges, n);
+    ok = false;
+  }
+  if (ok) {
+    ok = sameAnswers(segments, full, nPages) && sameDocs(segments, full, nPages);
+  }
+  segments_delete(segments);
+
+  if (ok) {
+    printf("PASS: merges during updates, %d segments, %d merges\n", nAdded, merger.merges);
+  }
+  removeIndex(name);
+  mem_free(name);
+  return ok;
+}
+
+/* Merge until the updates are over, and once more after. */
+static void*
+mergeWorker(void* arg)
+{
+  merger_t* merger = arg;
+  bool done;
+  do {
+    done = atomic_load(&merger->done);
+    int merges = segments_merge(merger->indexFileName, FACTOR);
+    if (merges < 0) {
+      merger->failed = true;
+      break;
+    }
+    merger->merges += merges;
+  } while (!done);
+  return NULL;
+}
+
+/**************** makePages ****************/
+/* Write nPages pages to dir, of words from the vocabulary, some often. */
+static void
+makePages(void)
+{
+  for (int docID = 1; docID <= nPages; docID++) {
+    int nTokens = 20 + rand() % 200;
+    char* html = mem_malloc_assert(nTokens * 12 + 40, "html");
+    char* end = html + sprintf(html, "<html><body>");
+    for (int i = 0; i < nTokens; i++) {
+      char word[12];
+      makeWord(rand() % (1 + rand() % nWords), word);    // skewed to the first words
+      end += sprintf(end, " %s", word);
+    }
+    sprintf(end, "</body></html>");
+
+    char url[40];
+    sprintf(url, "http://segmentstest/%d.html", docID);
+    // webpage_delete free()s them
+    webpage_t* page = webpage_new(strdup(url), docID % 3, strdup(html));
+    pagedir_save(page, dir, docID);
+    webpage_delete(page);
+    mem_free(html);
+  }
+}
+
+/**************** indexPages ****************/
+/* Index pages first..last of dir, as the indexer does each page. */
+static index_t*
+indexPages(const int first, const int last)
+{
+  index_t* index = mem_assert(index_new(), "index");
+  for (int docID = first; docID <= last; docID++) {
+    char filepath[sizeof(dir) + 20];
+    sprintf(filepath, "%s/%d", dir, docID);
+    webpage_t* page = mem_assert(pagedir_load(filepath), "page");
+
+    int pos = 0, tokens = 0;
+    char* word;
+    while ( (word = webpage_getNextWord(page, &pos)) != NULL) {
+      if (strlen(word) > 2) {
+        normalizeWord(word);
+        index_insert(index, word, docID);
+        tokens++;
+      }
+      free(word);
+    }
+    char* html = webpage_getHTML(page);
+    index_doc_t doc = { webpage_getURL(page), webpage_getDepth(page), tokens,
+                        html != NULL ? (int) strlen(html) : 0 };
+    index_setDoc(index, docID, &doc);
+    webpage_delete(page);
+  }
+  return index;
+}
+
+/* Save an index, in binary, to a file. */
+static bool
+saveIndex(index_t* index, const char* name)
+{
+  FILE* fp = fopen(name, "w");
+  if (fp == NULL) {
+    return false;
+  }
+  bool ok = index_save(index, fp);
+  return (fclose(fp) == 0) && ok;
+}
+
+/* Name a file in dir; caller must mem_free() it. */
+static char*
+indexName(const char* name)
+{
+  char* path = mem_malloc_assert(sizeof(dir) + strlen(name) + 1, "name");
+  sprintf(path, "%s/%s", dir, name);
+  return path;
+}
+
+/* Word i of the vocabulary: "seg", then i in base 26. */
+static void
+makeWord(const int i, char* word)
+{
+  char* end = word + sprintf(word, "seg");
+  int rest = i;
+  do {
+    *end++ = 'a' + rest % 26;
+    rest /= 26;
+  } while (rest > 0);
+  *end = '\0';
+}
+
+/**************** sameAnswers ****************/
+/*
+ * Random queries -- single words, and conjunctions of two or three --
+ * must find the same documents, with the same counts, in the segments,
+ * unioned, as in the full index, up to docID last.
+ */
+static bool
+sameAnswers(segments_t* segments, index_t* full, const int last)
+{
+  int* mine = mem_malloc_assert((nPages + 1) * sizeof(int), "answer");
+  int* theirs = mem_malloc_assert((nPages + 1) * sizeof(int), "answer");
+  bool ok = true;
+
+  for (int q = 0; q < nQueries && ok; q++) {
+    int n = 1 + rand() % 3;
+    char buf[3][12];
+    char* words[3];
+    for (int i = 0; i < n; i++) {
+      makeWord(rand() % (1 + rand() % nWords), buf[i]);
+      words[i] = buf[i];
+    }
+    answerSegments(segments, words, n, mine);
+    answerIndex(full, words, n, theirs);
+    for (int docID = 1; docID <= nPages && ok; docID++) {
+      int expected = (docID <= last) ? theirs[docID] : 0;
+      if (mine[docID] != expected) {
+        printf("FAIL: query '%s%s%s%s%s' finds docID %d %d times in %d segments, "
+               "not %d\n", words[0], n > 1 ? " " : "", n > 1 ? words[1] : "",
+               n > 2 ? " " : "", n > 2 ? words[2] : "",
+               docID, mine[docID], segments_size(segments), expected);
+        ok = false;
+      }
+    }
+  }
+  mem_free(mine);
+  mem_free(theirs);
+  return ok;
+}
+
+/* The query's answer over each segment, unioned: their docIDs are apart. */
+static void
+answerSegments(segments_t* segments, char** words, const int n, int* count)
+{
+  int* part = mem_malloc_assert((nPages + 1) * sizeof(int), "answer");
+  memset(count, 0, (nPages + 1) * sizeof(int));
+  for (int s = 0; s < segments_size(segments); s++) {
+    answerIndex(segments_get(segments, s), words, n, part);
+    for (int docID = 1; docID <= nPages; docID++) {
+      count[docID] += part[docID];
+    }
+  }
+  mem_free(part);
+}
+
+/* The query's answer over one index, as the querier intersects words. */
+static void
+answerIndex(index_t* index, char** words, const int n, int* count)
+{
+  memset(count, 0, (nPages + 1) * sizeof(int));
+  counters_t* ctrs = index_find(index, words[0]);       // the index's own
+  counters_t* mine = NULL;
+  for (int i = 1; i < n && ctrs != NULL; i++) {
+    counters_t* next = mem_assert(index_intersect(index, words[i], ctrs), "intersect");
+    if (mine != NULL) {
+      counters_delete(mine);
+    }
+    ctrs = mine = next;
+  }
+  if (ctrs != NULL) {
+    counters_iterate(ctrs, count, answerCounts);
+  }
+  if (mine != NULL) {
+    counters_delete(mine);
+  }
+}
+
+static void
+answerCounts(void* arg, const int docID, const int count)
+{
+  int* counts = arg;
+  if (docID >= 1 && docID <= nPages) {
+    counts[docID] = count;
+  }
+}
+
+/**************** sameDocs ****************/
+/* The segments' document tables must hold what the full index's does, up to last. */
+static bool
+sameDocs(segments_t* segments, index_t* full, const int last)
+{
+  for (int docID = 1; docID <= nPages; docID++) {
+    index_doc_t mine, theirs;
+    bool found = segments_getDoc(segments, docID, &mine);
+    if (found != (docID <= last)
+        || (found && (!index_getDoc(full, docID, &theirs)
+                      || strcmp(mine.url, theirs.url) != 0 || mine.depth != theirs.depth
+                      || mine.tokens != theirs.tokens || mine.bytes != theirs.bytes))) {
+      printf("FAIL: docID %d is %s in %d segments' document tables\n", docID,
+             found ? "wrong" : "missing", segments_size(segments));
+      return false;
+    }
+  }
+  return true;
+}
+
+/**************** manifestSizes ****************/
+/* Count the segments an index's manifest lists, and read the sizes of the first max. */
+static bool
+manifestSizes(const char* indexFileName, long* bytes, const int max, int* n, int* next)
+{
+  char name[strlen(indexFileName) + 20];
+  sprintf(name, "%s.segments", indexFileName);
+  FILE* fp = fopen(name, "r");
+  if (fp == NULL) {
+    return false;
+  }
+  int version, gen;
+  long size;
+  bool ok = fscanf(fp, "segments %d %d", &version, next) == 2;
+  for (*n = 0; ok && fscanf(fp, "%d %ld", &gen, &size) == 2; (*n)++) {
+    if (*n < max) {
+      bytes[*n] = size;
+    }
+  }
+  fclose(fp);
+  return ok;
+}
+
+/* A segment's tier, as segments.c reckons it. */
+static int
+tier(const long bytes)
+{
+  int t = 0;
+  for (long limit = TIER_BYTES; bytes >= limit; limit *= FACTOR) {
+    t++;
+  }
+  return t;
+}
+
+/* Do FACTOR neighbouring segments share a tier, so a merge is due? */
+static bool
+mergeDue(const long* bytes, const int n)
+{
+  int run = 0;
+  for (int i = 0; i < n; i++) {
+    run = (i > 0 && tier(bytes[i]) == tier(bytes[i-1])) ? run + 1 : 1;
+    if (run >= FACTOR) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************** removeIndex ****************/
+/* Remove an index, its manifest and segments, and any lock files. */
+static void
+removeIndex(const char* indexFileName)
+{
+  int n, next = 1;
+  manifestSizes(indexFileName, NULL, 0, &n, &next);
+
+  char name[strlen(indexFileName) + 40];
+  for (int gen = 1; gen < next; gen++) {
+    sprintf(name, "%s.seg%d", indexFileName, gen);
+    remove(name);
+  }
+  const char* suffixes[] = { ".segments", ".lock", ".merging", "" };
+  for (int i = 0; i < 4; i++) {
+    sprintf(name, "%s%s", indexFileName, suffixes[i]);
+    remove(name);
+  }
+}
@@ -0,0 +1,74 @@
+/**
+ * @file indexconvert.c
+ * @author Amittai J. Wekesa (@siavava)
+ * @brief: converts an index file between the text format
+ * of index_print() and the binary format of index_save().
+ *
+ * Usage: ./indexconvert --binary|--text [SOURCE FILE] [OUTPUT FILE]
+ *
+ * The source may be in either format; index_load() tells them apart.
+ * The output is in the format named by the flag.
+ *
+ * @version 0.1
+ * @date 2021-05-07
+ *
+ * @copyright Copyright (c) 2021
+ */
+
+/******** Header Files *********/
+
+/* Standard Libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* index data structure */
+#include "index.h"
+
+
+int
+main(const int argc, const char* argv[])
+{
+
+  /* if incorrect usage, exit. */
+  bool binary = argc == 4 && strcmp(argv[1], "--binary") == 0;
+  if (argc != 4 || (!binary && strcmp(argv[1], "--text") != 0)) {
+    fprintf(stderr, "Invalid usage.\n");
+    fprintf(stderr, "Usage: ./indexconvert --binary|--text [SOURCE FILE] [OUTPUT FILE]\n");
+    exit(1);
+  }
+  const char* source = argv[2];
+  const char* output = argv[3];
+
+  /* load the source index, in whichever format */
+  index_t* index;
+  if ( (index = index_load(source)) == NULL) {
+    fprintf(stderr, "Error loading source file: '%s'\n", source);
+    exit(2);
+  }
+
+  /* open output file */
+  FILE* outputFile;
+  if ( (outputFile = fopen(output, "w")) == NULL) {
+    fprintf(stderr, "Error opening output file: '%s'\n", output);
+    index_delete(index);
+    exit(3);
+  }
+
+  /* write it in the format asked for */
+  bool ok = true;
+  if (binary) {
+    ok = index_save(index, outputFile);
+  }
+  else {
+    index_print(index, outputFile);
+  }
+  if (fclose(outputFile) != 0 || !ok) {
+    fprintf(stderr, "Error writing output file: '%s'\n", output);
+    ok = false;
+  }
+
+  index_delete(index);
+  return ok ? 0 : 4;
+}
@@ -20,10 +20,14 @@
 /* data structures */
 #include "webpage.h"
 #include "index.h"
+#include "segments.h"
 
 /* memory library */
 #include "mem.h"
 
+/* worker threads */
+#include "threadpool.h"
+
 /* TSE libraries */
 #include "pagedir.h"
 #include "word.h"
@@ -32,8 +36,22 @@
 /************** Function Prototypes ***************/
 
 /* See function definitions for documentation */
-static void parseArgs(char* argv[], char** pageDirectory, char** indexFileName);
-static void indexBuild(const char* pageDirectory, index_t* index);
+struct docs;                    // see LOCAL TYPES
+static void parseArgs(char* argv[], char** pageDirectory, char** indexFileName, const bool update);
+static bool parseOptions(int argc, char* argv[], int* nThreads, long* memoryMB, bool* binary, bool* update, bool* merge, bool* positions, char** docList);
+static int* parseDocs(const char* docList, int* nDocs);
+static int compareDocIDs(const void* a, const void* b);
+static bool indexUpdate(const char* pageDirectory, const char* indexFileName, const char* docList, const bool positions, threadpool_t* pool);
+static bool docsMissing(const char* pageDirectory, const struct docs* docs);
+static void indexBuild(const char* pageDirectory, const struct docs* docs, index_t* index, const bool positions, threadpool_t* pool);
+static bool indexBuildRuns(const char* pageDirectory, const struct docs* docs, const char* indexFileName, threadpool_t* pool, const long budget);
+static struct part* partsNew(const char* pageDirectory, const struct docs* docs, threadpool_t* pool, index_t* first, const bool positions, int* nParts);
+static int partsBuild(struct part* parts, const int nParts, threadpool_t* pool);
+static void partBuild(void* arg, const int lo, const int hi);
+static bool partFlush(struct part* part);
+static void partMerge(void* arg, const int lo, const int hi);
+static FILE* tempOpen(const char* indexFileName, char** temp);
+static bool tempPublish(FILE* fp, char* temp, const char* indexFileName, bool ok);
 static void indexPage(webpage_t* page, int docID, index_t* index);
 
 /* function to log progress */
@@ -48,6 +66,42 @@ static const int INVALID_DIR = 2;
 static const int INVALID_FILE = 3;
 static const int INDEX_ERROR = 4;
 
+/* docID ranges, hence partial indexes, for each worker thread */
+static const int PARTS_PER_THREAD = 2;
+
+/* segments of a tier that --merge merges into one, a tier up */
+static const int MERGE_FACTOR = 4;
+
+
+/************* LOCAL TYPES ***************/
+/* the docIDs to index: first..last */
+typedef struct docs {
+  int first, last;              // docIDs, inclusive
+} docs_t;
+
+/* a range of docIDs, indexed by one worker into a partial index of its own */
+typedef struct part {
+  const char* pageDirectory;    // where the pages are
+  int first, last;              // docIDs first..last, inclusive
+  int missing;                  // first docID in range that did not load; 0 if none
+  index_t* index;               // the partial index
+  /* for indexBuildRuns only */
+  int id;                       // position in the array of parts
+  long budget;                  // bytes the partial index may grow to; 0 for no limit
+  const char* runPrefix;        // runs are named runPrefix.run<id>.<n>
+  int nPending;                 // pages indexed since the last run
+  int nRuns;                    // runs written so far
+  char** runs;                  // their names
+  bool failed;                  // a run could not be written
+} part_t;
+
+/* one round of merging partial indexes: parts[i] absorbs parts[i+step] */
+typedef struct merge {
+  part_t* parts;                // the parts still left
+  int nParts;                   // how many
+  int step;                     // distance between merged pairs
+} merge_t;
+
 
 int 
 main(int argc, char* argv[])
@@ -55,11 +109,16 @@ main(int argc, char* argv[])
   /* NORMAL FUNCTIONALITY */  
 
   /* If invalid number of arguments, print usage and error message, exit non-zero. */
-  if (argc != 3) {
-    const char* usage = "./indexer [pageDirectory] [indexFilename]\n";
+  int nThreads;
+  long memoryMB;
+  bool binary, update, merge, positions;
+  char* docList;
+  if (argc < 3 || argc > 9 || !parseOptions(argc, argv, &nThreads, &memoryMB, &binary, &update, &merge, &positions, &docList)) {
+    const char* usage = "./indexer [pageDirectory] [indexFilename] [--threads N] [--memory MB | --binary [--positions] | --update [--docs LIST] [--positions] | --merge]\n";
 
     if (argc < 3) fprintf(stderr, "Too few arguments.\n");
-    else fprintf(stderr, "Too many arguments.\n");
+    else if (argc > 9) fprintf(stderr, "Too many arguments.\n");
+    else fprintf(stderr, "Invalid options.\n");
     
     fprintf(stderr, "Usage: '%s'", usage);
     exit(INCORRECT_USAGE);
@@ -70,38 +129,104 @@ main(int argc, char* argv[])
   char** indexFileName = mem_malloc_assert(sizeof(argv[2]), "Memory allocation for indexFileName failed.");
 
   /* parse the arguments */
-  parseArgs(argv, pageDirectory, indexFileName);
+  parseArgs(argv, pageDirectory, indexFileName, update || merge);
 
-  /* initialize the index */
-  index_t* index;
-  if ( (index = index_new()) == NULL){
-    fprintf(stderr, "Error creating index.");
+  /*
+   * initialize the index: with the words' positions, if asked
+   * -- only to build it in memory; the runs and an update's segment
+   * are indexes of their own
+   */
+  index_t* index = NULL;
+  if (!update && !merge && memoryMB == 0
+      && (index = (positions ? index_newPositional() : index_new())) == NULL) {
+    fprintf(stderr, "Error creating index.\n");
     mem_free(pageDirectory);
     mem_free(indexFileName);
     exit(INDEX_ERROR);
   }
 
-  /* build the index */
-  indexBuild(*pageDirectory, index);
+  /* start the worker threads: by default, one per core */
+  threadpool_t* pool;
+  if ( (pool = threadpool_new(nThreads)) == NULL) {
+    fprintf(stderr, "Error starting worker threads.\n");
+    if (index != NULL) {
+      index_delete(index);
+    }
+    mem_free(pageDirectory);
+    mem_free(indexFileName);
+    exit(INDEX_ERROR);
+  }
 
-  /* print out the index to file */
-  FILE* fp = fopen(*indexFileName, "w");
-  if (fp != NULL) {
-    index_print(index, fp);
-    logProgress(1, "printed", *indexFileName);
-    fclose(fp);
+  /*
+   * build the index and print it out to file (or save it, in binary):
+   * in memory, or -- given a memory budget -- through sorted runs on disk;
+   * or, to update it, index only the new pages, into a new segment of it;
+   * or merge the segments updates have added, apart from any update
+   */
+  bool ok = true;
+  if (update) {
+    if (!indexUpdate(*pageDirectory, *indexFileName, docList, positions, pool)) {
+      fprintf(stderr, "Error updating index.\n");
+      ok = false;
+    }
+  }
+  else if (merge) {
+    if (segments_merge(*indexFileName, MERGE_FACTOR) < 0) {
+      fprintf(stderr, "Error merging segments of '%s'.\n", *indexFileName);
+      ok = false;
+    }
+    else {
+      logProgress(1, "merged", *indexFileName);
+    }
   }
+  else if (memoryMB == 0) {
+    docs_t allDocs = { 1, pagedir_count(*pageDirectory) };
+    indexBuild(*pageDirectory, &allDocs, index, positions, pool);
+
+    char* temp;
+    FILE* fp;
+    if ( (fp = tempOpen(*indexFileName, &temp)) == NULL) {
+      ok = false;
+    }
+    else {
+      if (!binary) {
+        index_print(index, fp);
+      }
+      else {
+        ok = index_save(index, fp);
+      }
+      ok = tempPublish(fp, temp, *indexFileName, ok);
+      if (ok) {
+        logProgress(1, binary ? "saved" : "printed", *indexFileName);
+      }
+    }
+  }
+  else {
+    docs_t allDocs = { 1, pagedir_count(*pageDirectory) };
+    if (!indexBuildRuns(*pageDirectory, &allDocs, *indexFileName, pool, memoryMB << 20)) {
+      fprintf(stderr, "Error merging index runs.\n");
+      ok = false;
+    }
+  }
+
+  /* stop the worker threads */
+#ifdef LOGPROGRESS
+  threadpool_report(pool, stdout, "threads");
+#endif
+  threadpool_delete(pool);
 
   /* delete the index */
-  index_delete(index);
-  logProgress(0, "deleted", "index object.");
+  if (index != NULL) {
+    index_delete(index);
+    logProgress(0, "deleted", "index object.");
+  }
 
   /* de-allocate memory for pageDirectory and indexFileName */
   mem_free(pageDirectory);
   mem_free(indexFileName);
 
   /* exit */
-  return SUCCESS;
+  return ok ? SUCCESS : INDEX_ERROR;
 }
 
 /**
@@ -112,6 +237,7 @@ main(int argc, char* argv[])
  * @param argv: argument vector received from commandline 
  * @param pageDirectory: pointer to malloc'ed memory location to hold page directory 
  * @param indexFileName: pointer to malloc'ed memory location to hold path to index file
+ * @param update: whether the index file is to be updated or merged, so must exist, not be (re)created
  * 
  * DISCLAIMER:
  * parseArgs expects input pointers to point to allocated memory.
@@ -120,7 +246,7 @@ main(int argc, char* argv[])
  * Passing in non-malloc'ed memory could cause segmentation faults.
  */
 static void
-parseArgs(char* argv[], char** pageDirectory, char** indexFileName)
+parseArgs(char* argv[], char** pageDirectory, char** indexFileName, const bool update)
 {
   /* 
    * If directory does not contain a .crawler file,
@@ -138,11 +264,14 @@ parseArgs(char* argv[], char** pageDirectory, char** indexFileName)
   }
 
   /*
-   * If unable to open (or create) the file wherein to write the index,
+   * If unable to open (or create) the file wherein to write the index
+   * -- or, to update it, to read it --
    * print an error message and exit.
+   * An index already there is left as it is, not truncated:
+   * the new one replaces it only once written in full.
    */
   FILE* fp;
-  if ((fp = fopen(argv[2], "w")) == NULL) {
+  if ((fp = fopen(argv[2], update ? "r" : "a")) == NULL) {
     fprintf(stderr, "Invalid index file name and/or directory.\n");
     mem_free(pageDirectory);
     mem_free(indexFileName);
@@ -158,6 +287,306 @@ parseArgs(char* argv[], char** pageDirectory, char** indexFileName)
   logProgress(0, "index", *indexFileName);
 }
 
+/**
+ * @function: parseOptions
+ * @brief: reads the options that may follow the two required arguments,
+ * in any order: "--threads N", "--memory MB", "--binary",
+ * "--update", "--docs LIST", "--positions" and "--merge".
+ * The runs of a memory-bounded build merge into a text index,
+ * so "--binary" does not go with "--memory";
+ * indexconvert converts the text index afterwards.
+ * An update indexes the new pages in memory, into a binary segment,
+ * so "--update" does not go with "--memory" either;
+ * "--docs" picks the pages an update indexes, so goes only with it.
+ * Only the binary format has room for positions,
+ * so "--positions" goes with "--binary" or "--update".
+ * "--merge" merges the segments updates have added, and builds nothing,
+ * so goes with none of the others but "--threads".
+ * 
+ * @param argc: argument count received from commandline
+ * @param argv: argument vector received from commandline
+ * @param nThreads: where to save N; 0 (one thread per core) if not given
+ * @param memoryMB: where to save MB; 0 (no limit) if not given
+ * @param binary: where to save whether to write the binary format
+ * @param update: where to save whether to update the index
+ * @param merge: where to save whether to merge the index's segments
+ * @param positions: where to save whether to keep the words' positions
+ * @param docList: where to save LIST; NULL if not given
+ * @return bool: true if every option was well-formed and positive.
+ */
+static bool
+parseOptions(int argc, char* argv[], int* nThreads, long* memoryMB, bool* binary, bool* update, bool* merge, bool* positions, char** docList)
+{
+  *nThreads = 0;
+  *memoryMB = 0;
+  *binary = false;
+  *update = false;
+  *merge = false;
+  *positions = false;
+  *docList = NULL;
+
+  for (int i = 3; i < argc; i += 2) {
+    char excess;
+    if (strcmp(argv[i], "--binary") == 0) {
+      *binary = true;
+      i--;                      // a flag, with no value to skip
+    }
+    else if (strcmp(argv[i], "--update") == 0) {
+      *update = true;
+      i--;                      // a flag, with no value to skip
+    }
+    else if (strcmp(argv[i], "--merge") == 0) {
+      *merge = true;
+      i--;                      // a flag, with no value to skip
+    }
+    else if (strcmp(argv[i], "--positions") == 0) {
+      *positions = true;
+      i--;                      // a flag, with no value to skip
+    }
+    else if (i + 1 == argc) {
+      return false;
+    }
+    else if (strcmp(argv[i], "--threads") == 0) {
+      if (sscanf(argv[i+1], "%d%c", nThreads, &excess) != 1 || *nThreads < 1) {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "--memory") == 0) {
+      if (sscanf(argv[i+1], "%ld%c", memoryMB, &excess) != 1 || *memoryMB < 1) {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i], "--docs") == 0) {
+      *docList = argv[i+1];
+    }
+    else {
+      return false;
+    }
+  }
+  if (*merge) {
+    return !*update && !*binary && !*positions && *memoryMB == 0 && *docList == NULL;
+  }
+  if (*update) {
+    return *memoryMB == 0;
+  }
+  return !(*binary && *memoryMB > 0) && *docList == NULL && (*binary || !*positions);
+}
+
+/**
+ * @function: parseDocs
+ * @brief: reads a list of docIDs and docID ranges, separated by commas,
+ * such as "12,15-20,31", into an array, sorted, without repeats.
+ * 
+ * @param docList: the list.
+ * @param nDocs: where to save the number of docIDs.
+ * @return int*: the docIDs; caller must mem_free() them.
+ * @return NULL: the list is malformed, or names a docID below 1.
+ */
+static int*
+parseDocs(const char* docList, int* nDocs)
+{
+  /* count the docIDs, to size the array */
+  long n = 0;
+  for (const char* p = docList; ; ) {
+    int lo, hi, len;
+    if (sscanf(p, "%d%n", &lo, &len) != 1 || lo < 1) {
+      return NULL;
+    }
+    p += len;
+    hi = lo;
+    if (*p == '-') {
+      p++;
+      if (sscanf(p, "%d%n", &hi, &len) != 1 || hi < lo) {
+        return NULL;
+      }
+      p += len;
+    }
+    n += (long) hi - lo + 1;
+    if (n > 1 << 28) {
+      return NULL;              // more than any crawl holds
+    }
+    if (*p == '\0') {
+      break;
+    }
+    if (*p++ != ',') {
+      return NULL;
+    }
+  }
+
+  /* then fill it: the list is known to be well-formed now */
+  int* docIDs = mem_malloc_assert(n * sizeof(int), "Memory allocation for docIDs failed.");
+  n = 0;
+  for (const char* p = docList; ; p++) {
+    int lo, hi, len;
+    sscanf(p, "%d%n", &lo, &len);
+    p += len;
+    hi = lo;
+    if (*p == '-') {
+      sscanf(++p, "%d%n", &hi, &len);
+      p += len;
+    }
+    for (long docID = lo; docID <= hi; docID++) {
+      docIDs[n++] = (int) docID;
+    }
+    if (*p == '\0') {
+      break;
+    }
+  }
+
+  /* sort, and drop repeats */
+  qsort(docIDs, n, sizeof(int), compareDocIDs);
+  int kept = 0;
+  for (long i = 0; i < n; i++) {
+    if (kept == 0 || docIDs[i] != docIDs[kept-1]) {
+      docIDs[kept++] = docIDs[i];
+    }
+  }
+  *nDocs = kept;
+  return docIDs;
+}
+
+/**
+ * @function: compareDocIDs
+ * @brief: qsort comparator: orders docIDs increasingly.
+ */
+static int
+compareDocIDs(const void* a, const void* b)
+{
+  int x = *(const int*) a, y = *(const int*) b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @function: indexUpdate
+ * @brief: indexes the pages added to pageDirectory since the index
+ * was built -- those after the largest docID in any of its segments,
+ * up to the first missing page -- or the pages docList names, all of which must load,
+ * into a new binary segment of the index (see segments.h).
+ * It merges none: "--merge" does, apart, so an update stays short.
+ * 
+ * Only the new pages are read and indexed:
+ * the cost of an update follows the new pages, not the corpus,
+ * so long as the index itself is binary and opens without loading.
+ * 
+ * Segments only add documents, and the next update starts after the largest
+ * docID indexed, so docList must name the docIDs that follow it, without a gap
+ * -- a page skipped would never be indexed; re-indexing a page is not an update.
+ * 
+ * Inputs:
+ * @param pageDirectory: page directory to search for saved webpages 
+ * @param indexFileName: path to the index file to update.
+ * @param docList: the docIDs to index, as parseDocs() reads them; NULL for the new pages.
+ * @param positions: whether the segment keeps the words' positions.
+ * @param pool: worker threads wherein to index the pages.
+ * 
+ * Returns:
+ * @return true: the index was updated -- or was up to date.
+ * @return false: error reading the index or docList, loading a page docList names,
+ * or writing the segment.
+ */
+static bool
+indexUpdate(const char* pageDirectory, const char* indexFileName, const char* docList, const bool positions, threadpool_t* pool)
+{
+  /* the largest docID indexed: from the segments' headers */
+  segments_t* segments;
+  if ( (segments = segments_open(indexFileName)) == NULL) {
+    return false;
+  }
+  int lastDocID = segments_lastDocID(segments);
+  segments_delete(segments);
+
+  /* the pages to index: the new ones, or those listed, which must follow on */
+  docs_t docs = { lastDocID + 1, 0 };
+  if (docList == NULL) {
+    docs.last = pagedir_lastFrom(pageDirectory, docs.first);
+  }
+  else {
+    int nDocs;
+    int* docIDs;
+    if ( (docIDs = parseDocs(docList, &nDocs)) == NULL) {
+      fprintf(stderr, "Invalid docID list: '%s'\n", docList);
+      return false;
+    }
+    int i = 0;
+    while (i < nDocs && docIDs[i] == docs.first + i) {
+      i++;
+    }
+    if (i < nDocs) {
+      if (docIDs[0] <= lastDocID) {
+        fprintf(stderr, "docID %d is already indexed (up to %d).\n", docIDs[0], lastDocID);
+      }
+      else {
+        fprintf(stderr, "docID list '%s' skips docID %d, which no later update would index.\n", docList, docs.first + i);
+      }
+      mem_free(docIDs);
+      return false;
+    }
+    docs.last = docIDs[nDocs-1];
+    mem_free(docIDs);
+    if (docsMissing(pageDirectory, &docs)) {
+      return false;
+    }
+  }
+
+  /* index them, and publish the segment -- unless there was nothing new */
+  bool ok = true;
+  if (docs.last >= docs.first) {
+    index_t* segment = mem_assert(positions ? index_newPositional() : index_new(), "Error creating segment index.");
+    indexBuild(pageDirectory, &docs, segment, positions, pool);
+    int first, last;
+    if (!index_docRange(segment, &first, &last)) {
+      last = docs.first - 1;
+    }
+    if (docList != NULL && last < docs.last) {
+      fprintf(stderr, "Error loading page %d of '%s'.\n", last + 1, pageDirectory);
+      ok = false;
+    }
+    else if (last >= docs.first) {
+      ok = segments_add(indexFileName, segment);
+      logProgress(1, "segment", indexFileName);
+    }
+    index_delete(segment);
+  }
+  return ok;
+}
+
+/**
+ * @function: docsMissing
+ * @brief: checks that pageDirectory holds a page for each of the docIDs,
+ * printing those it does not, if any.
+ * The files are opened, not loaded.
+ * 
+ * @param pageDirectory: page directory to search for saved webpages 
+ * @param docs: the docIDs to look for.
+ * @return true: some pages are missing; they are named on stderr.
+ * @return false: all are there.
+ */
+static bool
+docsMissing(const char* pageDirectory, const docs_t* docs)
+{
+  size_t len = strlen(pageDirectory);
+  const char* slash = (len > 0 && pageDirectory[len-1] == '/') ? "" : "/";
+
+  int nMissing = 0;
+  for (int docID = docs->first; docID <= docs->last; docID++) {
+    // file path: directory, slash if needed, docID
+    char filepath[len + 20];
+    sprintf(filepath, "%s%s%d", pageDirectory, slash, docID);
+
+    FILE* fp;
+    if ((fp = fopen(filepath, "r")) != NULL) {
+      fclose(fp);
+    }
+    else {
+      fprintf(stderr, "%s %d", (nMissing++ == 0) ? "Pages missing from the docID list:" : "", docID);
+    }
+  }
+  if (nMissing > 0) {
+    fprintf(stderr, "\n");
+  }
+  return nMissing > 0;
+}
+
 /**
  * @function: indexBuild
  * @brief: receives an address to a crawler folder 
@@ -165,66 +594,399 @@ parseArgs(char* argv[], char** pageDirectory, char** indexFileName)
  * scans saved webpage files in the directory, 
  * extracting words and inserting them into the index. 
  * 
+ * The docIDs are split into consecutive ranges, a few per worker thread;
+ * each range is indexed, without locks, into a partial index of its own,
+ * and the partial indexes are then merged pairwise, in range order,
+ * so the result is the same as indexing every page in turn.
+ * 
  * Inputs:
  * @param pageDirectory: page directory to search for saved webpages 
+ * @param docs: the docIDs to index.
  * @param index: address to file where index is to be written.
+ * @param positions: whether index keeps positions, so the partial indexes must too.
+ * @param pool: worker threads wherein to build and merge the partial indexes.
  */
 static void 
-indexBuild(const char* pageDirectory, index_t* index)
+indexBuild(const char* pageDirectory, const docs_t* docs, index_t* index, const bool positions, threadpool_t* pool)
 {
 
   /* log progress */
   logProgress(2, "START", "\n");
 
+  /* index the ranges in parallel, the first into index itself */
+  int nParts;
+  part_t* parts = partsNew(pageDirectory, docs, pool, index, positions, &nParts);
+  int end = partsBuild(parts, nParts, pool);
+
+  /* merge neighbouring partial indexes, in parallel, until only parts[0] -- index -- is left */
+  merge_t merge = { parts, end, 1 };
+  for ( ; merge.step < end; merge.step *= 2) {
+    int nPairs = (end + 2*merge.step - 1) / (2*merge.step);
+    threadpool_parallel_for(pool, 0, nPairs, 1, partMerge, &merge);
+  }
+
+  logProgress(2, "END", "\n");
+  mem_free(parts);
+}
+
+/**
+ * @function: indexBuildRuns
+ * @brief: builds the index in the manner of indexBuild,
+ * but in bounded memory (single-pass in-memory indexing, SPIMI):
+ * whenever a range's partial index outgrows its share of the budget,
+ * it is printed, sorted, to a run file beside the index file, and emptied.
+ * The runs are then k-way merged into the index file, and removed
+ * -- as they are, unmerged, if any of them could not be written.
+ * 
+ * The index holds the same words and postings as indexBuild's,
+ * with its words in sorted order.
+ * 
+ * Inputs:
+ * @param pageDirectory: page directory to search for saved webpages 
+ * @param docs: the docIDs to index.
+ * @param indexFileName: path to the index file to write.
+ * @param pool: worker threads wherein to build the partial indexes.
+ * @param budget: bytes that all the partial indexes together may use.
+ * 
+ * Returns:
+ * @return true: the index was written.
+ * @return false: error writing or merging the runs.
+ */
+static bool
+indexBuildRuns(const char* pageDirectory, const docs_t* docs, const char* indexFileName, threadpool_t* pool, const long budget)
+{
+  /* log progress */
+  logProgress(2, "START", "\n");
+
   /*
-   * Step through docID's from 1
-   * since docID's are assigned incrementally by the crawler.
-   * Once a non-existent file is reached, break.
+   * every range gets an equal share of the budget;
+   * as many ranges are indexed at once as there are workers,
+   * plus the calling thread.
    */
-  for (int docID=1; ; docID++) {
+  int nParts;
+  part_t* parts = partsNew(pageDirectory, docs, pool, NULL, false, &nParts);
+  for (int i = 0; i < nParts; i++) {
+    parts[i].budget = budget / (threadpool_size(pool) + 1);
+    parts[i].runPrefix = indexFileName;
+  }
+  int end = partsBuild(parts, nParts, pool);
 
-    // Initialize extension.
-    char extension[20];
+  /* gather the runs, in range order */
+  int nRuns = 0;
+  bool failed = false;
+  for (int i = 0; i < end; i++) {
+    nRuns += parts[i].nRuns;
+    failed = failed || parts[i].failed;
+  }
+  char** runs = mem_malloc_assert((nRuns + 1) * sizeof(char*), "Memory allocation for run names failed.");
+  nRuns = 0;
+  for (int i = 0; i < end; i++) {
+    for (int j = 0; j < parts[i].nRuns; j++) {
+      runs[nRuns++] = parts[i].runs[j];
+    }
+    if (parts[i].runs != NULL) {
+      mem_free(parts[i].runs);
+    }
+  }
+  mem_free(parts);
 
-    // Create extension (varies on presence/absence of a slash at end) 
-    if (pageDirectory[strlen(pageDirectory)-1] == '/') {
-      sprintf(extension, "%d", docID);
+  /* merge them into the index file -- if every one was written */
+  bool ok = false;
+  char* temp;
+  FILE* fp = failed ? NULL : tempOpen(indexFileName, &temp);
+  if (fp != NULL) {
+    ok = index_mergeRuns(runs, nRuns, fp);
+    ok = tempPublish(fp, temp, indexFileName, ok);
+    logProgress(1, "merged", indexFileName);
+  }
+
+  /* remove the runs */
+  for (int i = 0; i < nRuns; i++) {
+    remove(runs[i]);
+    mem_free(runs[i]);
+  }
+  mem_free(runs);
+
+  logProgress(2, "END", "\n");
+  return ok;
+}
+
+/**
+ * @function: partsNew
+ * @brief: splits the docIDs to index
+ * into consecutive ranges, PARTS_PER_THREAD per worker thread,
+ * each with a new, empty index.
+ * 
+ * @param pageDirectory: page directory to search for saved webpages 
+ * @param docs: the docIDs to index.
+ * @param pool: worker threads that will build the ranges.
+ * @param first: index to use for the first range; NULL for a new one.
+ * @param positions: whether the new indexes keep positions.
+ * @param nParts: where to save the number of ranges.
+ * @return part_t*: array of ranges; caller must mem_free() it.
+ */
+static part_t*
+partsNew(const char* pageDirectory, const docs_t* docs, threadpool_t* pool, index_t* first, const bool positions, int* nParts)
+{
+  int nPages = (docs->last >= docs->first) ? docs->last - docs->first + 1 : 0;
+  int n = PARTS_PER_THREAD * threadpool_size(pool);
+  if (n > nPages) {
+    n = (nPages > 0) ? nPages : 1;
+  }
+
+  part_t* parts = mem_calloc_assert(n, sizeof(part_t), "Memory allocation for partial indexes failed.");
+  for (int i = 0; i < n; i++) {
+    parts[i].pageDirectory = pageDirectory;
+    parts[i].first = docs->first + (int) ((long) nPages * i / n);
+    parts[i].last = docs->first + (int) ((long) nPages * (i + 1) / n) - 1;
+    parts[i].id = i;
+    parts[i].index = (i == 0 && first != NULL) ? first
+      : mem_assert(positions ? index_newPositional() : index_new(), "Error creating partial index.");
+  }
+
+  *nParts = n;
+  return parts;
+}
+
+/**
+ * @function: partsBuild
+ * @brief: indexes the ranges in parallel;
+ * then, since the pages after one that fails to load are not indexed,
+ * drops the ranges that start after the first such page,
+ * deleting their indexes and runs.
+ * 
+ * @param parts: array of ranges, from partsNew.
+ * @param nParts: number of ranges.
+ * @param pool: worker threads wherein to index them.
+ * @return int: number of ranges kept.
+ */
+static int
+partsBuild(part_t* parts, const int nParts, threadpool_t* pool)
+{
+  threadpool_parallel_for(pool, 0, nParts, 1, partBuild, parts);
+
+  int end = nParts;
+  for (int i = 0; i < end; i++) {
+    if (parts[i].missing != 0) {
+      end = i + 1;
     }
-    else {
-      sprintf(extension, "%s%d", "/", docID);
+  }
+  for (int i = end; i < nParts; i++) {
+    if (parts[i].index != NULL) {
+      index_delete(parts[i].index);
     }
+    for (int j = 0; j < parts[i].nRuns; j++) {
+      remove(parts[i].runs[j]);
+      mem_free(parts[i].runs[j]);
+    }
+    if (parts[i].runs != NULL) {
+      mem_free(parts[i].runs);
+    }
+  }
+  return end;
+}
+
+/**
+ * @function: partBuild
+ * @brief: indexes the docID ranges of parts [lo, hi), each into its own index,
+ * stopping a range at the first page that fails to load.
+ * A range with a memory budget flushes its index to a run
+ * whenever this thread's allocations outgrow the budget,
+ * and once more at the end; if a run cannot be written,
+ * the range is marked failed and indexes no further.
+ * Runs in the pool's workers.
+ * 
+ * @param arg: pointer to the array of part_t.
+ * @param lo: first part to build.
+ * @param hi: one past the last part to build.
+ */
+static void
+partBuild(void* arg, const int lo, const int hi)
+{
+  part_t* parts = arg;
 
-    // append extension
-    char directory[strlen(pageDirectory) + strlen(extension)];
-    sprintf(directory, "%s%s", pageDirectory, extension);
+  for (int i = lo; i < hi; i++) {
+    part_t* part = &parts[i];
+    size_t len = strlen(part->pageDirectory);
+    const char* slash = (len > 0 && part->pageDirectory[len-1] == '/') ? "" : "/";
 
-    /* log progress */
-    logProgress(3, "file", directory);
+    // whatever this thread holds already does not count against the budget
+    long base = mem_threadBytes();
 
-    // load webpage from address. If null, break loop.
-    webpage_t* page;
-    if ((page = pagedir_load(directory)) != NULL) {
+    for (int docID = part->first; docID <= part->last; docID++) {
+
+      // file path: directory, slash if needed, docID
+      char filepath[len + 20];
+      sprintf(filepath, "%s%s%d", part->pageDirectory, slash, docID);
+
+      // load webpage from address. If null, stop.
+      webpage_t* page;
+      if ((page = pagedir_load(filepath)) == NULL) {
+        part->missing = docID;
+        break;
+      }
 
       /* log progress */
       logProgress(4, "page", webpage_getURL(page));
 
-      // index the page
-      indexPage(page, docID, index);
-
-      // delete the page
+      // index the page, then delete it
+      indexPage(page, docID, part->index);
       webpage_delete(page);
+      part->nPending++;
+
+      // over budget: write out the index so far
+      if (part->budget > 0 && mem_threadBytes() - base > part->budget
+          && !partFlush(part)) {
+        part->failed = true;
+        break;
+      }
     }
-    else {
-      logProgress(2, "END", "\n");
-      break;
+
+    if (part->budget > 0) {
+      if (!part->failed && !partFlush(part)) {
+        part->failed = true;
+      }
+      index_delete(part->index);
+      part->index = NULL;
+    }
+  }
+}
+
+/**
+ * @function: partFlush
+ * @brief: prints a range's index, sorted, to its next run file, and empties it
+ * -- unless no pages were indexed since the last run.
+ * 
+ * @param part: pointer to the range.
+ * @return true: the run was written, or there was nothing to write.
+ * @return false: error creating or writing the run; it is removed.
+ */
+static bool
+partFlush(part_t* part)
+{
+  if (part->nPending == 0) {
+    return true;
+  }
+
+  /* name the run: runPrefix.run<id>.<n> */
+  char* run = mem_malloc_assert(strlen(part->runPrefix) + 40, "Memory allocation for run name failed.");
+  sprintf(run, "%s.run%d.%d", part->runPrefix, part->id, part->nRuns);
+  FILE* fp;
+  if ( (fp = fopen(run, "w")) == NULL) {
+    fprintf(stderr, "Error creating index run file '%s'.\n", run);
+    mem_free(run);
+    return false;
+  }
+  index_printSorted(part->index, fp);
+  bool ok = !ferror(fp);
+  if (!((fclose(fp) == 0) && ok)) {
+    fprintf(stderr, "Error writing index run file '%s'.\n", run);
+    remove(run);
+    mem_free(run);
+    return false;
+  }
+  logProgress(3, "run", run);
+
+  /* remember it */
+  char** runs = mem_malloc_assert((part->nRuns + 1) * sizeof(char*), "Memory allocation for run names failed.");
+  for (int j = 0; j < part->nRuns; j++) {
+    runs[j] = part->runs[j];
+  }
+  runs[part->nRuns++] = run;
+  if (part->runs != NULL) {
+    mem_free(part->runs);
+  }
+  part->runs = runs;
+
+  /* start afresh */
+  index_delete(part->index);
+  part->index = mem_assert(index_new(), "Error creating partial index.");
+  part->nPending = 0;
+  return true;
+}
+
+/**
+ * @function: partMerge
+ * @brief: merges, for each pair j in [lo, hi), the partial index
+ * parts[2*j*step + step] into parts[2*j*step] -- if there is such a part.
+ * Runs in the pool's workers; the pairs are disjoint.
+ * 
+ * @param arg: pointer to the merge_t for this round.
+ * @param lo: first pair to merge.
+ * @param hi: one past the last pair to merge.
+ */
+static void
+partMerge(void* arg, const int lo, const int hi)
+{
+  merge_t* merge = arg;
+
+  for (int j = lo; j < hi; j++) {
+    int i = 2 * j * merge->step;
+    if (i + merge->step < merge->nParts) {
+      index_merge(merge->parts[i].index, merge->parts[i + merge->step].index);
     }
   }
 }
 
+/**
+ * @function: tempOpen
+ * @brief: opens a temporary file beside the index file, "indexFileName.tmp",
+ * wherein to write the index, so the index file itself
+ * -- and any index already there -- stays whole until tempPublish.
+ * 
+ * @param indexFileName: path to the index file to write.
+ * @param temp: where to save the temporary file's name; caller must pass it to tempPublish.
+ * @return FILE*: the temporary file, open for writing.
+ * @return NULL: error creating it; an error message is printed.
+ */
+static FILE*
+tempOpen(const char* indexFileName, char** temp)
+{
+  *temp = mem_malloc_assert(strlen(indexFileName) + 5, "Memory allocation for temporary file name failed.");
+  sprintf(*temp, "%s.tmp", indexFileName);
+
+  FILE* fp;
+  if ( (fp = fopen(*temp, "w")) == NULL) {
+    fprintf(stderr, "Error creating '%s'.\n", *temp);
+    mem_free(*temp);
+  }
+  return fp;
+}
+
+/**
+ * @function: tempPublish
+ * @brief: closes a temporary file from tempOpen and, if it was written in full,
+ * renames it over the index file; otherwise removes it, leaving the index file as it was.
+ * Frees the temporary file's name either way.
+ * 
+ * @param fp: the temporary file.
+ * @param temp: its name, from tempOpen.
+ * @param indexFileName: path to the index file.
+ * @param ok: whether the caller wrote the index without error.
+ * @return true: the index file now holds the new index.
+ * @return false: error writing, closing or renaming; an error message is printed.
+ */
+static bool
+tempPublish(FILE* fp, char* temp, const char* indexFileName, bool ok)
+{
+  ok = !ferror(fp) && ok;
+  ok = (fclose(fp) == 0) && ok;
+  ok = ok && rename(temp, indexFileName) == 0;
+  if (!ok) {
+    fprintf(stderr, "Error writing index file '%s'.\n", indexFileName);
+    remove(temp);
+  }
+  mem_free(temp);
+  return ok;
+}
+
 /**
  * @function: indexPage
  * @brief: receives a single webpage struct and scans it for words,
- * normalizing them and inserting them into the index.
+ * normalizing them and inserting them into the index,
+ * each at its place among all the page's words, for an index that keeps them;
+ * then records the page in the index's document table:
+ * URL, depth, words indexed and HTML size.
  * 
  * @param page: pointer to webpage to search for words.
  * @param docID: depth of page (as discovered by the crawler).
@@ -237,14 +999,23 @@ indexPage(webpage_t* page, int docID, index_t* index)
   assert(index != NULL);
 
   int pos = 0;                                                    // variable to track position in webpage
+  int place = 0;                                                  // words read, so far, short ones included
+  int tokens = 0;                                                 // words indexed
   char* word;                                                     // variable to reference returned word
   while ( (word = webpage_getNextWord(page, &pos)) != NULL) {     // while next word from page is not NULL
     if (strlen(word) > 2) {                                       // if word is longer than two characters...
       normalizeWord(word);                                        // normalize the word. (defined in word.c)
-      index_insert(index, word, docID);                           // insert word into index.
+      index_insertAt(index, word, docID, place);                  // insert word, and its place, into index.
+      tokens++;
     }
-    mem_free(word);                                               // free pointer from webpage_getNextWord()
+    place++;
+    free(word);                                                   // free pointer from webpage_getNextWord() (plain malloc)
   } 
+
+  char* html = webpage_getHTML(page);
+  index_doc_t doc = { webpage_getURL(page), webpage_getDepth(page), tokens,
+                      html != NULL ? (int) strlen(html) : 0 };
+  index_setDoc(index, docID, &doc);
 }
 
 /* Function to log progress */
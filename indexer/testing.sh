@@ -52,6 +52,15 @@ fi;
 # invalid output directory (wherein to output create file)
 ./indexer ../data/output/wikipedia-1 ../data/outputDUMMY/wikipedia-1.index
 
+# binary format with a memory budget (not supported)
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.index --memory 8 --binary
+
+# positions in the text format (not supported)
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.index --positions
+
+# merging while updating (not supported)
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --update --merge
+
 
 # VALID TESTS:
 
@@ -73,3 +82,22 @@ fi;
 # wikipedia, maxDepth = 1
 ./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.index
 
+# wikipedia, maxDepth = 1, in the binary format, converted back to text
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --binary
+./indexconvert --text ../data/output/wikipedia-1.bin ../data/output/wikipedia-1-binary.index
+~/cs50-dev/shared/tse/indexcmp ../data/output/wikipedia-1.index ../data/output/wikipedia-1-binary.index
+
+# updating an index: docIDs already indexed (not supported), docIDs beyond a gap
+# (not supported), then none new
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --update --docs 1-3
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --update --docs 5000-5001
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --update
+ls ../data/output/wikipedia-1.bin*
+
+# merging its segments: none to merge
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --merge
+
+# wikipedia, maxDepth = 1, in the binary format with positions, converted back to text
+./indexer ../data/output/wikipedia-1 ../data/output/wikipedia-1.pos --binary --positions
+./indexconvert --text ../data/output/wikipedia-1.pos ../data/output/wikipedia-1-pos.index
+~/cs50-dev/shared/tse/indexcmp ../data/output/wikipedia-1.index ../data/output/wikipedia-1-pos.index
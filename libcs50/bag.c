@@ -24,6 +24,7 @@ typedef struct bagnode {
 /**************** global types ****************/
 typedef struct bag {
   struct bagnode *head;       // head of the list of items in bag
+  mem_pool_t* pool;           // where nodes come from; NULL until the first
 } bag_t;
 
 /**************** global functions ****************/
@@ -32,7 +33,7 @@ typedef struct bag {
 
 /**************** local functions ****************/
 /* not visible outside this file */
-static bagnode_t* bagnode_new(void* item);
+static bagnode_t* bagnode_new(bag_t* bag, void* item);
 
 /**************** bag_new() ****************/
 /* see bag.h for description */
@@ -44,8 +45,9 @@ bag_new(void)
   if (bag == NULL) {
     return NULL;              // error allocating bag
   } else {
-    // initialize contents of bag structure
+    // initialize contents of bag structure; the pool comes with the first item
     bag->head = NULL;
+    bag->pool = NULL;
     return bag;
   }
 }
@@ -57,7 +59,7 @@ bag_insert(bag_t* bag, void* item)
 {
   if (bag != NULL && item != NULL) {
     // allocate a new node to be added to the list
-    bagnode_t* new = bagnode_new(item);
+    bagnode_t* new = bagnode_new(bag, item);
     if (new != NULL) {
       // add it to the head of the list
       new->next = bag->head;
@@ -72,11 +74,14 @@ bag_insert(bag_t* bag, void* item)
 
 
 /**************** bagnode_new ****************/
-/* Allocate and initialize a bagnode */
+/* Allocate and initialize a bagnode, from the bag's pool */
 static bagnode_t*  // not visible outside this file
-bagnode_new(void* item)
+bagnode_new(bag_t* bag, void* item)
 {
-  bagnode_t* node = mem_malloc(sizeof(bagnode_t));
+  if (bag->pool == NULL && (bag->pool = mem_pool_new(sizeof(bagnode_t), false)) == NULL) {
+    return NULL;              // error allocating node pool
+  }
+  bagnode_t* node = mem_pool_alloc(bag->pool);
 
   if (node == NULL) {
     // error allocating memory for node; return error
@@ -101,7 +106,7 @@ bag_extract(bag_t* bag)
     bagnode_t* out = bag->head; // the node to take out
     void* item = out->item;     // the item to return
     bag->head = out->next;      // hop over the node to remove
-    mem_free(out);
+    mem_pool_free(bag->pool, out);
     return item;
   }
 }
@@ -151,11 +156,10 @@ bag_delete(bag_t* bag, void (*itemdelete)(void* item) )
       if (itemdelete != NULL) {         // if possible...
         (*itemdelete)(node->item);      // delete node's item
       }
-      bagnode_t* next = node->next;     // remember what comes next
-      mem_free(node);                   // free the node
-      node = next;                      // and move on to next
+      node = node->next;                // and move on to next
     }
 
+    mem_pool_delete(bag->pool);         // free all the nodes at once, if any
     mem_free(bag);
   }
 
@@ -0,0 +1,636 @@
+/*
+ * counters.c - CS50 'counters' module
+ *
+ * see counters.h for more information.
+ *
+ * A counterset is stored in one of two representations:
+ *
+ *   sparse - parallel arrays keys[] and counts[], sorted by key, grown
+ *            in place by doubling.  Lookups are binary searches; adding
+ *            keys in increasing order (as the indexer does, docID by
+ *            docID) is an append.
+ *
+ *   dense  - one array counts[] indexed directly by key, with ABSENT
+ *            marking keys not in the set.  Used once a counterset is
+ *            large and its keys are packed closely enough that the
+ *            dense array is no bigger than a few sparse arrays would be;
+ *            this is the common case for high-frequency words.
+ *
+ * Either way, iteration visits keys in increasing order, which lets
+ * counters_intersect and counters_union run as linear merges.
+ *
+ * A *view* (counters_view) is a sparse counterset whose arrays belong
+ * to the caller - a mapped index file, say - and are never written.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "counters.h"
+#include "mem.h"
+
+/**************** file-local global variables ****************/
+static const int INITIAL_CAPACITY = 4;  // sparse slots allocated at first
+static const int DENSE_MIN = 64;        // fewest counters worth densifying
+static const int DENSE_RATIO = 4;       // densify if keys span <= 4*size
+static const int SPARSE_RATIO = 16;     // go back if keys span > 16*size
+static const int ABSENT = -1;           // dense count of a missing key
+
+/**************** global types ****************/
+typedef struct counters {
+  int size;                   // number of keys in the set
+  int capacity;               // slots allocated in keys[] (or counts[])
+  bool dense;                 // which representation is in use
+  bool view;                  // keys[] and counts[] are the caller's; read-only
+  int* keys;                  // sparse: sorted keys; dense: NULL
+  int* counts;                // sparse: count of keys[i]; dense: of key i
+} counters_t;
+
+/**************** global functions ****************/
+/* that is, visible outside this file */
+/* see counters.h for comments about exported functions */
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static int* counters_slot(counters_t* ctrs, const int key, const bool create);
+static int search(const int* keys, int lo, const int hi, const int key);
+static int gallop(const int* keys, const int lo, const int hi, const int key);
+static bool grow(counters_t* ctrs, const int capacity);
+static bool densify(counters_t* ctrs);
+static bool sparsify(counters_t* ctrs);
+static counters_t* counters_sized(const int capacity);
+static bool append(counters_t* ctrs, const int key, const int count);
+static int entries(counters_t* ctrs, int** keys, int** counts);
+
+/**************** counters_new() ****************/
+/* see counters.h for description */
+counters_t*
+counters_new(void)
+{
+  return counters_sized(INITIAL_CAPACITY);
+}
+
+/**************** counters_sized ****************/
+/* Create an empty sparse counterset with room for capacity keys. */
+static counters_t*
+counters_sized(const int capacity)
+{
+  counters_t* ctrs = mem_malloc(sizeof(counters_t));
+  if (ctrs == NULL) {
+    return NULL;              // error allocating counters
+  }
+
+  // initialize contents of counters structure
+  ctrs->size = 0;
+  ctrs->capacity = 0;
+  ctrs->dense = false;
+  ctrs->view = false;
+  ctrs->keys = NULL;
+  ctrs->counts = NULL;
+  if (!grow(ctrs, capacity > 0 ? capacity : INITIAL_CAPACITY)) {
+    mem_free(ctrs);
+    return NULL;
+  }
+  return ctrs;
+}
+
+/**************** counters_newSorted() ****************/
+/* see counters.h for description */
+counters_t*
+counters_newSorted(const int* keys, const int* counts, const int n)
+{
+  if (n < 0) {
+    return NULL;
+  }
+  for (int i = 0; i < n; i++) {
+    if (keys[i] < 0 || counts[i] < 0 || (i > 0 && keys[i] <= keys[i - 1])) {
+      return NULL;            // out of order, or negative
+    }
+  }
+
+  counters_t* ctrs = counters_sized(n);
+  if (ctrs == NULL) {
+    return NULL;
+  }
+  if (n > 0) {
+    memcpy(ctrs->keys, keys, n * sizeof(int));
+    memcpy(ctrs->counts, counts, n * sizeof(int));
+  }
+  ctrs->size = n;
+
+  // a large set of closely packed keys is smaller and faster dense
+  if (n >= DENSE_MIN && keys[n - 1] < (long long) DENSE_RATIO * n) {
+    densify(ctrs);            // no memory to densify; carry on sparse
+  }
+  return ctrs;
+}
+
+/**************** counters_view() ****************/
+/* see counters.h for description */
+counters_t*
+counters_view(const int* keys, const int* counts, const int n)
+{
+  if (n < 0 || (n > 0 && (keys == NULL || counts == NULL))) {
+    return NULL;
+  }
+
+  counters_t* ctrs = mem_malloc(sizeof(counters_t));
+  if (ctrs == NULL) {
+    return NULL;              // error allocating counters
+  }
+  ctrs->size = n;
+  ctrs->capacity = n;
+  ctrs->dense = false;
+  ctrs->view = true;
+  ctrs->keys = (int*) keys;   // never written through: see counters_slot
+  ctrs->counts = (int*) counts;
+  return ctrs;
+}
+
+/**************** counters_add() ****************/
+/* see counters.h for description */
+int
+counters_add(counters_t* ctrs, const int key)
+{
+  if (ctrs == NULL || ctrs->view || key < 0) {
+    return 0;
+  }
+
+  int* count = counters_slot(ctrs, key, true);
+  if (count == NULL) {
+    return 0;                 // out of memory
+  }
+  return ++(*count);
+}
+
+/**************** counters_get() ****************/
+/* see counters.h for description */
+int
+counters_get(counters_t* ctrs, const int key)
+{
+  if (ctrs == NULL || key < 0) {
+    return 0;
+  }
+
+  int* count = counters_slot(ctrs, key, false);
+  return (count == NULL) ? 0 : *count;
+}
+
+/**************** counters_set() ****************/
+/* see counters.h for description */
+bool
+counters_set(counters_t* ctrs, const int key, const int count)
+{
+  if (ctrs == NULL || ctrs->view || key < 0 || count < 0) {
+    return false;
+  }
+
+  int* slot = counters_slot(ctrs, key, true);
+  if (slot == NULL) {
+    return false;             // out of memory
+  }
+  *slot = count;
+  return true;
+}
+
+/**************** counters_size() ****************/
+/* see counters.h for description */
+int
+counters_size(counters_t* ctrs)
+{
+  return (ctrs == NULL) ? 0 : ctrs->size;
+}
+
+/**************** counters_slot ****************/
+/* Return a pointer to the count for key, or NULL if key is absent.
+ * If create is true, an absent key is first inserted with count 0;
+ * NULL then means out of memory.
+ */
+static int*
+counters_slot(counters_t* ctrs, const int key, const bool create)
+{
+  if (ctrs->dense) {
+    if (key < ctrs->capacity && ctrs->counts[key] != ABSENT) {
+      return &ctrs->counts[key];
+    }
+    if (!create) {
+      return NULL;
+    }
+    if (key >= ctrs->capacity) {
+      if (key + 1LL > (long long) SPARSE_RATIO * (ctrs->size + 1)) {
+        // the new key would leave the dense array mostly empty
+        if (!sparsify(ctrs)) {
+          return NULL;
+        }
+        return counters_slot(ctrs, key, create);
+      }
+      int capacity = 2 * ctrs->capacity;
+      if (!grow(ctrs, (capacity > key) ? capacity : key + 1)) {
+        return NULL;
+      }
+    }
+    ctrs->counts[key] = 0;
+    ctrs->size++;
+    return &ctrs->counts[key];
+  }
+
+  // sparse: the common indexer case is a key beyond all others
+  int pos;
+  if (ctrs->size == 0 || key > ctrs->keys[ctrs->size - 1]) {
+    pos = ctrs->size;
+  } else {
+    pos = search(ctrs->keys, 0, ctrs->size, key);
+    if (pos < ctrs->size && ctrs->keys[pos] == key) {
+      return &ctrs->counts[pos];
+    }
+  }
+  if (!create) {
+    return NULL;
+  }
+
+  if (ctrs->size == ctrs->capacity && !grow(ctrs, 2 * ctrs->capacity)) {
+    return NULL;
+  }
+  // shift the larger keys up one slot to make room at pos
+  memmove(&ctrs->keys[pos + 1], &ctrs->keys[pos],
+          (ctrs->size - pos) * sizeof(int));
+  memmove(&ctrs->counts[pos + 1], &ctrs->counts[pos],
+          (ctrs->size - pos) * sizeof(int));
+  ctrs->keys[pos] = key;
+  ctrs->counts[pos] = 0;
+  ctrs->size++;
+
+  // a large set of closely packed keys is smaller and faster dense
+  if (ctrs->size >= DENSE_MIN
+      && ctrs->keys[ctrs->size - 1] < (long long) DENSE_RATIO * ctrs->size) {
+    if (densify(ctrs)) {
+      return &ctrs->counts[key];
+    }
+    // no memory to densify; carry on sparse
+  }
+  return &ctrs->counts[pos];
+}
+
+/**************** search ****************/
+/* Binary search of the sorted keys[lo..hi-1];
+ * return the position of the first key >= the given key (hi if none).
+ */
+static int
+search(const int* keys, int lo, int hi, const int key)
+{
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (keys[mid] < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/**************** gallop ****************/
+/* Galloping (exponential) search of the sorted keys[lo..hi-1];
+ * return the position of the first key >= the given key (hi if none).
+ * Costs O(log d), where d is the distance from lo to the answer,
+ * so a merge that gallops through a long list past a short one does
+ * O(m log(n/m)) work instead of O(n).
+ */
+static int
+gallop(const int* keys, const int lo, const int hi, const int key)
+{
+  if (lo >= hi || keys[lo] >= key) {
+    return lo;
+  }
+  // invariant: keys[lo + step/2] < key
+  int step = 1;
+  while (lo + step < hi && keys[lo + step] < key) {
+    step *= 2;
+  }
+  int end = (lo + step < hi) ? lo + step + 1 : hi;
+  return search(keys, lo + step / 2 + 1, end, key);
+}
+
+/**************** grow ****************/
+/* Reallocate the arrays to hold capacity slots; dense slots are
+ * initialized ABSENT.  Return false, leaving ctrs unchanged, if out of
+ * memory.
+ */
+static bool
+grow(counters_t* ctrs, const int capacity)
+{
+  int* counts = mem_malloc(capacity * sizeof(int));
+  int* keys = ctrs->dense ? NULL : mem_malloc(capacity * sizeof(int));
+  if (counts == NULL || (!ctrs->dense && keys == NULL)) {
+    if (counts != NULL) mem_free(counts);
+    if (keys != NULL) mem_free(keys);
+    return false;
+  }
+
+  int used = ctrs->dense ? ctrs->capacity : ctrs->size;
+  if (ctrs->counts != NULL) {
+    memcpy(counts, ctrs->counts, used * sizeof(int));
+    mem_free(ctrs->counts);
+  }
+  if (ctrs->keys != NULL) {
+    memcpy(keys, ctrs->keys, used * sizeof(int));
+    mem_free(ctrs->keys);
+  }
+  if (ctrs->dense) {
+    for (int i = used; i < capacity; i++) {
+      counts[i] = ABSENT;
+    }
+  }
+
+  ctrs->counts = counts;
+  ctrs->keys = keys;
+  ctrs->capacity = capacity;
+  return true;
+}
+
+/**************** densify ****************/
+/* Convert a sparse counterset to dense; return false if out of memory. */
+static bool
+densify(counters_t* ctrs)
+{
+  int capacity = ctrs->keys[ctrs->size - 1] + 1;
+  int* counts = mem_malloc(capacity * sizeof(int));
+  if (counts == NULL) {
+    return false;
+  }
+  for (int i = 0; i < capacity; i++) {
+    counts[i] = ABSENT;
+  }
+  for (int i = 0; i < ctrs->size; i++) {
+    counts[ctrs->keys[i]] = ctrs->counts[i];
+  }
+
+  mem_free(ctrs->keys);
+  mem_free(ctrs->counts);
+  ctrs->keys = NULL;
+  ctrs->counts = counts;
+  ctrs->capacity = capacity;
+  ctrs->dense = true;
+  return true;
+}
+
+/**************** sparsify ****************/
+/* Convert a dense counterset to sparse; return false if out of memory. */
+static bool
+sparsify(counters_t* ctrs)
+{
+  int capacity = 2 * (ctrs->size + 1);
+  int* keys = mem_malloc(capacity * sizeof(int));
+  int* counts = mem_malloc(capacity * sizeof(int));
+  if (keys == NULL || counts == NULL) {
+    if (keys != NULL) mem_free(keys);
+    if (counts != NULL) mem_free(counts);
+    return false;
+  }
+
+  int n = 0;
+  for (int key = 0; key < ctrs->capacity; key++) {
+    if (ctrs->counts[key] != ABSENT) {
+      keys[n] = key;
+      counts[n++] = ctrs->counts[key];
+    }
+  }
+
+  mem_free(ctrs->counts);
+  ctrs->keys = keys;
+  ctrs->counts = counts;
+  ctrs->capacity = capacity;
+  ctrs->dense = false;
+  return true;
+}
+
+/**************** append ****************/
+/* Add key, which must exceed every key in the sparse ctrs, with count. */
+static bool
+append(counters_t* ctrs, const int key, const int count)
+{
+  if (ctrs->size == ctrs->capacity && !grow(ctrs, 2 * ctrs->capacity)) {
+    return false;
+  }
+  ctrs->keys[ctrs->size] = key;
+  ctrs->counts[ctrs->size++] = count;
+  return true;
+}
+
+/**************** entries ****************/
+/* Point *keys and *counts at sorted parallel arrays of the entries in
+ * ctrs and return how many there are.  A dense counterset is expanded
+ * into freshly allocated arrays, which the caller must mem_free;
+ * for a sparse one the pointers are into ctrs itself, and *keys is
+ * returned equal to ctrs->keys so the caller can tell the difference.
+ * Return -1 if out of memory.
+ */
+static int
+entries(counters_t* ctrs, int** keys, int** counts)
+{
+  if (!ctrs->dense) {
+    *keys = ctrs->keys;
+    *counts = ctrs->counts;
+    return ctrs->size;
+  }
+
+  *keys = mem_malloc((ctrs->size + 1) * sizeof(int));
+  *counts = mem_malloc((ctrs->size + 1) * sizeof(int));
+  if (*keys == NULL || *counts == NULL) {
+    if (*keys != NULL) mem_free(*keys);
+    if (*counts != NULL) mem_free(*counts);
+    return -1;
+  }
+  int n = 0;
+  for (int key = 0; key < ctrs->capacity; key++) {
+    if (ctrs->counts[key] != ABSENT) {
+      (*keys)[n] = key;
+      (*counts)[n++] = ctrs->counts[key];
+    }
+  }
+  return n;
+}
+
+/**************** counters_intersect() ****************/
+/* see counters.h for description */
+counters_t*
+counters_intersect(counters_t* ctrs1, counters_t* ctrs2)
+{
+  if (ctrs1 == NULL || ctrs2 == NULL) {
+    return NULL;
+  }
+
+  // walk the smaller set, probing the larger
+  if (ctrs1->size > ctrs2->size) {
+    counters_t* swap = ctrs1;
+    ctrs1 = ctrs2;
+    ctrs2 = swap;
+  }
+
+  counters_t* result = counters_sized(ctrs1->size);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  int *keys1, *counts1;
+  int n1 = entries(ctrs1, &keys1, &counts1);
+  if (n1 < 0) {
+    counters_delete(result);
+    return NULL;              // out of memory
+  }
+
+  bool ok = true;
+  if (ctrs2->dense) {
+    // direct lookup: O(size of the smaller set)
+    for (int i = 0; i < n1 && ok; i++) {
+      int key = keys1[i];
+      if (key < ctrs2->capacity && ctrs2->counts[key] > 0 && counts1[i] > 0) {
+        int count2 = ctrs2->counts[key];
+        ok = append(result, key, (counts1[i] < count2) ? counts1[i] : count2);
+      }
+    }
+  } else {
+    // merge, galloping through the larger set
+    int* keys2 = ctrs2->keys;
+    int* counts2 = ctrs2->counts;
+    int j = 0;
+    for (int i = 0; i < n1 && j < ctrs2->size && ok; i++) {
+      j = gallop(keys2, j, ctrs2->size, keys1[i]);
+      if (j < ctrs2->size && keys2[j] == keys1[i]
+          && counts1[i] > 0 && counts2[j] > 0) {
+        ok = append(result, keys1[i],
+                    (counts1[i] < counts2[j]) ? counts1[i] : counts2[j]);
+      }
+    }
+  }
+
+  if (keys1 != ctrs1->keys) {
+    mem_free(keys1);
+    mem_free(counts1);
+  }
+  if (!ok) {
+    counters_delete(result);
+    return NULL;              // out of memory: the result would be short
+  }
+  return result;
+}
+
+/**************** counters_union() ****************/
+/* see counters.h for description */
+counters_t*
+counters_union(counters_t* ctrs1, counters_t* ctrs2)
+{
+  if (ctrs1 == NULL || ctrs2 == NULL) {
+    return NULL;
+  }
+
+  counters_t* result = counters_sized(ctrs1->size + ctrs2->size);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  int *keys1 = NULL, *counts1 = NULL, *keys2 = NULL, *counts2 = NULL;
+  int n1 = entries(ctrs1, &keys1, &counts1);
+  int n2 = (n1 < 0) ? -1 : entries(ctrs2, &keys2, &counts2);
+
+  // standard merge of two sorted lists, summing counts of common keys
+  bool ok = (n1 >= 0 && n2 >= 0);
+  int i = 0, j = 0;
+  while (ok && (i < n1 || j < n2)) {
+    if (j == n2 || (i < n1 && keys1[i] < keys2[j])) {
+      ok = append(result, keys1[i], counts1[i]);
+      i++;
+    } else if (i == n1 || keys2[j] < keys1[i]) {
+      ok = append(result, keys2[j], counts2[j]);
+      j++;
+    } else {
+      ok = append(result, keys1[i], counts1[i] + counts2[j]);
+      i++;
+      j++;
+    }
+  }
+
+  if (n1 >= 0 && keys1 != ctrs1->keys) {
+    mem_free(keys1);
+    mem_free(counts1);
+  }
+  if (n2 >= 0 && keys2 != ctrs2->keys) {
+    mem_free(keys2);
+    mem_free(counts2);
+  }
+  if (!ok) {
+    counters_delete(result);
+    return NULL;              // out of memory: the result would be short
+  }
+  return result;
+}
+
+/**************** counters_print() ****************/
+/* see counters.h for description */
+void
+counters_print(counters_t* ctrs, FILE* fp)
+{
+  if (fp != NULL) {
+    if (ctrs != NULL) {
+      fputc('{', fp);
+      int printed = 0;
+      for (int i = 0; i < (ctrs->dense ? ctrs->capacity : ctrs->size); i++) {
+        if (ctrs->dense && ctrs->counts[i] == ABSENT) {
+          continue;
+        }
+        // print this counter
+        fprintf(fp, "%d=%d", ctrs->dense ? i : ctrs->keys[i], ctrs->counts[i]);
+        if (++printed < ctrs->size) {
+          fputc(',', fp);
+        }
+      }
+      fputc('}', fp);
+    } else {
+      fputs("(null)", fp);
+    }
+  }
+}
+
+/**************** counters_iterate() ****************/
+/* see counters.h for description */
+void
+counters_iterate(counters_t* ctrs, void* arg,
+                 void (*itemfunc)(void* arg, const int key, const int count))
+{
+  if (ctrs != NULL && itemfunc != NULL) {
+    // call itemfunc with arg, on each counter, in increasing key order
+    if (ctrs->dense) {
+      for (int key = 0; key < ctrs->capacity; key++) {
+        if (ctrs->counts[key] != ABSENT) {
+          (*itemfunc)(arg, key, ctrs->counts[key]);
+        }
+      }
+    } else {
+      for (int i = 0; i < ctrs->size; i++) {
+        (*itemfunc)(arg, ctrs->keys[i], ctrs->counts[i]);
+      }
+    }
+  }
+}
+
+/**************** counters_delete() ****************/
+/* see counters.h for description */
+void
+counters_delete(counters_t* ctrs)
+{
+  if (ctrs != NULL) {
+    if (!ctrs->view) {
+      if (ctrs->keys != NULL) {
+        mem_free(ctrs->keys);
+      }
+      mem_free(ctrs->counts);
+    }
+    mem_free(ctrs);
+  }
+
+#ifdef MEMTEST
+  mem_report(stdout, "End of counters_delete");
+#endif
+}
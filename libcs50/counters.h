@@ -7,6 +7,10 @@
  * empty. Each time `counters_add` is called on a given key, that key's
  * counter is incremented. The current counter value can be retrieved by
  * asking for the relevant key.
+ *
+ * Counters are kept in arrays sorted by key (or, for large closely-packed
+ * sets, a dense array indexed by key), so lookups are logarithmic and
+ * iteration visits keys in increasing order.
  * 
  * David Kotz, April 2016, 2017, 2019, 2021
  * Xia Zhou, July 2017
@@ -42,7 +46,7 @@ counters_t* counters_new(void);
  *   valid pointer to counterset, and key (must be >= 0)
  * We return:
  *   the new value of the counter related to the indicated key.
- *   0 on error (if ctrs is NULL, key is negative, or out of memory)
+ *   0 on error (if ctrs is NULL or a view, key is negative, or out of memory)
  * We guarantee:
  *   the counter's value will be >= 1, on successful return.
  * We do:
@@ -73,7 +77,7 @@ int counters_get(counters_t* ctrs, const int key);
  *   key (must be >= 0), 
  *   counter value (must be >= 0).
  * We return:
- *   false if ctrs is NULL, if key < 0 or count < 0, or if out of memory.
+ *   false if ctrs is NULL or a view, if key < 0 or count < 0, or if out of memory.
  *   otherwise returns true.
  * We do:
  *   If the key does not yet exist, create a counter for it and initialize to
@@ -82,6 +86,88 @@ int counters_get(counters_t* ctrs, const int key);
  */
 bool counters_set(counters_t* ctrs, const int key, const int count);
 
+/**************** counters_newSorted ****************/
+/* Create a new counterset holding n given counters, all at once.
+ *
+ * Caller provides:
+ *   n keys, in strictly increasing order, all >= 0, and their counts,
+ *   all >= 0, as parallel arrays (either may be NULL if n is 0).
+ * We return:
+ *   pointer to a new counterset; NULL if error (keys out of order,
+ *   a negative key or count, or out of memory).
+ * Caller is responsible for:
+ *   later calling counters_delete();
+ * Notes:
+ *   the same counterset n calls to counters_set would build, in O(n),
+ *   for a caller - a loader, say - that already has the counters sorted.
+ */
+counters_t* counters_newSorted(const int* keys, const int* counts, const int n);
+
+/**************** counters_view ****************/
+/* Create a read-only counterset over n counters the caller holds.
+ *
+ * Caller provides:
+ *   n keys, in strictly increasing order, all >= 0, and their counts,
+ *   all >= 0, as parallel arrays (either may be NULL if n is 0).
+ * We return:
+ *   pointer to a new counterset that reads the caller's arrays in place,
+ *   without copying or checking them; NULL if error (out of memory).
+ * Caller is responsible for:
+ *   keeping the arrays unchanged until calling counters_delete(),
+ *   which frees the counterset but not the arrays.
+ * Notes:
+ *   counters_add and counters_set fail on a view; every other function
+ *   reads it as any counterset.
+ */
+counters_t* counters_view(const int* keys, const int* counts, const int n);
+
+/**************** counters_size ****************/
+/* Return the number of keys in the counterset.
+ *
+ * Caller provides:
+ *   valid pointer to counterset.
+ * We return:
+ *   the number of keys (including any whose counter is 0);
+ *   0 if ctrs is NULL.
+ */
+int counters_size(counters_t* ctrs);
+
+/**************** counters_intersect ****************/
+/* Create a new counterset holding the keys found in both countersets.
+ *
+ * Caller provides:
+ *   valid pointers to two countersets.
+ * We return:
+ *   pointer to a new counterset, in which each key whose counter is
+ *   positive in both ctrs1 and ctrs2 maps to the smaller of the two counts;
+ *   NULL if either counterset is NULL, or out of memory.
+ * We guarantee:
+ *   ctrs1 and ctrs2 are unchanged.
+ *   the work is linear in the smaller set, times the log of the ratio of
+ *   the two sizes - a rare key set intersected with a common one
+ *   does not scan the common one.
+ * Caller is responsible for:
+ *   later calling counters_delete() on the result.
+ */
+counters_t* counters_intersect(counters_t* ctrs1, counters_t* ctrs2);
+
+/**************** counters_union ****************/
+/* Create a new counterset holding the keys found in either counterset.
+ *
+ * Caller provides:
+ *   valid pointers to two countersets.
+ * We return:
+ *   pointer to a new counterset, in which each key in ctrs1 or ctrs2
+ *   maps to the sum of its counts in the two;
+ *   NULL if either counterset is NULL, or out of memory.
+ * We guarantee:
+ *   ctrs1 and ctrs2 are unchanged.
+ *   the work is linear in the total size of the two sets.
+ * Caller is responsible for:
+ *   later calling counters_delete() on the result.
+ */
+counters_t* counters_union(counters_t* ctrs1, counters_t* ctrs2);
+
 /**************** counters_print ****************/
 /* Print all counters; provide the output file.
  *
@@ -106,7 +192,7 @@ void counters_print(counters_t* ctrs, FILE* fp);
  *   nothing, if ctrs==NULL or itemfunc==NULL.
  *   otherwise, call itemfunc once for each item, with (arg, key, count).
  * Note:
- *   the order in which items are handled is undefined.
+ *   items are handled in increasing order of key.
  *   the counterset is unchanged by this operation.
  */
 void counters_iterate(counters_t* ctrs, void* arg, 
@@ -0,0 +1,301 @@
+/*
+ * counterstest - behaviour test for counters, sparse and dense
+ *
+ * usage:
+ *   counterstest [nSets]
+ *
+ * setget: builds nSets random countersets with counters_add and
+ *   counters_set - keys packed closely enough to turn a set dense, then
+ *   spread widely enough to turn it sparse again, in random order - and
+ *   checks each against a plain array after every change: the counts,
+ *   the size, and that counters_iterate visits keys in increasing order.
+ * setops: intersects and unites random pairs, each sparse or dense, and
+ *   checks the results against the same operations on plain arrays,
+ *   whichever way round the pair is passed.
+ * edges: keys near INT_MAX, in both representations; negative keys and
+ *   counts; counters_newSorted out of order; a read-only view.
+ *
+ * `make counterstest` builds it with -fsanitize=address,undefined, so an
+ * overflow or a read outside the arrays shows up as a report.
+ * Prints PASS or FAIL lines; exits non-zero on any failure.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "counters.h"
+#include "mem.h"
+
+/**************** file-local global types ****************/
+/* a counterset as a plain array: count[key], or -1 if key is absent */
+typedef struct model {
+  int* count;
+  int span;                   // keys 0..span-1
+} model_t;
+
+/**************** file-local global variables ****************/
+static int nSets = 300;
+static const int MAX_SPAN = 4000;
+
+/**************** local functions ****************/
+static bool testSetGet(void);
+static bool testSetOps(void);
+static bool testEdges(void);
+static counters_t* randomSet(model_t* model);
+static bool matches(counters_t* ctrs, model_t* model, const char* what);
+static void visit(void* arg, const int key, const int count);
+static model_t modelNew(const int span);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 2 || (argc > 1 && sscanf(argv[1], "%d", &nSets) != 1)
+      || nSets < 1) {
+    fprintf(stderr, "usage: %s [nSets>=1]\n", argv[0]);
+    exit(1);
+  }
+  srand(2021);
+
+  bool ok = testSetGet();
+  ok = testSetOps() && ok;
+  ok = testEdges() && ok;
+
+  if (mem_net() != 0) {
+    mem_report(stdout, "FAIL: leaked");
+    ok = false;
+  }
+  return ok ? 0 : 2;
+}
+
+/**************** testSetGet ****************/
+static bool
+testSetGet(void)
+{
+  bool ok = true;
+  for (int i = 0; i < nSets && ok; i++) {
+    model_t model = modelNew(MAX_SPAN);
+    counters_t* ctrs = mem_assert(counters_new(), "counters");
+
+    // a dense run of keys first, then a few far ones, then more near ones
+    int nOps = 1 + rand() % (MAX_SPAN / 2);
+    for (int op = 0; op < nOps && ok; op++) {
+      int key = (op < nOps / 2) ? rand() % (nOps / 2 + 1)
+              : (op % 7 == 0) ? rand() % MAX_SPAN : rand() % 200;
+      if (rand() % 3 == 0) {
+        int count = rand() % 50;
+        ok = counters_set(ctrs, key, count);
+        model.count[key] = count;
+      } else {
+        int expect = (model.count[key] < 0) ? 1 : model.count[key] + 1;
+        ok = (counters_add(ctrs, key) == expect);
+        model.count[key] = expect;
+      }
+      if (!ok) {
+        printf("FAIL: setget: set %d, op %d on key %d\n", i, op, key);
+      }
+      else if (op % 97 == 0 || op == nOps - 1) {
+        ok = matches(ctrs, &model, "setget");
+      }
+    }
+    counters_delete(ctrs);
+    mem_free(model.count);
+  }
+  printf("%s: setget, %d sets\n", ok ? "PASS" : "FAIL", nSets);
+  return ok;
+}
+
+/**************** testSetOps ****************/
+static bool
+testSetOps(void)
+{
+  bool ok = true;
+  int nDense = 0;
+  for (int i = 0; i < nSets && ok; i++) {
+    model_t m1 = modelNew(MAX_SPAN), m2 = modelNew(MAX_SPAN);
+    counters_t* c1 = randomSet(&m1);
+    counters_t* c2 = randomSet(&m2);
+
+    // what the results should be
+    model_t both = modelNew(MAX_SPAN), either = modelNew(MAX_SPAN);
+    for (int key = 0; key < MAX_SPAN; key++) {
+      int a = m1.count[key], b = m2.count[key];
+      if (a > 0 && b > 0) {
+        both.count[key] = (a < b) ? a : b;
+      }
+      if (a >= 0 || b >= 0) {
+        either.count[key] = (a > 0 ? a : 0) + (b > 0 ? b : 0);
+      }
+    }
+
+    for (int swap = 0; swap <= 1 && ok; swap++) {
+      counters_t* x = swap ? counters_intersect(c2, c1) : counters_intersect(c1, c2);
+      counters_t* u = swap ? counters_union(c2, c1) : counters_union(c1, c2);
+      ok = x != NULL && u != NULL
+        && matches(x, &both, "intersect") && matches(u, &either, "union");
+      if (x == NULL || u == NULL) {
+        printf("FAIL: setops: pair %d gave NULL\n", i);
+      }
+      counters_delete(x);
+      counters_delete(u);
+    }
+    nDense += (counters_size(c1) >= 64) + (counters_size(c2) >= 64);
+
+    counters_delete(c1);
+    counters_delete(c2);
+    mem_free(m1.count);
+    mem_free(m2.count);
+    mem_free(both.count);
+    mem_free(either.count);
+  }
+  printf("%s: setops, %d pairs, %d large sets\n", ok ? "PASS" : "FAIL",
+         nSets, nDense);
+  return ok;
+}
+
+/**************** testEdges ****************/
+static bool
+testEdges(void)
+{
+  bool ok = true;
+
+  // keys near INT_MAX: sparse, then a dense set that must go sparse for one
+  counters_t* ctrs = mem_assert(counters_new(), "counters");
+  ok = counters_set(ctrs, INT_MAX, 3) && counters_add(ctrs, INT_MAX - 1) == 1
+    && counters_get(ctrs, INT_MAX) == 3 && counters_size(ctrs) == 2;
+  counters_delete(ctrs);
+
+  ctrs = mem_assert(counters_new(), "counters");
+  for (int key = 0; key < 256; key++) {
+    counters_set(ctrs, key, key + 1);
+  }
+  ok = counters_set(ctrs, INT_MAX, 9) && counters_get(ctrs, INT_MAX) == 9
+    && counters_get(ctrs, 255) == 256 && counters_size(ctrs) == 257 && ok;
+  counters_t* far = mem_assert(counters_new(), "counters");
+  counters_set(far, INT_MAX, 4);
+  counters_set(far, 10, 1);
+  counters_t* x = counters_intersect(ctrs, far);
+  counters_t* u = counters_union(far, ctrs);
+  ok = x != NULL && counters_size(x) == 2 && counters_get(x, INT_MAX) == 4
+    && u != NULL && counters_size(u) == 257 && counters_get(u, 10) == 12 && ok;
+  counters_delete(x);
+  counters_delete(u);
+  counters_delete(far);
+
+  // bad arguments change nothing
+  ok = !counters_set(ctrs, -1, 1) && !counters_set(ctrs, 1, -1)
+    && counters_add(ctrs, -1) == 0 && counters_get(ctrs, -1) == 0
+    && counters_size(ctrs) == 257 && ok;
+  ok = counters_intersect(ctrs, NULL) == NULL
+    && counters_union(NULL, ctrs) == NULL && ok;
+  counters_delete(ctrs);
+
+  // counters_newSorted: in order, out of order, repeated
+  int keys[] = { 2, 5, 9 }, counts[] = { 1, 2, 3 }, bad[] = { 2, 9, 5 };
+  ctrs = counters_newSorted(keys, counts, 3);
+  ok = ctrs != NULL && counters_get(ctrs, 9) == 3 && counters_size(ctrs) == 3
+    && counters_newSorted(bad, counts, 3) == NULL
+    && counters_newSorted(keys, counts, -1) == NULL && ok;
+  counters_delete(ctrs);
+
+  // a view reads the caller's arrays, and refuses to change them
+  ctrs = counters_view(keys, counts, 3);
+  ok = ctrs != NULL && counters_get(ctrs, 5) == 2
+    && !counters_set(ctrs, 5, 7) && counters_add(ctrs, 6) == 0
+    && counts[1] == 2 && counters_size(ctrs) == 3 && ok;
+  counters_delete(ctrs);
+
+  printf("%s: edges\n", ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+/**************** randomSet ****************/
+/* A random counterset, and its model: small or large, packed or spread,
+ * so pairs of them cover each pairing of sparse and dense.
+ */
+static counters_t*
+randomSet(model_t* model)
+{
+  counters_t* ctrs = mem_assert(counters_new(), "counters");
+  int n = (rand() % 2) ? rand() % 40 : 64 + rand() % 1000;
+  int span = (rand() % 2) ? n + 1 : MAX_SPAN;
+  for (int i = 0; i < n; i++) {
+    int key = rand() % span;
+    int count = rand() % 5;   // zero counts too, which intersect drops
+    counters_set(ctrs, key, count);
+    model->count[key] = count;
+  }
+  return ctrs;
+}
+
+/**************** matches ****************/
+/* Does the counterset hold just what the model does, and iterate in order? */
+static bool
+matches(counters_t* ctrs, model_t* model, const char* what)
+{
+  int size = 0;
+  for (int key = 0; key < model->span; key++) {
+    int expect = (model->count[key] < 0) ? 0 : model->count[key];
+    if (counters_get(ctrs, key) != expect) {
+      printf("FAIL: %s: key %d counts %d, not %d\n", what, key,
+             counters_get(ctrs, key), expect);
+      return false;
+    }
+    size += (model->count[key] >= 0);
+  }
+  if (counters_size(ctrs) != size) {
+    printf("FAIL: %s: size %d, not %d\n", what, counters_size(ctrs), size);
+    return false;
+  }
+
+  // iteration: every key once, in increasing order
+  model_t seen = modelNew(model->span + 1);   // and the last key visited
+  counters_iterate(ctrs, &seen, visit);
+  bool ok = true;
+  for (int key = 0; key < model->span && ok; key++) {
+    ok = (seen.count[key] == model->count[key]);
+  }
+  if (!ok || seen.count[model->span] == INT_MIN) {
+    printf("FAIL: %s: iteration out of order or incomplete\n", what);
+    ok = false;
+  }
+  mem_free(seen.count);
+  return ok;
+}
+
+/**************** visit ****************/
+/* counters_iterate helper: record the count, and check the key order;
+ * the slot past the span holds the last key seen, or INT_MIN once
+ * a key comes out of order.
+ */
+static void
+visit(void* arg, const int key, const int count)
+{
+  model_t* seen = arg;
+  int* last = &seen->count[seen->span - 1];
+  if (*last == INT_MIN) {
+    return;
+  }
+  if (key <= *last || key >= seen->span - 1) {
+    *last = INT_MIN;
+    return;
+  }
+  seen->count[key] = count;
+  *last = key;
+}
+
+/**************** modelNew ****************/
+/* An empty model of keys 0..span-1. */
+static model_t
+modelNew(const int span)
+{
+  model_t model = { mem_malloc_assert(span * sizeof(int), "model"), span };
+  for (int key = 0; key < span; key++) {
+    model.count[key] = -1;
+  }
+  return model;
+}
@@ -0,0 +1,252 @@
+/*
+ * deque.c - CS50 'deque' module
+ *
+ * see deque.h for more information.
+ *
+ * Items live in a circular array, between top (the next to steal) and
+ * bottom (the next free slot); both only ever increase, and index the
+ * array modulo its size.  When the owner fills the array it copies the
+ * live items to one twice the size.  A thief may still be reading the
+ * old array, so it is kept, on a list, until the deque is deleted; the
+ * old arrays add up to less than the current one.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "deque.h"
+#include "mem.h"
+
+/**************** local types ****************/
+typedef struct dequearray {
+  long size;                        // number of slots; a power of two
+  struct dequearray* older;         // the array this one replaced
+  _Atomic(void*) slots[];           // the items
+} dequearray_t;
+
+/**************** global types ****************/
+// top and bottom each get a cache line to themselves, so the owner
+// working the bottom does not collide with thieves at the top.
+typedef struct deque {
+  char pad0[64];
+  atomic_long top;                  // next item to steal
+  char pad1[64];
+  atomic_long bottom;               // next free slot; owner writes it
+  _Atomic(dequearray_t*) array;     // current array; owner replaces it
+  char pad2[64];
+} deque_t;
+
+/**************** file-local global variables ****************/
+static const long INITIAL_SIZE = 64;    // slots in a new deque's array
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static dequearray_t* dequearray_new(const long size);
+static dequearray_t* deque_grow(deque_t* deque, dequearray_t* array,
+                                const long top, const long bottom);
+
+/**************** global functions ****************/
+/* that is, visible outside this file */
+/* see deque.h for comments about exported functions */
+
+/**************** deque_new() ****************/
+/* see deque.h for description */
+deque_t*
+deque_new(void)
+{
+  deque_t* deque = mem_malloc(sizeof(deque_t));
+  if (deque == NULL) {
+    return NULL;              // error allocating deque
+  }
+
+  dequearray_t* array = dequearray_new(INITIAL_SIZE);
+  if (array == NULL) {
+    mem_free(deque);
+    return NULL;              // error allocating array
+  }
+
+  // initialize contents of deque structure
+  atomic_init(&deque->top, 0);
+  atomic_init(&deque->bottom, 0);
+  atomic_init(&deque->array, array);
+  return deque;
+}
+
+/**************** dequearray_new ****************/
+/* Allocate an array of size slots */
+static dequearray_t*  // not visible outside this file
+dequearray_new(const long size)
+{
+  dequearray_t* array = mem_malloc(sizeof(dequearray_t)
+                                   + size * sizeof(_Atomic(void*)));
+  if (array != NULL) {
+    array->size = size;
+    array->older = NULL;
+    for (long i = 0; i < size; i++) {
+      atomic_init(&array->slots[i], NULL);
+    }
+  }
+  return array;
+}
+
+/**************** deque_grow ****************/
+/* Replace the full array with one twice the size, holding the same
+ * items top..bottom-1 in the same positions.  Owner only.
+ * Returns the new array, or NULL if out of memory.
+ */
+static dequearray_t*  // not visible outside this file
+deque_grow(deque_t* deque, dequearray_t* array, const long top,
+           const long bottom)
+{
+  dequearray_t* bigger = dequearray_new(2 * array->size);
+  if (bigger == NULL) {
+    return NULL;
+  }
+  for (long i = top; i < bottom; i++) {
+    void* item = atomic_load_explicit(&array->slots[i & (array->size - 1)],
+                                      memory_order_relaxed);
+    atomic_store_explicit(&bigger->slots[i & (bigger->size - 1)], item,
+                          memory_order_relaxed);
+  }
+  bigger->older = array;      // keep it for thieves still reading it
+  atomic_store_explicit(&deque->array, bigger, memory_order_release);
+  return bigger;
+}
+
+/**************** deque_push() ****************/
+/* see deque.h for description */
+bool
+deque_push(deque_t* deque, void* item)
+{
+  if (deque == NULL || item == NULL) {
+    return false;
+  }
+
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  dequearray_t* array = atomic_load_explicit(&deque->array,
+                                             memory_order_relaxed);
+  if (bottom - top > array->size - 1) {
+    // full: grow
+    if ((array = deque_grow(deque, array, top, bottom)) == NULL) {
+      return false;
+    }
+  }
+
+  atomic_store_explicit(&array->slots[bottom & (array->size - 1)], item,
+                        memory_order_relaxed);
+  // publish the item before the new bottom that makes it visible
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  return true;
+}
+
+/**************** deque_pop() ****************/
+/* see deque.h for description */
+void*
+deque_pop(deque_t* deque)
+{
+  if (deque == NULL) {
+    return NULL;
+  }
+
+  // reserve the bottom item, then see whether a thief got there first
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  dequearray_t* array = atomic_load_explicit(&deque->array,
+                                             memory_order_relaxed);
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  void* item = NULL;
+  if (top <= bottom) {
+    // not empty
+    item = atomic_load_explicit(&array->slots[bottom & (array->size - 1)],
+                                memory_order_relaxed);
+    if (top == bottom) {
+      // the last item: race the thieves for it
+      if (!atomic_compare_exchange_strong_explicit(&deque->top, &top,
+                                                   top + 1,
+                                                   memory_order_seq_cst,
+                                                   memory_order_relaxed)) {
+        item = NULL;          // a thief won
+      }
+      atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+  } else {
+    // empty: undo the reservation
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  }
+  return item;
+}
+
+/**************** deque_steal() ****************/
+/* see deque.h for description */
+void*
+deque_steal(deque_t* deque)
+{
+  if (deque == NULL) {
+    return NULL;
+  }
+
+  long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+  if (top < bottom) {
+    // not empty: read the top item, then claim it
+    dequearray_t* array = atomic_load_explicit(&deque->array,
+                                               memory_order_acquire);
+    void* item = atomic_load_explicit(&array->slots[top & (array->size - 1)],
+                                      memory_order_relaxed);
+    if (atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                memory_order_seq_cst,
+                                                memory_order_relaxed)) {
+      return item;
+    }
+  }
+  return NULL;                // empty, or lost the race
+}
+
+/**************** deque_size() ****************/
+/* see deque.h for description */
+int
+deque_size(deque_t* deque)
+{
+  if (deque == NULL) {
+    return 0;
+  }
+
+  long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+  return (bottom > top) ? (int) (bottom - top) : 0;
+}
+
+/**************** deque_delete() ****************/
+/* see deque.h for description */
+void
+deque_delete(deque_t* deque, void (*itemdelete)(void* item) )
+{
+  if (deque != NULL) {
+    void* item;
+    while ((item = deque_pop(deque)) != NULL) {
+      if (itemdelete != NULL) {         // if possible...
+        (*itemdelete)(item);            // delete the item
+      }
+    }
+
+    dequearray_t* array = atomic_load(&deque->array);
+    while (array != NULL) {
+      dequearray_t* older = array->older;
+      mem_free(array);
+      array = older;
+    }
+    mem_free(deque);
+  }
+
+#ifdef MEMTEST
+  mem_report(stdout, "End of deque_delete");
+#endif
+}
@@ -0,0 +1,86 @@
+/*
+ * deque.h - header file for CS50 'deque' module
+ *
+ * A *deque* is a work-stealing double-ended queue (Chase and Lev, with
+ * the C11 memory orderings of Le, Pop, Cohen and Zappa Nardelli).  One
+ * thread, its *owner*, pushes and pops items at the bottom, last-in
+ * first-out, almost always without any atomic read-modify-write; any
+ * other thread may *steal* the oldest item from the top.  An idle worker
+ * steals from a busy one's deque, so work spreads without a shared queue.
+ *
+ * Like a bag, it holds opaque pointers to items, and NULL is not an item.
+ * It grows as needed.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#ifndef __DEQUE_H
+#define __DEQUE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct deque deque_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** deque_new ****************/
+/* Create a new (empty) deque.
+ *
+ * We return:
+ *   pointer to a new deque, or NULL if error.
+ * Caller is responsible for:
+ *   later calling deque_delete.
+ */
+deque_t* deque_new(void);
+
+/**************** deque_push ****************/
+/* Add item to the bottom of the deque.  Owner only.
+ *
+ * Caller provides:
+ *   valid deque pointer, valid item pointer.
+ * We return:
+ *   false if any parameter is NULL, or out of memory; true otherwise.
+ */
+bool deque_push(deque_t* deque, void* item);
+
+/**************** deque_pop ****************/
+/* Remove and return the item at the bottom - the newest.  Owner only.
+ *
+ * We return:
+ *   the item, or NULL if the deque is empty (or NULL).
+ */
+void* deque_pop(deque_t* deque);
+
+/**************** deque_steal ****************/
+/* Remove and return the item at the top - the oldest.  Any thread.
+ *
+ * We return:
+ *   the item, or NULL if the deque is empty (or NULL), or another thread
+ *   took the item first; a thief that wants to be sure can try again.
+ */
+void* deque_steal(deque_t* deque);
+
+/**************** deque_size ****************/
+/* Return the number of items in the deque - exact when no thread is
+ * using it, a snapshot otherwise; 0 if deque is NULL.
+ */
+int deque_size(deque_t* deque);
+
+/**************** deque_delete ****************/
+/* Delete deque, calling a delete function on each remaining item.
+ *
+ * Caller provides:
+ *   valid deque pointer,
+ *   valid pointer to function that handles one item (may be NULL).
+ * We do:
+ *   if deque==NULL, do nothing.
+ *   otherwise, unless itemfunc==NULL, call the itemfunc on each item.
+ *   free the deque itself.
+ * Notes:
+ *   no other thread may be using the deque.
+ */
+void deque_delete(deque_t* deque, void (*itemdelete)(void* item) );
+
+#endif // __DEQUE_H
@@ -8,11 +8,37 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 #include <ctype.h>
 #include "file.h"
+#include "mapfile.h"
+#include "mem.h"
+
+/**************** global types ****************/
+typedef struct file_reader {
+  FILE* fp;                   // the file being read; NULL for a memory region
+  char* buf;                  // size+1 bytes, leaving room for a null;
+                              // or the region, which we must not write
+  size_t size;                // bytes the buffer can hold from the file
+  size_t start;               // offset of the first unconsumed byte
+  size_t end;                 // offset just past the last byte read in
+} file_reader_t;
+
+/**************** file-local global variables ****************/
+static const size_t READER_BUFSIZE = 64 * 1024;   // initial reader buffer
+static const size_t READ_BLOCKSIZE = 64 * 1024;   // fread size for whole files
+
+/**************** local functions ****************/
+static char* readRest(FILE* fp);
+static bool reader_fill(file_reader_t* reader);
+static size_t findSpace(const char* p, const size_t n);
 
 
 /**************** file_numLines ****************/
+/* Map the file (or read it, where it cannot be mapped) and count
+ * newlines with memchr, rather than fgetc'ing a byte at a time. */
 int
 file_numLines(FILE* fp)
 {
@@ -20,18 +46,30 @@ file_numLines(FILE* fp)
     return 0;
   }
 
+  mapfile_t* map = mapfile_fromFile(fp);
+  int nlines = file_numLinesMem(mapfile_data(map), mapfile_size(map));
+  mapfile_close(map);
+
   rewind(fp);
+  
+  return nlines;
+}
 
-  int nlines = 0;
-  char c = '\0';
-  while ( (c = fgetc(fp)) != EOF) {
-    if (c == '\n') {
-      nlines++;
-    }
+/**************** file_numLinesMem ****************/
+/* See file.h for documentation. */
+int
+file_numLinesMem(const char* data, const size_t len)
+{
+  if (data == NULL) {
+    return 0;
   }
 
-  rewind(fp);
-  
+  int nlines = 0;
+  const char* end = data + len;
+  for (const char* p = data;
+       (p = memchr(p, '\n', end - p)) != NULL; p++) {
+    nlines++;
+  }
   return nlines;
 }
 
@@ -42,7 +80,7 @@ static int isnewline(int c) { return (c == '\n'); }
 
 /**************** file_readFile ****************/
 /* See file.h for documentation. */
-char* file_readFile(FILE* fp) { return file_readUntil(fp, never); }
+char* file_readFile(FILE* fp) { return readRest(fp); }
 
 /**************** file_readLine ****************/
 /* See file.h for documentation. */
@@ -57,27 +95,28 @@ char* file_readWord(FILE* fp) { return file_readUntil(fp, isspace); }
 char* 
 file_readUntil(FILE* fp, int (*stopfunc)(int c))
 {
-  if (stopfunc == NULL) {
-    stopfunc = never;
+  if (stopfunc == NULL || stopfunc == never) {
+    return readRest(fp);      // no stop character to look for; read in blocks
   }
 
   // allocate buffer big enough for "typical" words/lines
-  int len = 81;
+  size_t len = 81;
   char* buf = malloc(len * sizeof(char));
   if (buf == NULL) {
     return NULL;
   }
 
   // Read characters from file until stop-character or EOF, 
-  // expanding the buffer when needed to hold more.
-  int pos;
-  char c;
-  for (pos = 0; (c = fgetc(fp)) != EOF && !(*stopfunc)(c); pos++) {
+  // doubling the buffer when needed to hold more, so that
+  // reading n characters costs O(log n) reallocs, not O(n).
+  size_t pos;
+  int c;
+  for (pos = 0; (c = getc(fp)) != EOF && !(*stopfunc)(c); pos++) {
     // We need to save buf[pos+1] for the terminating null
     // and buf[len-1] is the last usable slot, 
     // so if pos+1 is past that slot, we need to grow the buffer.
     if (pos+1 > len-1) {
-      char* newbuf = realloc(buf, ++len * sizeof(char));
+      char* newbuf = realloc(buf, (len *= 2) * sizeof(char));
       if (newbuf == NULL) {
         free(buf);
         return NULL;
@@ -99,6 +138,302 @@ file_readUntil(FILE* fp, int (*stopfunc)(int c))
   }
 }
 
+/**************** readRest ****************/
+/* Read the remainder of the file in blocks, doubling the buffer as
+ * needed; the semantics of file_readFile.
+ */
+static char*
+readRest(FILE* fp)
+{
+  size_t size = READ_BLOCKSIZE;
+  size_t len = 0;
+  char* buf = malloc(size + 1);
+  if (buf == NULL) {
+    return NULL;
+  }
+
+  size_t n;
+  while ((n = fread(buf + len, 1, size - len, fp)) > 0) {
+    len += n;
+    if (len == size) {
+      char* newbuf = realloc(buf, (size *= 2) + 1);
+      if (newbuf == NULL) {
+        free(buf);
+        return NULL;
+      }
+      buf = newbuf;
+    }
+  }
+
+  if (len == 0) {
+    // nothing was read before EOF (or error)
+    free(buf);
+    return NULL;
+  }
+  buf[len] = '\0';
+  return buf;
+}
+
+/**************** file_reader_new ****************/
+/* See file.h for documentation. */
+file_reader_t*
+file_reader_new(FILE* fp)
+{
+  if (fp == NULL) {
+    return NULL;
+  }
+
+  file_reader_t* reader = mem_malloc(sizeof(file_reader_t));
+  if (reader == NULL) {
+    return NULL;
+  }
+  reader->buf = mem_malloc(READER_BUFSIZE + 1);
+  if (reader->buf == NULL) {
+    mem_free(reader);
+    return NULL;
+  }
+  reader->fp = fp;
+  reader->size = READER_BUFSIZE;
+  reader->start = 0;
+  reader->end = 0;
+  return reader;
+}
+
+/**************** file_reader_newMem ****************/
+/* See file.h for documentation. */
+file_reader_t*
+file_reader_newMem(const char* data, const size_t len)
+{
+  if (data == NULL) {
+    return NULL;
+  }
+
+  file_reader_t* reader = mem_malloc(sizeof(file_reader_t));
+  if (reader == NULL) {
+    return NULL;
+  }
+  // the whole region is 'read in' already
+  reader->fp = NULL;
+  reader->buf = (char*) data;
+  reader->size = len;
+  reader->start = 0;
+  reader->end = len;
+  return reader;
+}
+
+/**************** reader_fill ****************/
+/* Read more of the file into the buffer, after what is unconsumed:
+ * first sliding the unconsumed bytes down to the front, then doubling the
+ * buffer if they fill it.  This moves the data, so offsets relative to
+ * reader->start stay good but pointers into the buffer do not.
+ * Returns false at EOF (or error, or out of memory), with nothing added;
+ * a memory region is always at EOF.
+ */
+static bool
+reader_fill(file_reader_t* reader)
+{
+  if (reader->fp == NULL) {
+    return false;
+  }
+  if (reader->start > 0) {
+    memmove(reader->buf, reader->buf + reader->start,
+            reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->start = 0;
+  }
+  if (reader->end == reader->size) {
+    char* newbuf = mem_malloc(2 * reader->size + 1);
+    if (newbuf == NULL) {
+      return false;
+    }
+    memcpy(newbuf, reader->buf, reader->end);
+    mem_free(reader->buf);
+    reader->buf = newbuf;
+    reader->size *= 2;
+  }
+
+  size_t n = fread(reader->buf + reader->end, 1,
+                   reader->size - reader->end, reader->fp);
+  reader->end += n;
+  return n > 0;
+}
+
+/**************** file_reader_line ****************/
+/* See file.h for documentation. */
+char*
+file_reader_line(file_reader_t* reader, size_t* len)
+{
+  if (reader == NULL) {
+    return NULL;
+  }
+
+  // look for the newline, reading more until we find it or hit EOF;
+  // 'scanned' bytes past start are known to have none
+  size_t scanned = 0;
+  char* newline;
+  while ((newline = memchr(reader->buf + reader->start + scanned, '\n',
+                           reader->end - reader->start - scanned)) == NULL) {
+    scanned = reader->end - reader->start;
+    if (!reader_fill(reader)) {
+      break;
+    }
+  }
+
+  size_t stop = (newline != NULL) ? (size_t) (newline - reader->buf)
+                                  : reader->end;
+  if (newline == NULL && stop == reader->start) {
+    return NULL;              // EOF, with nothing left
+  }
+
+  char* slice = reader->buf + reader->start;
+  if (reader->fp != NULL) {
+    reader->buf[stop] = '\0';
+  }
+  reader->start = (newline != NULL) ? stop + 1 : stop;
+  if (len != NULL) {
+    *len = stop - (slice - reader->buf);
+  }
+  return slice;
+}
+
+/**************** file_reader_word ****************/
+/* See file.h for documentation. */
+char*
+file_reader_word(file_reader_t* reader, size_t* len)
+{
+  if (reader == NULL) {
+    return NULL;
+  }
+
+  // skip whitespace, reading more as needed
+  for (;;) {
+    while (reader->start < reader->end
+           && isspace((unsigned char) reader->buf[reader->start])) {
+      reader->start++;
+    }
+    if (reader->start < reader->end) {
+      break;
+    }
+    if (!reader_fill(reader)) {
+      return NULL;            // EOF, with only whitespace left
+    }
+  }
+
+  // find the whitespace after the word, reading more as needed
+  size_t scanned = 0;
+  size_t found;
+  bool atEOF = false;
+  while ((found = findSpace(reader->buf + reader->start + scanned,
+                            reader->end - reader->start - scanned))
+         == reader->end - reader->start - scanned) {
+    scanned = reader->end - reader->start;
+    if (!reader_fill(reader)) {
+      atEOF = true;
+      break;
+    }
+  }
+
+  char* slice = reader->buf + reader->start;
+  size_t wordlen = atEOF ? scanned : scanned + found;
+  if (reader->fp != NULL) {
+    slice[wordlen] = '\0';
+  }
+  reader->start += atEOF ? wordlen : wordlen + 1;
+  if (len != NULL) {
+    *len = wordlen;
+  }
+  return slice;
+}
+
+/**************** findSpace ****************/
+/* Return the offset of the first whitespace character in p[0..n-1],
+ * or n if there is none.  Whitespace is all below '!', so we test
+ * eight bytes at a time for any byte below '!', and look closer only
+ * at groups that have one.
+ */
+static size_t
+findSpace(const char* p, const size_t n)
+{
+  const uint64_t ones = 0x0101010101010101ull;
+  const uint64_t highs = 0x8080808080808080ull;
+  size_t i = 0;
+
+  while (i < n) {
+    if (i + 8 <= n) {
+      uint64_t x;
+      memcpy(&x, p + i, 8);
+      if (((x - ones * '!') & ~x & highs) == 0) {
+        i += 8;               // no byte below '!' in these eight
+        continue;
+      }
+    }
+    size_t stop = (i + 8 < n) ? i + 8 : n;
+    for ( ; i < stop; i++) {
+      if (isspace((unsigned char) p[i])) {
+        return i;
+      }
+    }
+  }
+  return n;
+}
+
+/**************** file_reader_rest ****************/
+/* See file.h for documentation. */
+char*
+file_reader_rest(file_reader_t* reader, size_t* len)
+{
+  if (reader == NULL) {
+    return NULL;
+  }
+
+  while (reader_fill(reader)) {
+    // read it all in
+  }
+  if (reader->start == reader->end) {
+    return NULL;              // EOF, with nothing left
+  }
+
+  char* slice = reader->buf + reader->start;
+  if (reader->fp != NULL) {
+    reader->buf[reader->end] = '\0';
+  }
+  if (len != NULL) {
+    *len = reader->end - reader->start;
+  }
+  reader->start = reader->end;
+  return slice;
+}
+
+/**************** file_reader_copy ****************/
+/* See file.h for documentation. */
+char*
+file_reader_copy(const char* slice, const size_t len)
+{
+  if (slice == NULL) {
+    return NULL;
+  }
+
+  char* copy = malloc(len + 1);
+  if (copy != NULL) {
+    memcpy(copy, slice, len);
+    copy[len] = '\0';
+  }
+  return copy;
+}
+
+/**************** file_reader_delete ****************/
+/* See file.h for documentation. */
+void
+file_reader_delete(file_reader_t* reader)
+{
+  if (reader != NULL) {
+    if (reader->fp != NULL) {
+      mem_free(reader->buf);
+    }
+    mem_free(reader);
+  }
+}
+
 /* ********************************************************** */
 /* a simple unit test of the code above */
 #ifdef QUICKTEST
@@ -1,6 +1,13 @@
 /* 
  * file utilities - reading a word, line, or entire file
  * 
+ * The file_read* functions return a fresh string per call.  For reading
+ * a whole file a line or word at a time, a file_reader_t is much cheaper:
+ * it reads big blocks into a buffer of its own and hands out slices of
+ * that buffer, copying only when asked.  A reader can also run over a
+ * region of memory - a file mapped with mapfile.h, say - with no
+ * buffer and no system calls at all.
+ *
  * David Kotz, 2016, 2017, 2019, 2021
  */
 
@@ -8,6 +15,7 @@
 #define __FILE_H
 
 #include <stdio.h>
+#include <stddef.h>
 
 /**************** file_numLines ****************/
 /* Returns the number of lines in the given file,
@@ -18,6 +26,11 @@
  */
 int file_numLines(FILE* fp);
 
+/**************** file_numLinesMem ****************/
+/* Like file_numLines, for a region of memory of len bytes.
+ */
+int file_numLinesMem(const char* data, const size_t len);
+
 /**************** readuntil ****************/
 /* 
  * Read characters from the file into a null-terminated string,
@@ -60,4 +73,71 @@ char* file_readLine(FILE* fp);
  */
 char* file_readWord(FILE* fp);
 
+/**************** global types ****************/
+typedef struct file_reader file_reader_t;  // opaque to users of the module
+
+/**************** file_reader_new ****************/
+/* Create a reader for the given open file.
+ * Caller provides:
+ *   a FILE open for reading; the reader reads ahead in big blocks, so
+ *   it suits files and pipes, not a keyboard waiting on each line.
+ * We return:
+ *   pointer to a new reader, or NULL if fp is NULL or out of memory.
+ * Caller is responsible for:
+ *   not reading fp except through the reader, until it is deleted;
+ *   later calling file_reader_delete, and closing fp.
+ */
+file_reader_t* file_reader_new(FILE* fp);
+
+/**************** file_reader_newMem ****************/
+/* Create a reader over a region of memory, len bytes from data.
+ * We return:
+ *   pointer to a new reader, or NULL if data is NULL or out of memory.
+ * Caller is responsible for:
+ *   keeping the region alive, and unchanged, until the reader is deleted;
+ *   later calling file_reader_delete.
+ * Notes:
+ *   slices are pointers into the region itself, so they stay valid as
+ *   long as it does; but we cannot write into the region, so slices are
+ *   NOT null-terminated - use the length, and do not write through them.
+ */
+file_reader_t* file_reader_newMem(const char* data, const size_t len);
+
+/**************** file_reader_line ****************/
+/* Return the next line, without its newline, as a slice of the reader's
+ * buffer, null-terminated; if len is not NULL, set *len to its length.
+ * Returns empty string for an empty line.
+ * Returns NULL at EOF.
+ * The slice is valid only until the next call on this reader (but see
+ * file_reader_newMem); see file_reader_copy for a string to keep.
+ */
+char* file_reader_line(file_reader_t* reader, size_t* len);
+
+/**************** file_reader_word ****************/
+/* Like file_reader_line, but return the next word - a run of
+ * non-whitespace characters - skipping any whitespace before it, and
+ * consuming the one whitespace character after it.
+ * Returns NULL at EOF.
+ */
+char* file_reader_word(file_reader_t* reader, size_t* len);
+
+/**************** file_reader_rest ****************/
+/* Like file_reader_line, but return the remainder of the file.
+ * Returns NULL if EOF is reached without reading anything.
+ */
+char* file_reader_rest(file_reader_t* reader, size_t* len);
+
+/**************** file_reader_copy ****************/
+/* Return a copy of a slice of length len, null-terminated, for the
+ * caller to keep; caller must later free() it.
+ * Returns NULL if slice is NULL or out of memory.
+ */
+char* file_reader_copy(const char* slice, const size_t len);
+
+/**************** file_reader_delete ****************/
+/* Delete the reader and its buffer; does not close its file.
+ * Any slices it handed out are invalid from now on.
+ */
+void file_reader_delete(file_reader_t* reader);
+
 #endif // __FILE_H
@@ -0,0 +1,225 @@
+/*
+ * filebench - compare ways of reading a file in file.h
+ *
+ * usage:
+ *   filebench [file]
+ *
+ * Reads the file - or a synthetic 10 MB web page if none is given - as a
+ * whole, by lines, and by words, and reports MB/s for:
+ *   the old file_readUntil, which grew its buffer one byte at a time
+ *     (whole file only; kept here for comparison);
+ *   the file_read* functions, which return a fresh string per call;
+ *   a file_reader_t, which returns slices of its own buffer;
+ *   a file_reader_t over the file mapped with mapfile.h, which returns
+ *     slices of the mapping itself (the time includes mapping it);
+ * and counts lines with file_numLines.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#define _POSIX_C_SOURCE 199309L   // clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "file.h"
+#include "mapfile.h"
+#include "mem.h"
+
+/**************** file-local global variables ****************/
+static const long PAGESIZE = 10 * 1000 * 1000;   // size of synthetic page
+
+/**************** local functions ****************/
+static FILE* makePage(void);
+static char* oldReadFile(FILE* fp);
+static void report(const char* label, const long nBytes, const double secs,
+                   const long nItems);
+static double now(void);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [file]\n", argv[0]);
+    exit(1);
+  }
+
+  FILE* fp = (argc == 2) ? fopen(argv[1], "r") : makePage();
+  if (fp == NULL) {
+    fprintf(stderr, "%s: cannot open file\n", argv[0]);
+    exit(2);
+  }
+  fseek(fp, 0, SEEK_END);
+  long nBytes = ftell(fp);
+  printf("%ld bytes\n", nBytes);
+
+  // whole file
+  rewind(fp);
+  double start = now();
+  char* text = oldReadFile(fp);
+  report("old readUntil", nBytes, now() - start, 1);
+  free(text);
+
+  rewind(fp);
+  start = now();
+  text = file_readFile(fp);
+  report("file_readFile", nBytes, now() - start, 1);
+  free(text);
+
+  rewind(fp);
+  start = now();
+  file_reader_t* reader = file_reader_new(fp);
+  size_t len;
+  text = file_reader_copy(file_reader_rest(reader, &len), len);
+  file_reader_delete(reader);
+  report("reader rest+copy", nBytes, now() - start, 1);
+  free(text);
+
+  // lines
+  rewind(fp);
+  long nItems = 0;
+  start = now();
+  while ((text = file_readLine(fp)) != NULL) {
+    nItems++;
+    free(text);
+  }
+  report("file_readLine", nBytes, now() - start, nItems);
+
+  rewind(fp);
+  nItems = 0;
+  start = now();
+  reader = file_reader_new(fp);
+  while (file_reader_line(reader, NULL) != NULL) {
+    nItems++;
+  }
+  file_reader_delete(reader);
+  report("reader line", nBytes, now() - start, nItems);
+
+  nItems = 0;
+  start = now();
+  mapfile_t* map = mapfile_fromFile(fp);
+  reader = file_reader_newMem(mapfile_data(map), mapfile_size(map));
+  while (file_reader_line(reader, NULL) != NULL) {
+    nItems++;
+  }
+  file_reader_delete(reader);
+  mapfile_close(map);
+  report("mapped line", nBytes, now() - start, nItems);
+
+  start = now();
+  nItems = file_numLines(fp);
+  report("file_numLines", nBytes, now() - start, nItems);
+
+  // words
+  rewind(fp);
+  nItems = 0;
+  start = now();
+  while ((text = file_readWord(fp)) != NULL) {
+    nItems += (text[0] != '\0');    // file_readWord returns "" between spaces
+    free(text);
+  }
+  report("file_readWord", nBytes, now() - start, nItems);
+
+  rewind(fp);
+  nItems = 0;
+  start = now();
+  reader = file_reader_new(fp);
+  while (file_reader_word(reader, NULL) != NULL) {
+    nItems++;
+  }
+  file_reader_delete(reader);
+  report("reader word", nBytes, now() - start, nItems);
+
+  nItems = 0;
+  start = now();
+  map = mapfile_fromFile(fp);
+  reader = file_reader_newMem(mapfile_data(map), mapfile_size(map));
+  while (file_reader_word(reader, NULL) != NULL) {
+    nItems++;
+  }
+  file_reader_delete(reader);
+  mapfile_close(map);
+  report("mapped word", nBytes, now() - start, nItems);
+
+  fclose(fp);
+  return (mem_net() == 0) ? 0 : 3;
+}
+
+/**************** makePage ****************/
+/* Write a crawler-style page file of about PAGESIZE bytes - URL, depth,
+ * then HTML lines of words and tags - to a temporary file.
+ */
+static FILE*
+makePage(void)
+{
+  FILE* fp = tmpfile();
+  if (fp == NULL) {
+    return NULL;
+  }
+  fprintf(fp, "http://cs50tse.cs.dartmouth.edu/tse/wikipedia/big.html\n1\n");
+
+  srand(2021);
+  while (ftell(fp) < PAGESIZE) {
+    fputs("<p>", fp);
+    int nWords = 5 + rand() % 20;
+    for (int w = 0; w < nWords; w++) {
+      int len = 2 + rand() % 10;
+      for (int i = 0; i < len; i++) {
+        fputc('a' + rand() % 26, fp);
+      }
+      fputc(' ', fp);
+    }
+    fputs("</p>\n", fp);
+  }
+  return fp;
+}
+
+/**************** oldReadFile ****************/
+/* file_readFile as it was: fgetc, and realloc one byte bigger each time
+ * the buffer fills.
+ */
+static char*
+oldReadFile(FILE* fp)
+{
+  int len = 81;
+  char* buf = malloc(len * sizeof(char));
+  if (buf == NULL) {
+    return NULL;
+  }
+
+  int pos;
+  int c;
+  for (pos = 0; (c = fgetc(fp)) != EOF; pos++) {
+    if (pos+1 > len-1) {
+      char* newbuf = realloc(buf, ++len * sizeof(char));
+      if (newbuf == NULL) {
+        free(buf);
+        return NULL;
+      }
+      buf = newbuf;
+    }
+    buf[pos] = c;
+  }
+  buf[pos] = '\0';
+  return buf;
+}
+
+/**************** report ****************/
+static void
+report(const char* label, const long nBytes, const double secs,
+       const long nItems)
+{
+  printf("  %-18s %8.1f MB/s %10ld items\n", label, nBytes / secs / 1e6,
+         nItems);
+}
+
+/**************** now ****************/
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
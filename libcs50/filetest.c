@@ -0,0 +1,339 @@
+/*
+ * filetest - behaviour test for file readers and mapfile
+ *
+ * usage:
+ *   filetest [nRandom]
+ *
+ * Reads each of a set of files - empty, a lone newline, without a
+ * trailing newline, blank lines, runs of spaces and tabs, a line and a
+ * word each longer than a reader's buffer, and nRandom random ones -
+ * four ways: a reader on the open file; a reader over the file mapped
+ * with mapfile_open; a reader on a pipe; and a reader over a pipe read
+ * in by mapfile_fromFile, which cannot map it and falls back to reading.
+ * Each way, the lines, the words, and a line followed by the rest must
+ * come out as the same file split by hand; so must file_readLine's,
+ * and file_numLines must count its newlines.
+ *
+ * `make filetest` builds it with -fsanitize=address,undefined, so a read
+ * past the end of a mapped file or a buffer shows up as a report.
+ * Prints PASS or FAIL lines; exits non-zero on any failure.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L   // mkstemp, popen
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "file.h"
+#include "mapfile.h"
+#include "mem.h"
+
+/**************** file-local global types ****************/
+/* what to read a file as */
+typedef enum { LINES, WORDS, REST } readmode_t;
+
+/* the items read, joined by SEP */
+typedef struct items {
+  char* text;
+  size_t len, size;
+} items_t;
+
+/**************** file-local global variables ****************/
+static int nRandom = 50;
+static const char SEP = '\001';
+static const size_t LONG = 200000;   // past a reader's 64 KiB buffer
+static const char* modes[] = { "lines", "words", "line and rest" };
+
+/**************** local functions ****************/
+static bool testFile(const char* content, const size_t len, const char* name);
+static bool readWays(const char* path, const char* content, const size_t len,
+                     const char* name);
+static items_t expect(const char* content, const size_t len, const readmode_t mode);
+static items_t readAll(file_reader_t* reader, const readmode_t mode);
+static items_t itemsNew(void);
+static void add(items_t* items, const char* item, const size_t len);
+static bool same(items_t* got, items_t* want, const char* name,
+                 const char* way, const readmode_t mode);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 2 || (argc > 1 && sscanf(argv[1], "%d", &nRandom) != 1)
+      || nRandom < 0) {
+    fprintf(stderr, "usage: %s [nRandom>=0]\n", argv[0]);
+    exit(1);
+  }
+  srand(2021);
+
+  // the edges, by name
+  static const char* edges[][2] = {
+    { "empty", "" },
+    { "a lone newline", "\n" },
+    { "no trailing newline", "one\ntwo" },
+    { "blank lines", "\n\none\n\n\ntwo\n\n" },
+    { "spaces and tabs", "  lead  and\ttabs \n\n trailing \t" },
+  };
+  bool ok = true;
+  int nFiles = 0;
+  for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++, nFiles++) {
+    ok = testFile(edges[i][1], strlen(edges[i][1]), edges[i][0]) && ok;
+  }
+
+  // a long line, then a short one without a newline; and one long word
+  char* big = mem_malloc_assert(LONG + 20, "big");
+  memset(big, 'x', LONG);
+  strcpy(big + LONG, "\nshort");
+  ok = testFile(big, strlen(big), "a long line") && ok;
+  big[3] = ' ';
+  big[LONG] = ' ';
+  ok = testFile(big, strlen(big), "a long word") && ok;
+  nFiles += 2;
+  mem_free(big);
+
+  // random files of a few characters, so lines and words are all sizes
+  for (int i = 0; i < nRandom; i++, nFiles++) {
+    size_t len = rand() % (i % 2 ? 300000 : 200);
+    char* content = mem_malloc_assert(len + 1, "content");
+    const char* alphabet = (i % 3) ? "ab \n\t" : "abcdefgh\n";
+    for (size_t j = 0; j < len; j++) {
+      content[j] = alphabet[rand() % strlen(alphabet)];
+    }
+    content[len] = '\0';
+    char name[40];
+    sprintf(name, "random file %d", i);
+    ok = testFile(content, len, name) && ok;
+    mem_free(content);
+  }
+
+  if (mem_net() != 0) {
+    mem_report(stdout, "FAIL: leaked");
+    ok = false;
+  }
+  printf("%s: %d files, 4 ways each\n", ok ? "PASS" : "FAIL", nFiles);
+  return ok ? 0 : 2;
+}
+
+/**************** testFile ****************/
+/* Write the content to a file, and read it back every way. */
+static bool
+testFile(const char* content, const size_t len, const char* name)
+{
+  char path[] = "/tmp/filetestXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    printf("FAIL: %s: cannot make a temporary file\n", name);
+    return false;
+  }
+  FILE* fp = fdopen(fd, "w");
+  bool ok = fp != NULL && fwrite(content, 1, len, fp) == len;
+  ok = fp != NULL && fclose(fp) == 0 && ok;
+  if (!ok) {
+    printf("FAIL: %s: cannot write the temporary file\n", name);
+  } else {
+    ok = readWays(path, content, len, name);
+  }
+  unlink(path);
+  return ok;
+}
+
+/**************** readWays ****************/
+static bool
+readWays(const char* path, const char* content, const size_t len,
+         const char* name)
+{
+  char command[100];
+  sprintf(command, "cat %s", path);
+  bool ok = true;
+
+  for (readmode_t mode = LINES; mode <= REST && ok; mode++) {
+    items_t want = expect(content, len, mode);
+
+    // a reader on the file
+    FILE* fp = mem_assert(fopen(path, "r"), "fopen");
+    file_reader_t* reader = mem_assert(file_reader_new(fp), "reader");
+    items_t got = readAll(reader, mode);
+    ok = same(&got, &want, name, "file", mode);
+    file_reader_delete(reader);
+    fclose(fp);
+
+    // a reader over the file, mapped
+    mapfile_t* map = mapfile_open(path);
+    if (map == NULL || (len > 0 && !mapfile_isMapped(map))
+        || mapfile_size(map) != len) {
+      printf("FAIL: %s: mapfile_open\n", name);
+      ok = false;
+    } else {
+      reader = mem_assert(file_reader_newMem(mapfile_data(map), len), "reader");
+      got = readAll(reader, mode);
+      ok = same(&got, &want, name, "mapped file", mode) && ok;
+      file_reader_delete(reader);
+    }
+    mapfile_close(map);
+
+    // a reader on a pipe
+    fp = mem_assert(popen(command, "r"), "popen");
+    reader = mem_assert(file_reader_new(fp), "reader");
+    got = readAll(reader, mode);
+    ok = same(&got, &want, name, "pipe", mode) && ok;
+    file_reader_delete(reader);
+    pclose(fp);
+
+    // a reader over a pipe, which mapfile must read in
+    fp = mem_assert(popen(command, "r"), "popen");
+    map = mapfile_fromFile(fp);
+    if (map == NULL || mapfile_isMapped(map) || mapfile_size(map) != len
+        || (len > 0 && memcmp(mapfile_data(map), content, len) != 0)) {
+      printf("FAIL: %s: mapfile_fromFile on a pipe\n", name);
+      ok = false;
+    } else {
+      reader = mem_assert(file_reader_newMem(mapfile_data(map), len), "reader");
+      got = readAll(reader, mode);
+      ok = same(&got, &want, name, "pipe read in", mode) && ok;
+      file_reader_delete(reader);
+    }
+    mapfile_close(map);
+    pclose(fp);
+
+    mem_free(want.text);
+  }
+
+  // the old way, a fresh string per line; and a count of the newlines
+  FILE* fp = mem_assert(fopen(path, "r"), "fopen");
+  items_t want = expect(content, len, LINES), got = itemsNew();
+  char* line;
+  while ((line = file_readLine(fp)) != NULL) {
+    add(&got, line, strlen(line));
+    free(line);
+  }
+  ok = same(&got, &want, name, "file_readLine", LINES) && ok;
+  mem_free(want.text);
+
+  int newlines = 0;
+  for (size_t i = 0; i < len; i++) {
+    newlines += (content[i] == '\n');
+  }
+  if (file_numLines(fp) != newlines) {
+    printf("FAIL: %s: file_numLines counts %d, not %d\n", name,
+           file_numLines(fp), newlines);
+    ok = false;
+  }
+  fclose(fp);
+  return ok;
+}
+
+/**************** expect ****************/
+/* Split the content by hand, as the reader should. */
+static items_t
+expect(const char* content, const size_t len, const readmode_t mode)
+{
+  items_t items = itemsNew();
+
+  size_t i = 0;
+  if (mode == WORDS) {
+    while (i < len) {
+      while (i < len && isspace((unsigned char) content[i])) {
+        i++;
+      }
+      size_t start = i;
+      while (i < len && !isspace((unsigned char) content[i])) {
+        i++;
+      }
+      if (i > start) {
+        add(&items, content + start, i - start);
+      }
+    }
+    return items;
+  }
+
+  // lines: each up to a newline; the last may lack one
+  while (i < len) {
+    const char* newline = memchr(content + i, '\n', len - i);
+    size_t stop = (newline != NULL) ? (size_t) (newline - content) : len;
+    add(&items, content + i, stop - i);
+    i = (newline != NULL) ? stop + 1 : len;
+    if (mode == REST) {
+      if (i < len) {
+        add(&items, content + i, len - i);
+      }
+      break;
+    }
+  }
+  return items;
+}
+
+/**************** readAll ****************/
+/* Read the reader to the end, as lines, words, or a line and the rest. */
+static items_t
+readAll(file_reader_t* reader, const readmode_t mode)
+{
+  items_t items = itemsNew();
+
+  char* slice;
+  size_t len;
+  if (mode == REST) {
+    if ((slice = file_reader_line(reader, &len)) != NULL) {
+      add(&items, slice, len);
+      if ((slice = file_reader_rest(reader, &len)) != NULL) {
+        add(&items, slice, len);
+      }
+    }
+    return items;
+  }
+  while ((slice = (mode == LINES) ? file_reader_line(reader, &len)
+                                  : file_reader_word(reader, &len)) != NULL) {
+    add(&items, slice, len);
+  }
+  return items;
+}
+
+/**************** itemsNew ****************/
+/* No items, yet. */
+static items_t
+itemsNew(void)
+{
+  items_t items = { mem_malloc_assert(64, "items"), 0, 64 };
+  return items;
+}
+
+/**************** add ****************/
+/* Append an item, and a separator. */
+static void
+add(items_t* items, const char* item, const size_t len)
+{
+  if (items->len + len + 2 > items->size) {
+    size_t size = 2 * (items->len + len + 2);
+    char* text = mem_malloc_assert(size, "items");
+    memcpy(text, items->text, items->len);
+    mem_free(items->text);
+    items->text = text;
+    items->size = size;
+  }
+  memcpy(items->text + items->len, item, len);
+  items->len += len;
+  items->text[items->len++] = SEP;
+}
+
+/**************** same ****************/
+/* Did we read what we should have? Frees what we read. */
+static bool
+same(items_t* got, items_t* want, const char* name, const char* way,
+     const readmode_t mode)
+{
+  bool ok = got->len == want->len && memcmp(got->text, want->text, got->len) == 0;
+  if (!ok) {
+    size_t at = 0;
+    while (at < got->len && at < want->len && got->text[at] == want->text[at]) {
+      at++;
+    }
+    printf("FAIL: %s: %s of the %s differ at byte %zu (%zu read, %zu expected)\n",
+           name, modes[mode], way, at, got->len, want->len);
+  }
+  mem_free(got->text);
+  return ok;
+}
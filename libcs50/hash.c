@@ -1,13 +1,29 @@
 /* =========================================================================
- * hash.c - Jenkins' Hash, maps from string to integer
+ * hash.c - string hash functions, maps from string to integer
  *
  * Implementation details can be found at:
  *     http://www.burtleburtle.net/bob/hash/doobs.html
- * ========================================================================= 
+ *     https://github.com/wangyi-fudan/wyhash
+ * =========================================================================
  */
 
+#include <stdint.h>
 #include <string.h>
-#include "hash.h" 
+#include "hash.h"
+
+/**************** file-local global variables ****************/
+// wyhash mixing constants ("secret"), from the reference implementation.
+static const uint64_t wysecret[4] = {
+  0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+  0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+/**************** local functions ****************/
+static inline void wymum(uint64_t* a, uint64_t* b);
+static inline uint64_t wymix(uint64_t a, uint64_t b);
+static inline uint64_t wyr8(const uint8_t* p);
+static inline uint64_t wyr4(const uint8_t* p);
+static inline uint64_t wyr3(const uint8_t* p, const size_t k);
 
 // hash_jenkins - see header file for usage
 unsigned long
@@ -17,11 +33,19 @@ hash_jenkins(const char* str, const unsigned long mod)
     return 0;
   }
 
-  size_t len = strlen(str);
-  unsigned long hash = 0;
+  return hash_jenkins_len(str, strlen(str), 0) % mod;
+}
+
+// hash_jenkins_len - see header file for usage
+unsigned long
+hash_jenkins_len(const void* key, const size_t len, const unsigned long seed)
+{
+  const unsigned char* str = key;
+  unsigned long hash = seed;
 
-  for (int i = 0; i < len; i++) {
-    hash += str[i];
+  for (size_t i = 0; i < len; i++) {
+    // sign-extend, exactly as the original char-by-char loop did
+    hash += (signed char) str[i];
     hash += (hash << 10);
     hash ^= (hash >> 6);
   }
@@ -30,5 +54,128 @@ hash_jenkins(const char* str, const unsigned long mod)
   hash ^= (hash >> 11);
   hash += (hash << 15);
 
-  return (hash % mod);
+  return hash;
+}
+
+// hash_wy - see header file for usage
+unsigned long
+hash_wy(const void* key, const size_t len, const unsigned long seed)
+{
+  const uint8_t* p = key;
+  uint64_t s = seed;
+  uint64_t a, b;
+
+  s ^= wymix(s ^ wysecret[0], wysecret[1]);
+
+  if (len <= 16) {
+    if (len >= 4) {
+      // two overlapping 4-byte reads from each end cover 4..16 bytes
+      a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+      b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = wyr3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      // three independent lanes of 16 bytes each
+      uint64_t see1 = s, see2 = s;
+      do {
+        s = wymix(wyr8(p) ^ wysecret[1], wyr8(p + 8) ^ s);
+        see1 = wymix(wyr8(p + 16) ^ wysecret[2], wyr8(p + 24) ^ see1);
+        see2 = wymix(wyr8(p + 32) ^ wysecret[3], wyr8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      s ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      s = wymix(wyr8(p) ^ wysecret[1], wyr8(p + 8) ^ s);
+      i -= 16;
+      p += 16;
+    }
+    // the last 16 bytes, overlapping what came before if need be
+    a = wyr8(p + i - 16);
+    b = wyr8(p + i - 8);
+  }
+
+  a ^= wysecret[1];
+  b ^= s;
+  wymum(&a, &b);
+  return (unsigned long) wymix(a ^ wysecret[0] ^ len, b ^ wysecret[1]);
+}
+
+// hash_string - see header file for usage
+unsigned long
+hash_string(const char* str, const unsigned long mod)
+{
+  if (str == NULL || mod <= 1) {
+    return 0;
+  }
+
+  return hash_default(str, strlen(str), 0) % mod;
+}
+
+/**************** wymum ****************/
+/* Multiply a and b into a 128-bit product; low half to a, high half to b.
+ */
+static inline void
+wymum(uint64_t* a, uint64_t* b)
+{
+#ifdef __SIZEOF_INT128__
+  __extension__ typedef unsigned __int128 uint128_t;
+  uint128_t r = (uint128_t) *a * *b;
+  *a = (uint64_t) r;
+  *b = (uint64_t) (r >> 64);
+#else
+  // schoolbook multiply on 32-bit halves
+  uint64_t ha = *a >> 32, hb = *b >> 32;
+  uint64_t la = (uint32_t) *a, lb = (uint32_t) *b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32);
+  uint64_t c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  *a = lo;
+  *b = hi;
+#endif
+}
+
+/**************** wymix ****************/
+/* Multiply and fold the two halves of the product together.
+ */
+static inline uint64_t
+wymix(uint64_t a, uint64_t b)
+{
+  wymum(&a, &b);
+  return a ^ b;
+}
+
+/**************** wyr8, wyr4, wyr3 ****************/
+/* Unaligned little reads; memcpy compiles down to a single load.
+ */
+static inline uint64_t
+wyr8(const uint8_t* p)
+{
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint64_t
+wyr4(const uint8_t* p)
+{
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static inline uint64_t
+wyr3(const uint8_t* p, const size_t k)
+{
+  return (((uint64_t) p[0]) << 16) | (((uint64_t) p[k >> 1]) << 8) | p[k - 1];
 }
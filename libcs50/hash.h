@@ -1,21 +1,84 @@
 /* =========================================================================
- * hash.h - Jenkins' Hash, maps from string to integer
+ * hash.h - string hash functions, maps from string to integer
  *
- * Implementation details can be found at:
+ * Two families of hash function live here:
+ *
+ *   Jenkins' one_at_a_time hash, processing one byte per step:
  *     http://www.burtleburtle.net/bob/hash/doobs.html
- * ========================================================================= 
+ *
+ *   A wyhash-style hash, processing eight bytes per step with a
+ *   64x64->128-bit multiply-and-fold mixer:
+ *     https://github.com/wangyi-fudan/wyhash
+ *
+ * Every function of type hash_func_t takes an explicit length, so callers
+ * that already know the key length never pay for strlen, and a seed,
+ * so callers that hash untrusted keys can pick a secret seed and resist
+ * hash-flooding.  hash_default is the function used by the hashtable
+ * module unless the caller plugs in another one.
+ * =========================================================================
  */
 
 #ifndef HASH_H
 #define HASH_H
 
+#include <stddef.h>
+
+/**************** global types ****************/
+/* A length-aware, seeded hash function:
+ * hashes 'len' bytes starting at 'key' and returns the full-width hash;
+ * the caller reduces it modulo the number of slots.
+ */
+typedef unsigned long (*hash_func_t)(const void* key, const size_t len,
+                                     const unsigned long seed);
+
+/**************** hash_default ****************/
+/* The hash function used when the caller does not choose one.
+ */
+#define hash_default hash_wy
+
+/**************** hash_jenkins ****************/
 /*
  * hash_jenkins - Bob Jenkins' one_at_a_time hash function
  * str: char buffer to hash (non-NULL)
  * mod: desired hash modulus (>0)
  *
- * Returns hash(str) % mod. 
+ * Returns hash(str) % mod.
  */
 unsigned long hash_jenkins(const char* str, const unsigned long mod);
 
+/**************** hash_jenkins_len ****************/
+/*
+ * hash_jenkins_len - one_at_a_time over a known-length key, as hash_func_t.
+ * key: bytes to hash (non-NULL unless len is 0)
+ * len: number of bytes to hash
+ * seed: initial hash state; with seed 0,
+ *   hash_jenkins_len(s, strlen(s), 0) % mod == hash_jenkins(s, mod).
+ *
+ * Returns the full-width hash.
+ */
+unsigned long hash_jenkins_len(const void* key, const size_t len,
+                               const unsigned long seed);
+
+/**************** hash_wy ****************/
+/*
+ * hash_wy - wyhash-style 64-bit hash, eight bytes per step, as hash_func_t.
+ * key: bytes to hash (non-NULL unless len is 0)
+ * len: number of bytes to hash
+ * seed: any value; different seeds give independent hash functions.
+ *
+ * Returns the full-width hash.
+ */
+unsigned long hash_wy(const void* key, const size_t len,
+                      const unsigned long seed);
+
+/**************** hash_string ****************/
+/*
+ * hash_string - hash a null-terminated string with hash_default, seed 0.
+ * str: char buffer to hash (non-NULL)
+ * mod: desired hash modulus (>0)
+ *
+ * Returns hash(str) % mod; a drop-in replacement for hash_jenkins().
+ */
+unsigned long hash_string(const char* str, const unsigned long mod);
+
 #endif // HASH_H
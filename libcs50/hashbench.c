@@ -0,0 +1,275 @@
+/*
+ * hashbench - compare the hash functions in hash.h
+ *
+ * usage:
+ *   hashbench [keyFile]
+ *
+ * Loads keys - the first word of each line of keyFile (an index file works
+ * well), or synthetic words and URLs if no file is given - and reports,
+ * for each hash function:
+ *   throughput, hashing every key many times, in Mkeys/s and MB/s;
+ *   probe counts, as the mean number of key comparisons for a successful
+ *     lookup and the longest chain, at the indexer's 200 slots and at
+ *     one slot per key;
+ *   time to insert and then find every key in a hashtable.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#define _POSIX_C_SOURCE 199309L   // clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hash.h"
+#include "hashtable.h"
+#include "file.h"
+#include "mem.h"
+
+/**************** file-local global types ****************/
+typedef struct {
+  int nKeys;                  // number of keys in the list
+  char** keys;                // array of keys
+  size_t* lens;               // strlen of each key
+  size_t nBytes;              // sum of lens
+} keylist_t;
+
+typedef struct {
+  const char* name;           // for printing
+  hash_func_t func;           // the function under test
+} contender_t;
+
+/**************** file-local global variables ****************/
+static const contender_t contenders[] = {
+  { "jenkins", hash_jenkins_len },
+  { "wyhash",  hash_wy },
+};
+static const int nContenders = sizeof(contenders) / sizeof(contenders[0]);
+static const int ROUNDS = 200;        // passes over the keys when timing
+
+/**************** local functions ****************/
+static keylist_t* keylist_load(const char* keyFilename);
+static keylist_t* keylist_synthesize(const int nKeys);
+static void keylist_delete(keylist_t* keylist);
+static void benchThroughput(const keylist_t* keylist, const char* label);
+static void benchProbes(const keylist_t* keylist, const int nSlots);
+static void benchTable(const keylist_t* keylist);
+static double now(void);
+static void dummyDelete(void* item);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [keyFile]\n", argv[0]);
+    exit(1);
+  }
+
+  keylist_t* keylist = (argc == 2) ? keylist_load(argv[1])
+                                   : keylist_synthesize(50000);
+  if (keylist == NULL || keylist->nKeys == 0) {
+    fprintf(stderr, "%s: no keys to hash\n", argv[0]);
+    exit(2);
+  }
+
+  printf("%d keys, mean length %.1f bytes\n\n", keylist->nKeys,
+         (double) keylist->nBytes / keylist->nKeys);
+
+  benchThroughput(keylist, "keys");
+  benchProbes(keylist, 200);
+  benchProbes(keylist, keylist->nKeys);
+  benchTable(keylist);
+
+  keylist_delete(keylist);
+  return 0;
+}
+
+/**************** keylist_load ****************/
+/* Load the first word of every line of the file as a key.
+ */
+static keylist_t*
+keylist_load(const char* keyFilename)
+{
+  FILE* fp = fopen(keyFilename, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "cannot open key file '%s'\n", keyFilename);
+    return NULL;
+  }
+
+  int maxKeys = file_numLines(fp);
+  keylist_t* keylist = mem_malloc_assert(sizeof(keylist_t), "keylist");
+  keylist->keys = mem_calloc_assert(maxKeys + 1, sizeof(char*), "keys[]");
+  keylist->lens = mem_calloc_assert(maxKeys + 1, sizeof(size_t), "lens[]");
+  keylist->nKeys = 0;
+  keylist->nBytes = 0;
+
+  char* line;
+  while ((line = file_readLine(fp)) != NULL && keylist->nKeys < maxKeys) {
+    char* space = strchr(line, ' ');
+    if (space != NULL) {
+      *space = '\0';
+    }
+    keylist->lens[keylist->nKeys] = strlen(line);
+    keylist->nBytes += strlen(line);
+    keylist->keys[keylist->nKeys++] = line;
+  }
+  free(line);
+  fclose(fp);
+  return keylist;
+}
+
+/**************** keylist_synthesize ****************/
+/* Make nKeys keys: half short words, half crawler-style URLs.
+ */
+static keylist_t*
+keylist_synthesize(const int nKeys)
+{
+  keylist_t* keylist = mem_malloc_assert(sizeof(keylist_t), "keylist");
+  keylist->keys = mem_calloc_assert(nKeys, sizeof(char*), "keys[]");
+  keylist->lens = mem_calloc_assert(nKeys, sizeof(size_t), "lens[]");
+  keylist->nKeys = nKeys;
+  keylist->nBytes = 0;
+
+  srand(2021);
+  for (int k = 0; k < nKeys; k++) {
+    char buf[100];
+    if (k % 2 == 0) {
+      int len = 3 + rand() % 10;
+      for (int i = 0; i < len; i++) {
+        buf[i] = 'a' + rand() % 26;
+      }
+      buf[len] = '\0';
+    } else {
+      sprintf(buf, "http://cs50tse.cs.dartmouth.edu/tse/wikipedia/%d.html", k);
+    }
+    keylist->keys[k] = mem_malloc_assert(strlen(buf) + 1, "key");
+    strcpy(keylist->keys[k], buf);
+    keylist->lens[k] = strlen(buf);
+    keylist->nBytes += strlen(buf);
+  }
+  return keylist;
+}
+
+/**************** keylist_delete ****************/
+static void
+keylist_delete(keylist_t* keylist)
+{
+  for (int k = 0; k < keylist->nKeys; k++) {
+    free(keylist->keys[k]);
+  }
+  mem_free(keylist->keys);
+  mem_free(keylist->lens);
+  mem_free(keylist);
+}
+
+/**************** benchThroughput ****************/
+/* Hash every key ROUNDS times with each contender; also time the old
+ * strlen-then-hash entry point, to show what a length-aware caller saves.
+ */
+static void
+benchThroughput(const keylist_t* keylist, const char* label)
+{
+  printf("throughput over %s:\n", label);
+  unsigned long sink = 0;
+  double keys = (double) keylist->nKeys * ROUNDS;
+  double mbytes = (double) keylist->nBytes * ROUNDS / 1e6;
+
+  double start = now();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int k = 0; k < keylist->nKeys; k++) {
+      sink += hash_jenkins(keylist->keys[k], 200);
+    }
+  }
+  double secs = now() - start;
+  printf("  %-16s %8.1f Mkeys/s %8.1f MB/s\n", "jenkins+strlen",
+         keys / secs / 1e6, mbytes / secs);
+
+  for (int c = 0; c < nContenders; c++) {
+    start = now();
+    for (int r = 0; r < ROUNDS; r++) {
+      for (int k = 0; k < keylist->nKeys; k++) {
+        sink += contenders[c].func(keylist->keys[k], keylist->lens[k], r);
+      }
+    }
+    secs = now() - start;
+    printf("  %-16s %8.1f Mkeys/s %8.1f MB/s\n", contenders[c].name,
+           keys / secs / 1e6, mbytes / secs);
+  }
+  printf("  (checksum %lu)\n\n", sink & 0xff);
+}
+
+/**************** benchProbes ****************/
+/* Distribute the keys over nSlots chains; a successful lookup of the i'th
+ * key in a chain costs i comparisons, so a chain of length L costs
+ * L(L+1)/2 in total.
+ */
+static void
+benchProbes(const keylist_t* keylist, const int nSlots)
+{
+  printf("probes with %d slots (ideal mean %.2f):\n", nSlots,
+         1.0 + (double) (keylist->nKeys - 1) / (2.0 * nSlots));
+  int* chain = mem_calloc_assert(nSlots, sizeof(int), "chain[]");
+
+  for (int c = 0; c < nContenders; c++) {
+    memset(chain, 0, nSlots * sizeof(int));
+    for (int k = 0; k < keylist->nKeys; k++) {
+      chain[contenders[c].func(keylist->keys[k], keylist->lens[k], 0)
+            % nSlots]++;
+    }
+    double probes = 0;
+    int longest = 0;
+    for (int s = 0; s < nSlots; s++) {
+      probes += (double) chain[s] * (chain[s] + 1) / 2.0;
+      if (chain[s] > longest) {
+        longest = chain[s];
+      }
+    }
+    printf("  %-16s mean %6.2f probes, longest chain %d\n",
+           contenders[c].name, probes / keylist->nKeys, longest);
+  }
+  mem_free(chain);
+  printf("\n");
+}
+
+/**************** benchTable ****************/
+/* Insert every key into a right-sized hashtable, then find every key.
+ */
+static void
+benchTable(const keylist_t* keylist)
+{
+  printf("hashtable insert+find, %d slots:\n", keylist->nKeys);
+  for (int c = 0; c < nContenders; c++) {
+    double start = now();
+    hashtable_t* ht = hashtable_new_hash(keylist->nKeys, contenders[c].func, 0);
+    for (int k = 0; k < keylist->nKeys; k++) {
+      hashtable_insert_len(ht, keylist->keys[k], keylist->lens[k], "x");
+    }
+    int found = 0;
+    for (int r = 0; r < 10; r++) {
+      for (int k = 0; k < keylist->nKeys; k++) {
+        found += hashtable_find_len(ht, keylist->keys[k], keylist->lens[k])
+                 != NULL;
+      }
+    }
+    hashtable_delete(ht, dummyDelete);
+    printf("  %-16s %8.3f s (%d found)\n", contenders[c].name,
+           now() - start, found);
+  }
+}
+
+/**************** now ****************/
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**************** dummyDelete ****************/
+static void
+dummyDelete(void* item)
+{
+}
@@ -0,0 +1,215 @@
+/*
+ * hashtable.c - CS50 'hashtable' module
+ *
+ * see hashtable.h for more information.
+ *
+ * The table is an array of sets, one per slot; a key lives in the set
+ * at slot hash(key) % num_slots.  The hash function is pluggable,
+ * and defaults to hash_default (see hash.h).
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hashtable.h"
+#include "hash.h"
+#include "set.h"
+#include "mem.h"
+
+/**************** file-local global variables ****************/
+/* none */
+
+/**************** global types ****************/
+typedef struct hashtable {
+  int num_slots;              // number of slots in the table
+  set_t** slots;              // array of num_slots sets
+  hash_func_t hashfunc;       // hash function for keys
+  unsigned long seed;         // seed passed to hashfunc
+  mem_arena_t* arena;         // where sets come from, if not NULL
+  mem_pool_t* pool;           // otherwise, where all the sets' nodes come from
+} hashtable_t;
+
+/**************** global functions ****************/
+/* that is, visible outside this file */
+/* see hashtable.h for comments about exported functions */
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static set_t* hashtable_slot(hashtable_t* ht, const char* key,
+                             const size_t len);
+
+/**************** hashtable_new() ****************/
+/* see hashtable.h for description */
+hashtable_t*
+hashtable_new(const int num_slots)
+{
+  return hashtable_new_hash(num_slots, NULL, 0);
+}
+
+/**************** hashtable_new_hash() ****************/
+/* see hashtable.h for description */
+hashtable_t*
+hashtable_new_hash(const int num_slots,
+                   hash_func_t hashfunc, const unsigned long seed)
+{
+  if (num_slots <= 0) {
+    return NULL;
+  }
+
+  hashtable_t* ht = mem_malloc(sizeof(hashtable_t));
+  if (ht == NULL) {
+    return NULL;              // error allocating hashtable
+  }
+
+  ht->slots = mem_calloc(num_slots, sizeof(set_t*));
+  if (ht->slots == NULL) {
+    mem_free(ht);
+    return NULL;              // error allocating slots
+  }
+
+  // initialize contents of hashtable structure;
+  // each slot's set is created the first time a key lands in it,
+  // and the pool of nodes they share, rather than one per set,
+  // the first time a set needs one.
+  ht->pool = NULL;
+  ht->num_slots = num_slots;
+  ht->hashfunc = (hashfunc != NULL) ? hashfunc : hash_default;
+  ht->seed = seed;
+  ht->arena = NULL;
+  return ht;
+}
+
+/**************** hashtable_new_arena() ****************/
+/* see hashtable.h for description */
+hashtable_t*
+hashtable_new_arena(const int num_slots, mem_arena_t* arena)
+{
+  hashtable_t* ht = hashtable_new_hash(num_slots, NULL, 0);
+  if (ht != NULL) {
+    ht->arena = arena;
+  }
+  return ht;
+}
+
+/**************** hashtable_insert() ****************/
+/* see hashtable.h for description */
+bool
+hashtable_insert(hashtable_t* ht, const char* key, void* item)
+{
+  if (key == NULL) {
+    return false;
+  }
+  return hashtable_insert_len(ht, key, strlen(key), item);
+}
+
+/**************** hashtable_insert_len() ****************/
+/* see hashtable.h for description */
+bool
+hashtable_insert_len(hashtable_t* ht, const char* key, const size_t len,
+                     void* item)
+{
+  if (ht == NULL || key == NULL || item == NULL) {
+    return false;
+  }
+
+  unsigned long slot = ht->hashfunc(key, len, ht->seed) % ht->num_slots;
+  if (ht->slots[slot] == NULL) {
+    if (ht->arena == NULL && ht->pool == NULL
+        && (ht->pool = set_pool_new(false)) == NULL) {
+      return false;           // error allocating pool
+    }
+    ht->slots[slot] = (ht->arena != NULL) ? set_new_arena(ht->arena)
+                                          : set_new_pool(ht->pool);
+    if (ht->slots[slot] == NULL) {
+      return false;           // error allocating set
+    }
+  }
+  return set_insert(ht->slots[slot], key, item);
+}
+
+/**************** hashtable_find() ****************/
+/* see hashtable.h for description */
+void*
+hashtable_find(hashtable_t* ht, const char* key)
+{
+  if (key == NULL) {
+    return NULL;
+  }
+  return hashtable_find_len(ht, key, strlen(key));
+}
+
+/**************** hashtable_find_len() ****************/
+/* see hashtable.h for description */
+void*
+hashtable_find_len(hashtable_t* ht, const char* key, const size_t len)
+{
+  if (ht == NULL || key == NULL) {
+    return NULL;
+  }
+  return set_find(hashtable_slot(ht, key, len), key);
+}
+
+/**************** hashtable_slot ****************/
+/* Return the set in the slot for key; may be NULL if that slot is empty. */
+static set_t*
+hashtable_slot(hashtable_t* ht, const char* key, const size_t len)
+{
+  return ht->slots[ht->hashfunc(key, len, ht->seed) % ht->num_slots];
+}
+
+/**************** hashtable_print() ****************/
+/* see hashtable.h for description */
+void
+hashtable_print(hashtable_t* ht, FILE* fp,
+                void (*itemprint)(FILE* fp, const char* key, void* item))
+{
+  if (fp != NULL) {
+    if (ht != NULL) {
+      for (int i = 0; i < ht->num_slots; i++) {
+        if (ht->slots[i] != NULL && itemprint != NULL) {
+          set_print(ht->slots[i], fp, itemprint);
+        } else {
+          fputs("{}", fp);
+        }
+        fputc('\n', fp);
+      }
+    } else {
+      fputs("(null)", fp);
+    }
+  }
+}
+
+/**************** hashtable_iterate() ****************/
+/* see hashtable.h for description */
+void
+hashtable_iterate(hashtable_t* ht, void* arg,
+                  void (*itemfunc)(void* arg, const char* key, void* item) )
+{
+  if (ht != NULL && itemfunc != NULL) {
+    // iterate over each slot in turn
+    for (int i = 0; i < ht->num_slots; i++) {
+      set_iterate(ht->slots[i], arg, itemfunc);
+    }
+  }
+}
+
+/**************** hashtable_delete() ****************/
+/* see hashtable.h for description */
+void
+hashtable_delete(hashtable_t* ht, void (*itemdelete)(void* item) )
+{
+  if (ht != NULL) {
+    for (int i = 0; i < ht->num_slots; i++) {
+      set_delete(ht->slots[i], itemdelete);
+    }
+    mem_pool_delete(ht->pool);          // ignores NULL
+    mem_free(ht->slots);
+    mem_free(ht);
+  }
+
+#ifdef MEMTEST
+  mem_report(stdout, "End of hashtable_delete");
+#endif
+}
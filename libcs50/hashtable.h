@@ -13,6 +13,9 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "hash.h"
+#include "mem.h"
 
 /**************** global types ****************/
 typedef struct hashtable hashtable_t;  // opaque to users of the module
@@ -33,6 +36,38 @@ typedef struct hashtable hashtable_t;  // opaque to users of the module
  */
 hashtable_t* hashtable_new(const int num_slots);
 
+/**************** hashtable_new_hash ****************/
+/* Create a new (empty) hashtable that uses a caller-chosen hash function.
+ *
+ * Caller provides:
+ *   number of slots to be used for the hashtable (must be > 0),
+ *   hash function (may be NULL, meaning hash_default),
+ *   seed passed to every call of the hash function; callers that insert
+ *   untrusted keys should pick an unpredictable seed.
+ * We return:
+ *   pointer to the new hashtable; return NULL if error.
+ * Notes:
+ *   hashtable_new(n) is hashtable_new_hash(n, NULL, 0).
+ */
+hashtable_t* hashtable_new_hash(const int num_slots,
+                                hash_func_t hashfunc, const unsigned long seed);
+
+/**************** hashtable_new_arena ****************/
+/* Create a new (empty) hashtable whose sets, nodes and key copies
+ * come from an arena, rather than one mem_malloc each.
+ *
+ * Caller provides:
+ *   number of slots to be used for the hashtable (must be > 0),
+ *   valid arena pointer (NULL means the same as hashtable_new).
+ * We return:
+ *   pointer to the new hashtable; return NULL if error.
+ * Caller is responsible for:
+ *   later calling hashtable_delete, which deletes items but leaves the
+ *   key strings for the caller to release with the arena;
+ *   keeping the arena alive (and un-reset) as long as the hashtable.
+ */
+hashtable_t* hashtable_new_arena(const int num_slots, mem_arena_t* arena);
+
 /**************** hashtable_insert ****************/
 /* Insert item, identified by key (string), into the given hashtable.
  *
@@ -49,6 +84,17 @@ hashtable_t* hashtable_new(const int num_slots);
  */
 bool hashtable_insert(hashtable_t* ht, const char* key, void* item);
 
+/**************** hashtable_insert_len ****************/
+/* Like hashtable_insert, for a caller that already knows strlen(key).
+ *
+ * Caller provides:
+ *   as for hashtable_insert, plus len == strlen(key).
+ * We return:
+ *   as for hashtable_insert.
+ */
+bool hashtable_insert_len(hashtable_t* ht, const char* key, const size_t len,
+                          void* item);
+
 /**************** hashtable_find ****************/
 /* Return the item associated with the given key.
  *
@@ -62,6 +108,16 @@ bool hashtable_insert(hashtable_t* ht, const char* key, void* item);
  */
 void* hashtable_find(hashtable_t* ht, const char* key);
 
+/**************** hashtable_find_len ****************/
+/* Like hashtable_find, for a caller that already knows strlen(key).
+ *
+ * Caller provides:
+ *   as for hashtable_find, plus len == strlen(key).
+ * We return:
+ *   as for hashtable_find.
+ */
+void* hashtable_find_len(hashtable_t* ht, const char* key, const size_t len);
+
 /**************** hashtable_print ****************/
 /* Print the whole table; provide the output file and func to print each item.
  * 
@@ -0,0 +1,199 @@
+/*
+ * mapfile.c - 'mapfile' module
+ *
+ * see mapfile.h for more information.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L   // fileno, mmap, posix_madvise
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#ifndef NOMMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#include "mapfile.h"
+#include "file.h"
+#include "mem.h"
+
+/**************** global types ****************/
+typedef struct mapfile {
+  const char* data;           // start of the region
+  size_t size;                // length of the region
+  bool mapped;                // mapped with mmap, or read into a buffer?
+} mapfile_t;
+
+/**************** local functions ****************/
+static bool mapfile_map(mapfile_t* map, FILE* fp);
+static bool mapfile_read(mapfile_t* map, FILE* fp);
+
+/**************** mapfile_open() ****************/
+/* see mapfile.h for description */
+mapfile_t*
+mapfile_open(const char* pathname)
+{
+  if (pathname == NULL) {
+    return NULL;
+  }
+
+  FILE* fp = fopen(pathname, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+
+  // the mapping outlives the file descriptor it came from
+  mapfile_t* map = mapfile_fromFile(fp);
+  fclose(fp);
+  return map;
+}
+
+/**************** mapfile_fromFile() ****************/
+/* see mapfile.h for description */
+mapfile_t*
+mapfile_fromFile(FILE* fp)
+{
+  if (fp == NULL) {
+    return NULL;
+  }
+
+  mapfile_t* map = mem_malloc(sizeof(mapfile_t));
+  if (map == NULL) {
+    return NULL;
+  }
+  map->data = "";
+  map->size = 0;
+  map->mapped = false;
+
+  if (!mapfile_map(map, fp) && !mapfile_read(map, fp)) {
+    mem_free(map);
+    return NULL;
+  }
+  return map;
+}
+
+/**************** mapfile_map ****************/
+/* Map the file underlying fp, if it is a regular file and we can.
+ * An empty file needs no mapping; we leave the region empty.
+ */
+static bool
+mapfile_map(mapfile_t* map, FILE* fp)
+{
+#ifdef NOMMAP
+  return false;
+#else
+  int fd = fileno(fp);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;             // a pipe, a terminal, ...: read it instead
+  }
+  if (st.st_size == 0) {
+    return true;              // mmap refuses a zero length
+  }
+
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  map->data = data;
+  map->size = st.st_size;
+  map->mapped = true;
+  return true;
+#endif
+}
+
+/**************** mapfile_read ****************/
+/* The fallback: read the file into a buffer, from its beginning if it
+ * can seek, leaving the file pointer where it was.
+ */
+static bool
+mapfile_read(mapfile_t* map, FILE* fp)
+{
+  long pos = ftell(fp);
+  if (pos >= 0) {
+    rewind(fp);
+  }
+
+  size_t size;
+  file_reader_t* reader = file_reader_new(fp);
+  char* rest = file_reader_rest(reader, &size);
+  char* buffer = (rest != NULL) ? file_reader_copy(rest, size) : NULL;
+  file_reader_delete(reader);
+
+  if (pos >= 0) {
+    fseek(fp, pos, SEEK_SET);
+  }
+  if (rest != NULL && buffer == NULL) {
+    return false;             // out of memory
+  }
+  if (buffer != NULL) {
+    map->data = buffer;
+    map->size = size;
+  }
+  return true;
+}
+
+/**************** mapfile_data() ****************/
+/* see mapfile.h for description */
+const char*
+mapfile_data(mapfile_t* map)
+{
+  return (map != NULL) ? map->data : NULL;
+}
+
+/**************** mapfile_size() ****************/
+/* see mapfile.h for description */
+size_t
+mapfile_size(mapfile_t* map)
+{
+  return (map != NULL) ? map->size : 0;
+}
+
+/**************** mapfile_isMapped() ****************/
+/* see mapfile.h for description */
+bool
+mapfile_isMapped(mapfile_t* map)
+{
+  return (map != NULL) && map->mapped;
+}
+
+/**************** mapfile_advise() ****************/
+/* see mapfile.h for description */
+void
+mapfile_advise(mapfile_t* map, const mapfile_advice_t advice)
+{
+#ifndef NOMMAP
+  if (map != NULL && map->mapped) {
+    int posixAdvice;
+    switch (advice) {
+    case MAPFILE_SEQUENTIAL: posixAdvice = POSIX_MADV_SEQUENTIAL; break;
+    case MAPFILE_RANDOM:     posixAdvice = POSIX_MADV_RANDOM;     break;
+    case MAPFILE_WILLNEED:   posixAdvice = POSIX_MADV_WILLNEED;   break;
+    case MAPFILE_DONTNEED:   posixAdvice = POSIX_MADV_DONTNEED;   break;
+    default:                 posixAdvice = POSIX_MADV_NORMAL;     break;
+    }
+    posix_madvise((void*) map->data, map->size, posixAdvice);
+  }
+#endif
+}
+
+/**************** mapfile_close() ****************/
+/* see mapfile.h for description */
+void
+mapfile_close(mapfile_t* map)
+{
+  if (map != NULL) {
+    if (map->mapped) {
+#ifndef NOMMAP
+      munmap((void*) map->data, map->size);
+#endif
+    } else if (map->size > 0) {
+      free((void*) map->data);    // from file_reader_copy
+    }
+    mem_free(map);
+  }
+}
@@ -0,0 +1,90 @@
+/*
+ * mapfile - read-only access to a whole file as one region of memory
+ *
+ * A mapfile maps a file into memory with mmap, so reading it costs no
+ * system calls per token, and processes reading the same file share its
+ * pages in the page cache.  Where a file cannot be mapped - a pipe, a
+ * system without mmap, or a build with -DNOMMAP - the file is read into
+ * a heap buffer instead; callers see the same region either way.
+ *
+ * Iterate over the region with a reader from file.h:
+ *   mapfile_t* map = mapfile_open(path);
+ *   file_reader_t* reader = file_reader_newMem(mapfile_data(map),
+ *                                              mapfile_size(map));
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#ifndef __MAPFILE_H
+#define __MAPFILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**************** global types ****************/
+typedef struct mapfile mapfile_t;  // opaque to users of the module
+
+// how the caller expects to read the region; see mapfile_advise.
+typedef enum {
+  MAPFILE_NORMAL,             // no particular pattern
+  MAPFILE_SEQUENTIAL,         // front to back, once: read ahead aggressively
+  MAPFILE_RANDOM,             // here and there: do not read ahead
+  MAPFILE_WILLNEED,           // soon, all of it: start reading it in now
+  MAPFILE_DONTNEED,           // not again soon: pages may be dropped
+} mapfile_advice_t;
+
+/**************** functions ****************/
+
+/**************** mapfile_open ****************/
+/* Map the named file, read-only, in its entirety.
+ * Caller provides:
+ *   pathname of a readable file.
+ * We return:
+ *   pointer to a new mapfile, or NULL if the file cannot be opened or read.
+ * Caller is responsible for:
+ *   later calling mapfile_close.
+ * Notes:
+ *   an empty file maps to an empty region.
+ */
+mapfile_t* mapfile_open(const char* pathname);
+
+/**************** mapfile_fromFile ****************/
+/* Like mapfile_open, for a file already open; the file pointer is left
+ * where it was, and the caller still owns - and must close - the FILE.
+ * The region holds the whole file, from its beginning.
+ */
+mapfile_t* mapfile_fromFile(FILE* fp);
+
+/**************** mapfile_data ****************/
+/* Return the start of the region, or NULL if map is NULL.
+ * The region is read-only, and is NOT null-terminated.
+ */
+const char* mapfile_data(mapfile_t* map);
+
+/**************** mapfile_size ****************/
+/* Return the length of the region in bytes; 0 if map is NULL.
+ */
+size_t mapfile_size(mapfile_t* map);
+
+/**************** mapfile_isMapped ****************/
+/* Return true if the region is mapped, false if we fell back to reading
+ * the file into a buffer (or map is NULL).
+ */
+bool mapfile_isMapped(mapfile_t* map);
+
+/**************** mapfile_advise ****************/
+/* Tell the system how the region will be read, so it can read ahead (or
+ * not) to suit.  Advice is only a hint; we ignore it for a buffer, and
+ * ignore any error.
+ */
+void mapfile_advise(mapfile_t* map, const mapfile_advice_t advice);
+
+/**************** mapfile_close ****************/
+/* Unmap the region (or free the buffer) and delete the mapfile.
+ * Pointers into the region are invalid from now on.
+ * We ignore a NULL map.
+ */
+void mapfile_close(mapfile_t* map);
+
+#endif // __MAPFILE_H
@@ -8,18 +8,146 @@
  * 2. Variants that 'assert' the result is non-NULL;
  *    if NULL occurs, kick out an error and die.
  *
+ * 3. Arenas and pools; see mem.h.
+ *
  * David Kotz, April 2016, 2017, 2019, 2021
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#ifdef __GLIBC__
+#include <malloc.h>             // malloc_usable_size
+#endif
 #include "mem.h"
 
+/**************** file-local constants ****************/
+#define POOL_MAGAZINE 32      // objects in a thread's cache for one pool
+#define POOL_CACHES 4         // pools a thread caches at once
+#define MEM_SHARDS 64         // sets of counters; one per thread, at first
+#define MEM_TAGS 16           // allocation tags, including 'untagged'
+
+/**************** local types ****************/
+// one block of an arena; allocations are carved from data[] in order.
+typedef struct arenablock {
+  struct arenablock* next;    // next block in the arena's list
+  size_t size;                // bytes available in data[]
+  size_t used;                // bytes of data[] handed out so far
+  max_align_t data[];         // the space itself, aligned for any type
+} arenablock_t;
+
+// one chunk of a pool; its header fills the first cache line, and objects
+// are carved from the lines after it.
+typedef struct poolchunk {
+  struct poolchunk* next;     // next chunk in the pool's list
+  size_t size;                // bytes in this chunk, header included
+} poolchunk_t;
+
+// a free pool object, threaded onto the free list through its first word.
+typedef struct poolobj {
+  struct poolobj* next;       // next free object
+} poolobj_t;
+
+// a thread's cache of free objects from one shared pool.
+typedef struct poolcache {
+  unsigned long id;           // id of the pool they came from; 0 for none
+  struct mem_pool* pool;      // that pool, to give them back to
+  int count;                  // number of objects in objs[]
+  void* objs[POOL_MAGAZINE];  // the objects themselves
+} poolcache_t;
+
+// one thread's allocation counters, per tag; a cache line apart from
+// the next thread's, so threads never contend for a line.
+typedef struct memshard {
+  _Alignas(64) atomic_long nfreenull;   // number of free(NULL) calls
+  atomic_long nmalloc[MEM_TAGS];        // number of successful malloc calls
+  atomic_long nfree[MEM_TAGS];          // number of free calls
+  atomic_long bytes[MEM_TAGS];          // net bytes allocated
+} memshard_t;
+
+// the counters of all shards, summed.
+typedef struct memtotals {
+  long nfreenull;
+  long nmalloc[MEM_TAGS];
+  long nfree[MEM_TAGS];
+  long bytes[MEM_TAGS];
+} memtotals_t;
+
+/**************** global types ****************/
+typedef struct mem_arena {
+  size_t blocksize;           // size of each regular block
+  arenablock_t* head;         // regular blocks, in order of first use
+  arenablock_t* current;      // block now being carved
+  arenablock_t* large;        // blocks for requests bigger than blocksize
+  // statistics
+  long nalloc;                // calls to mem_arena_alloc since creation
+  long nbytes;                // bytes requested since creation
+  long nreset;                // calls to mem_arena_reset
+  long nblocks;               // blocks now held
+  long reserved;              // bytes now held in blocks
+} mem_arena_t;
+
+typedef struct mem_pool {
+  size_t objsize;             // size of each object, rounded up
+  poolchunk_t* chunks;        // every chunk, newest first
+  char* bump;                 // next never-used object in the newest chunk
+  char* end;                  // end of the newest chunk
+  poolobj_t* free;            // objects given back, for reuse
+  size_t chunksize;           // size of the next chunk
+  bool shared;                // may several threads use it at once?
+  unsigned long id;           // names this pool in the threads' caches
+  pthread_mutex_t lock;       // held for any change, if shared
+  // statistics
+  long nalloc;                // objects handed out (to a thread's cache, if shared)
+  long nfree;                 // objects given back
+  long nchunks;               // chunks now held
+  long reserved;              // bytes now held in chunks
+} mem_pool_t;
+
 /**************** file-local global variables ****************/
 // track malloc and free across *all* calls within this program.
-static int nmalloc = 0;         // number of successful malloc calls
-static int nfree = 0;           // number of free calls
-static int nfreenull = 0;       // number of free(NULL) calls
+// Each thread to allocate gets one of the first MEM_SHARDS-1 shards to
+// itself, and updates it without atomic read-modify-write, until it
+// exits and gives the shard back for the next thread; any threads beyond
+// MEM_SHARDS-1 alive at once share the last shard, and pay for the atomics.
+static memshard_t memshards[MEM_SHARDS];
+static int nshards = 0;                         // shards handed out so far
+static int freeshards[MEM_SHARDS - 1];          // those given back since
+static int nfreeshards = 0;
+static pthread_mutex_t shardlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t shardonce = PTHREAD_ONCE_INIT;
+static pthread_key_t shardkey;                  // gives a shard back at exit
+static bool shardkeyMade = false;
+static _Thread_local memshard_t* myshard = NULL;
+static _Thread_local bool myshardShared = false;
+static _Thread_local long myshardBase = 0;      // bytes it held when we took it
+
+// tag names; 0 is 'untagged', and the library tags its own blocks.
+static const char* tagnames[MEM_TAGS] = { "untagged", "arena", "pool" };
+static int ntags = 3;
+static pthread_mutex_t taglock = PTHREAD_MUTEX_INITIALIZER;
+static const int TAG_ARENA = 1;
+static const int TAG_POOL = 2;
+
+static const size_t ARENA_BLOCKSIZE = 64 * 1024;   // default block size
+
+static const size_t POOL_LINE = 64;              // cache line size
+static const size_t POOL_FIRSTCHUNK = 512;       // size of a pool's first chunk
+static const size_t POOL_MAXCHUNK = 64 * 1024;   // chunks stop doubling here
+static atomic_ulong poolids = 0;                 // last pool id handed out
+
+// each thread caches objects for a few shared pools, by pool id.
+static _Thread_local poolcache_t poolcaches[POOL_CACHES];
+
+// the shared pools not yet deleted, so a cache that another pool takes
+// over can give its objects back to theirs, if it is still there.
+static mem_pool_t** livepools = NULL;
+static int nlivepools = 0;
+static int livepoolsSize = 0;
+static pthread_mutex_t livelock = PTHREAD_MUTEX_INITIALIZER;
 
 
 /**************** mem_assert ****************/
@@ -46,6 +174,16 @@ mem_assert_const(const void* ptr, const char* message)
   return ptr;
 }
 
+/**************** local functions ****************/
+static memshard_t* shard(void);
+static void shardKey(void);
+static void shardExit(void* arg);
+static void count(atomic_long* counter, const long delta);
+static void countAlloc(void* ptr, const int tag);
+static void countFree(void* ptr, const int tag);
+static long sizeOf(void* ptr);
+static void totals(memtotals_t* t);
+
 /**************** mem_malloc_assert() ****************/
 /* see mem.h for description */
 void*
@@ -56,7 +194,7 @@ mem_malloc_assert(const size_t size, const char* message)
     fprintf(stderr, "Out of memory: %s\n", message);
     exit (99);
   }
-  nmalloc++;
+  countAlloc(ptr, 0);
   return ptr;
 }
 
@@ -65,10 +203,18 @@ mem_malloc_assert(const size_t size, const char* message)
 /* see mem.h for description */
 void*
 mem_malloc(const size_t size)
+{
+  return mem_malloc_tagged(size, 0);
+}
+
+/**************** mem_malloc_tagged() ****************/
+/* see mem.h for description */
+void*
+mem_malloc_tagged(const size_t size, const int tag)
 {
   void* ptr = malloc(size);
   if (ptr != NULL) {
-    nmalloc++;
+    countAlloc(ptr, tag);
   }
   return ptr;
 }
@@ -79,7 +225,7 @@ void*
 mem_calloc_assert(const size_t nmemb, const size_t size, const char* message)
 {
   void* ptr = mem_assert(calloc(nmemb, size), message);
-  nmalloc++;
+  countAlloc(ptr, 0);
   return ptr;
 }
 
@@ -87,10 +233,18 @@ mem_calloc_assert(const size_t nmemb, const size_t size, const char* message)
 /* see mem.h for description */
 void*
 mem_calloc(const size_t nmemb, const size_t size)
+{
+  return mem_calloc_tagged(nmemb, size, 0);
+}
+
+/**************** mem_calloc_tagged() ****************/
+/* see mem.h for description */
+void*
+mem_calloc_tagged(const size_t nmemb, const size_t size, const int tag)
 {
   void* ptr = calloc(nmemb, size);
   if (ptr != NULL) {
-    nmalloc++;
+    countAlloc(ptr, tag);
   }
   return ptr;
 }
@@ -99,13 +253,21 @@ mem_calloc(const size_t nmemb, const size_t size)
 /* see mem.h for description */
 void 
 mem_free(void* ptr)
+{
+  mem_free_tagged(ptr, 0);
+}
+
+/**************** mem_free_tagged() ****************/
+/* see mem.h for description */
+void
+mem_free_tagged(void* ptr, const int tag)
 {
   if (ptr != NULL) {
+    countFree(ptr, tag);
     free(ptr);
-    nfree++;
   } else {
     // it's an error to call free(NULL)!
-    nfreenull++;
+    count(&shard()->nfreenull, 1);
   }
 }
 
@@ -114,8 +276,27 @@ mem_free(void* ptr)
 void 
 mem_report(FILE* fp, const char* message)
 {
-  fprintf(fp, "%s: %d malloc, %d free, %d free(NULL), %d net\n", 
-          message, nmalloc, nfree, nfreenull, nmalloc - nfree - nfreenull);
+  memtotals_t t;
+  totals(&t);
+  long nmalloc = 0, nfree = 0, bytes = 0;
+  for (int tag = 0; tag < MEM_TAGS; tag++) {
+    nmalloc += t.nmalloc[tag];
+    nfree += t.nfree[tag];
+    bytes += t.bytes[tag];
+  }
+
+  fprintf(fp, "%s: %ld malloc, %ld free, %ld free(NULL), %ld net, "
+          "%ld bytes\n", message, nmalloc, nfree, t.nfreenull,
+          nmalloc - nfree - t.nfreenull, bytes);
+
+  pthread_mutex_lock(&taglock);
+  for (int tag = 0; tag < ntags; tag++) {
+    if (t.nmalloc[tag] > 0) {
+      fprintf(fp, "  %s: %ld malloc, %ld free, %ld bytes\n", tagnames[tag],
+              t.nmalloc[tag], t.nfree[tag], t.bytes[tag]);
+    }
+  }
+  pthread_mutex_unlock(&taglock);
 }
 
 /**************** mem_net() ****************/
@@ -123,5 +304,680 @@ mem_report(FILE* fp, const char* message)
 int
 mem_net(void)
 {
-  return nmalloc - nfree - nfreenull;
+  memtotals_t t;
+  totals(&t);
+  long net = -t.nfreenull;
+  for (int tag = 0; tag < MEM_TAGS; tag++) {
+    net += t.nmalloc[tag] - t.nfree[tag];
+  }
+  return (int) net;
+}
+
+/**************** mem_bytes() ****************/
+/* see mem.h for description */
+long
+mem_bytes(void)
+{
+  memtotals_t t;
+  totals(&t);
+  long bytes = 0;
+  for (int tag = 0; tag < MEM_TAGS; tag++) {
+    bytes += t.bytes[tag];
+  }
+  return bytes;
+}
+
+/**************** mem_threadBytes() ****************/
+/* see mem.h for description */
+long
+mem_threadBytes(void)
+{
+  memshard_t* my = shard();
+  long bytes = 0;
+  for (int tag = 0; tag < MEM_TAGS; tag++) {
+    bytes += atomic_load_explicit(&my->bytes[tag], memory_order_relaxed);
+  }
+  return bytes - myshardBase;
+}
+
+/**************** mem_tag() ****************/
+/* see mem.h for description */
+int
+mem_tag(const char* name)
+{
+  if (name == NULL) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&taglock);
+  int tag;
+  for (tag = 0; tag < ntags; tag++) {
+    if (strcmp(tagnames[tag], name) == 0) {
+      break;
+    }
+  }
+  if (tag == ntags) {
+    if (ntags < MEM_TAGS) {
+      tagnames[ntags++] = name;
+    } else {
+      tag = 0;                // table full; count it as untagged
+    }
+  }
+  pthread_mutex_unlock(&taglock);
+  return tag;
+}
+
+/**************** shard ****************/
+/* Return this thread's counters, choosing them on first use:
+ * a shard some thread gave back as it exited, or one never used,
+ * or, failing both, the last one, shared.
+ */
+static memshard_t*
+shard(void)
+{
+  if (myshard == NULL) {
+    pthread_once(&shardonce, shardKey);
+    pthread_mutex_lock(&shardlock);
+    int n = (nfreeshards > 0) ? freeshards[--nfreeshards]
+          : (nshards < MEM_SHARDS - 1) ? nshards++ : MEM_SHARDS - 1;
+    pthread_mutex_unlock(&shardlock);
+
+    myshard = &memshards[n];
+    myshardShared = (n == MEM_SHARDS - 1);
+    myshardBase = 0;
+    for (int tag = 0; tag < MEM_TAGS; tag++) {
+      myshardBase += atomic_load_explicit(&myshard->bytes[tag],
+                                          memory_order_relaxed);
+    }
+    if (!myshardShared && shardkeyMade) {
+      pthread_setspecific(shardkey, myshard);
+    }
+  }
+  return myshard;
+}
+
+/**************** shardKey ****************/
+/* Make the key whose destructor gives each thread's shard back;
+ * without it, shards are never given back.
+ */
+static void
+shardKey(void)
+{
+  shardkeyMade = (pthread_key_create(&shardkey, shardExit) == 0);
+}
+
+/**************** shardExit ****************/
+/* As a thread exits, give its shard back for the next thread to take.
+ * Anything it frees later still counts, in the shared last shard.
+ */
+static void
+shardExit(void* arg)
+{
+  memshard_t* sh = arg;
+  myshard = &memshards[MEM_SHARDS - 1];
+  myshardShared = true;
+  pthread_mutex_lock(&shardlock);
+  freeshards[nfreeshards++] = (int) (sh - memshards);
+  pthread_mutex_unlock(&shardlock);
+}
+
+/**************** count ****************/
+/* Add delta to one of this thread's counters.  Only this thread writes
+ * an unshared shard, so a relaxed load and store suffice; readers summing
+ * the shards see each counter whole, if perhaps a moment stale.
+ */
+static void
+count(atomic_long* counter, const long delta)
+{
+  if (myshardShared) {
+    atomic_fetch_add_explicit(counter, delta, memory_order_relaxed);
+  } else {
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed)
+                          + delta, memory_order_relaxed);
+  }
+}
+
+/**************** countAlloc, countFree ****************/
+/* Count one allocation or free of ptr, and its bytes, against tag.
+ */
+static void
+countAlloc(void* ptr, const int tag)
+{
+  memshard_t* my = shard();
+  int t = (tag > 0 && tag < MEM_TAGS) ? tag : 0;
+  count(my->nmalloc + t, 1);
+  count(my->bytes + t, sizeOf(ptr));
+}
+
+static void
+countFree(void* ptr, const int tag)
+{
+  memshard_t* my = shard();
+  int t = (tag > 0 && tag < MEM_TAGS) ? tag : 0;
+  count(my->nfree + t, 1);
+  count(my->bytes + t, -sizeOf(ptr));
+}
+
+/**************** sizeOf ****************/
+/* The bytes malloc set aside for ptr, where the C library can tell us.
+ */
+static long
+sizeOf(void* ptr)
+{
+#ifdef __GLIBC__
+  return (long) malloc_usable_size(ptr);
+#else
+  return 0;
+#endif
+}
+
+/**************** totals ****************/
+/* Sum the counters of every shard into t.
+ */
+static void
+totals(memtotals_t* t)
+{
+  memset(t, 0, sizeof(memtotals_t));
+  for (int i = 0; i < MEM_SHARDS; i++) {
+    memshard_t* sh = &memshards[i];
+    t->nfreenull += atomic_load_explicit(&sh->nfreenull, memory_order_relaxed);
+    for (int tag = 0; tag < MEM_TAGS; tag++) {
+      t->nmalloc[tag] += atomic_load_explicit(&sh->nmalloc[tag],
+                                              memory_order_relaxed);
+      t->nfree[tag] += atomic_load_explicit(&sh->nfree[tag],
+                                            memory_order_relaxed);
+      t->bytes[tag] += atomic_load_explicit(&sh->bytes[tag],
+                                            memory_order_relaxed);
+    }
+  }
+}
+
+/**************** mem_arena_new() ****************/
+/* see mem.h for description */
+mem_arena_t*
+mem_arena_new(const size_t blocksize)
+{
+  mem_arena_t* arena = mem_malloc(sizeof(mem_arena_t));
+  if (arena == NULL) {
+    return NULL;
+  }
+
+  arena->blocksize = (blocksize > 0) ? blocksize : ARENA_BLOCKSIZE;
+  arena->head = NULL;
+  arena->current = NULL;
+  arena->large = NULL;
+  arena->nalloc = 0;
+  arena->nbytes = 0;
+  arena->nreset = 0;
+  arena->nblocks = 0;
+  arena->reserved = 0;
+  return arena;
+}
+
+/**************** arenablock_new ****************/
+/* Allocate a block with room for size bytes of data. */
+static arenablock_t*
+arenablock_new(mem_arena_t* arena, const size_t size)
+{
+  arenablock_t* block = mem_malloc_tagged(sizeof(arenablock_t) + size,
+                                            TAG_ARENA);
+  if (block != NULL) {
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    arena->nblocks++;
+    arena->reserved += size;
+  }
+  return block;
+}
+
+/**************** mem_arena_alloc() ****************/
+/* see mem.h for description */
+void*
+mem_arena_alloc(mem_arena_t* arena, const size_t size)
+{
+  if (arena == NULL) {
+    return NULL;
+  }
+
+  // round up, so the next allocation stays aligned for any type
+  const size_t align = sizeof(max_align_t);
+  size_t need = (size + align - 1) / align * align;
+  if (need == 0) {
+    need = align;
+  }
+  arena->nalloc++;
+  arena->nbytes += size;
+
+  // an oversized request gets a block of its own
+  if (need > arena->blocksize) {
+    arenablock_t* block = arenablock_new(arena, need);
+    if (block == NULL) {
+      return NULL;
+    }
+    block->used = need;
+    block->next = arena->large;
+    arena->large = block;
+    return block->data;
+  }
+
+  // move on to the next block (kept from before a reset, or new) if need be
+  arenablock_t* block = arena->current;
+  if (block == NULL || block->size - block->used < need) {
+    if (block != NULL && block->next != NULL) {
+      block = block->next;
+    } else if (block == NULL && arena->head != NULL) {
+      block = arena->head;
+    } else {
+      arenablock_t* new = arenablock_new(arena, arena->blocksize);
+      if (new == NULL) {
+        return NULL;
+      }
+      if (block == NULL) {
+        arena->head = new;
+      } else {
+        block->next = new;
+      }
+      block = new;
+    }
+    arena->current = block;
+  }
+
+  void* ptr = (char*) block->data + block->used;
+  block->used += need;
+  return ptr;
+}
+
+/**************** mem_arena_strdup() ****************/
+/* see mem.h for description */
+char*
+mem_arena_strdup(mem_arena_t* arena, const char* str)
+{
+  if (str == NULL) {
+    return NULL;
+  }
+
+  size_t len = strlen(str) + 1;
+  char* copy = mem_arena_alloc(arena, len);
+  if (copy != NULL) {
+    memcpy(copy, str, len);
+  }
+  return copy;
+}
+
+/**************** mem_arena_reset() ****************/
+/* see mem.h for description */
+void
+mem_arena_reset(mem_arena_t* arena)
+{
+  if (arena != NULL) {
+    // keep the regular blocks, emptied, for reuse
+    for (arenablock_t* block = arena->head; block != NULL; block = block->next) {
+      block->used = 0;
+    }
+    arena->current = arena->head;
+
+    // but give the oversized ones back
+    for (arenablock_t* block = arena->large; block != NULL; ) {
+      arenablock_t* next = block->next;
+      arena->nblocks--;
+      arena->reserved -= block->size;
+      mem_free_tagged(block, TAG_ARENA);
+      block = next;
+    }
+    arena->large = NULL;
+    arena->nreset++;
+  }
+}
+
+/**************** mem_arena_delete() ****************/
+/* see mem.h for description */
+void
+mem_arena_delete(mem_arena_t* arena)
+{
+  if (arena != NULL) {
+    mem_arena_reset(arena);
+    for (arenablock_t* block = arena->head; block != NULL; ) {
+      arenablock_t* next = block->next;
+      mem_free_tagged(block, TAG_ARENA);
+      block = next;
+    }
+    mem_free(arena);
+  }
+}
+
+/**************** mem_arena_report() ****************/
+/* see mem.h for description */
+void
+mem_arena_report(mem_arena_t* arena, FILE* fp, const char* message)
+{
+  if (arena == NULL) {
+    fprintf(fp, "%s: (null arena)\n", message);
+  } else {
+    fprintf(fp, "%s: %ld alloc, %ld bytes requested, %ld reset, "
+            "%ld blocks holding %ld bytes\n", message,
+            arena->nalloc, arena->nbytes, arena->nreset,
+            arena->nblocks, arena->reserved);
+  }
+}
+
+/**************** local functions ****************/
+static size_t pool_objsize(const size_t size);
+static bool pool_grow(mem_pool_t* pool);
+static void* pool_take(mem_pool_t* pool);
+static void pool_give(mem_pool_t* pool, void* ptr);
+static bool pool_live(mem_pool_t* pool);
+static void pool_dead(mem_pool_t* pool);
+static void cache_takeover(poolcache_t* cache, mem_pool_t* pool);
+
+/**************** mem_pool_new() ****************/
+/* see mem.h for description */
+mem_pool_t*
+mem_pool_new(const size_t size, const bool shared)
+{
+  if (size == 0) {
+    return NULL;
+  }
+
+  mem_pool_t* pool = mem_malloc(sizeof(mem_pool_t));
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  pool->objsize = pool_objsize(size);
+  pool->chunks = NULL;
+  pool->bump = NULL;
+  pool->end = NULL;
+  pool->free = NULL;
+  // room for the header and at least four objects, in whole cache lines
+  pool->chunksize = POOL_FIRSTCHUNK;
+  while (pool->chunksize < POOL_LINE + 4 * pool->objsize) {
+    pool->chunksize *= 2;
+  }
+  pool->shared = shared;
+  pool->id = atomic_fetch_add(&poolids, 1) + 1;
+  if (shared && pthread_mutex_init(&pool->lock, NULL) != 0) {
+    mem_free(pool);
+    return NULL;
+  }
+  pool->nalloc = 0;
+  pool->nfree = 0;
+  pool->nchunks = 0;
+  pool->reserved = 0;
+  if (shared && !pool_live(pool)) {
+    pthread_mutex_destroy(&pool->lock);
+    mem_free(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+/**************** pool_objsize ****************/
+/* Round an object size up so objects pack cache lines evenly:
+ * small objects to a power of two no smaller than max_align_t's alignment,
+ * so none straddles a line; bigger ones to whole lines.
+ */
+static size_t
+pool_objsize(const size_t size)
+{
+  if (size > POOL_LINE) {
+    return (size + POOL_LINE - 1) / POOL_LINE * POOL_LINE;
+  }
+
+  size_t objsize = _Alignof(max_align_t);
+  while (objsize < size || objsize < sizeof(poolobj_t)) {
+    objsize *= 2;
+  }
+  return objsize;
+}
+
+/**************** pool_grow ****************/
+/* Add a fresh chunk to the pool, and carve from it from now on.
+ * Chunks are cache-line aligned and double in size up to POOL_MAXCHUNK.
+ * They come from aligned_alloc, but count as mallocs for mem_net().
+ */
+static bool
+pool_grow(mem_pool_t* pool)
+{
+  poolchunk_t* chunk = aligned_alloc(POOL_LINE, pool->chunksize);
+  if (chunk == NULL) {
+    return false;
+  }
+  countAlloc(chunk, TAG_POOL);
+
+  chunk->size = pool->chunksize;
+  chunk->next = pool->chunks;
+  pool->chunks = chunk;
+  pool->bump = (char*) chunk + POOL_LINE;
+  pool->end = (char*) chunk + chunk->size;
+  pool->nchunks++;
+  pool->reserved += chunk->size;
+
+  if (pool->chunksize < POOL_MAXCHUNK) {
+    pool->chunksize *= 2;
+  }
+  return true;
+}
+
+/**************** pool_take ****************/
+/* Take one object: the most recently freed, else the next never-used one.
+ * Caller holds the lock, if the pool is shared.
+ */
+static void*
+pool_take(mem_pool_t* pool)
+{
+  void* ptr;
+  if (pool->free != NULL) {
+    ptr = pool->free;
+    pool->free = pool->free->next;
+  } else {
+    if (pool->bump == NULL || pool->bump + pool->objsize > pool->end) {
+      if (!pool_grow(pool)) {
+        return NULL;
+      }
+    }
+    ptr = pool->bump;
+    pool->bump += pool->objsize;
+  }
+  pool->nalloc++;
+  return ptr;
+}
+
+/**************** pool_give ****************/
+/* Put one object back on the free list.
+ * Caller holds the lock, if the pool is shared.
+ */
+static void
+pool_give(mem_pool_t* pool, void* ptr)
+{
+  poolobj_t* obj = ptr;
+  obj->next = pool->free;
+  pool->free = obj;
+  pool->nfree++;
+}
+
+/**************** pool_live ****************/
+/* Add a shared pool to the live ones; false if out of memory. */
+static bool
+pool_live(mem_pool_t* pool)
+{
+  bool ok = true;
+  pthread_mutex_lock(&livelock);
+  if (nlivepools == livepoolsSize) {
+    // bookkeeping of mem's own, so not counted by mem_net
+    int size = (livepoolsSize > 0) ? 2 * livepoolsSize : 16;
+    mem_pool_t** pools = realloc(livepools, size * sizeof(mem_pool_t*));
+    if (pools == NULL) {
+      ok = false;
+    } else {
+      livepools = pools;
+      livepoolsSize = size;
+    }
+  }
+  if (ok) {
+    livepools[nlivepools++] = pool;
+  }
+  pthread_mutex_unlock(&livelock);
+  return ok;
+}
+
+/**************** pool_dead ****************/
+/* Remove a shared pool from the live ones, before it is freed:
+ * once this returns, no cache will give objects back to it.
+ */
+static void
+pool_dead(mem_pool_t* pool)
+{
+  pthread_mutex_lock(&livelock);
+  for (int i = 0; i < nlivepools; i++) {
+    if (livepools[i] == pool) {
+      livepools[i] = livepools[--nlivepools];
+      break;
+    }
+  }
+  if (nlivepools == 0) {
+    free(livepools);
+    livepools = NULL;
+    livepoolsSize = 0;
+  }
+  pthread_mutex_unlock(&livelock);
+}
+
+/**************** cache_takeover ****************/
+/* Make this thread's cache pool's: first give the objects it holds back
+ * to the pool they came from, unless that pool has been deleted.
+ * Caller holds neither pool's lock; the live pools' lock is taken first.
+ */
+static void
+cache_takeover(poolcache_t* cache, mem_pool_t* pool)
+{
+  if (cache->count > 0) {
+    pthread_mutex_lock(&livelock);
+    for (int i = 0; i < nlivepools; i++) {
+      mem_pool_t* old = livepools[i];
+      // a pointer reused by a newer pool has another id
+      if (old == cache->pool && old->id == cache->id) {
+        pthread_mutex_lock(&old->lock);
+        while (cache->count > 0) {
+          pool_give(old, cache->objs[--cache->count]);
+        }
+        pthread_mutex_unlock(&old->lock);
+        break;
+      }
+    }
+    pthread_mutex_unlock(&livelock);
+  }
+  cache->id = pool->id;
+  cache->pool = pool;
+  cache->count = 0;
+}
+
+/**************** mem_pool_alloc() ****************/
+/* see mem.h for description */
+void*
+mem_pool_alloc(mem_pool_t* pool)
+{
+  if (pool == NULL) {
+    return NULL;
+  }
+  if (!pool->shared) {
+    return pool_take(pool);
+  }
+
+  // most of the time, this thread's cache has one for us, lock-free
+  poolcache_t* cache = &poolcaches[pool->id % POOL_CACHES];
+  if (cache->id == pool->id && cache->count > 0) {
+    return cache->objs[--cache->count];
+  }
+
+  // otherwise, refill the cache to half full from the pool
+  if (cache->id != pool->id) {
+    cache_takeover(cache, pool);
+  }
+  pthread_mutex_lock(&pool->lock);
+  while (cache->count < POOL_MAGAZINE / 2) {
+    void* ptr = pool_take(pool);
+    if (ptr == NULL) {
+      break;
+    }
+    cache->objs[cache->count++] = ptr;
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return (cache->count > 0) ? cache->objs[--cache->count] : NULL;
+}
+
+/**************** mem_pool_free() ****************/
+/* see mem.h for description */
+void
+mem_pool_free(mem_pool_t* pool, void* ptr)
+{
+  if (pool == NULL || ptr == NULL) {
+    return;
+  }
+  if (!pool->shared) {
+    pool_give(pool, ptr);
+    return;
+  }
+
+  poolcache_t* cache = &poolcaches[pool->id % POOL_CACHES];
+  if (cache->id == pool->id && cache->count < POOL_MAGAZINE) {
+    cache->objs[cache->count++] = ptr;
+    return;
+  }
+
+  // the cache is full, or not ours: give half back to the pool
+  if (cache->id != pool->id) {
+    cache_takeover(cache, pool);
+  }
+  pthread_mutex_lock(&pool->lock);
+  while (cache->count > POOL_MAGAZINE / 2) {
+    pool_give(pool, cache->objs[--cache->count]);
+  }
+  cache->objs[cache->count++] = ptr;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/**************** mem_pool_delete() ****************/
+/* see mem.h for description */
+void
+mem_pool_delete(mem_pool_t* pool)
+{
+  if (pool != NULL) {
+    if (pool->shared) {
+      pool_dead(pool);
+    }
+    for (poolchunk_t* chunk = pool->chunks; chunk != NULL; ) {
+      poolchunk_t* next = chunk->next;
+      mem_free_tagged(chunk, TAG_POOL);
+      chunk = next;
+    }
+    if (pool->shared) {
+      // forget our own cache now; other threads forget theirs lazily
+      poolcache_t* cache = &poolcaches[pool->id % POOL_CACHES];
+      if (cache->id == pool->id) {
+        cache->id = 0;
+        cache->pool = NULL;
+        cache->count = 0;
+      }
+      pthread_mutex_destroy(&pool->lock);
+    }
+    mem_free(pool);
+  }
+}
+
+/**************** mem_pool_report() ****************/
+/* see mem.h for description */
+void
+mem_pool_report(mem_pool_t* pool, FILE* fp, const char* message)
+{
+  if (pool == NULL) {
+    fprintf(fp, "%s: (null pool)\n", message);
+  } else {
+    fprintf(fp, "%s: %lu-byte objects, %ld in use, "
+            "%ld chunks holding %ld bytes\n", message,
+            (unsigned long) pool->objsize, pool->nalloc - pool->nfree,
+            pool->nchunks, pool->reserved);
+  }
 }
@@ -2,8 +2,10 @@
  * memory - mem_malloc and related functions 
  * 
  * 1. Replacements for malloc(), calloc(), and free(),
- *    that count the number of calls to each,
+ *    that count the number of calls to each, and the bytes involved,
  *    so you can print reports about the current balance of memory.
+ *    Counts are kept per thread, without locks, and summed on demand;
+ *    allocations may carry a tag, so the report breaks bytes down by use.
  * 
  * 2. Variants that 'assert' the result is non-NULL;
  *    if NULL occurs, kick out an error and die.
@@ -14,6 +16,15 @@
  *    that needs to defensively check function parameters that
  *    "should never be NULL".
  *
+ * 4. Arenas (regions): many small allocations carved out of a few large
+ *    blocks, all released together by one call.  Useful for the many
+ *    tiny objects that share one lifetime - the words of an index,
+ *    the tokens of one query.
+ *
+ * 5. Pools (slabs): fixed-size objects - list nodes - carved out of
+ *    cache-line-aligned chunks and recycled through a free list, so
+ *    insert/delete churn does not go through malloc at all.
+ *
  * David Kotz, April 2016, 2017, 2019, 2021
  */
 
@@ -22,6 +33,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 /**************** mem_assert **************************/
 /* If pointer p is NULL, print error message to stderr and die,
@@ -98,7 +110,8 @@ void mem_free(void* ptr);
  * We assume:
  *   caller provides a FILE open for writing, and message suitable for printf.
  * We format and print a report to that FILE, indicating the number of calls
- * to mem_malloc/calloc and of calls to mem_free, and the net difference.
+ * to mem_malloc/calloc and of calls to mem_free, the net difference, and
+ * the net bytes; then a line for each tag that has seen any allocation.
  */
 void mem_report(FILE* fp, const char* message);
 
@@ -113,4 +126,178 @@ void mem_report(FILE* fp, const char* message);
  */
 int mem_net(void);
 
+/**************** mem_bytes() ****************/
+/* Return the net bytes now allocated through mem_malloc/calloc, as
+ * malloc_usable_size() counts them (0 where the C library lacks it).
+ */
+long mem_bytes(void);
+
+/**************** mem_threadBytes() ****************/
+/* Return the net bytes the calling thread has allocated through
+ * mem_malloc/calloc: what it allocated, less what it freed.
+ * Notes:
+ *   a thread that frees another's memory counts the bytes against
+ *   itself; threads beyond 63 alive at once share a single count.
+ */
+long mem_threadBytes(void);
+
+/**************** mem_tag() ****************/
+/* Return the tag of the given name, creating it if need be.
+ * Caller provides:
+ *   a name that lives as long as the program - a string literal is ideal.
+ * We return:
+ *   a small positive integer to pass to mem_malloc_tagged and friends;
+ *   0, meaning 'untagged', if name is NULL or the table of tags is full.
+ * Notes:
+ *   look a tag up once and keep it; each call takes a lock.
+ */
+int mem_tag(const char* name);
+
+/**************** mem_malloc_tagged() ****************/
+/* Like mem_malloc, but count the allocation against the given tag.
+ */
+void* mem_malloc_tagged(const size_t size, const int tag);
+
+/**************** mem_calloc_tagged() ****************/
+/* Like mem_calloc, but count the allocation against the given tag.
+ */
+void* mem_calloc_tagged(const size_t nmemb, const size_t size, const int tag);
+
+/**************** mem_free_tagged() ****************/
+/* Like mem_free, for space from mem_malloc_tagged or mem_calloc_tagged.
+ * We assume:
+ *   caller provides the same tag the space was allocated with.
+ */
+void mem_free_tagged(void* ptr, const int tag);
+
+/**************** global types ****************/
+typedef struct mem_arena mem_arena_t;  // opaque to users of the module
+
+/**************** mem_arena_new() ****************/
+/* Create a new, empty arena.
+ * Caller provides:
+ *   the size of each block the arena carves allocations from;
+ *   0 means a default of 64 KiB.
+ * We return:
+ *   pointer to the new arena, or NULL if out of memory.
+ * Caller is responsible for:
+ *   later calling mem_arena_delete.
+ * Notes:
+ *   an arena is not thread-safe; give each thread its own.
+ *   blocks are obtained with mem_malloc, so they show up in mem_report,
+ *   under the tag "arena".
+ */
+mem_arena_t* mem_arena_new(const size_t blocksize);
+
+/**************** mem_arena_alloc() ****************/
+/* Like malloc(), but carve the space out of the arena.
+ * Caller provides:
+ *   valid arena pointer, and the size of desired allocation.
+ * We return:
+ *   pointer to uninitialized space, aligned for any type;
+ *   NULL if arena is NULL or out of memory.
+ * Caller is responsible for:
+ *   never calling free() or mem_free() on the result; the space is
+ *   released by mem_arena_reset or mem_arena_delete.
+ */
+void* mem_arena_alloc(mem_arena_t* arena, const size_t size);
+
+/**************** mem_arena_strdup() ****************/
+/* Copy a string into the arena.
+ * We return:
+ *   pointer to the copy, or NULL if arena or str is NULL, or out of memory.
+ */
+char* mem_arena_strdup(mem_arena_t* arena, const char* str);
+
+/**************** mem_arena_reset() ****************/
+/* Release everything allocated from the arena, in one step,
+ * but keep its blocks for reuse by later allocations.
+ * We do:
+ *   ignore a NULL arena.
+ * Notes:
+ *   every pointer obtained from the arena becomes invalid.
+ */
+void mem_arena_reset(mem_arena_t* arena);
+
+/**************** mem_arena_delete() ****************/
+/* Release everything allocated from the arena, and the arena itself.
+ * We do:
+ *   ignore a NULL arena.
+ */
+void mem_arena_delete(mem_arena_t* arena);
+
+/**************** mem_arena_report() ****************/
+/* Print statistics about the arena.
+ * We assume:
+ *   caller provides a FILE open for writing, and message suitable for printf.
+ * We print:
+ *   the number of allocations and bytes requested since the arena was
+ *   created, the number of resets, and the blocks and bytes it now holds.
+ */
+void mem_arena_report(mem_arena_t* arena, FILE* fp, const char* message);
+
+/**************** global types ****************/
+typedef struct mem_pool mem_pool_t;    // opaque to users of the module
+
+/**************** mem_pool_new() ****************/
+/* Create a new, empty pool of objects of one size.
+ * Caller provides:
+ *   the size of each object (> 0);
+ *   whether the pool is shared: a shared pool may be used by several
+ *   threads at once, and gives each thread a small cache of free objects
+ *   so most calls take no lock; an unshared pool takes no locks at all
+ *   and must be used by one thread at a time.
+ * We return:
+ *   pointer to the new pool, or NULL if out of memory.
+ * Caller is responsible for:
+ *   later calling mem_pool_delete.
+ * Notes:
+ *   objects are rounded up so that none straddles a cache line needlessly;
+ *   chunks start small and double, so a pool of a few objects stays small.
+ */
+mem_pool_t* mem_pool_new(const size_t size, const bool shared);
+
+/**************** mem_pool_alloc() ****************/
+/* Like malloc(size), for the pool's size, but from the pool.
+ * We return:
+ *   pointer to uninitialized space, aligned for any type;
+ *   NULL if pool is NULL or out of memory.
+ * Notes:
+ *   mem_net() counts the pool's chunks, not the objects in them;
+ *   mem_report shows the chunks under the tag "pool".
+ */
+void* mem_pool_alloc(mem_pool_t* pool);
+
+/**************** mem_pool_free() ****************/
+/* Like free(), but return the object to the pool for reuse.
+ * We assume:
+ *   caller provides an object from mem_pool_alloc on this same pool.
+ * We do:
+ *   ignore NULL pool or ptr.
+ */
+void mem_pool_free(mem_pool_t* pool, void* ptr);
+
+/**************** mem_pool_delete() ****************/
+/* Release the pool's chunks - every object from the pool, whether freed
+ * or not - and the pool itself.
+ * We do:
+ *   ignore a NULL pool.
+ * Notes:
+ *   a thread's cache may still hold objects from a deleted shared pool;
+ *   they are dropped, never touched, the next time that thread uses a pool.
+ */
+void mem_pool_delete(mem_pool_t* pool);
+
+/**************** mem_pool_report() ****************/
+/* Print statistics about the pool.
+ * We assume:
+ *   caller provides a FILE open for writing, and message suitable for printf.
+ * We print:
+ *   the object size, the objects now in use, and the chunks and bytes the
+ *   pool holds; for a shared pool, objects cached by threads count as in use.
+ *   A thread caches a few shared pools' objects at once; one that takes
+ *   another pool's place in its cache gives that pool's objects back first.
+ */
+void mem_pool_report(mem_pool_t* pool, FILE* fp, const char* message);
+
 #endif // __MEM_H
@@ -0,0 +1,470 @@
+/*
+ * memtest - behaviour test for arenas, pools, and mem's accounting
+ *
+ * usage:
+ *   memtest [nObjects]
+ *
+ * arena: carves nObjects allocations of random sizes, some bigger than a
+ *   block, from an arena; each must be aligned for any type and must not
+ *   overlap another. Then resets it and carves them again: the regular
+ *   blocks must be reused, not added to, and the oversized ones given back.
+ * pool: takes nObjects objects from a private pool, frees every other
+ *   one and takes as many again; freed objects must be reused, and no two
+ *   live objects may overlap. Then threads share a pool, each stamping its
+ *   objects and checking that no other thread wrote over them.
+ * pool caches: more shared pools than a thread caches take turns, so
+ *   they keep taking each other's place in its cache; none may count
+ *   more than a cache's worth of objects in use for it. Then another
+ *   thread deletes half of them while the cache still holds their
+ *   objects, and the rest take turns again.
+ * tags: counts tagged allocations, arena blocks and pool chunks under
+ *   their tags in mem_report, and each thread's net bytes in
+ *   mem_threadBytes, through rounds of threads that come and go.
+ *
+ * `make memtest` builds it with -fsanitize=address,undefined, so a write
+ * past an object shows up as a report.
+ * Prints PASS or FAIL lines; exits non-zero on any failure.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "mem.h"
+
+/**************** file-local global types ****************/
+/* one allocation, to check for overlaps */
+typedef struct span {
+  char* start;
+  size_t size;
+} span_t;
+
+/* one thread sharing a pool, or counting its bytes */
+typedef struct worker {
+  pthread_t thread;
+  int id;
+  mem_pool_t* pool;
+} worker_t;
+
+/**************** file-local global variables ****************/
+static int nObjects = 20000;
+static const size_t BLOCKSIZE = 4096;
+static const int nThreads = 4;
+static atomic_bool failed;
+
+/**************** local functions ****************/
+static bool testArena(void);
+static bool testPool(void);
+static void* poolWorker(void* arg);
+static bool testPoolCaches(void);
+static void poolRound(mem_pool_t* pool);
+static void* poolDeleter(void* arg);
+static long poolInUse(mem_pool_t* pool);
+static bool testTags(void);
+static void* bytesWorker(void* arg);
+static bool overlaps(span_t* spans, const int n);
+static int compareSpans(const void* a, const void* b);
+static bool tagLine(const char* name, long* nmalloc, long* nfree, long* bytes);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 2 || (argc > 1 && sscanf(argv[1], "%d", &nObjects) != 1)
+      || nObjects < 2) {
+    fprintf(stderr, "usage: %s [nObjects>=2]\n", argv[0]);
+    exit(1);
+  }
+  srand(2021);
+
+  bool ok = testArena();
+  ok = testPool() && ok;
+  ok = testPoolCaches() && ok;
+  ok = testTags() && ok;
+
+  if (mem_net() != 0 || mem_bytes() != 0) {
+    mem_report(stdout, "FAIL: leaked");
+    ok = false;
+  }
+  return ok ? 0 : 2;
+}
+
+/**************** testArena ****************/
+static bool
+testArena(void)
+{
+  mem_arena_t* arena = mem_assert(mem_arena_new(BLOCKSIZE), "arena");
+  span_t* spans = mem_malloc_assert(nObjects * sizeof(span_t), "spans");
+  bool ok = true;
+  int blocks = 0;
+
+  for (int round = 0; round < 2 && ok; round++) {
+    srand(round);             // the same sizes each round
+    for (int i = 0; i < nObjects && ok; i++) {
+      size_t size = (i % 100 == 0) ? BLOCKSIZE + rand() % BLOCKSIZE
+                                   : (size_t) rand() % 200;
+      char* p = mem_arena_alloc(arena, size);
+      if (p == NULL || (uintptr_t) p % sizeof(max_align_t) != 0) {
+        printf("FAIL: arena: allocation %d of %zu bytes at %p\n", i, size, (void*) p);
+        ok = false;
+        break;
+      }
+      memset(p, i, size);
+      spans[i] = (span_t) { p, size };
+    }
+    ok = ok && !overlaps(spans, nObjects);
+
+    // a reset keeps the regular blocks; the same sizes need no more
+    int net = mem_net();
+    if (round == 0) {
+      blocks = net;
+    } else if (net != blocks) {
+      printf("FAIL: arena: %d blocks after a reset, not %d\n", net, blocks);
+      ok = false;
+    }
+    mem_arena_reset(arena);
+    int large = (nObjects + 99) / 100;
+    if (ok && mem_net() != blocks - large) {
+      printf("FAIL: arena: a reset gave back %d blocks, not %d oversized\n",
+             blocks - mem_net(), large);
+      ok = false;
+    }
+  }
+
+  // strdup, and NULLs
+  char* s = mem_arena_strdup(arena, "tse");
+  ok = s != NULL && strcmp(s, "tse") == 0
+    && mem_arena_strdup(arena, NULL) == NULL
+    && mem_arena_alloc(NULL, 8) == NULL && ok;
+
+  mem_free(spans);
+  mem_arena_delete(arena);
+  printf("%s: arena, %d allocations, twice\n", ok ? "PASS" : "FAIL", nObjects);
+  return ok;
+}
+
+/**************** testPool ****************/
+static bool
+testPool(void)
+{
+  const size_t size = 40;
+  mem_pool_t* pool = mem_assert(mem_pool_new(size, false), "pool");
+  span_t* spans = mem_malloc_assert(nObjects * sizeof(span_t), "spans");
+  bool ok = true;
+
+  for (int i = 0; i < nObjects; i++) {
+    spans[i] = (span_t) { mem_assert(mem_pool_alloc(pool), "object"), size };
+    memset(spans[i].start, i, size);
+  }
+  ok = !overlaps(spans, nObjects);
+
+  // free every other object; as many again must come from those freed
+  int chunks = mem_net();
+  for (int i = 0; i < nObjects; i += 2) {
+    mem_pool_free(pool, spans[i].start);
+  }
+  for (int i = 0; i < nObjects; i += 2) {
+    spans[i].start = mem_assert(mem_pool_alloc(pool), "object");
+    memset(spans[i].start, i, size);
+  }
+  if (mem_net() != chunks) {
+    printf("FAIL: pool: %d chunks after reuse, not %d\n", mem_net(), chunks);
+    ok = false;
+  }
+  ok = ok && !overlaps(spans, nObjects);
+  ok = mem_pool_alloc(NULL) == NULL && mem_pool_new(0, false) == NULL && ok;
+  mem_pool_delete(pool);
+
+  // threads sharing a pool
+  worker_t workers[nThreads];
+  pool = mem_assert(mem_pool_new(size, true), "pool");
+  atomic_store(&failed, false);
+  for (int t = 0; t < nThreads; t++) {
+    workers[t] = (worker_t) { .id = t + 1, .pool = pool };
+    pthread_create(&workers[t].thread, NULL, poolWorker, &workers[t]);
+  }
+  for (int t = 0; t < nThreads; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+  ok = !atomic_load(&failed) && ok;
+  mem_pool_delete(pool);
+
+  mem_free(spans);
+  printf("%s: pool, %d objects, and %d threads sharing one\n",
+         ok ? "PASS" : "FAIL", nObjects, nThreads);
+  return ok;
+}
+
+/**************** poolWorker ****************/
+/* Take objects from the shared pool, stamped with our id, giving some
+ * back as we go; any stamp found changed means another thread had it.
+ */
+static void*
+poolWorker(void* arg)
+{
+  worker_t* me = arg;
+  int n = nObjects / nThreads;
+  int** objs = mem_malloc_assert(n * sizeof(int*), "objects");
+  for (int i = 0; i < n; i++) {
+    objs[i] = mem_assert(mem_pool_alloc(me->pool), "object");
+    objs[i][0] = me->id;
+    objs[i][1] = i;
+    if (i % 3 == 2) {         // give one back, and take another in its place
+      mem_pool_free(me->pool, objs[i - 1]);
+      objs[i - 1] = mem_assert(mem_pool_alloc(me->pool), "object");
+      objs[i - 1][0] = me->id;
+      objs[i - 1][1] = i - 1;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    if (objs[i][0] != me->id || objs[i][1] != i) {
+      printf("FAIL: pool: thread %d's object %d was overwritten\n", me->id, i);
+      atomic_store(&failed, true);
+      break;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    mem_pool_free(me->pool, objs[i]);
+  }
+  mem_free(objs);
+  return NULL;
+}
+
+/**************** testPoolCaches ****************/
+static bool
+testPoolCaches(void)
+{
+  const int nPools = 8, rounds = nObjects / 20;
+  const long CACHED = 64;     // at least a thread's cache of one pool
+  mem_pool_t* pools[nPools + 1];
+  for (int i = 0; i < nPools; i++) {
+    pools[i] = mem_assert(mem_pool_new(24, true), "pool");
+  }
+  pools[nPools] = NULL;
+  bool ok = true;
+
+  // the pools take turns; each turn takes another's place in the cache
+  for (int round = 0; round < rounds; round++) {
+    for (int i = 0; i < nPools; i++) {
+      poolRound(pools[i]);
+    }
+  }
+  for (int i = 0; i < nPools && ok; i++) {
+    long inUse = poolInUse(pools[i]);
+    if (inUse < 0 || inUse > CACHED) {
+      printf("FAIL: pool caches: pool %d counts %ld in use after %d turns\n",
+             i, inUse, rounds);
+      ok = false;
+    }
+  }
+
+  // another thread deletes half, whose objects this thread still caches
+  pthread_t deleter;
+  pthread_create(&deleter, NULL, poolDeleter, pools + nPools / 2);
+  pthread_join(deleter, NULL);
+  for (int round = 0; round < rounds; round++) {
+    for (int i = 0; i < nPools / 2; i++) {
+      poolRound(pools[i]);
+    }
+  }
+  for (int i = 0; i < nPools / 2 && ok; i++) {
+    long inUse = poolInUse(pools[i]);
+    if (inUse < 0 || inUse > CACHED) {
+      printf("FAIL: pool caches: pool %d counts %ld in use after the deletes\n",
+             i, inUse);
+      ok = false;
+    }
+  }
+  for (int i = 0; i < nPools / 2; i++) {
+    mem_pool_delete(pools[i]);
+  }
+
+  printf("%s: pool caches, %d shared pools taking %d turns\n",
+         ok ? "PASS" : "FAIL", nPools, rounds);
+  return ok;
+}
+
+/**************** poolRound ****************/
+/* One turn: take a few objects from the pool, and give them back. */
+static void
+poolRound(mem_pool_t* pool)
+{
+  void* objs[20];
+  for (int i = 0; i < 20; i++) {
+    objs[i] = mem_assert(mem_pool_alloc(pool), "object");
+    memset(objs[i], i, 24);
+  }
+  for (int i = 0; i < 20; i++) {
+    mem_pool_free(pool, objs[i]);
+  }
+}
+
+/**************** poolDeleter ****************/
+/* Delete the pools, up to a NULL. */
+static void*
+poolDeleter(void* arg)
+{
+  for (mem_pool_t** pools = arg; *pools != NULL; pools++) {
+    mem_pool_delete(*pools);
+  }
+  return NULL;
+}
+
+/**************** poolInUse ****************/
+/* The objects the pool counts in use, from mem_pool_report. */
+static long
+poolInUse(mem_pool_t* pool)
+{
+  FILE* fp = mem_assert(tmpfile(), "report file");
+  mem_pool_report(pool, fp, "pool");
+  rewind(fp);
+  unsigned long objsize;
+  long inUse = -1;
+  if (fscanf(fp, "pool: %lu-byte objects, %ld in use", &objsize, &inUse) != 2) {
+    inUse = -1;
+  }
+  fclose(fp);
+  return inUse;
+}
+
+/**************** testTags ****************/
+static bool
+testTags(void)
+{
+  bool ok = true;
+
+  // a tag, looked up twice, is the same tag
+  int tag = mem_tag("memtest");
+  ok = (tag > 0 && mem_tag("memtest") == tag && mem_tag(NULL) == 0);
+
+  long nmalloc, nfree, bytes;
+  void* a = mem_malloc_tagged(100, tag);
+  void* b = mem_calloc_tagged(10, 30, tag);
+  if (!tagLine("memtest", &nmalloc, &nfree, &bytes)
+      || nmalloc != 2 || nfree != 0 || (bytes != 0 && bytes < 400)) {
+    printf("FAIL: tags: after 2 allocations, %ld malloc, %ld free, %ld bytes\n",
+           nmalloc, nfree, bytes);
+    ok = false;
+  }
+  mem_free_tagged(a, tag);
+  mem_free_tagged(b, tag);
+  if (!tagLine("memtest", &nmalloc, &nfree, &bytes)
+      || nmalloc != 2 || nfree != 2 || bytes != 0) {
+    printf("FAIL: tags: after 2 frees, %ld malloc, %ld free, %ld bytes\n",
+           nmalloc, nfree, bytes);
+    ok = false;
+  }
+
+  // the library's own blocks, under theirs
+  long arenaBefore, poolBefore;
+  tagLine("arena", &arenaBefore, &nfree, &bytes);
+  tagLine("pool", &poolBefore, &nfree, &bytes);
+  mem_arena_t* arena = mem_assert(mem_arena_new(BLOCKSIZE), "arena");
+  mem_pool_t* pool = mem_assert(mem_pool_new(16, false), "pool");
+  mem_arena_alloc(arena, 10);
+  mem_pool_alloc(pool);
+  long arenaAfter, poolAfter;
+  tagLine("arena", &arenaAfter, &nfree, &bytes);
+  tagLine("pool", &poolAfter, &nfree, &bytes);
+  if (arenaAfter != arenaBefore + 1 || poolAfter != poolBefore + 1) {
+    printf("FAIL: tags: arena blocks %ld -> %ld, pool chunks %ld -> %ld\n",
+           arenaBefore, arenaAfter, poolBefore, poolAfter);
+    ok = false;
+  }
+  mem_arena_delete(arena);
+  mem_pool_delete(pool);
+
+  // each thread's bytes are its own, however many threads came before it
+  atomic_store(&failed, false);
+  for (int round = 0; round < 40; round++) {
+    worker_t workers[nThreads];
+    for (int t = 0; t < nThreads; t++) {
+      workers[t] = (worker_t) { .id = t + 1 };
+      pthread_create(&workers[t].thread, NULL, bytesWorker, &workers[t]);
+    }
+    for (int t = 0; t < nThreads; t++) {
+      pthread_join(workers[t].thread, NULL);
+    }
+  }
+  ok = !atomic_load(&failed) && ok;
+
+  printf("%s: tags, and bytes of %d threads\n", ok ? "PASS" : "FAIL", 40 * nThreads);
+  return ok;
+}
+
+/**************** bytesWorker ****************/
+/* Allocate, and check that mem_threadBytes counts just what we hold. */
+static void*
+bytesWorker(void* arg)
+{
+  worker_t* me = arg;
+  long base = mem_threadBytes();
+  void* p = mem_malloc_assert(1000 * me->id, "bytes");
+  long held = mem_threadBytes() - base;
+  mem_free(p);
+  long after = mem_threadBytes() - base;
+  // 0 where the C library cannot tell us the size
+  if ((held != 0 && held < 1000 * me->id) || after != 0) {
+    printf("FAIL: tags: thread holding %d bytes counts %ld, then %ld\n",
+           1000 * me->id, held, after);
+    atomic_store(&failed, true);
+  }
+  return NULL;
+}
+
+/**************** overlaps ****************/
+/* Sort the allocations by address; does any run into the next? */
+static bool
+overlaps(span_t* spans, const int n)
+{
+  span_t* sorted = mem_malloc_assert(n * sizeof(span_t), "sorted");
+  memcpy(sorted, spans, n * sizeof(span_t));
+  qsort(sorted, n, sizeof(span_t), compareSpans);
+  bool overlap = false;
+  for (int i = 1; i < n && !overlap; i++) {
+    if (sorted[i - 1].start + sorted[i - 1].size > sorted[i].start
+        || sorted[i - 1].start == sorted[i].start) {
+      printf("FAIL: %zu bytes at %p run into %p\n", sorted[i - 1].size,
+             (void*) sorted[i - 1].start, (void*) sorted[i].start);
+      overlap = true;
+    }
+  }
+  mem_free(sorted);
+  return overlap;
+}
+
+/**************** compareSpans ****************/
+static int
+compareSpans(const void* a, const void* b)
+{
+  uintptr_t x = (uintptr_t) ((const span_t*) a)->start;
+  uintptr_t y = (uintptr_t) ((const span_t*) b)->start;
+  return (x > y) - (x < y);
+}
+
+/**************** tagLine ****************/
+/* Find the tag's line in mem_report; false if it has none. */
+static bool
+tagLine(const char* name, long* nmalloc, long* nfree, long* bytes)
+{
+  *nmalloc = *nfree = *bytes = 0;
+  FILE* fp = mem_assert(tmpfile(), "report file");
+  mem_report(fp, "report");
+  rewind(fp);
+
+  char line[200], tag[100];
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), fp) != NULL) {
+    found = sscanf(line, "  %99[^:]: %ld malloc, %ld free, %ld bytes",
+                   tag, nmalloc, nfree, bytes) == 4
+         && strcmp(tag, name) == 0;
+  }
+  fclose(fp);
+  return found;
+}
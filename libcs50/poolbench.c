@@ -0,0 +1,243 @@
+/*
+ * poolbench - compare the pool allocator in mem.h with malloc
+ *
+ * usage:
+ *   poolbench [nOps]
+ *
+ * For node-sized objects (a bag node, a set node), reports:
+ *   churn throughput: with a working set of live objects, repeatedly free
+ *     a random one and allocate a replacement, in Mops/s, for malloc, an
+ *     unshared pool, and a shared pool (through its thread cache);
+ *   fragmentation: after allocating many objects and freeing most of them
+ *     at random, the bytes the heap holds per byte still live, measured
+ *     in a fresh process for each allocator;
+ *   bag churn: bag_insert/bag_extract cycles, which now use a pool.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#define _POSIX_C_SOURCE 199309L   // clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "bag.h"
+#include "mem.h"
+
+/**************** file-local global types ****************/
+// which allocator a run uses
+typedef enum { USE_MALLOC, USE_POOL, USE_SHARED } allocator_t;
+
+/**************** file-local global variables ****************/
+static const char* allocatorNames[] = { "malloc", "pool", "shared pool" };
+static const int WORKING = 10000;     // live objects during churn
+static const int FRAGOBJS = 200000;   // objects allocated for fragmentation
+
+/**************** local functions ****************/
+static void benchChurn(const size_t size, const long nOps);
+static void benchFragmentation(const size_t size);
+static void fragment(const allocator_t which, const size_t size);
+static void benchBag(const long nOps);
+static void* obj_alloc(const allocator_t which, mem_pool_t* pool,
+                       const size_t size);
+static void obj_free(const allocator_t which, mem_pool_t* pool, void* ptr);
+static long heapInUse(void);
+static double now(void);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  long nOps = 10000000;
+  if (argc > 2 || (argc == 2 && sscanf(argv[1], "%ld", &nOps) != 1)) {
+    fprintf(stderr, "usage: %s [nOps]\n", argv[0]);
+    exit(1);
+  }
+
+  const size_t sizes[] = { 16, 24 };   // a bag node, a set node
+  for (int s = 0; s < 2; s++) {
+    benchChurn(sizes[s], nOps);
+    benchFragmentation(sizes[s]);
+  }
+  benchBag(nOps);
+
+  if (mem_net() != 0) {
+    mem_report(stderr, "poolbench leaked");
+    return 2;
+  }
+  return 0;
+}
+
+/**************** benchChurn ****************/
+/* Keep WORKING objects live; each op frees a random one and replaces it.
+ */
+static void
+benchChurn(const size_t size, const long nOps)
+{
+  printf("churn of %lu-byte objects, %d live, %ld ops:\n",
+         (unsigned long) size, WORKING, nOps);
+  void** live = mem_calloc_assert(WORKING, sizeof(void*), "live[]");
+
+  for (allocator_t which = USE_MALLOC; which <= USE_SHARED; which++) {
+    mem_pool_t* pool = (which == USE_MALLOC) ? NULL
+                       : mem_pool_new(size, which == USE_SHARED);
+    srand(2021);
+    for (int i = 0; i < WORKING; i++) {
+      live[i] = obj_alloc(which, pool, size);
+    }
+
+    double start = now();
+    for (long op = 0; op < nOps; op++) {
+      int victim = rand() % WORKING;
+      obj_free(which, pool, live[victim]);
+      live[victim] = obj_alloc(which, pool, size);
+      memset(live[victim], 0, size);    // touch it, as a real node would
+    }
+    double secs = now() - start;
+
+    for (int i = 0; i < WORKING; i++) {
+      obj_free(which, pool, live[i]);
+    }
+    mem_pool_delete(pool);
+    printf("  %-12s %8.1f Mops/s\n", allocatorNames[which], nOps / secs / 1e6);
+  }
+  mem_free(live);
+  printf("\n");
+}
+
+/**************** benchFragmentation ****************/
+/* Run the fragmentation test for each allocator in a child process,
+ * so neither inherits heap the other left behind.
+ */
+static void
+benchFragmentation(const size_t size)
+{
+  printf("fragmentation of %lu-byte objects (bytes held / bytes live):\n",
+         (unsigned long) size);
+  for (allocator_t which = USE_MALLOC; which <= USE_POOL; which++) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+      fragment(which, size);
+      exit(0);
+    } else if (child > 0) {
+      waitpid(child, NULL, 0);
+    }
+  }
+  printf("\n");
+}
+
+/**************** fragment ****************/
+/* Allocate FRAGOBJS objects, free nine in ten at random, then allocate
+ * a tenth as many again; report bytes held per live byte.
+ */
+static void
+fragment(const allocator_t which, const size_t size)
+{
+  void** objs = mem_calloc_assert(FRAGOBJS, sizeof(void*), "objs[]");
+  mem_pool_t* pool = (which == USE_MALLOC) ? NULL : mem_pool_new(size, false);
+  long before = heapInUse();
+
+  srand(2021);
+  for (int i = 0; i < FRAGOBJS; i++) {
+    objs[i] = obj_alloc(which, pool, size);
+  }
+  for (int i = 0; i < FRAGOBJS; i++) {
+    if (rand() % 10 != 0) {
+      obj_free(which, pool, objs[i]);
+      objs[i] = NULL;
+    }
+  }
+  for (int i = 0; i < FRAGOBJS; i += 10) {
+    if (objs[i] == NULL) {
+      objs[i] = obj_alloc(which, pool, size);
+    }
+  }
+  long nLive = 0;
+  for (int i = 0; i < FRAGOBJS; i++) {
+    nLive += (objs[i] != NULL);
+  }
+
+  long held = heapInUse() - before;
+  printf("  %-12s %8.2f (%ld live)\n", allocatorNames[which],
+         (double) held / (nLive * size), nLive);
+  if (which == USE_POOL) {
+    mem_pool_report(pool, stdout, "    pool");
+  }
+
+  for (int i = 0; i < FRAGOBJS; i++) {
+    obj_free(which, pool, objs[i]);
+  }
+  mem_pool_delete(pool);
+  mem_free(objs);
+}
+
+/**************** benchBag ****************/
+/* Insert and extract through a bag, keeping it about WORKING deep.
+ */
+static void
+benchBag(const long nOps)
+{
+  bag_t* bag = bag_new();
+  for (int i = 0; i < WORKING; i++) {
+    bag_insert(bag, bag);
+  }
+  double start = now();
+  for (long op = 0; op < nOps; op++) {
+    bag_insert(bag, bag_extract(bag));
+  }
+  double secs = now() - start;
+  bag_delete(bag, NULL);
+  printf("bag extract+insert, %d deep: %8.1f Mops/s\n", WORKING,
+         nOps / secs / 1e6);
+}
+
+/**************** obj_alloc, obj_free ****************/
+static void*
+obj_alloc(const allocator_t which, mem_pool_t* pool, const size_t size)
+{
+  return (which == USE_MALLOC) ? mem_malloc_assert(size, "obj")
+                               : mem_assert(mem_pool_alloc(pool), "obj");
+}
+
+static void
+obj_free(const allocator_t which, mem_pool_t* pool, void* ptr)
+{
+  if (ptr == NULL) {
+    return;
+  } else if (which == USE_MALLOC) {
+    mem_free(ptr);
+  } else {
+    mem_pool_free(pool, ptr);
+  }
+}
+
+/**************** heapInUse ****************/
+/* Bytes malloc holds from the system, whether handed out or free in its
+ * heap; zero where the C library cannot tell us.
+ */
+static long
+heapInUse(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  struct mallinfo2 mi = mallinfo2();
+  return (long) (mi.arena + mi.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+/**************** now ****************/
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,593 @@
+/*
+ * postings.c - CS50 'postings' module
+ *
+ * see postings.h for more information.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include "postings.h"
+#include "mem.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**************** file-local global variables ****************/
+static const int VARINT_MAX = 5;        // bytes in the longest varint
+static const int LANES = 4;             // 32-bit lanes a packed block interleaves
+static const int MAX_BITS = 31;         // widest packed value: a non-negative int
+static const int SKIP_SIZE = 8;         // bytes of a skip table entry
+#ifdef __SSE2__
+static bool simd = true;                // unpack with SSE2?
+#else
+static bool simd = false;
+#endif
+
+/**************** global types ****************/
+typedef struct postings_reader {
+  postings_codec_t codec;     // how the list is packed
+  const unsigned char* skips; // the skip table; NULL for a list of one block
+  const unsigned char* data;  // the first block
+  const unsigned char* p;     // next byte to read
+  const unsigned char* end;   // end of the bytes
+  int n;                      // postings in the list
+  int block;                  // next block to read
+  int remaining;              // postings not yet read; -1 once corrupt
+  long last;                  // docID of the last posting read; -1 before any
+} postings_reader_t;
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static unsigned char* putVarint(unsigned char* p, unsigned int value);
+static bool getVarint(const unsigned char** p, const unsigned char* end,
+                      unsigned long* value);
+static unsigned char* packBlock(unsigned char* p, const uint32_t* values);
+static const unsigned char* unpackBlock(const unsigned char* p,
+                                        const unsigned char* end,
+                                        uint32_t* values, uint32_t* most);
+static void unpackBits(const unsigned char* in, const int bits, uint32_t* values);
+static int readVarintBlock(postings_reader_t* reader, const int n,
+                           int* docIDs, int* counts);
+static int readPackedBlock(postings_reader_t* reader, int* docIDs, int* counts);
+static inline int nBlocks(const int n);
+static inline uint32_t get32(const unsigned char* p);
+static inline void put32(unsigned char* p, uint32_t value);
+
+/**************** postings_codecFor() ****************/
+/* see postings.h for description */
+postings_codec_t
+postings_codecFor(const int n)
+{
+  return (n >= POSTINGS_BLOCK) ? POSTINGS_PACKED : POSTINGS_VARINT;
+}
+
+/**************** postings_maxBytes() ****************/
+/* see postings.h for description */
+size_t
+postings_maxBytes(const int n)
+{
+  // a packed block is never bigger than the same postings as varints
+  if (n <= 0) {
+    return 1;
+  }
+  size_t skips = (n > POSTINGS_BLOCK) ? SKIP_SIZE * (size_t) nBlocks(n) : 0;
+  return 1 + skips + 2 * VARINT_MAX * (size_t) n;
+}
+
+/**************** postings_encode() ****************/
+/* see postings.h for description */
+size_t
+postings_encode(const postings_codec_t codec,
+                const int* docIDs, const int* counts, const int n,
+                unsigned char* buf)
+{
+  unsigned char* p = buf;
+  *p++ = (unsigned char) codec;
+
+  // room for the skip table, filled in block by block
+  unsigned char* skip = NULL;
+  if (n > POSTINGS_BLOCK) {
+    skip = p;
+    p += SKIP_SIZE * nBlocks(n);
+  }
+  const unsigned char* data = p;
+
+  long last = -1;
+  for (int block = 0; block < n; block += POSTINGS_BLOCK) {
+    int end = (n - block < POSTINGS_BLOCK) ? n : block + POSTINGS_BLOCK;
+    if (skip != NULL) {
+      put32(skip, (uint32_t) docIDs[end - 1]);
+      put32(skip + 4, (uint32_t) (p - data));
+      skip += SKIP_SIZE;
+    }
+    if (codec == POSTINGS_PACKED && end - block == POSTINGS_BLOCK) {
+      uint32_t values[POSTINGS_BLOCK];
+      for (int i = block; i < end; i++) {
+        values[i - block] = (uint32_t) (docIDs[i] - last - 1);
+        last = docIDs[i];
+      }
+      p = packBlock(p, values);
+      for (int i = block; i < end; i++) {
+        values[i - block] = (uint32_t) counts[i];
+      }
+      p = packBlock(p, values);
+    }
+    else {
+      for (int i = block; i < end; i++) {
+        p = putVarint(p, (unsigned int) (docIDs[i] - last - 1));
+        last = docIDs[i];
+      }
+      for (int i = block; i < end; i++) {
+        p = putVarint(p, (unsigned int) counts[i]);
+      }
+    }
+  }
+  return p - buf;
+}
+
+/**************** postings_reader_new() ****************/
+/* see postings.h for description */
+postings_reader_t*
+postings_reader_new(const unsigned char* buf, const size_t len, const int n)
+{
+  postings_reader_t* reader = mem_malloc(sizeof(postings_reader_t));
+  if (reader == NULL) {
+    return NULL;              // error allocating reader
+  }
+
+  reader->n = (n > 0) ? n : 0;
+  reader->block = 0;
+  reader->remaining = reader->n;
+  reader->last = -1;
+  reader->end = buf + len;
+  reader->codec = (len > 0) ? buf[0] : POSTINGS_VARINT;
+  reader->skips = NULL;
+  reader->data = buf + (len > 0 ? 1 : 0);
+  if (len == 0 || (reader->codec != POSTINGS_VARINT
+                   && reader->codec != POSTINGS_PACKED)) {
+    reader->remaining = -1;   // no codec byte, or not one we know
+  }
+  else if (reader->n > POSTINGS_BLOCK) {
+    size_t skipBytes = SKIP_SIZE * (size_t) nBlocks(reader->n);
+    if (len - 1 < skipBytes) {
+      reader->remaining = -1; // no room for the skip table
+    }
+    else {
+      reader->skips = buf + 1;
+      reader->data = buf + 1 + skipBytes;
+    }
+  }
+  reader->p = reader->data;
+  return reader;
+}
+
+/**************** postings_reader_next() ****************/
+/* see postings.h for description */
+int
+postings_reader_next(postings_reader_t* reader, int* docIDs, int* counts)
+{
+  if (reader == NULL || reader->remaining < 0) {
+    return -1;
+  }
+  int n = (reader->remaining < POSTINGS_BLOCK) ? reader->remaining
+                                               : POSTINGS_BLOCK;
+  if (n == 0) {
+    return 0;
+  }
+  if (reader->codec == POSTINGS_PACKED && n == POSTINGS_BLOCK) {
+    n = readPackedBlock(reader, docIDs, counts);
+  }
+  else {
+    n = readVarintBlock(reader, n, docIDs, counts);
+  }
+  // the block must end where the skip table says
+  if (n < 0 || (reader->skips != NULL
+                && reader->last != get32(reader->skips + SKIP_SIZE * reader->block))) {
+    reader->remaining = -1;
+    return -1;
+  }
+  reader->block++;
+  reader->remaining -= n;
+  return n;
+}
+
+/**************** postings_reader_seek() ****************/
+/* see postings.h for description */
+void
+postings_reader_seek(postings_reader_t* reader, const int target)
+{
+  if (reader == NULL || reader->remaining <= 0 || reader->skips == NULL) {
+    return;
+  }
+
+  // binary-search the skip table for the first block that ends >= target
+  const unsigned char* skips = reader->skips;
+  int lo = reader->block, hi = nBlocks(reader->n);
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if ((long) get32(skips + SKIP_SIZE * mid) < target) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  if (lo == reader->block) {
+    return;                   // already there
+  }
+  if (lo == nBlocks(reader->n)) {
+    reader->block = lo;       // every docID is below target
+    reader->remaining = 0;
+    return;
+  }
+
+  // start block lo where the one before it ended
+  uint32_t offset = get32(skips + SKIP_SIZE * lo + 4);
+  uint32_t last = get32(skips + SKIP_SIZE * (lo - 1));
+  if (offset > (size_t) (reader->end - reader->data) || last > INT_MAX) {
+    reader->remaining = -1;
+    return;
+  }
+  reader->p = reader->data + offset;
+  reader->last = last;
+  reader->block = lo;
+  reader->remaining = reader->n - lo * POSTINGS_BLOCK;
+}
+
+/**************** postings_reader_delete() ****************/
+/* see postings.h for description */
+void
+postings_reader_delete(postings_reader_t* reader)
+{
+  if (reader != NULL) {
+    mem_free(reader);
+  }
+}
+
+/**************** postings_decode() ****************/
+/* see postings.h for description */
+bool
+postings_decode(const unsigned char* buf, const size_t len, const int n,
+                int* docIDs, int* counts)
+{
+  postings_reader_t* reader = postings_reader_new(buf, len, n);
+  if (reader == NULL) {
+    return false;
+  }
+  int got = 0, k;
+  while ((k = postings_reader_next(reader, docIDs + got, counts + got)) > 0) {
+    got += k;
+  }
+  postings_reader_delete(reader);
+  return k == 0;
+}
+
+/**************** postings_simd() ****************/
+/* see postings.h for description */
+bool
+postings_simd(const bool enable)
+{
+#ifdef __SSE2__
+  simd = enable;
+#endif
+  return simd;
+}
+
+/**************** readVarintBlock ****************/
+/* Read a block of n postings packed as varints;
+ * return n, or -1 if the bytes are corrupt.
+ */
+static int
+readVarintBlock(postings_reader_t* reader, const int n, int* docIDs, int* counts)
+{
+  // the docIDs, each a gap (less one) from the one before;
+  // most gaps fit one byte, so take those without a call
+  const unsigned char* p = reader->p;
+  const unsigned char* end = reader->end;
+  long last = reader->last;
+  for (int i = 0; i < n; i++) {
+    unsigned long gap;
+    if (p < end && *p < 0x80) {
+      gap = *p++;
+    }
+    else if (!getVarint(&p, end, &gap)) {
+      return -1;
+    }
+    if (last + 1 + gap > INT_MAX) {
+      return -1;
+    }
+    last += 1 + gap;
+    docIDs[i] = (int) last;
+  }
+
+  // then their counts
+  for (int i = 0; i < n; i++) {
+    unsigned long count;
+    if (p < end && *p < 0x80) {
+      count = *p++;
+    }
+    else if (!getVarint(&p, end, &count) || count > INT_MAX) {
+      return -1;
+    }
+    counts[i] = (int) count;
+  }
+
+  reader->p = p;
+  reader->last = last;
+  return n;
+}
+
+/**************** readPackedBlock ****************/
+/* Read a full block of bit-packed postings;
+ * return POSTINGS_BLOCK, or -1 if the bytes are corrupt.
+ * The gaps unpack into docIDs[], which a running sum then turns into
+ * docIDs; when no docID can pass INT_MAX it skips the checks, and
+ * with SSE2 sums four at a time.
+ */
+static int
+readPackedBlock(postings_reader_t* reader, int* docIDs, int* counts)
+{
+  uint32_t* gaps = (uint32_t*) docIDs;
+  uint32_t most;                      // no gap is above this
+  const unsigned char* p = unpackBlock(reader->p, reader->end, gaps, &most);
+  if (p == NULL || (p = unpackBlock(p, reader->end, (uint32_t*) counts, &most)) == NULL) {
+    return -1;
+  }
+
+  long last = reader->last;
+  if (last + POSTINGS_BLOCK * ((long) most + 1) > INT_MAX) {
+    for (int i = 0; i < POSTINGS_BLOCK; i++) {
+      if (last + 1 + gaps[i] > INT_MAX) {
+        return -1;
+      }
+      last += 1 + gaps[i];
+      docIDs[i] = (int) last;
+    }
+  }
+#ifdef __SSE2__
+  else if (simd) {
+    // prefix sums of four lanes: add each lane to those after it, twice
+    __m128i carry = _mm_set1_epi32((int) last);
+    const __m128i one = _mm_set1_epi32(1);
+    for (int i = 0; i < POSTINGS_BLOCK; i += LANES) {
+      __m128i x = _mm_add_epi32(_mm_loadu_si128((const __m128i*) (docIDs + i)), one);
+      x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi32(x, carry);
+      _mm_storeu_si128((__m128i*) (docIDs + i), x);
+      carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    last = docIDs[POSTINGS_BLOCK - 1];
+  }
+#endif
+  else {
+    int sum = (int) last;
+    for (int i = 0; i < POSTINGS_BLOCK; i++) {
+      sum += 1 + (int) gaps[i];
+      docIDs[i] = sum;
+    }
+    last = sum;
+  }
+
+  reader->p = p;
+  reader->last = last;
+  return POSTINGS_BLOCK;
+}
+
+/**************** packBlock ****************/
+/* Bit-pack POSTINGS_BLOCK values, each at most INT_MAX, at p, as
+ * described in postings.h; return the byte after them.
+ * The width b is the one that makes the block smallest: 16*b bytes of
+ * low bits, plus a position byte and a varint for each value wider.
+ */
+static unsigned char*
+packBlock(unsigned char* p, const uint32_t* values)
+{
+  // how many values need each number of bits
+  int nWithBits[33] = { 0 };
+  int widest = 0;
+  for (int i = 0; i < POSTINGS_BLOCK; i++) {
+    int bits = 0;
+    for (uint32_t v = values[i]; v != 0; v >>= 1) {
+      bits++;
+    }
+    nWithBits[bits]++;
+    widest = (bits > widest) ? bits : widest;
+  }
+
+  // the narrowest width that costs least; no exceptions at the widest
+  int best = widest;
+  long bestCost = (long) POSTINGS_BLOCK / 8 * widest;
+  for (int b = widest - 1; b >= 0; b--) {
+    long cost = (long) POSTINGS_BLOCK / 8 * b;
+    for (int bits = b + 1; bits <= widest; bits++) {
+      cost += nWithBits[bits] * (1 + (bits - b + 6) / 7);
+    }
+    if (cost < bestCost) {
+      best = b;
+      bestCost = cost;
+    }
+  }
+
+  // the low bits, value i in lane i%4, LSB first
+  uint32_t mask = (1u << best) - 1;
+  uint32_t words[LANES * MAX_BITS];
+  memset(words, 0, sizeof(words));
+  for (int i = 0; i < POSTINGS_BLOCK && best > 0; i++) {
+    int lane = i % LANES, bit = (i / LANES) * best;
+    int word = bit / 32, offset = bit % 32;
+    uint32_t v = values[i] & mask;
+    words[LANES * word + lane] |= v << offset;
+    if (offset + best > 32) {
+      words[LANES * (word + 1) + lane] |= v >> (32 - offset);
+    }
+  }
+
+  unsigned char* nExceptions = p + 1;
+  *p++ = (unsigned char) best;
+  *p++ = 0;
+  for (int w = 0; w < LANES * best; w++) {
+    put32(p, words[w]);
+    p += 4;
+  }
+  for (int i = 0; i < POSTINGS_BLOCK; i++) {
+    if ((values[i] & ~mask) != 0) {
+      (*nExceptions)++;
+      *p++ = (unsigned char) i;
+      p = putVarint(p, values[i] >> best);
+    }
+  }
+  return p;
+}
+
+/**************** unpackBlock ****************/
+/* Unpack a block written by packBlock, at p and before end, into
+ * values[POSTINGS_BLOCK], and set *most to a bound on them:
+ * 2^b-1, with no exceptions, else INT_MAX.
+ * Return the byte after the block, or NULL if it is corrupt.
+ */
+static const unsigned char*
+unpackBlock(const unsigned char* p, const unsigned char* end,
+            uint32_t* values, uint32_t* most)
+{
+  if (end - p < 2 || p[0] > MAX_BITS || p[1] > POSTINGS_BLOCK
+      || end - p - 2 < (long) POSTINGS_BLOCK / 8 * p[0]) {
+    return NULL;
+  }
+  int bits = p[0], nExceptions = p[1];
+  p += 2;
+  unpackBits(p, bits, values);
+  p += POSTINGS_BLOCK / 8 * bits;
+
+  // patch in the exceptions' high bits
+  for (int e = 0; e < nExceptions; e++) {
+    unsigned long high;
+    if (p >= end || *p >= POSTINGS_BLOCK) {
+      return NULL;
+    }
+    int i = *p++;
+    if (!getVarint(&p, end, &high) || high > ((unsigned long) INT_MAX >> bits)) {
+      return NULL;
+    }
+    values[i] |= (uint32_t) high << bits;
+  }
+
+  *most = (nExceptions > 0) ? INT_MAX : (uint32_t) ((1ul << bits) - 1);
+  return p;
+}
+
+/**************** unpackBits ****************/
+/* Unpack POSTINGS_BLOCK values of the given width, 0..MAX_BITS,
+ * from the 16*bits bytes at in.
+ * The j'th value of each lane sits at the same bit offset in all four
+ * lanes, so one shift of a group of four 32-bit words serves them all.
+ */
+static void
+unpackBits(const unsigned char* in, const int bits, uint32_t* values)
+{
+  if (bits == 0) {
+    memset(values, 0, POSTINGS_BLOCK * sizeof(uint32_t));
+    return;
+  }
+  const uint32_t mask = (1u << bits) - 1;
+  const int groups = POSTINGS_BLOCK / LANES;
+
+#ifdef __SSE2__
+  if (simd) {
+    const __m128i masks = _mm_set1_epi32((int) mask);
+    for (int j = 0; j < groups; j++) {
+      int bit = j * bits, word = bit / 32, offset = bit % 32;
+      __m128i x = _mm_loadu_si128((const __m128i*) (in + 16 * word));
+      x = _mm_srl_epi32(x, _mm_cvtsi32_si128(offset));
+      if (offset + bits > 32) {
+        __m128i y = _mm_loadu_si128((const __m128i*) (in + 16 * (word + 1)));
+        x = _mm_or_si128(x, _mm_sll_epi32(y, _mm_cvtsi32_si128(32 - offset)));
+      }
+      _mm_storeu_si128((__m128i*) (values + LANES * j), _mm_and_si128(x, masks));
+    }
+    return;
+  }
+#endif
+
+  for (int j = 0; j < groups; j++) {
+    int bit = j * bits, word = bit / 32, offset = bit % 32;
+    for (int lane = 0; lane < LANES; lane++) {
+      uint32_t v = get32(in + 16 * word + 4 * lane) >> offset;
+      if (offset + bits > 32) {
+        v |= get32(in + 16 * (word + 1) + 4 * lane) << (32 - offset);
+      }
+      values[LANES * j + lane] = v & mask;
+    }
+  }
+}
+
+/**************** putVarint ****************/
+/* Write value as a varint at p; return the byte after it.
+ */
+static unsigned char*
+putVarint(unsigned char* p, unsigned int value)
+{
+  while (value >= 0x80) {
+    *p++ = (unsigned char) (value | 0x80);
+    value >>= 7;
+  }
+  *p++ = (unsigned char) value;
+  return p;
+}
+
+/**************** getVarint ****************/
+/* Read a varint at *p, before end, into *value, and advance *p past it;
+ * return false if it runs past end or VARINT_MAX bytes.
+ */
+static bool
+getVarint(const unsigned char** p, const unsigned char* end,
+          unsigned long* value)
+{
+  const unsigned char* q = *p;
+  unsigned long v = 0;
+  for (int shift = 0; q < end && shift < 7 * VARINT_MAX; shift += 7) {
+    unsigned char byte = *q++;
+    v |= (unsigned long) (byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      *value = v;
+      *p = q;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************** nBlocks ****************/
+/* The number of blocks in a list of n postings.
+ */
+static inline int
+nBlocks(const int n)
+{
+  return (n > 0) ? (n - 1) / POSTINGS_BLOCK + 1 : 0;
+}
+
+/**************** get32, put32 ****************/
+/* A little-endian 32-bit word at p, whatever the host's byte order.
+ */
+static inline uint32_t
+get32(const unsigned char* p)
+{
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8
+    | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline void
+put32(unsigned char* p, uint32_t value)
+{
+  p[0] = (unsigned char) value;
+  p[1] = (unsigned char) (value >> 8);
+  p[2] = (unsigned char) (value >> 16);
+  p[3] = (unsigned char) (value >> 24);
+}
@@ -0,0 +1,150 @@
+/*
+ * postings.h - header file for CS50 'postings' module
+ *
+ * A *postings list* is a word's docIDs, in increasing order, each with
+ * a count.  This module packs one into a few bytes per posting, and
+ * unpacks it again a *block* of POSTINGS_BLOCK postings at a time.
+ *
+ * A packed list starts with a byte naming its *codec*.  A list of more
+ * than one block then has a *skip table*: for each block, the last docID
+ * in it and the offset of the block from the end of the table, 32-bit
+ * little-endian words, so that a reader can seek to the block holding
+ * a given docID without unpacking the blocks before it.  Then come the
+ * blocks.  Each block holds its docIDs, as their gaps from the docID
+ * before, less one (the first in the list counts from -1), and then - a
+ * parallel stream - their counts.  Only the last block may hold fewer
+ * than POSTINGS_BLOCK postings.  The codecs:
+ *
+ *   POSTINGS_VARINT: every gap and count is a varint: seven bits a byte,
+ *     low bits first, with the high bit set on every byte but the last;
+ *     gaps below 128, and counts below 128, take one byte each.
+ *   POSTINGS_PACKED: each full block's gaps, and then its counts, are
+ *     bit-packed, PForDelta-style: a byte b, the bit width; a byte e,
+ *     the number of *exceptions*; the low b bits of all POSTINGS_BLOCK
+ *     values, in 16*b bytes; then, for each exception, a byte giving
+ *     its place in the block and a varint of its bits above the low b.
+ *     b is chosen to make the block smallest, so a few outliers do not
+ *     widen every value.  The values are interleaved four ways (value i
+ *     in 32-bit word lane i%4), as in SIMD-BP128, so that SSE2 unpacks
+ *     four at a time where the build has it.  A last block short of
+ *     POSTINGS_BLOCK is packed as in POSTINGS_VARINT.
+ *
+ * Varints suit short lists, and packing long ones; postings_codecFor
+ * chooses between them by the length of the list.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#ifndef __POSTINGS_H
+#define __POSTINGS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct postings_reader postings_reader_t;  // opaque to users of the module
+
+/* the ways a list may be packed; the value is the list's first byte */
+typedef enum postings_codec {
+  POSTINGS_VARINT = 0,
+  POSTINGS_PACKED = 1,
+} postings_codec_t;
+
+/* postings in a full block */
+#define POSTINGS_BLOCK 128
+
+/**************** functions ****************/
+
+/**************** postings_codecFor ****************/
+/* Return the codec to pack a list of n postings with: POSTINGS_PACKED
+ * if it fills at least one block, else POSTINGS_VARINT.
+ */
+postings_codec_t postings_codecFor(const int n);
+
+/**************** postings_maxBytes ****************/
+/* Return the most bytes postings_encode can write for n postings,
+ * with either codec, skip table and all.
+ */
+size_t postings_maxBytes(const int n);
+
+/**************** postings_encode ****************/
+/* Pack a postings list into buf.
+ *
+ * Caller provides:
+ *   a codec; n docIDs, in strictly increasing order, all >= 0, and their
+ *   counts, all >= 0, as parallel arrays; a buffer of postings_maxBytes(n)
+ *   bytes.
+ * We return:
+ *   the number of bytes written.
+ * Notes:
+ *   we do not check the order; a list out of order will not decode.
+ */
+size_t postings_encode(const postings_codec_t codec,
+                       const int* docIDs, const int* counts, const int n,
+                       unsigned char* buf);
+
+/**************** postings_reader_new ****************/
+/* Start reading a postings list packed by postings_encode.
+ *
+ * Caller provides:
+ *   the packed bytes and their length, and the number of postings in
+ *   the list; the bytes must stay put until the reader is deleted.
+ * We return:
+ *   pointer to a new reader, or NULL if out of memory.
+ * Caller is responsible for:
+ *   later calling postings_reader_delete.
+ */
+postings_reader_t* postings_reader_new(const unsigned char* buf,
+                                       const size_t len, const int n);
+
+/**************** postings_reader_next ****************/
+/* Unpack the next block of postings.
+ *
+ * Caller provides:
+ *   valid reader; arrays of POSTINGS_BLOCK ints for the docIDs and counts.
+ * We return:
+ *   the number of postings unpacked into the arrays, 1..POSTINGS_BLOCK;
+ *   0 once the list is done;
+ *   -1 if the bytes are not a list of the promised length, in order -
+ *   a corrupt file, say; the reader then returns -1 from here on.
+ */
+int postings_reader_next(postings_reader_t* reader, int* docIDs, int* counts);
+
+/**************** postings_reader_seek ****************/
+/* Skip ahead, without unpacking them, past the blocks whose docIDs are
+ * all below target, so that postings_reader_next unpacks the block
+ * holding the first docID >= target - if there is one; if there is
+ * not, postings_reader_next returns 0.
+ *
+ * Caller provides:
+ *   valid reader; any target.
+ * Notes:
+ *   the reader never goes back: a target below the next block's docIDs
+ *   does nothing.  A list of one block has no skip table, so it is left
+ *   for postings_reader_next to unpack.
+ */
+void postings_reader_seek(postings_reader_t* reader, const int target);
+
+/**************** postings_reader_delete ****************/
+/* Free the reader (not the bytes it reads); ignore NULL.
+ */
+void postings_reader_delete(postings_reader_t* reader);
+
+/**************** postings_decode ****************/
+/* Unpack a whole postings list of n postings, block by block, into
+ * arrays of (at least) n ints.
+ * Return false if the bytes are corrupt, as postings_reader_next, or
+ * out of memory.
+ */
+bool postings_decode(const unsigned char* buf, const size_t len, const int n,
+                     int* docIDs, int* counts);
+
+/**************** postings_simd ****************/
+/* Unpack POSTINGS_PACKED blocks with SSE2 if enable, and this build
+ * has it (any x86-64 build does); else with plain C, which reads the
+ * same bytes.  SSE2 is on to begin with; this is for benchmarks and
+ * tests.  Return whether SSE2 is now in use.
+ */
+bool postings_simd(const bool enable);
+
+#endif // __POSTINGS_H
@@ -0,0 +1,407 @@
+/*
+ * postingsbench - size and speed of packed postings lists
+ *
+ * usage:
+ *   postingsbench [indexFile ...]
+ *
+ * Reads the postings lists of each index file in the text format
+ * ("word docID count docID count ..." a line) - or, if none is given,
+ * makes a synthetic index of Zipf-distributed list lengths - and reports,
+ * for all the lists and again for just the long ones (a block or more),
+ * the bytes per posting and the millions of integers (docIDs and counts)
+ * unpacked a second:
+ *   as text (size only);
+ *   as counters_t, copied out with counters_iterate;
+ *   packed with POSTINGS_VARINT;
+ *   packed with POSTINGS_PACKED, unpacked in plain C and with SSE2;
+ *   packed with the codec postings_codecFor chooses, as index_save does.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#define _POSIX_C_SOURCE 199309L   // clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <time.h>
+#include "postings.h"
+#include "counters.h"
+#include "file.h"
+#include "mem.h"
+
+/**************** file-local global types ****************/
+/* the postings of every word, end to end */
+typedef struct corpus {
+  int nLists;                 // words
+  long nPostings;             // postings, all words
+  long textBytes;             // size of the index file; 0 if synthetic
+  int* starts;                // list i is postings starts[i]..starts[i+1]-1
+  int* docIDs;
+  int* counts;
+} corpus_t;
+
+/* where copyCount puts the next posting */
+typedef struct cursor {
+  int* docIDs;
+  int* counts;
+} cursor_t;
+
+/* the size and speed of one way of keeping the lists */
+typedef struct result {
+  long postings;              // in the lists measured
+  double bytes;               // bytes per posting
+  double rate;                // millions of integers unpacked a second; 0 if not timed
+} result_t;
+
+/* which lists to measure */
+typedef enum { ALL_LISTS, LONG_LISTS } which_t;
+
+/* the codecs, as the benchmark names them */
+typedef enum { VARINT, PACKED, BY_LENGTH } choice_t;
+
+/**************** file-local global variables ****************/
+static const double MINSECS = 0.5;      // time each measurement this long
+static const int SYNTHETIC_WORDS = 20000;
+static const int SYNTHETIC_DOCS = 100000;
+
+/**************** local functions ****************/
+static corpus_t* readIndex(const char* path);
+static corpus_t* makeIndex(void);
+static void addPosting(corpus_t* corpus, long* capacity, const int docID,
+                       const int count);
+static void bench(const char* label, corpus_t* corpus);
+static result_t benchText(corpus_t* corpus, const which_t which);
+static result_t benchCounters(corpus_t* corpus, const which_t which);
+static result_t benchCodec(corpus_t* corpus, const which_t which,
+                           const choice_t choice, const bool simd);
+static bool measured(corpus_t* corpus, const which_t which, const int i);
+static void printRow(const char* label, result_t all, result_t longs);
+static void copyCount(void* arg, const int key, const int count);
+static void corpusDelete(corpus_t* corpus);
+static double now(void);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc == 1) {
+    corpus_t* corpus = makeIndex();
+    bench("(synthetic)", corpus);
+    corpusDelete(corpus);
+  }
+  for (int i = 1; i < argc; i++) {
+    corpus_t* corpus = readIndex(argv[i]);
+    if (corpus == NULL) {
+      fprintf(stderr, "%s: cannot read '%s'\n", argv[0], argv[i]);
+      exit(1);
+    }
+    bench(argv[i], corpus);
+    corpusDelete(corpus);
+  }
+  printf("B = bytes per posting; Mint/s = millions of docIDs and counts "
+         "unpacked a second\n");
+  return 0;
+}
+
+/**************** bench ****************/
+/* Measure each way of keeping the lists, and print a table.
+ */
+static void
+bench(const char* label, corpus_t* corpus)
+{
+  printf("%s\n", label);
+  printf("  %-18s %24s   %24s\n", "", "all lists",
+         "lists of a block or more");
+  printf("  %-18s %9s %6s %8s   %9s %6s %8s\n", "", "postings", "B", "Mint/s",
+         "postings", "B", "Mint/s");
+  if (corpus->textBytes > 0) {
+    printRow("text", benchText(corpus, ALL_LISTS), benchText(corpus, LONG_LISTS));
+  }
+  printRow("counters_iterate", benchCounters(corpus, ALL_LISTS),
+           benchCounters(corpus, LONG_LISTS));
+  printRow("varint", benchCodec(corpus, ALL_LISTS, VARINT, false),
+           benchCodec(corpus, LONG_LISTS, VARINT, false));
+  printRow("packed, plain C", benchCodec(corpus, ALL_LISTS, PACKED, false),
+           benchCodec(corpus, LONG_LISTS, PACKED, false));
+  if (postings_simd(true)) {
+    printRow("packed, SSE2", benchCodec(corpus, ALL_LISTS, PACKED, true),
+             benchCodec(corpus, LONG_LISTS, PACKED, true));
+  }
+  printRow("by length", benchCodec(corpus, ALL_LISTS, BY_LENGTH, true),
+           benchCodec(corpus, LONG_LISTS, BY_LENGTH, true));
+}
+
+/**************** benchText ****************/
+/* The text format's size; for the long lists, the share of the file
+ * in proportion to their postings.
+ */
+static result_t
+benchText(corpus_t* corpus, const which_t which)
+{
+  result_t result = { 0, 0, 0 };
+  for (int i = 0; i < corpus->nLists; i++) {
+    if (measured(corpus, which, i)) {
+      result.postings += corpus->starts[i + 1] - corpus->starts[i];
+    }
+  }
+  result.bytes = (double) corpus->textBytes / corpus->nPostings;
+  return result;
+}
+
+/**************** benchCounters ****************/
+/* The lists as counters_t: the memory they take, and how fast
+ * counters_iterate copies them out.
+ */
+static result_t
+benchCounters(corpus_t* corpus, const which_t which)
+{
+  result_t result = { 0, 0, 0 };
+  counters_t** ctrs = mem_calloc_assert(corpus->nLists + 1, sizeof(counters_t*),
+                                        "ctrs");
+  long before = mem_threadBytes();
+  for (int i = 0; i < corpus->nLists; i++) {
+    if (measured(corpus, which, i)) {
+      int first = corpus->starts[i], n = corpus->starts[i + 1] - first;
+      ctrs[i] = mem_assert(counters_newSorted(corpus->docIDs + first,
+                                              corpus->counts + first, n), "ctrs");
+      result.postings += n;
+    }
+  }
+  if (result.postings == 0) {
+    mem_free(ctrs);
+    return result;
+  }
+  result.bytes = (double) (mem_threadBytes() - before) / result.postings;
+
+  int* copyIDs = mem_malloc_assert((corpus->nPostings + 1) * sizeof(int), "copy");
+  int* copyCounts = mem_malloc_assert((corpus->nPostings + 1) * sizeof(int), "copy");
+  long copied = 0;
+  double start = now(), secs;
+  do {
+    cursor_t cursor = { copyIDs, copyCounts };
+    for (int i = 0; i < corpus->nLists; i++) {
+      if (ctrs[i] != NULL) {
+        counters_iterate(ctrs[i], &cursor, copyCount);
+      }
+    }
+    copied += result.postings;
+  } while ((secs = now() - start) < MINSECS);
+  result.rate = 2 * copied / secs / 1e6;
+
+  for (int i = 0; i < corpus->nLists; i++) {
+    counters_delete(ctrs[i]);
+  }
+  mem_free(ctrs);
+  mem_free(copyIDs);
+  mem_free(copyCounts);
+  return result;
+}
+
+/**************** benchCodec ****************/
+/* Pack the lists with the codec chosen, then time unpacking them all,
+ * block by block, with SSE2 or without.
+ */
+static result_t
+benchCodec(corpus_t* corpus, const which_t which, const choice_t choice,
+           const bool simd)
+{
+  result_t result = { 0, 0, 0 };
+  size_t* offsets = mem_calloc_assert(corpus->nLists + 1, sizeof(size_t),
+                                      "offsets");
+  unsigned char* packed = mem_malloc_assert(
+      postings_maxBytes(corpus->nPostings) + corpus->nLists, "packed");
+  size_t nBytes = 0;
+  for (int i = 0; i < corpus->nLists; i++) {
+    int first = corpus->starts[i], n = corpus->starts[i + 1] - first;
+    offsets[i] = nBytes;
+    if (measured(corpus, which, i)) {
+      postings_codec_t codec = (choice == VARINT) ? POSTINGS_VARINT
+        : (choice == PACKED) ? POSTINGS_PACKED : postings_codecFor(n);
+      nBytes += postings_encode(codec, corpus->docIDs + first,
+                                corpus->counts + first, n, packed + nBytes);
+      result.postings += n;
+    }
+  }
+  offsets[corpus->nLists] = nBytes;
+  if (result.postings == 0) {
+    mem_free(packed);
+    mem_free(offsets);
+    return result;
+  }
+  result.bytes = (double) nBytes / result.postings;
+
+  postings_simd(simd);
+  int docIDs[POSTINGS_BLOCK], counts[POSTINGS_BLOCK];
+  long unpacked = 0;
+  double start = now(), secs;
+  do {
+    for (int i = 0; i < corpus->nLists; i++) {
+      if (offsets[i + 1] == offsets[i]) {
+        continue;             // not measured
+      }
+      postings_reader_t* reader = postings_reader_new(
+          packed + offsets[i], offsets[i + 1] - offsets[i],
+          corpus->starts[i + 1] - corpus->starts[i]);
+      int k;
+      while ((k = postings_reader_next(reader, docIDs, counts)) > 0) {
+        unpacked += k;
+      }
+      if (k < 0) {
+        fprintf(stderr, "list %d does not unpack\n", i);
+        exit(2);
+      }
+      postings_reader_delete(reader);
+    }
+  } while ((secs = now() - start) < MINSECS);
+  result.rate = 2 * unpacked / secs / 1e6;
+  postings_simd(true);
+
+  mem_free(packed);
+  mem_free(offsets);
+  return result;
+}
+
+/**************** measured ****************/
+/* Is list i one of those measured? */
+static bool
+measured(corpus_t* corpus, const which_t which, const int i)
+{
+  int n = corpus->starts[i + 1] - corpus->starts[i];
+  return n > 0 && (which == ALL_LISTS || n >= POSTINGS_BLOCK);
+}
+
+/**************** printRow ****************/
+static void
+printRow(const char* label, result_t all, result_t longs)
+{
+  printf("  %-18s %9ld %6.2f ", label, all.postings, all.bytes);
+  all.rate > 0 ? printf("%8.1f", all.rate) : printf("%8s", "-");
+  printf("   %9ld %6.2f ", longs.postings, longs.bytes);
+  longs.rate > 0 ? printf("%8.1f\n", longs.rate) : printf("%8s\n", "-");
+}
+
+/**************** copyCount ****************/
+static void
+copyCount(void* arg, const int key, const int count)
+{
+  cursor_t* cursor = arg;
+  *cursor->docIDs++ = key;
+  *cursor->counts++ = count;
+}
+
+/**************** readIndex ****************/
+/* Read the lists of an index file; NULL if it cannot be read.
+ */
+static corpus_t*
+readIndex(const char* path)
+{
+  FILE* fp = fopen(path, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+  file_reader_t* reader = mem_assert(file_reader_new(fp), "reader");
+
+  corpus_t* corpus = mem_calloc_assert(1, sizeof(corpus_t), "corpus");
+  long capacity = 0;
+  int listCapacity = 1024;
+  corpus->starts = mem_malloc_assert(listCapacity * sizeof(int), "starts");
+
+  char* line;
+  size_t len;
+  while ((line = file_reader_line(reader, &len)) != NULL) {
+    corpus->textBytes += len + 1;
+    if (len == 0 || !isalpha((unsigned char) line[0])) {
+      continue;
+    }
+    if (corpus->nLists + 2 > listCapacity) {
+      listCapacity *= 2;
+      int* starts = mem_malloc_assert(listCapacity * sizeof(int), "starts");
+      memcpy(starts, corpus->starts, (corpus->nLists + 1) * sizeof(int));
+      mem_free(corpus->starts);
+      corpus->starts = starts;
+    }
+    corpus->starts[corpus->nLists++] = corpus->nPostings;
+
+    // the line is null-terminated in the reader's buffer
+    char* p = strchr(line, ' ');
+    int docID, count, used;
+    while (p != NULL && sscanf(p, "%d %d%n", &docID, &count, &used) == 2) {
+      addPosting(corpus, &capacity, docID, count);
+      p += used;
+    }
+  }
+  corpus->starts[corpus->nLists] = corpus->nPostings;
+
+  file_reader_delete(reader);
+  fclose(fp);
+  return corpus;
+}
+
+/**************** makeIndex ****************/
+/* Make SYNTHETIC_WORDS lists, the i'th of about SYNTHETIC_DOCS/(i+1)
+ * random docIDs (Zipf's law), with small random counts.
+ */
+static corpus_t*
+makeIndex(void)
+{
+  corpus_t* corpus = mem_calloc_assert(1, sizeof(corpus_t), "corpus");
+  corpus->starts = mem_malloc_assert((SYNTHETIC_WORDS + 1) * sizeof(int),
+                                     "starts");
+  long capacity = 0;
+  srand(2021);
+  for (int i = 0; i < SYNTHETIC_WORDS; i++) {
+    corpus->starts[corpus->nLists++] = corpus->nPostings;
+    int step = i + 1;           // mean gap between docIDs
+    for (int docID = 1 + rand() % step; docID <= SYNTHETIC_DOCS;
+         docID += 1 + rand() % (2 * step)) {
+      addPosting(corpus, &capacity, docID, 1 + rand() % 4);
+    }
+  }
+  corpus->starts[corpus->nLists] = corpus->nPostings;
+  return corpus;
+}
+
+/**************** addPosting ****************/
+static void
+addPosting(corpus_t* corpus, long* capacity, const int docID, const int count)
+{
+  if (corpus->nPostings == *capacity) {
+    *capacity = (*capacity > 0) ? 2 * *capacity : 4096;
+    int* docIDs = mem_malloc_assert(*capacity * sizeof(int), "docIDs");
+    int* counts = mem_malloc_assert(*capacity * sizeof(int), "counts");
+    if (corpus->nPostings > 0) {
+      memcpy(docIDs, corpus->docIDs, corpus->nPostings * sizeof(int));
+      memcpy(counts, corpus->counts, corpus->nPostings * sizeof(int));
+      mem_free(corpus->docIDs);
+      mem_free(corpus->counts);
+    }
+    corpus->docIDs = docIDs;
+    corpus->counts = counts;
+  }
+  corpus->docIDs[corpus->nPostings] = docID;
+  corpus->counts[corpus->nPostings++] = count;
+}
+
+/**************** corpusDelete ****************/
+static void
+corpusDelete(corpus_t* corpus)
+{
+  if (corpus->docIDs != NULL) {
+    mem_free(corpus->docIDs);
+    mem_free(corpus->counts);
+  }
+  mem_free(corpus->starts);
+  mem_free(corpus);
+}
+
+/**************** now ****************/
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,330 @@
+/*
+ * postingstest - round-trip and corruption test for packed postings
+ *
+ * usage:
+ *   postingstest [nLists]
+ *
+ * roundtrip: packs nLists random lists - of every length up to a few
+ *   blocks, with gaps and counts drawn from narrow, wide, and mixed
+ *   ranges, so packed blocks take every bit width and some take
+ *   exceptions - with each codec, and unpacks each, with and without
+ *   SSE2; every list must come back as it went in.
+ * seek: seeks through random lists of more than a block to increasing
+ *   random targets; each seek must land on the block holding the first
+ *   docID at or above the target, or at the end of the list.
+ * edges: an empty list; docID 0; docIDs and counts up to INT_MAX;
+ *   a run of consecutive docIDs, which packs into zero-width blocks.
+ * corrupt: truncates and flips bytes of packed lists; each must either
+ *   unpack to some list in order or be reported corrupt, and seeking
+ *   through it must not read outside it.
+ *
+ * `make postingstest` builds it with -fsanitize=address,undefined, so
+ * a read past the packed bytes shows up as a report.
+ * Prints PASS or FAIL lines; exits non-zero on any failure.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "postings.h"
+#include "mem.h"
+
+/**************** file-local global variables ****************/
+static int nLists = 2000;
+static const int MAX_LENGTH = 5 * POSTINGS_BLOCK + 3;
+
+/**************** local functions ****************/
+static bool testRoundtrip(void);
+static bool testSeek(void);
+static bool testEdges(void);
+static bool testCorrupt(void);
+static bool roundtrip(const int* docIDs, const int* counts, const int n);
+static int randomList(int* docIDs, int* counts);
+static int randomValue(const int kind);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 2 || (argc > 1 && sscanf(argv[1], "%d", &nLists) != 1)
+      || nLists < 1) {
+    fprintf(stderr, "usage: %s [nLists>=1]\n", argv[0]);
+    exit(1);
+  }
+  srand(2021);
+
+  bool ok = testRoundtrip();
+  ok = testSeek() && ok;
+  ok = testEdges() && ok;
+  ok = testCorrupt() && ok;
+
+  postings_simd(true);
+  if (mem_net() != 0) {
+    mem_report(stdout, "FAIL: leaked");
+    ok = false;
+  }
+  return ok ? 0 : 2;
+}
+
+/**************** testRoundtrip ****************/
+static bool
+testRoundtrip(void)
+{
+  int* docIDs = mem_malloc_assert(MAX_LENGTH * sizeof(int), "docIDs");
+  int* counts = mem_malloc_assert(MAX_LENGTH * sizeof(int), "counts");
+  bool ok = true;
+  for (int i = 0; i < nLists && ok; i++) {
+    int n = randomList(docIDs, counts);
+    ok = roundtrip(docIDs, counts, n);
+  }
+  mem_free(docIDs);
+  mem_free(counts);
+  printf("%s: roundtrip, %d lists\n", ok ? "PASS" : "FAIL", nLists);
+  return ok;
+}
+
+/**************** testSeek ****************/
+static bool
+testSeek(void)
+{
+  int* docIDs = mem_malloc_assert(MAX_LENGTH * sizeof(int), "docIDs");
+  int* counts = mem_malloc_assert(MAX_LENGTH * sizeof(int), "counts");
+  unsigned char* packed = mem_malloc_assert(postings_maxBytes(MAX_LENGTH), "packed");
+  int blockIDs[POSTINGS_BLOCK], blockCounts[POSTINGS_BLOCK];
+  bool ok = true;
+  int nSeeks = 0;
+
+  for (int i = 0; i < nLists && ok; i++) {
+    int n = randomList(docIDs, counts);
+    if (n <= POSTINGS_BLOCK) {
+      continue;               // no skip table
+    }
+    postings_codec_t codec = (i % 2) ? POSTINGS_PACKED : POSTINGS_VARINT;
+    size_t len = postings_encode(codec, docIDs, counts, n, packed);
+    postings_reader_t* reader = mem_assert(postings_reader_new(packed, len, n),
+                                           "reader");
+
+    // targets that climb through the list, a random stride at a time
+    long target = docIDs[0] - 1;
+    int first = 0;            // the first docID >= target, or n
+    while (ok) {
+      target += 1 + rand() % (1 + 2 * (docIDs[n - 1] - docIDs[0]) / 5);
+      if (target > INT_MAX) {
+        break;
+      }
+      while (first < n && docIDs[first] < target) {
+        first++;
+      }
+      postings_reader_seek(reader, (int) target);
+      int k = postings_reader_next(reader, blockIDs, blockCounts);
+      int start = first / POSTINGS_BLOCK * POSTINGS_BLOCK;
+      int expect = (first == n) ? 0
+        : (n - start < POSTINGS_BLOCK) ? n - start : POSTINGS_BLOCK;
+      nSeeks++;
+      if (k != expect || (k > 0
+          && (memcmp(blockIDs, docIDs + start, k * sizeof(int)) != 0
+              || memcmp(blockCounts, counts + start, k * sizeof(int)) != 0))) {
+        printf("FAIL: seek to %ld in %d postings: got %d postings, "
+               "expected %d from %d\n", target, n, k, expect, start);
+        ok = false;
+      }
+      if (k == 0) {
+        break;
+      }
+      first = start + k;      // the reader has moved on past the block
+      target = docIDs[first - 1];
+    }
+    postings_reader_delete(reader);
+  }
+
+  mem_free(packed);
+  mem_free(docIDs);
+  mem_free(counts);
+  printf("%s: seek, %d seeks\n", ok ? "PASS" : "FAIL", nSeeks);
+  return ok;
+}
+
+/**************** testEdges ****************/
+static bool
+testEdges(void)
+{
+  int n = 3 * POSTINGS_BLOCK;
+  int* docIDs = mem_malloc_assert(n * sizeof(int), "docIDs");
+  int* counts = mem_malloc_assert(n * sizeof(int), "counts");
+
+  // empty
+  bool ok = roundtrip(docIDs, counts, 0);
+
+  // consecutive docIDs from 0, all counts 1: zero-width blocks
+  for (int i = 0; i < n; i++) {
+    docIDs[i] = i;
+    counts[i] = 1;
+  }
+  ok = roundtrip(docIDs, counts, n) && ok;
+
+  // the same, ending at INT_MAX, with counts of INT_MAX
+  for (int i = 0; i < n; i++) {
+    docIDs[i] = INT_MAX - n + 1 + i;
+    counts[i] = INT_MAX - i;
+  }
+  ok = roundtrip(docIDs, counts, n) && ok;
+
+  // one posting, and one block, each spanning all the docIDs
+  docIDs[0] = INT_MAX;
+  counts[0] = 0;
+  ok = roundtrip(docIDs, counts, 1) && ok;
+  for (int i = 0; i < POSTINGS_BLOCK; i++) {
+    docIDs[i] = (i == POSTINGS_BLOCK - 1) ? INT_MAX : i;
+  }
+  ok = roundtrip(docIDs, counts, POSTINGS_BLOCK) && ok;
+
+  mem_free(docIDs);
+  mem_free(counts);
+  printf("%s: edges\n", ok ? "PASS" : "FAIL");
+  return ok;
+}
+
+/**************** testCorrupt ****************/
+static bool
+testCorrupt(void)
+{
+  int* docIDs = mem_malloc_assert(MAX_LENGTH * sizeof(int), "docIDs");
+  int* counts = mem_malloc_assert(MAX_LENGTH * sizeof(int), "counts");
+  int* outIDs = mem_malloc_assert(MAX_LENGTH * sizeof(int), "outIDs");
+  int* outCounts = mem_malloc_assert(MAX_LENGTH * sizeof(int), "outCounts");
+  bool ok = true;
+  int nCorrupt = 0, tries = 0;
+
+  for (int i = 0; i < nLists / 4 + 1 && ok; i++) {
+    int n = randomList(docIDs, counts);
+    postings_codec_t codec = (i % 2) ? POSTINGS_PACKED : POSTINGS_VARINT;
+    size_t max = postings_maxBytes(n);
+    unsigned char* packed = mem_malloc_assert(max, "packed");
+    size_t len = postings_encode(codec, docIDs, counts, n, packed);
+
+    for (int t = 0; t < 8 && ok; t++, tries++) {
+      // a copy just big enough, so a read past it is caught
+      size_t cut = (t == 0) ? (size_t) rand() % (len + 1) : len;
+      unsigned char* bad = mem_malloc_assert(cut + 1, "bad");
+      memcpy(bad, packed, cut);
+      if (t > 0) {
+        bad[rand() % len] ^= (unsigned char) (1 + rand() % 255);
+      }
+      postings_simd(t % 2 == 0);
+      if (!postings_decode(bad, cut, n, outIDs, outCounts)) {
+        nCorrupt++;
+      }
+      else {
+        for (int k = 1; k < n; k++) {
+          if (outIDs[k] <= outIDs[k - 1]) {
+            printf("FAIL: corrupt: list %d unpacked out of order\n", i);
+            ok = false;
+            break;
+          }
+        }
+      }
+
+      // seeking through it must stay inside it too
+      postings_reader_t* reader = mem_assert(postings_reader_new(bad, cut, n),
+                                             "reader");
+      postings_reader_seek(reader, n > 0 ? docIDs[rand() % n] : 0);
+      while (postings_reader_next(reader, outIDs, outCounts) > 0) {
+        postings_reader_seek(reader, rand());
+      }
+      postings_reader_delete(reader);
+      mem_free(bad);
+    }
+    mem_free(packed);
+  }
+
+  mem_free(docIDs);
+  mem_free(counts);
+  mem_free(outIDs);
+  mem_free(outCounts);
+  printf("%s: corrupt, %d of %d damaged lists reported\n",
+         ok ? "PASS" : "FAIL", nCorrupt, tries);
+  return ok;
+}
+
+/**************** roundtrip ****************/
+/* Pack the list with each codec, and unpack it with and without SSE2;
+ * is it the same list each time?
+ */
+static bool
+roundtrip(const int* docIDs, const int* counts, const int n)
+{
+  unsigned char* packed = mem_malloc_assert(postings_maxBytes(n), "packed");
+  int* outIDs = mem_malloc_assert((n + 1) * sizeof(int), "outIDs");
+  int* outCounts = mem_malloc_assert((n + 1) * sizeof(int), "outCounts");
+  bool ok = true;
+
+  for (int c = POSTINGS_VARINT; c <= POSTINGS_PACKED && ok; c++) {
+    size_t len = postings_encode(c, docIDs, counts, n, packed);
+    if (len > postings_maxBytes(n)) {
+      printf("FAIL: %d postings packed in %zu bytes, over the %zu promised\n",
+             n, len, postings_maxBytes(n));
+      ok = false;
+    }
+    for (int simd = 0; simd <= 1 && ok; simd++) {
+      postings_simd(simd);
+      memset(outIDs, 0xFF, (n + 1) * sizeof(int));
+      if (!postings_decode(packed, len, n, outIDs, outCounts)
+          || memcmp(outIDs, docIDs, n * sizeof(int)) != 0
+          || memcmp(outCounts, counts, n * sizeof(int)) != 0) {
+        printf("FAIL: %d postings, codec %d, %s\n", n, c,
+               simd ? "SSE2" : "plain C");
+        ok = false;
+      }
+    }
+  }
+
+  mem_free(packed);
+  mem_free(outIDs);
+  mem_free(outCounts);
+  return ok;
+}
+
+/**************** randomList ****************/
+/* Fill docIDs[] and counts[] with a random list, of random length
+ * below MAX_LENGTH; return the length.
+ */
+static int
+randomList(int* docIDs, int* counts)
+{
+  int n = rand() % MAX_LENGTH;
+  int gapKind = rand() % 4, countKind = rand() % 4;
+  long docID = -1;
+  for (int i = 0; i < n; i++) {
+    docID += 1 + randomValue(gapKind);
+    if (docID > INT_MAX) {
+      return i;               // out of docIDs: a shorter list
+    }
+    docIDs[i] = (int) docID;
+    counts[i] = randomValue(countKind);
+  }
+  return n;
+}
+
+/**************** randomValue ****************/
+/* A random value: kind 0, below 4; kind 1, below 2^(1..20); kind 2, mostly
+ * below 16 with a few up to 2^24, which make exceptions; kind 3, up to
+ * 2^30, so that docIDs run out soon.
+ */
+static int
+randomValue(const int kind)
+{
+  switch (kind) {
+  case 0:
+    return rand() % 4;
+  case 1:
+    return rand() % (1 << (1 + rand() % 20));
+  case 2:
+    return (rand() % 20 == 0) ? rand() % (1 << 24) : rand() % 16;
+  default:
+    return (int) (((long) rand() << 8 ^ rand()) % (1L << 30));
+  }
+}
@@ -0,0 +1,181 @@
+/*
+ * queue.c - CS50 'queue' module
+ *
+ * see queue.h for more information.
+ *
+ * Each cell's sequence number says what it is waiting for.  A cell at
+ * position pos is free for the producer that claims pos when seq == pos,
+ * and holds an item for the consumer that claims pos when seq == pos+1.
+ * Having filled or emptied the cell, the thread sets seq to hand it on:
+ * to pos+1 for the consumer, or to pos+capacity for the producer one lap
+ * later.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "queue.h"
+#include "mem.h"
+
+/**************** local types ****************/
+typedef struct cell {
+  atomic_size_t seq;          // whose turn it is; see above
+  _Atomic(void*) item;        // the item, while the cell is full
+} cell_t;
+
+/**************** global types ****************/
+// head and tail each get a cache line to themselves, apart from the
+// read-mostly fields, so producers and consumers do not share lines.
+typedef struct queue {
+  cell_t* cells;              // the ring, capacity cells long
+  size_t mask;                // capacity - 1; capacity is a power of two
+  char pad0[64];
+  atomic_size_t tail;         // next position to push
+  char pad1[64];
+  atomic_size_t head;         // next position to pop
+  char pad2[64];
+} queue_t;
+
+/**************** global functions ****************/
+/* that is, visible outside this file */
+/* see queue.h for comments about exported functions */
+
+/**************** queue_new() ****************/
+/* see queue.h for description */
+queue_t*
+queue_new(const int capacity)
+{
+  if (capacity <= 0) {
+    return NULL;
+  }
+
+  size_t size = 1;
+  while (size < (size_t) capacity) {
+    size *= 2;
+  }
+
+  queue_t* queue = mem_malloc(sizeof(queue_t));
+  if (queue == NULL) {
+    return NULL;              // error allocating queue
+  }
+  queue->cells = mem_malloc(size * sizeof(cell_t));
+  if (queue->cells == NULL) {
+    mem_free(queue);
+    return NULL;              // error allocating cells
+  }
+
+  // initialize contents of queue structure
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&queue->cells[i].seq, i);
+    atomic_init(&queue->cells[i].item, NULL);
+  }
+  queue->mask = size - 1;
+  atomic_init(&queue->tail, 0);
+  atomic_init(&queue->head, 0);
+  return queue;
+}
+
+/**************** queue_push() ****************/
+/* see queue.h for description */
+bool
+queue_push(queue_t* queue, void* item)
+{
+  if (queue == NULL || item == NULL) {
+    return false;
+  }
+
+  size_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  for (;;) {
+    cell_t* cell = &queue->cells[pos & queue->mask];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+    if (diff == 0) {
+      // the cell is free for position pos; try to claim pos
+      if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        atomic_store_explicit(&cell->item, item, memory_order_relaxed);
+        atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+        return true;
+      }
+      // another producer claimed it; pos now holds the new tail
+    } else if (diff < 0) {
+      return false;           // the cell still holds last lap's item: full
+    } else {
+      // another producer got here first; catch up
+      pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    }
+  }
+}
+
+/**************** queue_pop() ****************/
+/* see queue.h for description */
+void*
+queue_pop(queue_t* queue)
+{
+  if (queue == NULL) {
+    return NULL;
+  }
+
+  size_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  for (;;) {
+    cell_t* cell = &queue->cells[pos & queue->mask];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+    if (diff == 0) {
+      // the cell holds the item for position pos; try to claim pos
+      if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        void* item = atomic_load_explicit(&cell->item, memory_order_relaxed);
+        atomic_store_explicit(&cell->seq, pos + queue->mask + 1,
+                              memory_order_release);
+        return item;
+      }
+    } else if (diff < 0) {
+      return NULL;            // nothing pushed here yet: empty
+    } else {
+      pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    }
+  }
+}
+
+/**************** queue_size() ****************/
+/* see queue.h for description */
+int
+queue_size(queue_t* queue)
+{
+  if (queue == NULL) {
+    return 0;
+  }
+
+  size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  return (tail > head) ? (int) (tail - head) : 0;
+}
+
+/**************** queue_delete() ****************/
+/* see queue.h for description */
+void
+queue_delete(queue_t* queue, void (*itemdelete)(void* item) )
+{
+  if (queue != NULL) {
+    void* item;
+    while ((item = queue_pop(queue)) != NULL) {
+      if (itemdelete != NULL) {         // if possible...
+        (*itemdelete)(item);            // delete the item
+      }
+    }
+    mem_free(queue->cells);
+    mem_free(queue);
+  }
+
+#ifdef MEMTEST
+  mem_report(stdout, "End of queue_delete");
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+ * queue.h - header file for CS50 'queue' module
+ *
+ * A *queue* is a bounded, first-in first-out ring of items that any
+ * number of threads may push to and pop from at once, without locks
+ * (Dmitry Vyukov's bounded MPMC queue).  Each slot carries a sequence
+ * number saying whose turn it is; a thread claims a slot with one
+ * compare-and-swap on the head or tail index, so a stalled thread never
+ * holds others up for long, and producers and consumers touch different
+ * cache lines.
+ *
+ * Like a bag, it holds opaque pointers to items, and NULL is not an item.
+ * Unlike a bag, it is fixed in size: a push to a full queue fails.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#ifndef __QUEUE_H
+#define __QUEUE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct queue queue_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** queue_new ****************/
+/* Create a new (empty) queue.
+ *
+ * Caller provides:
+ *   the number of items it must hold (> 0); we round up to a power of two.
+ * We return:
+ *   pointer to a new queue, or NULL if error.
+ * Caller is responsible for:
+ *   later calling queue_delete.
+ */
+queue_t* queue_new(const int capacity);
+
+/**************** queue_push ****************/
+/* Add item to the tail of the queue; safe to call from any thread.
+ *
+ * Caller provides:
+ *   valid queue pointer, valid item pointer.
+ * We return:
+ *   true if the item was added;
+ *   false if the queue is full, or any parameter is NULL.
+ */
+bool queue_push(queue_t* queue, void* item);
+
+/**************** queue_pop ****************/
+/* Remove and return the item at the head of the queue; safe to call
+ * from any thread.
+ *
+ * We return:
+ *   the item, or NULL if the queue is empty or NULL.
+ */
+void* queue_pop(queue_t* queue);
+
+/**************** queue_size ****************/
+/* Return the number of items in the queue - exact when no thread is
+ * pushing or popping, a snapshot otherwise; 0 if queue is NULL.
+ */
+int queue_size(queue_t* queue);
+
+/**************** queue_delete ****************/
+/* Delete queue, calling a delete function on each remaining item.
+ *
+ * Caller provides:
+ *   valid queue pointer,
+ *   valid pointer to function that handles one item (may be NULL).
+ * We do:
+ *   if queue==NULL, do nothing.
+ *   otherwise, unless itemfunc==NULL, call the itemfunc on each item.
+ *   free the queue itself.
+ * Notes:
+ *   no other thread may be using the queue.
+ */
+void queue_delete(queue_t* queue, void (*itemdelete)(void* item) );
+
+#endif // __QUEUE_H
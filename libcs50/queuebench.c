@@ -0,0 +1,181 @@
+/*
+ * queuebench - throughput of the concurrent queue and deque
+ *
+ * usage:
+ *   queuebench [maxThreads [nOps]]
+ *
+ * For 1, 2, 4, ... maxThreads threads (default: the number of cores,
+ * but at least 4), reports millions of items per second through:
+ *   queue: each thread alternately pushes and pops, nOps times in all;
+ *   bag+mutex: the same, through a bag guarded by one mutex - what a
+ *     program would use without the queue;
+ *   deque: one owner pushes nOps items, popping one in three, while the
+ *     other threads steal, until all are out.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L   // clock_gettime, sysconf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "queue.h"
+#include "deque.h"
+#include "bag.h"
+#include "mem.h"
+
+/**************** file-local global variables ****************/
+static long nOps = 2000000;
+static int nThreads;                // threads in the current run
+static queue_t* queue;
+static bag_t* bag;
+static pthread_mutex_t bagLock = PTHREAD_MUTEX_INITIALIZER;
+static deque_t* deque;
+static atomic_long taken;           // deque items taken so far
+static atomic_bool ownerDone;       // the deque's owner has pushed all
+
+/**************** local functions ****************/
+static double run(void* (*func)(void* arg));
+static void* queueWorker(void* arg);
+static void* bagWorker(void* arg);
+static void* dequeWorker(void* arg);
+static double now(void);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  long nCores = sysconf(_SC_NPROCESSORS_ONLN);
+  int maxThreads = (nCores > 4) ? (int) nCores : 4;
+  if (argc > 3
+      || (argc > 1 && sscanf(argv[1], "%d", &maxThreads) != 1)
+      || (argc > 2 && sscanf(argv[2], "%ld", &nOps) != 1)
+      || maxThreads < 1 || nOps < 1) {
+    fprintf(stderr, "usage: %s [maxThreads [nOps]]\n", argv[0]);
+    exit(1);
+  }
+
+  printf("%ld cores; Mitems/s for %ld items\n", nCores, nOps);
+  printf("%8s %10s %10s %10s\n", "threads", "queue", "bag+mutex", "deque");
+  for (nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+    queue = queue_new(4096);
+    double queueSecs = run(queueWorker);
+    queue_delete(queue, NULL);
+
+    bag = bag_new();
+    double bagSecs = run(bagWorker);
+    bag_delete(bag, NULL);
+
+    deque = deque_new();
+    atomic_store(&taken, 0);
+    atomic_store(&ownerDone, false);
+    double dequeSecs = run(dequeWorker);
+    deque_delete(deque, NULL);
+
+    printf("%8d %10.1f %10.1f %10.1f\n", nThreads, nOps / queueSecs / 1e6,
+           nOps / bagSecs / 1e6, nOps / dequeSecs / 1e6);
+  }
+  return 0;
+}
+
+/**************** run ****************/
+/* Run func in nThreads threads, passing each its index; return seconds.
+ */
+static double
+run(void* (*func)(void* arg))
+{
+  pthread_t* threads = mem_malloc_assert(nThreads * sizeof(pthread_t),
+                                         "threads");
+  double start = now();
+  for (long i = 0; i < nThreads; i++) {
+    pthread_create(&threads[i], NULL, func, (void*) i);
+  }
+  for (int i = 0; i < nThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  double secs = now() - start;
+  mem_free(threads);
+  return secs;
+}
+
+/**************** queueWorker ****************/
+/* This thread's share of nOps: push one, pop one.
+ */
+static void*
+queueWorker(void* arg)
+{
+  long share = nOps / nThreads;
+  for (long i = 0; i < share; i++) {
+    while (!queue_push(queue, (void*) (uintptr_t) (i + 1))) {
+      // full; try again
+    }
+    while (queue_pop(queue) == NULL) {
+      // another thread took ours; wait for the next
+    }
+  }
+  return NULL;
+}
+
+/**************** bagWorker ****************/
+/* The same, through the bag under its mutex.
+ */
+static void*
+bagWorker(void* arg)
+{
+  long share = nOps / nThreads;
+  for (long i = 0; i < share; i++) {
+    pthread_mutex_lock(&bagLock);
+    bag_insert(bag, (void*) (uintptr_t) (i + 1));
+    pthread_mutex_unlock(&bagLock);
+
+    void* item = NULL;
+    while (item == NULL) {
+      pthread_mutex_lock(&bagLock);
+      item = bag_extract(bag);
+      pthread_mutex_unlock(&bagLock);
+    }
+  }
+  return NULL;
+}
+
+/**************** dequeWorker ****************/
+/* Thread 0 owns the deque and pushes; the others steal.
+ */
+static void*
+dequeWorker(void* arg)
+{
+  if ((uintptr_t) arg == 0) {
+    for (long i = 0; i < nOps; i++) {
+      deque_push(deque, (void*) (uintptr_t) (i + 1));
+      if (i % 3 == 2 && deque_pop(deque) != NULL) {
+        atomic_fetch_add_explicit(&taken, 1, memory_order_relaxed);
+      }
+    }
+    atomic_store(&ownerDone, true);
+    while (deque_pop(deque) != NULL) {
+      atomic_fetch_add_explicit(&taken, 1, memory_order_relaxed);
+    }
+  } else {
+    while (!atomic_load(&ownerDone) || deque_size(deque) > 0) {
+      if (deque_steal(deque) != NULL) {
+        atomic_fetch_add_explicit(&taken, 1, memory_order_relaxed);
+      }
+    }
+  }
+  return NULL;
+}
+
+/**************** now ****************/
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
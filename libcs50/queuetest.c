@@ -0,0 +1,259 @@
+/*
+ * queuetest - stress test for the concurrent queue and deque
+ *
+ * usage:
+ *   queuetest [nThreads [nItems]]
+ *
+ * queue: half the threads push nItems items each while the other half
+ *   pop; every item must come out exactly once, and each consumer must
+ *   see each producer's items in the order they were pushed.
+ * deque: one owner pushes nItems items, popping some of them as it goes,
+ *   while the other threads steal; every item must come out exactly once.
+ *
+ * `make queuetest` builds it with -fsanitize=thread, so a data race
+ * shows up as a report even when the counts come out right.
+ * Prints PASS or FAIL lines; exits non-zero on any failure.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "queue.h"
+#include "deque.h"
+#include "mem.h"
+
+/**************** file-local global types ****************/
+typedef struct worker {
+  pthread_t thread;           // the thread itself
+  int id;                     // 0..nThreads-1
+  long count;                 // items it took
+} worker_t;
+
+/**************** file-local global variables ****************/
+static int nThreads = 4;
+static long nItems = 200000;
+static queue_t* queue;
+static deque_t* deque;
+static atomic_char* seen;           // seen[item] = times item came out
+static atomic_long taken;           // items taken so far, all threads
+static atomic_bool failed;          // any check failed
+static atomic_bool ownerDone;       // the deque's owner has pushed all
+
+/**************** local functions ****************/
+static bool testQueue(void);
+static void* queueProducer(void* arg);
+static void* queueConsumer(void* arg);
+static bool testDeque(void);
+static void* dequeOwner(void* arg);
+static void* dequeThief(void* arg);
+static void take(const uintptr_t item);
+static bool checkSeen(const long nTotal);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 3
+      || (argc > 1 && sscanf(argv[1], "%d", &nThreads) != 1)
+      || (argc > 2 && sscanf(argv[2], "%ld", &nItems) != 1)
+      || nThreads < 2 || nItems < 1) {
+    fprintf(stderr, "usage: %s [nThreads>=2 [nItems>=1]]\n", argv[0]);
+    exit(1);
+  }
+
+  bool ok = testQueue();
+  ok = testDeque() && ok;
+
+  if (mem_net() != 0) {
+    mem_report(stdout, "FAIL: leaked");
+    ok = false;
+  }
+  return ok ? 0 : 2;
+}
+
+/**************** testQueue ****************/
+static bool
+testQueue(void)
+{
+  int nProducers = nThreads / 2;
+  int nConsumers = nThreads - nProducers;
+  long nTotal = nProducers * nItems;
+  queue = queue_new(1024);    // small, so producers often find it full
+  seen = mem_calloc_assert(nTotal, sizeof(atomic_char), "seen[]");
+  atomic_store(&taken, 0);
+  atomic_store(&failed, false);
+
+  worker_t* workers = mem_calloc_assert(nThreads, sizeof(worker_t), "workers");
+  for (int i = 0; i < nThreads; i++) {
+    workers[i].id = i;
+    pthread_create(&workers[i].thread, NULL,
+                   (i < nProducers) ? queueProducer : queueConsumer,
+                   &workers[i]);
+  }
+  for (int i = 0; i < nThreads; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  bool ok = !atomic_load(&failed) && checkSeen(nTotal)
+            && queue_size(queue) == 0;
+  printf("%s: queue, %d producers x %ld items, %d consumers\n",
+         ok ? "PASS" : "FAIL", nProducers, nItems, nConsumers);
+
+  queue_delete(queue, NULL);
+  mem_free(workers);
+  mem_free(seen);
+  return ok;
+}
+
+/**************** queueProducer ****************/
+/* Push items id*nItems+1 .. (id+1)*nItems, in order, retrying when full.
+ */
+static void*
+queueProducer(void* arg)
+{
+  worker_t* me = arg;
+  for (long i = 0; i < nItems; i++) {
+    uintptr_t item = me->id * nItems + i + 1;
+    while (!queue_push(queue, (void*) item)) {
+      // full; spin until a consumer makes room
+    }
+  }
+  return NULL;
+}
+
+/**************** queueConsumer ****************/
+/* Pop until every item is out; items from any one producer must come
+ * in increasing order.
+ */
+static void*
+queueConsumer(void* arg)
+{
+  int nProducers = nThreads / 2;
+  long nTotal = nProducers * nItems;
+  uintptr_t* last = mem_calloc_assert(nProducers, sizeof(uintptr_t), "last");
+
+  while (atomic_load(&taken) < nTotal) {
+    uintptr_t item = (uintptr_t) queue_pop(queue);
+    if (item != 0) {
+      int producer = (item - 1) / nItems;
+      if (item <= last[producer]) {
+        atomic_store(&failed, true);    // out of order
+      }
+      last[producer] = item;
+      take(item);
+    }
+  }
+  mem_free(last);
+  return NULL;
+}
+
+/**************** testDeque ****************/
+static bool
+testDeque(void)
+{
+  deque = deque_new();
+  seen = mem_calloc_assert(nItems, sizeof(atomic_char), "seen[]");
+  atomic_store(&taken, 0);
+  atomic_store(&failed, false);
+  atomic_store(&ownerDone, false);
+
+  worker_t* workers = mem_calloc_assert(nThreads, sizeof(worker_t), "workers");
+  for (int i = 0; i < nThreads; i++) {
+    workers[i].id = i;
+    pthread_create(&workers[i].thread, NULL,
+                   (i == 0) ? dequeOwner : dequeThief, &workers[i]);
+  }
+  long stolen = 0;
+  for (int i = 0; i < nThreads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    if (i > 0) {
+      stolen += workers[i].count;
+    }
+  }
+
+  bool ok = !atomic_load(&failed) && checkSeen(nItems)
+            && deque_size(deque) == 0;
+  printf("%s: deque, 1 owner x %ld items, %d thieves stole %ld\n",
+         ok ? "PASS" : "FAIL", nItems, nThreads - 1, stolen);
+
+  deque_delete(deque, NULL);
+  mem_free(workers);
+  mem_free(seen);
+  return ok;
+}
+
+/**************** dequeOwner ****************/
+/* Push all the items, popping one after every third push - so the deque
+ * grows, and the owner and thieves race for the last item - then pop
+ * whatever the thieves leave.
+ */
+static void*
+dequeOwner(void* arg)
+{
+  worker_t* me = arg;
+  for (long i = 0; i < nItems; i++) {
+    deque_push(deque, (void*) (uintptr_t) (i + 1));
+    if (i % 3 == 2) {
+      uintptr_t item = (uintptr_t) deque_pop(deque);
+      if (item != 0) {
+        take(item);
+        me->count++;
+      }
+    }
+  }
+  atomic_store(&ownerDone, true);
+
+  uintptr_t item;
+  while ((item = (uintptr_t) deque_pop(deque)) != 0) {
+    take(item);
+    me->count++;
+  }
+  return NULL;
+}
+
+/**************** dequeThief ****************/
+/* Steal until the owner is done and the deque is empty.
+ */
+static void*
+dequeThief(void* arg)
+{
+  worker_t* me = arg;
+  while (!atomic_load(&ownerDone) || deque_size(deque) > 0) {
+    uintptr_t item = (uintptr_t) deque_steal(deque);
+    if (item != 0) {
+      take(item);
+      me->count++;
+    }
+  }
+  return NULL;
+}
+
+/**************** take ****************/
+/* Record that item (1-based) came out once more.
+ */
+static void
+take(const uintptr_t item)
+{
+  atomic_fetch_add(&seen[item - 1], 1);
+  atomic_fetch_add(&taken, 1);
+}
+
+/**************** checkSeen ****************/
+/* Did every item come out exactly once?
+ */
+static bool
+checkSeen(const long nTotal)
+{
+  for (long i = 0; i < nTotal; i++) {
+    if (atomic_load(&seen[i]) != 1) {
+      printf("item %ld came out %d times\n", i + 1, (int) atomic_load(&seen[i]));
+      return false;
+    }
+  }
+  return true;
+}
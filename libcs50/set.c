@@ -0,0 +1,274 @@
+/*
+ * set.c - CS50 'set' module
+ *
+ * see set.h for more information.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "set.h"
+#include "mem.h"
+
+/**************** file-local global variables ****************/
+static const int SMALL_SET = 8;   // nodes a set of its own mallocs before pooling
+
+/**************** local types ****************/
+typedef struct setnode {
+  char* key;                  // search key for this item
+  void* item;                 // pointer to data for this item
+  struct setnode *next;       // link to next node
+} setnode_t;
+
+/**************** global types ****************/
+typedef struct set {
+  struct setnode *head;       // head of the list of items in set
+  struct setnode *tail;       // tail of the list; new items go here
+  mem_arena_t* arena;         // where nodes and keys come from, if not NULL
+  mem_pool_t* pool;           // otherwise, where nodes come from
+  bool ownpool;               // is pool ours, made once the set outgrows SMALL_SET?
+  int nodes;                  // nodes allocated so far
+} set_t;
+
+/**************** global functions ****************/
+/* that is, visible outside this file */
+/* see set.h for comments about exported functions */
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static setnode_t* setnode_new(set_t* set, const char* key, void* item);
+static set_t* set_alloc(mem_arena_t* arena, mem_pool_t* pool);
+
+/**************** set_new() ****************/
+/* see set.h for description */
+set_t*
+set_new(void)
+{
+  set_t* set = set_alloc(NULL, NULL);
+  if (set != NULL) {
+    set->ownpool = true;      // made when needed: a small set costs no pool
+  }
+  return set;
+}
+
+/**************** set_pool_new() ****************/
+/* see set.h for description */
+mem_pool_t*
+set_pool_new(const bool shared)
+{
+  return mem_pool_new(sizeof(setnode_t), shared);
+}
+
+/**************** set_new_pool() ****************/
+/* see set.h for description */
+set_t*
+set_new_pool(mem_pool_t* pool)
+{
+  return (pool != NULL) ? set_alloc(NULL, pool) : set_new();
+}
+
+/**************** set_new_arena() ****************/
+/* see set.h for description */
+set_t*
+set_new_arena(mem_arena_t* arena)
+{
+  return (arena != NULL) ? set_alloc(arena, NULL) : set_new();
+}
+
+/**************** set_alloc ****************/
+/* Allocate and initialize an empty set drawing on arena or pool */
+static set_t*  // not visible outside this file
+set_alloc(mem_arena_t* arena, mem_pool_t* pool)
+{
+  set_t* set = (arena != NULL) ? mem_arena_alloc(arena, sizeof(set_t))
+                               : mem_malloc(sizeof(set_t));
+
+  if (set == NULL) {
+    return NULL;              // error allocating set
+  } else {
+    // initialize contents of set structure
+    set->head = NULL;
+    set->tail = NULL;
+    set->arena = arena;
+    set->pool = pool;
+    set->ownpool = false;
+    set->nodes = 0;
+    return set;
+  }
+}
+
+/**************** set_insert() ****************/
+/* see set.h for description */
+bool
+set_insert(set_t* set, const char* key, void* item)
+{
+  if (set == NULL || key == NULL || item == NULL) {
+    return false;
+  }
+  if (set_find(set, key) != NULL) {
+    return false;             // key already present
+  }
+
+  // allocate a new node to be added to the list
+  setnode_t* new = setnode_new(set, key, item);
+  if (new == NULL) {
+    return false;
+  }
+
+  // add it to the tail of the list, so iteration follows insertion order
+  if (set->tail == NULL) {
+    set->head = new;
+  } else {
+    set->tail->next = new;
+  }
+  set->tail = new;
+
+#ifdef MEMTEST
+  mem_report(stdout, "After set_insert");
+#endif
+
+  return true;
+}
+
+/**************** setnode_new ****************/
+/* Allocate and initialize a setnode, with its own copy of key */
+static setnode_t*  // not visible outside this file
+setnode_new(set_t* set, const char* key, void* item)
+{
+  if (set->arena != NULL) {
+    // node and key side by side in the arena
+    size_t len = strlen(key) + 1;
+    setnode_t* node = mem_arena_alloc(set->arena, sizeof(setnode_t) + len);
+    if (node == NULL) {
+      return NULL;
+    }
+    node->key = (char*) (node + 1);
+    memcpy(node->key, key, len);
+    node->item = item;
+    node->next = NULL;
+    return node;
+  }
+
+  // a set of its own mallocs its first few nodes, and pools the rest
+  bool small = set->ownpool && set->nodes < SMALL_SET;
+  if (!small && set->pool == NULL && (set->pool = set_pool_new(false)) == NULL) {
+    return NULL;
+  }
+  setnode_t* node = small ? mem_malloc(sizeof(setnode_t)) : mem_pool_alloc(set->pool);
+
+  if (node == NULL) {
+    // error allocating memory for node; return error
+    return NULL;
+  }
+
+  node->key = mem_malloc(strlen(key) + 1);
+  if (node->key == NULL) {
+    // error allocating memory for key; cleanup and return error
+    if (small) {
+      mem_free(node);
+    } else {
+      mem_pool_free(set->pool, node);
+    }
+    return NULL;
+  }
+
+  strcpy(node->key, key);
+  node->item = item;
+  node->next = NULL;
+  set->nodes++;
+  return node;
+}
+
+/**************** set_find() ****************/
+/* see set.h for description */
+void*
+set_find(set_t* set, const char* key)
+{
+  if (set == NULL || key == NULL) {
+    return NULL;              // bad set or key
+  }
+
+  for (setnode_t* node = set->head; node != NULL; node = node->next) {
+    if (strcmp(key, node->key) == 0) {
+      return node->item;
+    }
+  }
+  return NULL;                // not found
+}
+
+/**************** set_print() ****************/
+/* see set.h for description */
+void
+set_print(set_t* set, FILE* fp,
+          void (*itemprint)(FILE* fp, const char* key, void* item) )
+{
+  if (fp != NULL) {
+    if (set != NULL) {
+      fputc('{', fp);
+      for (setnode_t* node = set->head; node != NULL; node = node->next) {
+        // print this node
+        if (itemprint != NULL) { // print the node's key and item
+          (*itemprint)(fp, node->key, node->item);
+          if (node->next != NULL) {
+            fputc(',', fp);
+          }
+        }
+      }
+      fputc('}', fp);
+    } else {
+      fputs("(null)", fp);
+    }
+  }
+}
+
+/**************** set_iterate() ****************/
+/* see set.h for description */
+void
+set_iterate(set_t* set, void* arg,
+            void (*itemfunc)(void* arg, const char* key, void* item) )
+{
+  if (set != NULL && itemfunc != NULL) {
+    // call itemfunc with arg, on each item
+    for (setnode_t* node = set->head; node != NULL; node = node->next) {
+      (*itemfunc)(arg, node->key, node->item);
+    }
+  }
+}
+
+/**************** set_delete() ****************/
+/* see set.h for description */
+void
+set_delete(set_t* set, void (*itemdelete)(void* item) )
+{
+  if (set != NULL) {
+    int i = 0;                          // nodes are in the order allocated
+    for (setnode_t* node = set->head; node != NULL; i++) {
+      if (itemdelete != NULL) {         // if possible...
+        (*itemdelete)(node->item);      // delete node's item
+      }
+      setnode_t* next = node->next;     // remember what comes next
+      if (set->arena == NULL) {         // arena nodes go with the arena
+        mem_free(node->key);            // free the key string
+        if (!set->ownpool) {
+          mem_pool_free(set->pool, node);
+        } else if (i < SMALL_SET) {     // our own pool goes all at once
+          mem_free(node);
+        }
+      }
+      node = next;                      // and move on to next
+    }
+
+    if (set->arena == NULL) {
+      if (set->ownpool && set->pool != NULL) {
+        mem_pool_delete(set->pool);
+      }
+      mem_free(set);
+    }
+  }
+
+#ifdef MEMTEST
+  mem_report(stdout, "End of set_delete");
+#endif
+}
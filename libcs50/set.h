@@ -16,6 +16,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include "mem.h"
 
 /**************** global types ****************/
 typedef struct set set_t;  // opaque to users of the module
@@ -28,12 +29,52 @@ typedef struct set set_t;  // opaque to users of the module
  * We return:
  *   pointer to a new set, or NULL if error.
  * We guarantee:
- *   The set is initialized empty.
+ *   The set is initialized empty; it mallocs its first few nodes, and
+ *   keeps the rest in a pool of its own, made once it needs one.
  * Caller is responsible for:
  *   later calling set_delete.
  */
 set_t* set_new(void);
 
+/**************** set_pool_new ****************/
+/* Create a pool of set nodes, for several sets to share via set_new_pool.
+ *
+ * Caller provides:
+ *   whether the pool is shared among threads (see mem_pool_new).
+ * We return:
+ *   pointer to a new pool, or NULL if error.
+ * Caller is responsible for:
+ *   later calling mem_pool_delete, after set_delete on every set using it.
+ */
+mem_pool_t* set_pool_new(const bool shared);
+
+/**************** set_new_pool ****************/
+/* Create a new (empty) set whose nodes come from the given pool.
+ *
+ * Caller provides:
+ *   valid pool pointer, from set_pool_new (NULL means the same as set_new).
+ * We return:
+ *   pointer to a new set, or NULL if error.
+ * Caller is responsible for:
+ *   later calling set_delete, which returns the nodes to the pool;
+ *   keeping the pool alive as long as the set.
+ */
+set_t* set_new_pool(mem_pool_t* pool);
+
+/**************** set_new_arena ****************/
+/* Create a new (empty) set whose nodes and key copies come from an arena.
+ *
+ * Caller provides:
+ *   valid arena pointer (NULL means the same as set_new).
+ * We return:
+ *   pointer to a new set, or NULL if error.
+ * Caller is responsible for:
+ *   later calling set_delete, which deletes items but leaves the nodes
+ *   and key strings for the caller to release with the arena;
+ *   keeping the arena alive (and un-reset) as long as the set.
+ */
+set_t* set_new_arena(mem_arena_t* arena);
+
 /**************** set_insert ****************/
 /* Insert item, identified by a key (string), into the given set.
  *
@@ -0,0 +1,517 @@
+/*
+ * threadpool.c - CS50 'threadpool' module
+ *
+ * see threadpool.h for more information.
+ *
+ * A worker looks for a task in its own deque, newest first; then in the
+ * shared inbox; then it steals the oldest task of each other worker in
+ * turn.  The pool counts tasks *queued* (pushed but not yet taken) and
+ * *pending* (submitted but not yet finished).  A worker that finds no
+ * task for a while sleeps on `wake` until queued > 0; a submitter that
+ * sees a sleeper signals it.  Each side writes its own counter before
+ * reading the other's, so one of them always sees the other: a task is
+ * never left queued while every worker sleeps.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L   // clock_gettime, sysconf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "threadpool.h"
+#include "deque.h"
+#include "queue.h"
+#include "mem.h"
+
+/**************** local types ****************/
+typedef struct task {
+  void (*func)(void* arg);          // what to run
+  void* arg;                        // and its argument
+  atomic_int* group;                // if not NULL, count down when done
+} task_t;
+
+typedef struct chunk {
+  void (*body)(void* arg, const int lo, const int hi);
+  void* arg;
+  int lo, hi;                       // the chunk's range, [lo, hi)
+} chunk_t;
+
+// counters are written only by the worker's own thread; each worker
+// gets its own cache lines, so workers do not collide updating them.
+typedef struct worker {
+  pthread_t thread;                 // the thread itself
+  struct threadpool* pool;          // the pool it belongs to
+  int id;                           // 0..nWorkers-1
+  deque_t* deque;                   // its tasks; it alone pushes and pops
+  atomic_long ntasks;               // tasks it ran
+  atomic_long nstolen;              // ...of which it stole
+  atomic_llong busy;                // nanoseconds running them
+  char pad[64];
+} worker_t;
+
+/**************** global types ****************/
+typedef struct threadpool {
+  int nWorkers;                     // number of workers
+  worker_t* workers;                // array of them
+  queue_t* inbox;                   // tasks submitted from outside
+  mem_pool_t* tasks;                // where task_t's come from
+  long long start;                  // nanoseconds, when it was created
+  char pad0[64];
+  atomic_long queued;               // tasks pushed, not yet taken
+  atomic_long pending;              // tasks submitted, not yet finished
+  atomic_int idle;                  // workers asleep, or about to be
+  atomic_bool stopping;             // set by threadpool_delete
+  char pad1[64];
+  atomic_long ntasks;               // tasks run by waiting callers
+  atomic_llong busy;                // nanoseconds they spent on them
+  pthread_mutex_t lock;             // guards sleeping and waking
+  pthread_cond_t wake;              // idle workers wait here for work
+  pthread_cond_t done;              // threadpool_wait waits for pending==0
+} threadpool_t;
+
+/**************** file-local global variables ****************/
+static const int INBOX_SIZE = 1024;     // tasks in the shared inbox
+static const int SPINS = 64;            // empty looks before sleeping
+static const int CHUNKS_PER_THREAD = 4; // parallel_for's default grain
+
+// the worker this thread is, if any, and how deep in nested tasks
+static _Thread_local worker_t* self = NULL;
+static _Thread_local int depth = 0;
+
+/**************** local functions ****************/
+/* not visible outside this file */
+static void* workerMain(void* arg);
+static bool submit(threadpool_t* pool, void (*func)(void* arg), void* arg,
+                   atomic_int* group);
+static task_t* findTask(threadpool_t* pool, worker_t* me, bool* stolen);
+static void runTask(threadpool_t* pool, task_t* task, worker_t* me,
+                    const bool stolen);
+static bool helpOne(threadpool_t* pool);
+static void chunkTask(void* arg);
+static void stopWorkers(threadpool_t* pool, const int nStarted);
+static long long now(void);
+
+/**************** global functions ****************/
+/* that is, visible outside this file */
+/* see threadpool.h for comments about exported functions */
+
+/**************** threadpool_cores() ****************/
+/* see threadpool.h for description */
+int
+threadpool_cores(void)
+{
+  long nCores = sysconf(_SC_NPROCESSORS_ONLN);
+  return (nCores > 0) ? (int) nCores : 1;
+}
+
+/**************** threadpool_new() ****************/
+/* see threadpool.h for description */
+threadpool_t*
+threadpool_new(const int nThreads)
+{
+  int nWorkers = (nThreads > 0) ? nThreads : threadpool_cores();
+
+  threadpool_t* pool = mem_malloc(sizeof(threadpool_t));
+  if (pool == NULL) {
+    return NULL;              // error allocating pool
+  }
+  pool->nWorkers = nWorkers;
+  pool->workers = mem_calloc(nWorkers, sizeof(worker_t));
+  pool->inbox = queue_new(INBOX_SIZE);
+  pool->tasks = mem_pool_new(sizeof(task_t), true);
+  if (pool->workers == NULL || pool->inbox == NULL || pool->tasks == NULL) {
+    mem_free(pool->workers);
+    queue_delete(pool->inbox, NULL);
+    mem_pool_delete(pool->tasks);
+    mem_free(pool);
+    return NULL;              // error allocating contents
+  }
+
+  // initialize contents of pool structure
+  pool->start = now();
+  atomic_init(&pool->queued, 0);
+  atomic_init(&pool->pending, 0);
+  atomic_init(&pool->idle, 0);
+  atomic_init(&pool->stopping, false);
+  atomic_init(&pool->ntasks, 0);
+  atomic_init(&pool->busy, 0);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  // every deque exists before any worker starts stealing from it
+  for (int i = 0; i < nWorkers; i++) {
+    worker_t* worker = &pool->workers[i];
+    worker->pool = pool;
+    worker->id = i;
+    atomic_init(&worker->ntasks, 0);
+    atomic_init(&worker->nstolen, 0);
+    atomic_init(&worker->busy, 0);
+    if ((worker->deque = deque_new()) == NULL) {
+      stopWorkers(pool, 0);
+      return NULL;            // error allocating deques
+    }
+  }
+  for (int i = 0; i < nWorkers; i++) {
+    worker_t* worker = &pool->workers[i];
+    if (pthread_create(&worker->thread, NULL, workerMain, worker) != 0) {
+      stopWorkers(pool, i);
+      return NULL;            // error starting threads
+    }
+  }
+  return pool;
+}
+
+/**************** threadpool_size() ****************/
+/* see threadpool.h for description */
+int
+threadpool_size(threadpool_t* pool)
+{
+  return (pool == NULL) ? 0 : pool->nWorkers;
+}
+
+/**************** threadpool_submit() ****************/
+/* see threadpool.h for description */
+bool
+threadpool_submit(threadpool_t* pool, void (*func)(void* arg), void* arg)
+{
+  if (pool == NULL || func == NULL || atomic_load(&pool->stopping)) {
+    return false;
+  }
+  return submit(pool, func, arg, NULL);
+}
+
+/**************** threadpool_wait() ****************/
+/* see threadpool.h for description */
+void
+threadpool_wait(threadpool_t* pool)
+{
+  if (pool == NULL) {
+    return;
+  }
+
+  // help while there is work to take, then sleep until the rest is done
+  while (atomic_load(&pool->pending) > 0 && helpOne(pool)) {
+  }
+  pthread_mutex_lock(&pool->lock);
+  while (atomic_load(&pool->pending) > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/**************** threadpool_parallel_for() ****************/
+/* see threadpool.h for description */
+void
+threadpool_parallel_for(threadpool_t* pool, const int begin, const int end,
+                        const int grain,
+                        void (*body)(void* arg, const int lo, const int hi),
+                        void* arg)
+{
+  if (body == NULL || begin >= end) {
+    return;
+  }
+  if (pool == NULL) {
+    (*body)(arg, begin, end);
+    return;
+  }
+
+  long range = (long) end - begin;
+  long size = grain;
+  if (size <= 0) {
+    size = range / ((pool->nWorkers + 1) * CHUNKS_PER_THREAD);
+    if (size < 1) {
+      size = 1;
+    }
+  }
+  long nChunks = (range + size - 1) / size;
+  chunk_t* chunks = mem_malloc(nChunks * sizeof(chunk_t));
+  if (chunks == NULL) {
+    (*body)(arg, begin, end);     // out of memory: do it all here
+    return;
+  }
+
+  // the first chunk is ours; hand out the rest, then help until done
+  atomic_int remaining;
+  atomic_init(&remaining, 0);
+  for (long i = 0; i < nChunks; i++) {
+    chunk_t* chunk = &chunks[i];
+    chunk->body = body;
+    chunk->arg = arg;
+    chunk->lo = (int) (begin + i * size);
+    chunk->hi = (i == nChunks - 1) ? end : (int) (begin + (i + 1) * size);
+    if (i > 0 && !submit(pool, chunkTask, chunk, &remaining)) {
+      chunkTask(chunk);           // out of memory: run it here
+    }
+  }
+  chunkTask(&chunks[0]);
+  while (atomic_load_explicit(&remaining, memory_order_acquire) > 0) {
+    if (!helpOne(pool)) {
+      sched_yield();              // the rest are running elsewhere
+    }
+  }
+  mem_free(chunks);
+}
+
+/**************** threadpool_report() ****************/
+/* see threadpool.h for description */
+void
+threadpool_report(threadpool_t* pool, FILE* fp, const char* message)
+{
+  if (pool == NULL || fp == NULL) {
+    return;
+  }
+
+  double secs = (now() - pool->start) / 1e9;
+  fprintf(fp, "%s: %d workers, %.3f s\n", message, pool->nWorkers, secs);
+  for (int i = 0; i < pool->nWorkers; i++) {
+    worker_t* worker = &pool->workers[i];
+    double busy = atomic_load(&worker->busy) / 1e9;
+    fprintf(fp, "  worker %2d: %8ld tasks (%ld stolen), busy %.3f s (%.1f%%)\n",
+            i, atomic_load(&worker->ntasks), atomic_load(&worker->nstolen),
+            busy, (secs > 0) ? 100 * busy / secs : 0.0);
+  }
+  fprintf(fp, "  callers:   %8ld tasks, busy %.3f s\n",
+          atomic_load(&pool->ntasks), atomic_load(&pool->busy) / 1e9);
+}
+
+/**************** threadpool_delete() ****************/
+/* see threadpool.h for description */
+void
+threadpool_delete(threadpool_t* pool)
+{
+  if (pool != NULL) {
+    threadpool_wait(pool);
+    stopWorkers(pool, pool->nWorkers);
+  }
+
+#ifdef MEMTEST
+  mem_report(stdout, "End of threadpool_delete");
+#endif
+}
+
+/**************** workerMain ****************/
+/* The body of each worker thread: run tasks until the pool stops.
+ */
+static void*  // not visible outside this file
+workerMain(void* arg)
+{
+  worker_t* me = arg;
+  threadpool_t* pool = me->pool;
+  self = me;
+
+  int misses = 0;
+  while (!atomic_load(&pool->stopping)) {
+    bool stolen;
+    task_t* task = findTask(pool, me, &stolen);
+    if (task != NULL) {
+      runTask(pool, task, me, stolen);
+      misses = 0;
+    } else if (++misses < SPINS) {
+      sched_yield();
+    } else {
+      // sleep until something is queued
+      pthread_mutex_lock(&pool->lock);
+      atomic_fetch_add(&pool->idle, 1);
+      while (atomic_load(&pool->queued) <= 0
+             && !atomic_load(&pool->stopping)) {
+        pthread_cond_wait(&pool->wake, &pool->lock);
+      }
+      atomic_fetch_sub(&pool->idle, 1);
+      pthread_mutex_unlock(&pool->lock);
+      misses = 0;
+    }
+  }
+  return NULL;
+}
+
+/**************** submit ****************/
+/* Queue func(arg), counting it in group if not NULL: on this thread's
+ * deque if it is one of the pool's workers, else in the inbox.
+ * Returns false if out of memory.
+ */
+static bool  // not visible outside this file
+submit(threadpool_t* pool, void (*func)(void* arg), void* arg,
+       atomic_int* group)
+{
+  task_t* task = mem_pool_alloc(pool->tasks);
+  if (task == NULL) {
+    return false;
+  }
+  task->func = func;
+  task->arg = arg;
+  task->group = group;
+  if (group != NULL) {
+    atomic_fetch_add(group, 1);
+  }
+  atomic_fetch_add(&pool->pending, 1);
+
+  if (self != NULL && self->pool == pool) {
+    if (!deque_push(self->deque, task)) {
+      // out of memory growing the deque: run it now, in place
+      runTask(pool, task, self, false);
+      return true;
+    }
+  } else {
+    while (!queue_push(pool->inbox, task)) {
+      // full: make room by running a task ourselves
+      if (!helpOne(pool)) {
+        sched_yield();
+      }
+    }
+  }
+
+  atomic_fetch_add(&pool->queued, 1);
+  if (atomic_load(&pool->idle) > 0) {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return true;
+}
+
+/**************** findTask ****************/
+/* Take a task from me's deque (if me is not NULL), the inbox, or another
+ * worker's deque, in that order; set *stolen if it was another's.
+ * Returns NULL if none was found.
+ */
+static task_t*  // not visible outside this file
+findTask(threadpool_t* pool, worker_t* me, bool* stolen)
+{
+  task_t* task = NULL;
+  *stolen = false;
+  if (me != NULL) {
+    task = deque_pop(me->deque);
+  }
+  if (task == NULL) {
+    task = queue_pop(pool->inbox);
+  }
+  if (task == NULL) {
+    // steal, starting with the worker after me so thieves spread out
+    int first = (me != NULL) ? me->id + 1 : 0;
+    for (int i = 0; i < pool->nWorkers && task == NULL; i++) {
+      worker_t* victim = &pool->workers[(first + i) % pool->nWorkers];
+      if (victim != me) {
+        task = deque_steal(victim->deque);
+      }
+    }
+    *stolen = (task != NULL);
+  }
+  if (task != NULL) {
+    atomic_fetch_sub(&pool->queued, 1);
+  }
+  return task;
+}
+
+/**************** runTask ****************/
+/* Run task, timing it unless it is nested in another, and count it
+ * against me (if not NULL) or the callers; then free it and count down
+ * its group and the pool's pending tasks.
+ */
+static void  // not visible outside this file
+runTask(threadpool_t* pool, task_t* task, worker_t* me, const bool stolen)
+{
+  long long start = (depth == 0) ? now() : 0;
+  depth++;
+  (*task->func)(task->arg);
+  depth--;
+  long long busy = (depth == 0) ? now() - start : 0;
+
+  if (me != NULL) {
+    // only this thread writes these, so no read-modify-write is needed
+    atomic_store_explicit(&me->ntasks,
+        atomic_load_explicit(&me->ntasks, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+    atomic_store_explicit(&me->nstolen,
+        atomic_load_explicit(&me->nstolen, memory_order_relaxed) + stolen,
+        memory_order_relaxed);
+    atomic_store_explicit(&me->busy,
+        atomic_load_explicit(&me->busy, memory_order_relaxed) + busy,
+        memory_order_relaxed);
+  } else {
+    atomic_fetch_add_explicit(&pool->ntasks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->busy, busy, memory_order_relaxed);
+  }
+
+  atomic_int* group = task->group;
+  mem_pool_free(pool->tasks, task);
+  if (group != NULL) {
+    atomic_fetch_sub_explicit(group, 1, memory_order_release);
+  }
+  if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+/**************** helpOne ****************/
+/* Find and run one task in the calling thread, which may or may not be
+ * one of the pool's workers.  Returns false if there was none.
+ */
+static bool  // not visible outside this file
+helpOne(threadpool_t* pool)
+{
+  worker_t* me = (self != NULL && self->pool == pool) ? self : NULL;
+  bool stolen;
+  task_t* task = findTask(pool, me, &stolen);
+  if (task == NULL) {
+    return false;
+  }
+  runTask(pool, task, me, stolen);
+  return true;
+}
+
+/**************** chunkTask ****************/
+/* Run one chunk of a parallel_for.
+ */
+static void  // not visible outside this file
+chunkTask(void* arg)
+{
+  chunk_t* chunk = arg;
+  (*chunk->body)(chunk->arg, chunk->lo, chunk->hi);
+}
+
+/**************** stopWorkers ****************/
+/* Stop and join the first nStarted workers, and free the pool.
+ */
+static void  // not visible outside this file
+stopWorkers(threadpool_t* pool, const int nStarted)
+{
+  pthread_mutex_lock(&pool->lock);
+  atomic_store(&pool->stopping, true);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i = 0; i < nStarted; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+  }
+
+  for (int i = 0; i < pool->nWorkers; i++) {
+    deque_delete(pool->workers[i].deque, NULL);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wake);
+  pthread_cond_destroy(&pool->done);
+  queue_delete(pool->inbox, NULL);
+  mem_pool_delete(pool->tasks);
+  mem_free(pool->workers);
+  mem_free(pool);
+}
+
+/**************** now ****************/
+/* Return the time in nanoseconds, from an arbitrary start.
+ */
+static long long  // not visible outside this file
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
@@ -0,0 +1,119 @@
+/*
+ * threadpool.h - header file for CS50 'threadpool' module
+ *
+ * A *threadpool* is a fixed set of worker threads that run *tasks* -
+ * a function and an argument - handed to it by any thread.  Each worker
+ * keeps its own deque of tasks: a task submitted by a worker goes on
+ * that worker's deque, one submitted from outside the pool goes on a
+ * shared queue, and a worker with nothing to do steals from the others.
+ * Idle workers spin briefly, then sleep until there is work.
+ *
+ * threadpool_parallel_for splits a range of integers - docIDs, say -
+ * into chunks, runs them as tasks, and returns when all are done; the
+ * calling thread runs chunks too while it waits, so it may be called
+ * from inside a task.
+ *
+ * The pool counts, for each worker, the tasks it ran and stole and the
+ * time it spent running them; threadpool_report prints that.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct threadpool threadpool_t;  // opaque to users of the module
+
+/**************** functions ****************/
+
+/**************** threadpool_cores ****************/
+/* Return the number of cores online; at least 1.
+ */
+int threadpool_cores(void);
+
+/**************** threadpool_new ****************/
+/* Create a new pool and start its workers.
+ *
+ * Caller provides:
+ *   number of worker threads; 0 or less means threadpool_cores().
+ * We return:
+ *   pointer to a new pool, or NULL if error.
+ * Caller is responsible for:
+ *   later calling threadpool_delete.
+ */
+threadpool_t* threadpool_new(const int nThreads);
+
+/**************** threadpool_size ****************/
+/* Return the number of workers in the pool; 0 if pool is NULL.
+ */
+int threadpool_size(threadpool_t* pool);
+
+/**************** threadpool_submit ****************/
+/* Run func(arg) on some worker, some time soon.  Any thread.
+ *
+ * Caller provides:
+ *   valid pool pointer, valid function pointer, arg (may be NULL).
+ * We return:
+ *   false if pool or func is NULL, the pool is being deleted, or out of
+ *   memory; true otherwise.
+ * Notes:
+ *   tasks run in no particular order; to wait for a batch of them,
+ *   use threadpool_wait or threadpool_parallel_for.
+ */
+bool threadpool_submit(threadpool_t* pool, void (*func)(void* arg), void* arg);
+
+/**************** threadpool_wait ****************/
+/* Wait until every task submitted so far - and every task those tasks
+ * submit - has finished, running some of them in the calling thread.
+ *
+ * Notes:
+ *   not from inside a task, which would wait for itself;
+ *   ignore NULL pool.
+ */
+void threadpool_wait(threadpool_t* pool);
+
+/**************** threadpool_parallel_for ****************/
+/* Call body(arg, lo, hi) over chunks [lo, hi) that together cover
+ * [begin, end), in parallel, and return when all are done.
+ *
+ * Caller provides:
+ *   valid pool pointer (NULL runs the whole range in the calling thread),
+ *   the range, the chunk size (0 or less picks one: a few chunks per
+ *   worker), valid body pointer, arg (may be NULL).
+ * Notes:
+ *   chunks run in no particular order, and body must be safe to run in
+ *   several threads at once; any thread, including from inside a task.
+ */
+void threadpool_parallel_for(threadpool_t* pool, const int begin,
+                             const int end, const int grain,
+                             void (*body)(void* arg, const int lo, const int hi),
+                             void* arg);
+
+/**************** threadpool_report ****************/
+/* Print, to fp, a line per worker: the tasks it ran, how many of them
+ * it stole, and the time it spent running them, as a share of the
+ * pool's lifetime; then the same for tasks run by waiting callers.
+ * Ignore NULL pool or fp.
+ */
+void threadpool_report(threadpool_t* pool, FILE* fp, const char* message);
+
+/**************** threadpool_delete ****************/
+/* Let the queued tasks finish, stop the workers, and free the pool.
+ *
+ * Caller provides:
+ *   valid pool pointer.
+ * We do:
+ *   if pool==NULL, do nothing.
+ *   otherwise wait as threadpool_wait does - running tasks may still
+ *   submit more - then stop and join the workers, and free the pool.
+ * Notes:
+ *   not from inside a task; no other thread may submit once the queued
+ *   tasks have finished.
+ */
+void threadpool_delete(threadpool_t* pool);
+
+#endif // __THREADPOOL_H
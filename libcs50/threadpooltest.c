@@ -0,0 +1,232 @@
+/*
+ * threadpooltest - stress test for the threadpool
+ *
+ * usage:
+ *   threadpooltest [nThreads [nItems]]
+ *
+ * submit: the main thread submits nItems tasks, each of which marks its
+ *   item; after threadpool_wait every item must be marked exactly once.
+ * spawn: one task splits the range [0, nItems) in half, submitting a task
+ *   for each half, down to single items - tasks that submit tasks.
+ * parallel_for: marks every item in [0, nItems) through
+ *   threadpool_parallel_for, first from the main thread, then from inside
+ *   tasks, each of which runs a nested parallel_for over its own range.
+ * Then the pool is deleted while tasks are still queued; they must all run.
+ *
+ * `make threadpooltest` builds it with -fsanitize=thread, so a data race
+ * shows up as a report even when the counts come out right.
+ * Prints PASS or FAIL lines; exits non-zero on any failure.
+ *
+ * Amittai J. Wekesa, April 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "threadpool.h"
+#include "mem.h"
+
+/**************** file-local global types ****************/
+typedef struct range {
+  int lo, hi;                 // items [lo, hi)
+} range_t;
+
+/**************** file-local global variables ****************/
+static int nThreads = 4;
+static int nItems = 100000;
+static threadpool_t* pool;
+static atomic_char* seen;           // seen[item] = times item was marked
+static range_t* ranges;             // for the spawn test's tasks
+
+/**************** local functions ****************/
+static bool testSubmit(void);
+static bool testSpawn(void);
+static bool testParallelFor(void);
+static bool testNested(void);
+static bool testDelete(void);
+static void markTask(void* arg);
+static void spawnTask(void* arg);
+static void markRange(void* arg, const int lo, const int hi);
+static void nestedTask(void* arg);
+static void reset(void);
+static bool checkSeen(const char* test);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 3
+      || (argc > 1 && sscanf(argv[1], "%d", &nThreads) != 1)
+      || (argc > 2 && sscanf(argv[2], "%d", &nItems) != 1)
+      || nThreads < 1 || nItems < 1) {
+    fprintf(stderr, "usage: %s [nThreads>=1 [nItems>=1]]\n", argv[0]);
+    exit(1);
+  }
+
+  seen = mem_calloc_assert(nItems, sizeof(atomic_char), "seen[]");
+  ranges = mem_calloc_assert(4 * nItems, sizeof(range_t), "ranges[]");
+  pool = mem_assert(threadpool_new(nThreads), "threadpool");
+
+  bool ok = testSubmit();
+  ok = testSpawn() && ok;
+  ok = testParallelFor() && ok;
+  ok = testNested() && ok;
+  threadpool_report(pool, stdout, "threadpool");
+  ok = testDelete() && ok;
+
+  mem_free(ranges);
+  mem_free(seen);
+  if (mem_net() != 0) {
+    mem_report(stdout, "FAIL: leaked");
+    ok = false;
+  }
+  return ok ? 0 : 2;
+}
+
+/**************** testSubmit ****************/
+static bool
+testSubmit(void)
+{
+  reset();
+  for (intptr_t i = 0; i < nItems; i++) {
+    if (!threadpool_submit(pool, markTask, (void*) i)) {
+      printf("FAIL: submit %ld\n", (long) i);
+      return false;
+    }
+  }
+  threadpool_wait(pool);
+  return checkSeen("submit");
+}
+
+/**************** testSpawn ****************/
+static bool
+testSpawn(void)
+{
+  reset();
+  ranges[1] = (range_t) { 0, nItems };
+  threadpool_submit(pool, spawnTask, (void*) (intptr_t) 1);
+  threadpool_wait(pool);
+  return checkSeen("spawn");
+}
+
+/**************** testParallelFor ****************/
+static bool
+testParallelFor(void)
+{
+  reset();
+  threadpool_parallel_for(pool, 0, nItems, 0, markRange, NULL);
+  bool ok = checkSeen("parallel_for");
+
+  // odd grain, so the last chunk is short
+  reset();
+  threadpool_parallel_for(pool, 0, nItems, 7, markRange, NULL);
+  ok = checkSeen("parallel_for, grain 7") && ok;
+
+  reset();
+  threadpool_parallel_for(NULL, 0, nItems, 0, markRange, NULL);
+  return checkSeen("parallel_for, no pool") && ok;
+}
+
+/**************** testNested ****************/
+static bool
+testNested(void)
+{
+  reset();
+  int nTasks = 16;
+  for (intptr_t i = 0; i < nTasks; i++) {
+    threadpool_submit(pool, nestedTask, (void*) i);
+  }
+  threadpool_wait(pool);
+  return checkSeen("nested parallel_for");
+}
+
+/**************** testDelete ****************/
+static bool
+testDelete(void)
+{
+  reset();
+  for (intptr_t i = 0; i < nItems; i++) {
+    threadpool_submit(pool, markTask, (void*) i);
+  }
+  threadpool_delete(pool);
+  return checkSeen("delete");
+}
+
+/**************** markTask ****************/
+/* Mark item arg.
+ */
+static void
+markTask(void* arg)
+{
+  atomic_fetch_add(&seen[(intptr_t) arg], 1);
+}
+
+/**************** spawnTask ****************/
+/* Mark the item in ranges[arg], or split the range in two, as ranges
+ * 2*arg and 2*arg+1, and submit a task for each - a binary tree of
+ * tasks numbered as in a heap, so numbered below 4*nItems.
+ */
+static void
+spawnTask(void* arg)
+{
+  intptr_t node = (intptr_t) arg;
+  range_t range = ranges[node];
+  if (range.hi - range.lo == 1) {
+    atomic_fetch_add(&seen[range.lo], 1);
+  } else {
+    int mid = range.lo + (range.hi - range.lo) / 2;
+    ranges[2 * node] = (range_t) { range.lo, mid };
+    ranges[2 * node + 1] = (range_t) { mid, range.hi };
+    threadpool_submit(pool, spawnTask, (void*) (2 * node));
+    threadpool_submit(pool, spawnTask, (void*) (2 * node + 1));
+  }
+}
+
+/**************** markRange ****************/
+static void
+markRange(void* arg, const int lo, const int hi)
+{
+  for (int i = lo; i < hi; i++) {
+    atomic_fetch_add(&seen[i], 1);
+  }
+}
+
+/**************** nestedTask ****************/
+/* Mark task arg's sixteenth of the items, by a parallel_for of its own.
+ */
+static void
+nestedTask(void* arg)
+{
+  intptr_t i = (intptr_t) arg;
+  int lo = (int) ((long) nItems * i / 16);
+  int hi = (int) ((long) nItems * (i + 1) / 16);
+  threadpool_parallel_for(pool, lo, hi, 0, markRange, NULL);
+}
+
+/**************** reset ****************/
+static void
+reset(void)
+{
+  for (int i = 0; i < nItems; i++) {
+    atomic_store(&seen[i], 0);
+  }
+}
+
+/**************** checkSeen ****************/
+/* Was every item marked exactly once?  Print PASS or FAIL for test.
+ */
+static bool
+checkSeen(const char* test)
+{
+  for (int i = 0; i < nItems; i++) {
+    if (atomic_load(&seen[i]) != 1) {
+      printf("FAIL: %s: item %d marked %d times\n", test, i,
+             (int) atomic_load(&seen[i]));
+      return false;
+    }
+  }
+  printf("PASS: %s, %d threads x %d items\n", test, nThreads, nItems);
+  return true;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file bm25.c
+ * @author Amittai J.Wekesa (@siavava)
+ * @brief: BM25 scoring for the TSE querier:
+ * an index's collection statistics, and a table of
+ * each document's length normalization, computed once.
+ * @version 0.1
+ * @date 2021-05-28
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+/* standard libraries */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+/* data types */
+#include "index.h"
+#include "segments.h"
+#include "mem.h"
+
+/*     self     */
+#include "bm25.h"
+
+
+typedef struct bm25 {
+  long nDocs;               // documents in the collection
+  double avgdl;             // the words indexed from each, on average; 0 if unknown
+  int first;                // the smallest docID ...
+  int last;                 // ... and the largest
+  double* norms;            // norms[docID - first]: k1 * (1 - b + b * |d| / avgdl)
+} bm25_t;
+
+
+
+
+/**
+ * @brief: see bm25.h for full documentation.
+ *
+ * @param segments: the index's segments.
+ * @return bm25_t*: the scorer.
+ */
+bm25_t*
+bm25_new(segments_t* segments)
+{
+  assert(segments != NULL);
+
+  bm25_t* bm25 = mem_malloc_assert(sizeof(bm25_t), "Error allocating memory in bm25_new.");
+
+  /* the docIDs of all the segments */
+  bm25->first = bm25->last = 0;
+  for (int s = 0; s < segments_size(segments); s++) {
+    int first, last;
+    if (index_docRange(segments_get(segments, s), &first, &last)) {
+      bm25->first = (bm25->first == 0 || first < bm25->first) ? first : bm25->first;
+      bm25->last = (last > bm25->last) ? last : bm25->last;
+    }
+  }
+
+  /* the collection: as the headers count it, or, lacking tables, every docID */
+  long nTokens;
+  segments_docStats(segments, &bm25->nDocs, &nTokens);
+  double avgdl = bm25->avgdl = (bm25->nDocs > 0 && nTokens > 0) ? (double) nTokens / bm25->nDocs : 0;
+  if (bm25->nDocs == 0 && bm25->last > 0) {
+    bm25->nDocs = bm25->last - bm25->first + 1;
+  }
+
+  /* each document's normalization; a document the tables lack is of average length */
+  int size = (bm25->last > 0) ? bm25->last - bm25->first + 1 : 1;
+  bm25->norms = mem_malloc_assert(size * sizeof(double), "Error allocating memory in bm25_new.");
+  for (int i = 0; i < size; i++) {
+    bm25->norms[i] = BM25_K1;
+  }
+  if (avgdl > 0) {
+    for (int s = 0; s < segments_size(segments); s++) {
+      index_t* index = segments_get(segments, s);
+      int first, last;
+      if (!index_docRange(index, &first, &last)) {
+        continue;
+      }
+      for (int docID = first; docID <= last; docID++) {
+        index_doc_t doc;
+        if (index_getDoc(index, docID, &doc)) {
+          bm25->norms[docID - bm25->first] = BM25_K1 * (1 - BM25_B + BM25_B * doc.tokens / avgdl);
+        }
+      }
+    }
+  }
+  return bm25;
+}
+
+
+
+
+/**
+ * @brief: see bm25.h for full documentation.
+ *
+ * @param bm25: a valid scorer.
+ * @param df: how many documents hold the term.
+ * @return double: its IDF.
+ */
+double
+bm25_idf(bm25_t* bm25, const int df)
+{
+  assert(bm25 != NULL);
+
+  /* a collection the tables undercount holds at least the term's documents */
+  double n = (df > bm25->nDocs) ? df : bm25->nDocs;
+  return log(1 + (n - df + 0.5) / (df + 0.5));
+}
+
+
+
+
+/**
+ * @brief: see bm25.h for full documentation.
+ *
+ * @param bm25: a valid scorer.
+ * @param idf: the term's IDF.
+ * @param docID: the document.
+ * @param tf: how many times the document holds the term.
+ * @return double: the term's score in the document.
+ */
+double
+bm25_term(bm25_t* bm25, const double idf, const int docID, const int tf)
+{
+  if (tf <= 0) {
+    return 0;
+  }
+  double norm = (docID >= bm25->first && docID <= bm25->last) ? bm25->norms[docID - bm25->first] : BM25_K1;
+  return idf * tf * (BM25_K1 + 1) / (tf + norm);
+}
+
+
+
+
+/**
+ * @brief: see bm25.h for full documentation.
+ *
+ * A document of at least minTokens words has a norm at least this one's
+ * -- as has one the tables lack, normed as of average length,
+ * since minTokens is then 0 -- and more of the term only scores more.
+ *
+ * @param bm25: a valid scorer.
+ * @param idf: the term's IDF.
+ * @param maxCount: the most times a document holds the term.
+ * @param minTokens: the fewest words indexed from a document holding it.
+ * @return double: the most the term can score in such a document.
+ */
+double
+bm25_bound(bm25_t* bm25, const double idf, const int maxCount, const int minTokens)
+{
+  if (maxCount <= 0) {
+    return 0;
+  }
+  double norm = (bm25->avgdl > 0) ? BM25_K1 * (1 - BM25_B + BM25_B * minTokens / bm25->avgdl) : BM25_K1;
+  return idf * maxCount * (BM25_K1 + 1) / (maxCount + norm);
+}
+
+
+
+
+/**
+ * @brief: see bm25.h for full documentation.
+ *
+ * @param bm25: the scorer, or NULL.
+ */
+void
+bm25_delete(bm25_t* bm25)
+{
+  if (bm25 != NULL) {
+    mem_free(bm25->norms);
+    mem_free(bm25);
+  }
+}
@@ -0,0 +1,92 @@
+/**
+ * @file bm25.h
+ * @author Amittai J.Wekesa (@siavava)
+ * @brief: Exports functions defined in bm25.c --
+ * the collection statistics of an index, and BM25 term scores.
+ *
+ * A document d scores, for each query term t it holds tf times,
+ *
+ *   idf(t) * tf * (k1 + 1) / (tf + k1 * (1 - b + b * |d| / avgdl))
+ *
+ * where idf(t) = ln(1 + (N - df + 0.5) / (df + 0.5)), N is the number
+ * of documents, df the number holding t, |d| the words indexed from d
+ * and avgdl their average over all documents.
+ * The last factor of the denominator depends on the document alone,
+ * so it is computed once for every docID, when the scorer is made;
+ * scoring a posting is then a lookup and a little arithmetic.
+ *
+ * @version 0.1
+ * @date 2021-05-28
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#ifndef __BM25_H
+#define __BM25_H
+
+#include "segments.h"
+
+/* term-frequency saturation, and length normalization */
+#define BM25_K1 1.2
+#define BM25_B 0.75
+
+/* scores are kept in counters, as whole thousandths of a point */
+#define BM25_SCALE 1000
+
+typedef struct bm25 bm25_t;
+
+/**
+ * @brief: reads the statistics of an index and its segments
+ * -- the number of documents, and the average words indexed from each
+ * (segments_docStats()) -- and computes each document's length
+ * normalization, from its entry in its segment's document table.
+ * An index without document tables (a text index) knows neither:
+ * it counts the docIDs it spans as its documents, all of average length.
+ *
+ * @param segments: the index's segments.
+ * @return bm25_t*: the scorer; the caller must bm25_delete() it.
+ */
+bm25_t* bm25_new(segments_t* segments);
+
+/**
+ * @brief: the inverse document frequency of a term.
+ *
+ * @param bm25: a valid scorer.
+ * @param df: how many documents hold the term, all segments summed.
+ * @return double: its IDF, > 0.
+ */
+double bm25_idf(bm25_t* bm25, const int df);
+
+/**
+ * @brief: a term's contribution to a document's score.
+ *
+ * @param bm25: a valid scorer.
+ * @param idf: the term's IDF (bm25_idf()).
+ * @param docID: the document.
+ * @param tf: how many times the document holds the term.
+ * @return double: the term's score in the document; 0 if tf is 0.
+ */
+double bm25_term(bm25_t* bm25, const double idf, const int docID, const int tf);
+
+/**
+ * @brief: the most a term can score in any of a run of documents,
+ * knowing only the most times one holds it, and the fewest words
+ * indexed from one: an upper bound of bm25_term() over the run,
+ * for skipping documents that cannot score enough (see index_cursor()).
+ *
+ * @param bm25: a valid scorer.
+ * @param idf: the term's IDF (bm25_idf()).
+ * @param maxCount: the most times a document of the run holds the term.
+ * @param minTokens: the fewest words indexed from a document of the run;
+ * 0 if some document's length is not known.
+ * @return double: the bound; 0 if maxCount is 0.
+ */
+double bm25_bound(bm25_t* bm25, const double idf, const int maxCount, const int minTokens);
+
+/**
+ * @brief: deletes the scorer; ignores NULL.
+ */
+void bm25_delete(bm25_t* bm25);
+
+#endif // __BM25_H
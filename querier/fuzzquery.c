@@ -10,11 +10,12 @@
 
 #include <stdio.h>
 #include <stdlib.h> // rand, srand
-#include <string.h> // strchr
+#include <string.h> // memchr
 #include <ctype.h>  // isalpha
 #include <stdbool.h>
 #include "mem.h"
 #include "file.h"
+#include "mapfile.h"
 
 /**************** file-local global variables ****************/
 static char* program;
@@ -126,20 +127,21 @@ wordlist_load(const char* indexFilename)
     return NULL;
   }
 
-  FILE* fp = fopen(indexFilename, "r");
-  if (fp == NULL) {
+  mapfile_t* map = mapfile_open(indexFilename);
+  if (map == NULL) {
     fprintf(stderr, "%s: cannot open index file '%s'\n",
             program, indexFilename);
     return NULL;
   }
+  mapfile_advise(map, MAPFILE_SEQUENTIAL);
 
   // How many words will we have to read?
-  int maxWords = file_numLines(fp);
+  int maxWords = file_numLinesMem(mapfile_data(map), mapfile_size(map));
 
   if (maxWords == 0) {
     fprintf(stderr, "%s: index file '%s' has no words\n",
             program, indexFilename);
-    fclose(fp);
+    mapfile_close(map);
     return NULL;
   }
 
@@ -151,17 +153,20 @@ wordlist_load(const char* indexFilename)
   wordlist->words = words;
   wordlist->nWords = 0;
 
-  // read in all the words
+  // read in all the words, straight from the mapped file
+  file_reader_t* reader = file_reader_newMem(mapfile_data(map),
+                                             mapfile_size(map));
   int nWords = 0;
-  char* word = NULL;
-  while ((word = file_readLine(fp)) != NULL) {
-    // truncate the word at the first space
-    char* space = strchr(word, ' ');
-    if (space != NULL)
-      *space = '\0';
+  char* line = NULL;
+  size_t len;
+  while ((line = file_reader_line(reader, &len)) != NULL
+         && nWords < maxWords) {
+    // copy the word, up to the first space
+    char* space = memchr(line, ' ', len);
+    char* word = file_reader_copy(line, (space != NULL) ? space - line : len);
 
     // decide whether to save the word in the word list
-    if (onlyLetters(word)) {
+    if (word != NULL && onlyLetters(word)) {
       // save it - a simple word of only letters
       words[nWords++] = word;
     } else {
@@ -169,7 +174,8 @@ wordlist_load(const char* indexFilename)
       free(word);
     }
   }
-  fclose(fp);
+  file_reader_delete(reader);
+  mapfile_close(map);
 
   // record the actual number of words in the list
   wordlist->nWords = nWords;
@@ -188,7 +194,7 @@ wordlist_delete(wordlist_t* wordlist)
   char** words = wordlist->words;
   int nWords = wordlist->nWords;
   for (int w = 0; w < nWords; w++) {
-    free(words[w]);           // was allocated by file_readLine()
+    free(words[w]);           // was allocated by file_reader_copy()
   }
 
   mem_free(wordlist->words);
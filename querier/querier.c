@@ -33,6 +33,7 @@ int fileno(FILE* stream);
 
 /* Data Structures */
 #include "index.h"
+#include "segments.h"
 #include "webpage.h"
 
 /* Word library */
@@ -44,14 +45,20 @@ int fileno(FILE* stream);
 /* page/file IO handler */
 #include "pagedir.h"
 
+/* worker threads */
+#include "threadpool.h"
+
 
 /*********** FUNCTION PROTOTYPES *********/
 static void parseArgs(char* argv[], char** pageDirectory, char** indexFileName);
-char** getQuery(FILE* fp);
-char*** parseQuery(char** query);
-void runQuery(index_t* index, char* pageDirectory, char*** rawQuery);
+static bool parseOptions(int argc, char* argv[], int* nThreads, bool* bm25, int* top);
+char** getQuery(FILE* fp, mem_arena_t* arena);
+char*** parseQuery(char** query, mem_arena_t* arena);
+void runQuery(segments_t* segments, char* pageDirectory, char*** rawQuery, bm25_t* bm25, const int top, threadpool_t* pool);
 
 static void prompt(void);
+static char* getToken(char* token, mem_arena_t* arena, const size_t size);
+static char* getPhrase(char* token, mem_arena_t* arena, const size_t size);
 
 
 
@@ -80,11 +87,14 @@ main(int argc, char* argv[])
   /* NORMAL FUNCTIONALITY */  
 
   /* If invalid number of arguments, print usage and error message, exit non-zero. */
-  if (argc != 3) {
-    const char* usage = "./querier [pageDirectory] [indexFilename]\n";
+  int nThreads, top;
+  bool ranked;
+  if (argc < 3 || argc > 8 || !parseOptions(argc, argv, &nThreads, &ranked, &top)) {
+    const char* usage = "./querier [pageDirectory] [indexFilename] [--threads N] [--bm25] [--top K]\n";
 
     if (argc < 3) fprintf(stderr, "Too few arguments.\n");
-    else fprintf(stderr, "Too many arguments.\n");
+    else if (argc > 8) fprintf(stderr, "Too many arguments.\n");
+    else fprintf(stderr, "Invalid options.\n");
     
     fprintf(stderr, "Usage: '%s'", usage);
     exit(INCORRECT_USAGE);
@@ -97,49 +107,60 @@ main(int argc, char* argv[])
   /* parse the arguments */
   parseArgs(argv, pageDirectory, indexFileName);
 
-  /* reconstruct the index */
-  index_t* index;
-  if ( (index = index_load(*indexFileName)) == NULL) {
+  /* open a snapshot of the index and its segments: each mapped if binary, else loaded */
+  segments_t* segments;
+  if ( (segments = segments_open(*indexFileName)) == NULL) {
     fprintf(stderr, "Error initializing index");
     mem_free(pageDirectory);
     mem_free(indexFileName);
     exit(INDEX_ERROR);
   }
 
+  /* with --bm25, the collection statistics, and each document's normalization, once */
+  bm25_t* bm25 = ranked ? bm25_new(segments) : NULL;
+
+  /* start the worker threads: by default, one per core */
+  threadpool_t* pool;
+  if ( (pool = threadpool_new(nThreads)) == NULL) {
+    fprintf(stderr, "Error starting worker threads");
+    bm25_delete(bm25);
+    segments_delete(segments);
+    mem_free(pageDirectory);
+    mem_free(indexFileName);
+    exit(INDEX_ERROR);
+  }
+
   /* QUERIES */
   char** rawQuery;
 
+  /*
+   * everything one query allocates -- its tokens and sub-queries --
+   * comes from this arena, and is released in one step before the next.
+   */
+  mem_arena_t* queryArena = mem_assert(mem_arena_new(0), "Error allocating query arena.\n");
+
   /* prompt for first query */
   prompt();
-  while ((rawQuery = getQuery(stdin)) != NULL) { // NULL signifies EOF or error reading from file.
+  while ((rawQuery = getQuery(stdin, queryArena)) != NULL) { // NULL signifies EOF or error reading from file.
 
     /* 
      * if first token is NULL
-     * the entered query was not valid. 
-     * free the returned raw query
-     * and continue to next iteration.
+     * the entered query was not valid;
+     * continue to next iteration.
      */
-    if (rawQuery[0] == NULL) {
-      for (int i=1; ; i++) {
-        if (rawQuery[i] == NULL) {
-          break;
-        }
-        mem_free(rawQuery[i]);
-      }
-      mem_free(rawQuery);
-      continue;
-    }
+    if (rawQuery[0] != NULL) {
 
-    /* parse the query */
-    char*** parsedQuery = parseQuery(rawQuery);
+      /* parse the query */
+      char*** parsedQuery = parseQuery(rawQuery, queryArena);
 
-    /* run the query */
-    if (parsedQuery != NULL) {
-      runQuery(index, *pageDirectory, parsedQuery);
+      /* run the query */
+      if (parsedQuery != NULL) {
+        runQuery(segments, *pageDirectory, parsedQuery, bm25, top, pool);
+      }
     }
 
     /* free the current query before proceeding to next */
-    mem_free(parsedQuery);
+    mem_arena_reset(queryArena);
 
     /* prompt for next query */
     prompt();
@@ -147,8 +168,11 @@ main(int argc, char* argv[])
 
   /* EXITING */
 
-  /* delete the index */
-  index_delete(index);
+  /* stop the worker threads, delete the index and the query arena */
+  threadpool_delete(pool);
+  bm25_delete(bm25);
+  segments_delete(segments);
+  mem_arena_delete(queryArena);
 
   /* free commandline inputs */ 
   mem_free(pageDirectory);
@@ -213,19 +237,64 @@ parseArgs(char* argv[], char** pageDirectory, char** indexFileName)
 
 
 
+/**
+ * @function: parseOptions
+ * @brief: reads the options that may follow the two required arguments,
+ * in any order: "--threads N", "--bm25" and "--top K".
+ * 
+ * @param argc: argument count received from commandline
+ * @param argv: argument vector received from commandline
+ * @param nThreads: where to save N; 0 (one thread per core) if not given
+ * @param bm25: where to save whether to rank the results by BM25
+ * @param top: where to save K, the most results to find; 0 (all) if not given
+ * @return bool: true if every option was well-formed, and N and K positive.
+ */
+static bool
+parseOptions(int argc, char* argv[], int* nThreads, bool* bm25, int* top)
+{
+  *nThreads = 0;
+  *bm25 = false;
+  *top = 0;
+
+  for (int i = 3; i < argc; i++) {
+    char excess;
+    if (strcmp(argv[i], "--bm25") == 0) {
+      *bm25 = true;
+    }
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc
+             && sscanf(argv[i + 1], "%d%c", nThreads, &excess) == 1 && *nThreads >= 1) {
+      i++;                      // past the value
+    }
+    else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc
+             && sscanf(argv[i + 1], "%d%c", top, &excess) == 1 && *top >= 1) {
+      i++;
+    }
+    else {
+      return false;
+    }
+  }
+  return true;
+} /* end of parseOptions() */
+
+
+
+
 /**
  * @function: getQuery
  * @brief: reads in query from FILE*
  * returns an array of words in the query, in the specific order.
  * 
  * @param fp: FILE* wherein to read queries
+ * @param arena: arena wherein to allocate the array and words;
+ * they remain valid until the arena is reset.
  * @return char**: array of words in the query
+ * (first word NULL if the query was not valid)
  * @return NULL: EOF or error reading from FILE*
  */
 char**
-getQuery(FILE* fp)
+getQuery(FILE* fp, mem_arena_t* arena)
 {
-  assert(fp != NULL );
+  assert(fp != NULL && arena != NULL);
   
   /* get query */
   /* if end of file, pass NULL back to caller */
@@ -234,21 +303,17 @@ getQuery(FILE* fp)
     return NULL;
   }
 
+  /* to hold split sub-queries: at most one token per two characters, plus the end marker */
+  char** tokens = mem_assert(mem_arena_alloc(arena, (strlen(rawQuery)/2 + 2) * sizeof(char*)), "Error allocating memory for query tokens.\n");
+  tokens[0] = NULL;
+
   /* if empty query */
-  else if (strlen(rawQuery) == 0) {
+  if (strlen(rawQuery) == 0) {
     /* print to stderr */
     fprintf(stderr, "Error: empty query.\n");
 
-    /* free the query */
+    /* free the query; first word NULL lets the caller know an error occurred. */
     mem_free(rawQuery);
-
-    /* init temp tokens array to pass back to caller */
-    char** tokens = mem_calloc_assert(10, 2*sizeof(rawQuery), "Error allocating memory for query tokens.\n");
-
-    /* set first word to NULL to let them know an error occurred. */
-    tokens[0] = NULL;
-
-    /* pass tokens array back to caller */
     return tokens;
   }
 
@@ -256,22 +321,17 @@ getQuery(FILE* fp)
   normalizeWord(rawQuery);
   printf("\n\nQuery: %s\n\n", rawQuery);
 
-  /* to hold split sub-queries */
-  char** tokens = mem_calloc_assert(2*strlen(rawQuery), 5*sizeof(char), "Error allocating memory for query tokens.\n");
-  
+  /* length of the line, before strtok() splits it */
+  size_t size = strlen(rawQuery);
+
   /* track position in subquery */
   int pos = 0;
 
-  /* to track last saved token */
-  char* lastToken = mem_calloc(100, sizeof(char));
-
   /* get first word in query */
   char* token;
   if ( (token = strtok(rawQuery, " ")) == NULL) {
     fprintf(stderr, "Error parsing string tokens.\n");
     mem_free(rawQuery);
-    mem_free(lastToken);
-    tokens[0] = NULL;
     return tokens;
   }
 
@@ -279,17 +339,16 @@ getQuery(FILE* fp)
   else if (strcmp(token, "and") == 0 || strcmp(token, "or") == 0) {
     fprintf(stderr, "Error: '%s' at beginning of query.\n", token);
     mem_free(rawQuery);
-    mem_free(lastToken);
-    tokens[0] = NULL;
     return tokens;
   }
 
-  /* save token if valid */
-  tokens[pos++] = mem_malloc(10*sizeof(token));
-  strcpy(tokens[pos-1], token);
-
-  /* track it as last token */
-  strcpy(lastToken, token);
+  /* save token if valid; it is also the last token */
+  if ( (tokens[pos++] = getToken(token, arena, size)) == NULL) {
+    mem_free(rawQuery);
+    tokens[0] = NULL;
+    return tokens;
+  }
+  char* lastToken = tokens[pos-1];
 
   /*
    * while next token is valid, save it.
@@ -302,36 +361,32 @@ getQuery(FILE* fp)
       if ( (strcmp(lastToken, "and") == 0) || (strcmp(lastToken, "or") == 0) ) {
         fprintf(stderr, "Error: '%s' and '%s' not allowed to follow each other in query.\n", lastToken, token);
         mem_free(rawQuery);
-        mem_free(lastToken);
-        mem_free(tokens[0]);
         tokens[0] = NULL;
         return tokens;
       }
     }
 
-    /* else, copy the word into appropriate position and continue */
-    tokens[pos++] = mem_malloc(10*sizeof(token));
-    strcpy(tokens[pos-1], token);
-    strcpy(lastToken, token);
+    /* else, copy the word (or phrase) into appropriate position and continue */
+    if ( (tokens[pos++] = getToken(token, arena, size)) == NULL) {
+      mem_free(rawQuery);
+      tokens[0] = NULL;
+      return tokens;
+    }
+    lastToken = tokens[pos-1];
   }
 
   /* 
    * if last token is "and" or "or",
    * query is not valid.
-   * return NULL
    */
   if ( (strcmp(lastToken, "and") == 0) || (strcmp(lastToken, "or") == 0) ) {
     fprintf(stderr, "Error: '%s' at end of query.\n", lastToken);
     mem_free(rawQuery);
-    mem_free(lastToken);
-    mem_free(tokens[0]);
     tokens[0] = NULL;
     return tokens;
   }
 
-  /* free the allocated function variables */
-  mem_free(token);
-  mem_free(lastToken);
+  /* free the line read in */
   mem_free(rawQuery);
 
   /* mark end-point of query */
@@ -344,29 +399,130 @@ getQuery(FILE* fp)
 
 
 
+/**
+ * @function: getToken
+ * @brief: checks a token of the query getQuery() is splitting,
+ * and copies it into the arena: a word, a pattern,
+ * or, if it opens with a quote, the whole phrase (see getPhrase()).
+ * 
+ * @param token: the token, from strtok().
+ * @param arena: arena wherein to copy it.
+ * @param size: length of the query line, which bounds a phrase's.
+ * @return char*: the token, in the arena.
+ * @return NULL: the token is not valid; an error was printed.
+ */
+static char*
+getToken(char* token, mem_arena_t* arena, const size_t size)
+{
+  /* a pattern must start with a prefix, which bounds its expansion */
+  if (token[0] == '*') {
+    fprintf(stderr, "Error: '%s' must start with a letter, not '*'.\n", token);
+    return NULL;
+  }
+  if (token[0] == '"') {
+    return getPhrase(token, arena, size);
+  }
+  if (strchr(token, '"') != NULL) {
+    fprintf(stderr, "Error: '%s' has a quote inside a word.\n", token);
+    return NULL;
+  }
+  return mem_arena_strdup(arena, token);
+} /* end of getToken() */
+
+
+
+
+/**
+ * @function: getPhrase
+ * @brief: reads a quoted phrase, from its first token on
+ * through the token that closes it, strtok() reading the rest.
+ * The phrase is kept as a single token, quotes and all,
+ * with its words separated by single spaces: "new york city".
+ * A phrase holds plain words only -- no patterns, no inner quotes --
+ * and at least one word.
+ * 
+ * @param token: the phrase's first token, opening quote and all.
+ * @param arena: arena wherein to copy the phrase.
+ * @param size: length of the query line, which bounds the phrase's.
+ * @return char*: the phrase, in the arena.
+ * @return NULL: the phrase is not valid; an error was printed.
+ */
+static char*
+getPhrase(char* token, mem_arena_t* arena, const size_t size)
+{
+  char* phrase = mem_assert(mem_arena_alloc(arena, size + 3), "Error allocating memory for phrase.\n");
+  strcpy(phrase, "\"");
+
+  /* step past the opening quote; a token ending with a quote closes the phrase */
+  token++;
+  bool closed = false;
+  while (!closed) {
+    if (token == NULL) {
+      fprintf(stderr, "Error: no closing quote after '%s'.\n", phrase);
+      return NULL;
+    }
+    size_t len = strlen(token);
+    if (len > 0 && token[len-1] == '"') {
+      token[--len] = '\0';
+      closed = true;
+    }
+    if (strchr(token, '"') != NULL) {
+      fprintf(stderr, "Error: '%s' has a quote inside a word.\n", token);
+      return NULL;
+    }
+    if (strchr(token, '*') != NULL) {
+      fprintf(stderr, "Error: '%s' is a pattern; a phrase takes plain words only.\n", token);
+      return NULL;
+    }
+    if (len > 0) {
+      if (phrase[1] != '\0') {
+        strcat(phrase, " ");
+      }
+      strcat(phrase, token);
+    }
+    if (!closed) {
+      token = strtok(NULL, " ");
+    }
+  }
+
+  if (phrase[1] == '\0') {
+    fprintf(stderr, "Error: empty phrase.\n");
+    return NULL;
+  }
+  strcat(phrase, "\"");
+  return phrase;
+} /* end of getPhrase() */
+
+
+
+
 /**
  * @function: parseQuery
  * @brief: receives an array of words in a query.
  * splits the query into "actionable" blocks separated by 'OR' statements.
  * 
  * @param query: array of words in a query.
+ * @param arena: arena wherein to allocate the blocks.
  * @return char*** array of arrays of words --> parts of the query.
  */
 char***
-parseQuery(char** query)
+parseQuery(char** query, mem_arena_t* arena)
 {
-  assert(query != NULL);
+  assert(query != NULL && arena != NULL);
+
+  /* count the words: no more blocks, nor words per block, than that */
+  int numWords = 0;
+  while (query[numWords] != NULL) {
+    numWords++;
+  }
+
   /* alloc memory for split query */
-  char*** splitQuery = mem_calloc_assert(2, 100*sizeof(query), "Error allocating memory for parsed query.\n");
+  char*** splitQuery = mem_assert(mem_arena_alloc(arena, (numWords + 2) * sizeof(char**)), "Error allocating memory for parsed query.\n");
   int grouping = 0;
   int pos = 0;
+  splitQuery[grouping] = mem_assert(mem_arena_alloc(arena, (numWords + 1) * sizeof(char*)), "Error allocating memory for parsed query.\n");
 
-  for(int i=0; ; i++) {
-
-    /* on first NULL (end of query marker), break the loop */
-    if (query[i] == NULL) {
-      break;
-    }
+  for(int i=0; i<numWords; i++) {
 
     /* check for "and" sequences */
     if(strcmp(query[i], "and") == 0) {
@@ -383,26 +539,15 @@ parseQuery(char** query)
       splitQuery[grouping][pos++] = NULL;
       grouping++;
       pos = 0;
+      splitQuery[grouping] = mem_assert(mem_arena_alloc(arena, (numWords + 1) * sizeof(char*)), "Error allocating memory for parsed query.\n");
     }
 
-    /* general query word: save it */
+    /* general query word: save it (the arena keeps it alive) */
     else {
-      if (splitQuery[grouping] == NULL) {
-        splitQuery[grouping] = mem_malloc(50*sizeof(query));
-      }
-      splitQuery[grouping][pos++] = mem_calloc(strlen(query[i]) + 5, sizeof(char));
-      char* slot = splitQuery[grouping][pos-1];
-      char* currentWord = query[i];
-      strcpy(slot, currentWord);
+      splitQuery[grouping][pos++] = query[i];
     }
-
-    /* free the current word */
-    mem_free(query[i]);
   }
 
-  /* free the unsplit query passed in */
-  mem_free(query);
-
   /* mark endpoints with a NULL */
   splitQuery[grouping][pos] = NULL;
   splitQuery[grouping+1] = NULL;
@@ -416,26 +561,45 @@ parseQuery(char** query)
 
 /**
  * @brief: function to evaluate split tokens in a query and assemble a query object. 
+ * Each sub-query is run on each segment of the index, and all the results united:
+ * no document is in two segments, so a document's matches all come from one,
+ * and the union is the result of querying one index of every document.
  * 
  * Inputs:
- * @param index: pointer to a valid index struct
+ * @param segments: a snapshot of the index: its base and later segments.
  * @param pageDirectory: page directory wherein the pages are saved.
  * @param rawQuery: sequence of split tokens in a query.
+ * @param bm25: the scorer wherewith to rank the results; NULL to rank them by their counts.
+ * @param top: how many of the best results to find, skipping the rest (query_top()); 0 for all.
+ * @param pool: worker threads wherein to load the matching pages.
  * 
  * Returns:
  * @return query_t*: pointer to a query struct containing the results.
  */
 // query_t* 
 void
-runQuery(index_t* index, char* pageDirectory, char*** rawQuery)
+runQuery(segments_t* segments, char* pageDirectory, char*** rawQuery, bm25_t* bm25, const int top, threadpool_t* pool)
 {
   /* if any param is NULL, return NULL back to caller. */
-  if ( (index == NULL) || (pageDirectory == NULL) || (rawQuery == NULL)) {
+  if ( (segments == NULL) || (pageDirectory == NULL) || (rawQuery == NULL)) {
+    return;
+  }
+
+  /* only the best: scored as they are found, the others skipped */
+  if (top > 0) {
+    query_t* query;
+    if ( (query = query_top(segments, rawQuery, bm25, top)) == NULL) {
+      fprintf(stderr, "Error creating query.");
+      return;
+    }
+    query_index(query, segments, pageDirectory, pool);
+    query_print(query, stdout);
+    query_delete(query);
     return;
   }
 
   /* build initial subQuery */
-  query_t* query = query_build(index, rawQuery[0]);
+  query_t* query = query_build(segments_get(segments, 0), rawQuery[0]);
 
   /* exit if an error occured. */
   if (query == NULL) {
@@ -443,16 +607,19 @@ runQuery(index_t* index, char* pageDirectory, char*** rawQuery)
     return;
   }
 
-  /* unionize with builds of subsequent subQueries */
-  for (int i=1; ; i++) {
-    if (rawQuery[i] == NULL) {
-      break;
-    }
-    /* run subQ */
-    char** subQuery = rawQuery[i];
-    if (query != NULL) {
-      query_t* nextQuery = query_build(index, subQuery);
-      query = query_union(query, nextQuery);
+  /* unionize with builds of subsequent subQueries, on every segment */
+  for (int s=0; s < segments_size(segments); s++) {
+    index_t* index = segments_get(segments, s);
+    for (int i = (s == 0) ? 1 : 0; ; i++) {
+      if (rawQuery[i] == NULL) {
+        break;
+      }
+      /* run subQ */
+      char** subQuery = rawQuery[i];
+      if (query != NULL) {
+        query_t* nextQuery = query_build(index, subQuery);
+        query = query_union(query, nextQuery);
+      }
     }
   }
 
@@ -460,7 +627,10 @@ runQuery(index_t* index, char* pageDirectory, char*** rawQuery)
      print results
      and delete the query */
   if (query != NULL) {
-    query_index(query, pageDirectory);
+    if (bm25 != NULL) {
+      query_rank(query, segments, rawQuery, bm25);
+    }
+    query_index(query, segments, pageDirectory, pool);
     query_print(query, stdout);
     query_delete(query);
   }
@@ -15,12 +15,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <math.h>
 
 /* webpage handler */
 #include "webpage.h"
 
 /* data types */
 #include "index.h"
+#include "segments.h"
 #include "counters.h"
 
 /* file handler */
@@ -29,29 +32,112 @@
 /* helper library */
 #include "pagedir.h"
 
+/* ranking */
+#include "bm25.h"
+
 /*     self     */
 #include "query.h"
 
 
 /*********** Static Function Prototypes *********/
-static void dubCounters(void* arg, int docID, int count);
-static void intersect(void* arg, int docID, int count);
-static void unite(void* arg, int docID, int count);
-static void sort(void* arg, int docID, int count);
-static void setZero(void* arg, int docID, int count);
-
-
-/* global constants */
-static const int MAXPAGES = 200;
+typedef struct topk topk_t;
+typedef struct pruning pruning_t;
+static void loadPages(void* arg, const int lo, const int hi);
+static int compareRarity(const void* a, const void* b);
+static counters_t* expandPattern(index_t* index, char* pattern);
+static void collectMatch(void* arg, const char* key, void* item);
+static void intersectMatches(query_t* query, counters_t* matches);
+static counters_t* matchPhrase(index_t* index, char* phrase);
+static void matchPlaces(void* arg, int docID, int count);
+static void rankDoc(void* arg, int docID, int count);
+static char** distinctTerms(char*** subQueries, int* nTerms);
+static void pruneSegment(pruning_t* pruning, topk_t* top);
+static double termBound(pruning_t* pruning, const int t, const int maxCount, const int minTokens);
+static bool cannotRank(topk_t* top, const double bound);
+static void scoreDoc(pruning_t* pruning, topk_t* top, const int docID);
+static void rankCount(void* arg, int docID, int count);
+static void topPush(topk_t* top, const int docID, const int score);
+static void topDown(topk_t* top, const int docID, const int score);
+static void topSort(topk_t* top);
+static bool topWorse(topk_t* top, const int i, const int docID, const int score);
+
+
+/* a word of a subquery, and how many documents hold it */
+typedef struct queryword {
+  char* word;
+  int count;
+  counters_t* matches;      // a pattern's expansion; NULL for a plain word
+} queryword_t;
+
+
+/* a phrase's indexed words, and where they stand in it, being sought in each document */
+typedef struct phrase {
+  int n;                        // how many words
+  int* offsets;                 // each word's place, after the first's
+  index_positions_t** walks;    // each word's positions
+  const int** places;           // each word's positions in the document ...
+  int* sizes;                   // ... how many ...
+  int* at;                      // ... and how many passed over
+  counters_t* found;            // the documents holding the phrase, and how often
+} phrase_t;
+
+
+/* a query's terms, each one's documents in every segment, and its IDF */
+typedef struct ranking {
+  bm25_t* bm25;
+  int nTerms;                   // distinct words, patterns and phrases ...
+  int nSegments;                // ... in each of the segments
+  counters_t** ctrs;            // ctrs[t * nSegments + s]: term t's counts in segment s ...
+  bool* owned;                  // ... and whether they are ours to delete, not the index's
+  double* idf;                  // idf[t]: term t's IDF
+  counters_t* scores;           // the documents' scores, in thousandths
+} ranking_t;
+
+
+/* the best documents found so far, in a heap whose root is the worst (query_top, query_index) */
+struct topk {
+  int* docIDs;
+  int* scores;                  // in thousandths, or counts, as the query's scale
+  int size;                     // how many ...
+  int k;                        // ... of at most k
+  int scale;                    // the counts per point of score
+};
+
+
+/* a query's terms, walked together through a segment by their cursors (query_top) */
+struct pruning {
+  bm25_t* bm25;                 // the scorer; NULL to score by counts
+  int nTerms;                   // distinct words, patterns and phrases
+  int nGroups;                  // sub-queries ...
+  int** groups;                 // ... groups[g]: sub-query g's terms, by number, ending in -1
+  double* idf;                  // idf[t]: term t's IDF, if by BM25
+  index_cursor_t** cursors;     // cursors[t]: term t's postings in the segment; NULL if none
+  int* credits;                 // credits[t]: the sub-queries whose count term t bounds
+  double* bounds;               // bounds[t]: the most term t adds to any document's score
+  int* order;                   // the terms with cursors, by current docID
+  int* docs;                    // docs[t]: the docID of term t's cursor ...
+  int* counts;                  // ... and its count there
+};
+
+
+/* the counters of the words a pattern matches, still the index's */
+typedef struct matches {
+  counters_t** ctrs;
+  int n;                    // how many ...
+  int size;                 // ... and room for them
+} matches_t;
 
 
 typedef struct query {
   int numWords;
   int numPages;
-  int* docIDs;
+  int* docIDs;              // the documents, best first (query_index()) ...
+  int* scores;              // ... and their scores
   char* pageDirectory;
-  webpage_t** pages;
+  char** urls;
   counters_t* ctrs;
+  int scale;                // the counts per point of score: 1, or BM25_SCALE
+  int top;                  // the most documents kept (query_top()); 0 if all
 } query_t;
 
 
@@ -92,8 +178,13 @@ query_new()
 
   /* initialize struct pointers to NULL */
   query->docIDs = NULL;
+  query->scores = NULL;
   query->pageDirectory = NULL;
-  query->pages = NULL;
+  query->urls = NULL;
+
+  /* the scores are counts, until ranked otherwise, of every document matched */
+  query->scale = 1;
+  query->top = 0;
 
   /* initialize counters */
   query->ctrs = counters_new();
@@ -120,14 +211,16 @@ query_delete(query_t* query)
     if (query->docIDs != NULL) {
       mem_free(query->docIDs);
     }
-    if (query->pages != NULL) {
-      for (int i=0; ; i++) {
-        if (query->pages[i] == NULL) {
-          break;
+    if (query->scores != NULL) {
+      mem_free(query->scores);
+    }
+    if (query->urls != NULL) {
+      for (int i=0; i<query->numPages; i++) {
+        if (query->urls[i] != NULL) {
+          mem_free(query->urls[i]);
         }
-        webpage_delete(query->pages[i]);
       }
-      mem_free(query->pages);
+      mem_free(query->urls);
     }
     mem_free(query);
   }
@@ -139,7 +232,13 @@ query_delete(query_t* query)
 /**
  * @brief: assembles the results of a specific word's occurrence in the index.
  * Returns NULL in case of error or non-existence.
- * Also frees the passed in word. 
+ * The words remain the caller's (typically, in the per-query arena).
+ * A word with a '*' is a pattern: it stands for the union of the words
+ * it matches (see index_expand()), as if they were one word.
+ * A token in quotes is a phrase: it stands for the documents holding
+ * its words one after another, counted by how often they do.
+ * They are intersected rarest first (by index_count(), or the size
+ * of a pattern's union or a phrase's matches).
  * 
  * @param index: pointer to valid index object.
  * @param subQuery: the sequence of words to be checked in the index.
@@ -153,39 +252,53 @@ query_build(index_t* index, char** subQuery)
     query_t* query = query_new();
 
     if (query != NULL) {
-      int i = 0;                                    // track index in words
-      char* word = NULL;                            // track current word
-      while( (word = subQuery[i]) != NULL) {
+      /*
+       * take the words rarest first: the running intersection
+       * is then never bigger than the rarest word's documents,
+       * and each further word is sought only at those docIDs.
+       */
+      int numWords = 0;
+      while (subQuery[numWords] != NULL) {
+        numWords++;
+      }
+      queryword_t* words = mem_malloc_assert((numWords + 1) * sizeof(queryword_t), "Error allocating memory in query_build.");
+      for (int i = 0; i < numWords; i++) {
+        words[i].word = subQuery[i];
+        words[i].matches = NULL;
+        if (subQuery[i][0] == '"') {
+          words[i].matches = matchPhrase(index, subQuery[i]);
+          words[i].count = counters_size(words[i].matches);
+        }
+        else if (strchr(subQuery[i], '*') != NULL) {
+          words[i].matches = expandPattern(index, subQuery[i]);
+          words[i].count = counters_size(words[i].matches);
+        }
+        else {
+          words[i].count = index_count(index, subQuery[i]);
+        }
+      }
+      qsort(words, numWords, sizeof(queryword_t), compareRarity);
 
+      for (int i = 0; i < numWords; i++) {
         // find the intersection with next word
-        query_intersection(index, query, word);
-
-        // free word
-        mem_free(word);
-
-        // step to next index
-        i++;
+        if (words[i].matches != NULL) {
+          intersectMatches(query, words[i].matches);
+          counters_delete(words[i].matches);
+        }
+        else {
+          query_intersection(index, query, words[i].word);
+        }
       }
-
-      /* free the subQ */
-      mem_free(subQuery);
+      mem_free(words);
 
       /* return generated query struct */
       return query;
     }
 
-    /* free the subQ */
-    mem_free(subQuery);
-
     /* error creating query -- return NULL */
     return NULL;
   }
 
-  if (subQuery != NULL) {
-    /* free the subQ */
-    mem_free(subQuery);
-  }
-
   /* index is NULL or subQ is NULL; return NULL */
   return NULL;  
 }
@@ -206,45 +319,44 @@ query_intersection(index_t* index, query_t* query, char* nextWord) {
   /* confirm all parameters are valid */
   if ( (index != NULL) && (query != NULL) && (nextWord != NULL) ) {
 
-    /* find counters of word */
-    counters_t* nextCounts = index_find(index, nextWord);
-
-    /* 
-     * if word does not exist in page (NULL return),
-     * set all counts in query to zero
-     */
-    if (nextCounts == NULL) {
-      /* set all in query to 0 */
-      counters_iterate(query->ctrs, query->ctrs, setZero);
-      query->numWords++;
+    /* a phrase, or a pattern: the documents it matches */
+    if (nextWord[0] == '"' || strchr(nextWord, '*') != NULL) {
+      counters_t* matches = (nextWord[0] == '"') ? matchPhrase(index, nextWord) : expandPattern(index, nextWord);
+      intersectMatches(query, matches);
+      counters_delete(matches);
+      return;
     }
 
     /* 
      * if query is empty (initial step)
-     * copy the counters of first word into query.
+     * copy the counters of first word into query;
+     * if word does not exist in the index (NULL return),
+     * no document can match the whole sequence:
+     * leave the query results empty.
      */
-    else if (query->numWords == 0) {
-
-      /* copy the counters */
-      counters_iterate(nextCounts, query->ctrs, dubCounters);
+    if (query->numWords == 0) {
+      counters_t* nextCounts = index_find(index, nextWord);
+      if (nextCounts != NULL) {
+        /* copy the counters (a union with the empty set) */
+        counters_t* copy = counters_union(query->ctrs, nextCounts);
+        counters_delete(query->ctrs);
+        query->ctrs = copy;
+      }
 
       /* increment the number of words in query */
       query->numWords++;
     }
     else {
 
-      counters_t** buffer = mem_malloc(sizeof(query->ctrs) + sizeof(nextCounts));
-      counters_t* intersection = counters_new();
-      buffer[0] = nextCounts;
-      buffer[1] = intersection;
-
-      counters_iterate(query->ctrs, buffer, intersect);
-      
+      /*
+       * keep the docIDs in both, with the minimum count;
+       * the index seeks to them in the word's postings,
+       * rather than unpacking all of it.
+       */
+      counters_t* intersection = index_intersect(index, nextWord, query->ctrs);
       counters_delete(query->ctrs);
       query->ctrs = intersection;
 
-      mem_free(buffer);
-
       query->numWords++;
     }
   }
@@ -288,11 +400,9 @@ query_union(query_t* subQuery1, query_t* subQuery2)
    */
   query->numWords = subQuery1->numWords + subQuery2->numWords;
 
-  /* iterate over counters in first query */
-  counters_iterate(subQuery1->ctrs, query->ctrs, unite);
-
-  /* iterate over counters in second query */
-  counters_iterate(subQuery2->ctrs, query->ctrs, unite);
+  /* merge the two sorted sets, summing counts */
+  counters_delete(query->ctrs);
+  query->ctrs = counters_union(subQuery1->ctrs, subQuery2->ctrs);
 
   /* delete the two original sub queries */
   query_delete(subQuery1);
@@ -306,83 +416,299 @@ query_union(query_t* subQuery1, query_t* subQuery2)
 
 
 /**
- * @brief: merge the query results with data from the index and pages.
+ * @brief: scores the query's documents by BM25 (see bm25.h), in place
+ * of their counts. Each distinct term of the query -- word, pattern,
+ * or phrase, in any sub-query -- adds its score in each document
+ * holding it, whichever sub-query matched the document.
+ * A term's document frequency is summed over the segments,
+ * and its IDF computed once, into a table, before any document is scored.
  * 
- * @param query: pointer to a query struct.
- * @param pageDirectory: file directory wherein pages are saved.
+ * @param query: pointer to a query struct, as query_union() leaves it.
+ * @param segments: the index's segments.
+ * @param subQueries: the query's sub-queries, NULL-terminated, each of terms.
+ * @param bm25: the index's scorer.
  */
 void
-query_index(query_t* query, char* pageDirectory)
+query_rank(query_t* query, segments_t* segments, char*** subQueries, bm25_t* bm25)
 {
-  if (query == NULL || query->ctrs == NULL) {
+  if (query == NULL || query->ctrs == NULL || segments == NULL || subQueries == NULL || bm25 == NULL) {
     return;
   }
 
-  /* buffer to hold sorted docID-value pairs */
-  int** buffer = mem_calloc_assert(2, MAXPAGES*sizeof(int), "Error allocating memory in query_index.");
+  /* the distinct terms */
+  int nTerms;
+  char** terms = distinctTerms(subQueries, &nTerms);
+
+  /* each term's counts in each segment, and, from them, its IDF */
+  ranking_t ranking = { bm25, nTerms, segments_size(segments) };
+  ranking.ctrs = mem_calloc_assert(nTerms * ranking.nSegments + 1, sizeof(counters_t*), "Error allocating memory in query_rank.");
+  ranking.owned = mem_calloc_assert(nTerms * ranking.nSegments + 1, sizeof(bool), "Error allocating memory in query_rank.");
+  ranking.idf = mem_malloc_assert((nTerms + 1) * sizeof(double), "Error allocating memory in query_rank.");
+  for (int t = 0; t < nTerms; t++) {
+    int df = 0;
+    for (int s = 0; s < ranking.nSegments; s++) {
+      index_t* index = segments_get(segments, s);
+      int k = t * ranking.nSegments + s;
+      if (terms[t][0] == '"') {
+        ranking.ctrs[k] = matchPhrase(index, terms[t]);
+        ranking.owned[k] = true;
+      }
+      else if (strchr(terms[t], '*') != NULL) {
+        ranking.ctrs[k] = expandPattern(index, terms[t]);
+        ranking.owned[k] = true;
+      }
+      else {
+        ranking.ctrs[k] = index_find(index, terms[t]);
+      }
+      if (ranking.ctrs[k] != NULL) {
+        df += counters_size(ranking.ctrs[k]);
+      }
+    }
+    ranking.idf[t] = bm25_idf(bm25, df);
+  }
+
+  /* score the documents, in docID order */
+  ranking.scores = counters_new();
+  counters_iterate(query->ctrs, &ranking, rankDoc);
+  counters_delete(query->ctrs);
+  query->ctrs = ranking.scores;
+  query->scale = BM25_SCALE;
+
+  for (int k = 0; k < nTerms * ranking.nSegments; k++) {
+    if (ranking.owned[k]) {
+      counters_delete(ranking.ctrs[k]);
+    }
+  }
+  mem_free(ranking.ctrs);
+  mem_free(ranking.owned);
+  mem_free(ranking.idf);
+  mem_free(terms);
+}
 
-  buffer[0] = mem_calloc(MAXPAGES, sizeof(int));
-  buffer[1] = mem_calloc(MAXPAGES, sizeof(int));
 
-  char* sampleURL = mem_calloc(50, sizeof(char));
-  strcpy(sampleURL, "sampleURL.com");
-  webpage_t* samplePage = webpage_new(sampleURL, MAXPAGES, NULL);
 
-  query->pages = mem_calloc_assert(MAXPAGES, sizeof(samplePage), "Error allocating memory in query_index");
 
-  webpage_delete(samplePage);
+/**
+ * @brief: the k best documents of a query, by BM25 or by count, found
+ * without scoring every document it matches: Block-Max WAND.
+ * The terms' postings are walked together, by cursors (index_cursor()),
+ * through one segment, then the next, keeping the k best so far in a heap;
+ * once it is full, a document can rank only by outscoring the worst of them.
+ * Each term's maxima bound what it can add to a score, in any document
+ * (index_cursorMax()) and in each block of its postings (index_cursorBlock());
+ * the documents whose terms cannot add up to enough are skipped,
+ * and the blocks that cannot are not unpacked.
+ * Every other document is scored as query_rank(), or the count of
+ * query_build() and query_union(), would score it, so the k are those
+ * the whole ranking starts with, ties going to the lower docID.
+ * 
+ * @param segments: the index's segments.
+ * @param subQueries: the query's sub-queries, NULL-terminated, each of terms.
+ * @param bm25: the index's scorer (bm25_new()); NULL to score by counts.
+ * @param k: how many documents to keep; at least one.
+ * @return query_t*: a query struct holding the k documents, or fewer
+ * if fewer match, with their scores.
+ */
+query_t*
+query_top(segments_t* segments, char*** subQueries, bm25_t* bm25, const int k)
+{
+  if (segments == NULL || subQueries == NULL || k < 1) {
+    return NULL;
+  }
+  query_t* query;
+  if ( (query = query_new()) == NULL) {
+    return NULL;
+  }
 
-  query->docIDs = mem_calloc_assert(MAXPAGES, sizeof(int), "Error allocating memory in query_index.");
+  /* the distinct terms, and each sub-query's, by their places among them */
+  int nTerms;
+  char** terms = distinctTerms(subQueries, &nTerms);
+  pruning_t pruning = { bm25, nTerms };
+  while (subQueries[pruning.nGroups] != NULL) {
+    pruning.nGroups++;
+  }
+  pruning.groups = mem_malloc_assert((pruning.nGroups + 1) * sizeof(int*), "Error allocating memory in query_top.");
+  for (int g = 0; g < pruning.nGroups; g++) {
+    int n = 0;
+    while (subQueries[g][n] != NULL) {
+      n++;
+    }
+    pruning.groups[g] = mem_malloc_assert((n + 1) * sizeof(int), "Error allocating memory in query_top.");
+    for (int j = 0; j < n; j++) {
+      int t = 0;
+      while (strcmp(terms[t], subQueries[g][j]) != 0) {
+        t++;
+      }
+      pruning.groups[g][j] = t;
+    }
+    pruning.groups[g][n] = -1;
+  }
 
-  /* iterate through counters to sort calues. */
-  if (query->ctrs != NULL) {
-    counters_iterate(query->ctrs, buffer, sort);
+  /* the documents each pattern and phrase matches in each segment; each term's IDF */
+  int nSegments = segments_size(segments);
+  counters_t** matches = mem_calloc_assert(nTerms * nSegments + 1, sizeof(counters_t*), "Error allocating memory in query_top.");
+  pruning.idf = mem_calloc_assert(nTerms + 1, sizeof(double), "Error allocating memory in query_top.");
+  for (int t = 0; t < nTerms; t++) {
+    int df = 0;
+    for (int s = 0; s < nSegments; s++) {
+      index_t* index = segments_get(segments, s);
+      counters_t** ctrs = &matches[t * nSegments + s];
+      if (terms[t][0] == '"') {
+        *ctrs = matchPhrase(index, terms[t]);
+      }
+      else if (strchr(terms[t], '*') != NULL) {
+        *ctrs = expandPattern(index, terms[t]);
+      }
+      df += (*ctrs != NULL) ? counters_size(*ctrs) : index_count(index, terms[t]);
+    }
+    if (bm25 != NULL) {
+      pruning.idf[t] = bm25_idf(bm25, df);
+    }
   }
 
-  /* create counters of sorted values */
-  counters_t* sorted = counters_new();
-  int* keys = buffer[0];
-  int* counts = buffer[1];
+  /* each segment in turn, in docID order, into one heap */
+  pruning.cursors = mem_calloc_assert(nTerms + 1, sizeof(index_cursor_t*), "Error allocating memory in query_top.");
+  pruning.credits = mem_malloc_assert((nTerms + 1) * sizeof(int), "Error allocating memory in query_top.");
+  pruning.bounds = mem_malloc_assert((nTerms + 1) * sizeof(double), "Error allocating memory in query_top.");
+  pruning.order = mem_malloc_assert((nTerms + 1) * sizeof(int), "Error allocating memory in query_top.");
+  pruning.docs = mem_malloc_assert((nTerms + 1) * sizeof(int), "Error allocating memory in query_top.");
+  pruning.counts = mem_malloc_assert((nTerms + 1) * sizeof(int), "Error allocating memory in query_top.");
+  topk_t top = { mem_malloc_assert(k * sizeof(int), "Error allocating memory in query_top."),
+                 mem_malloc_assert(k * sizeof(int), "Error allocating memory in query_top."),
+                 0, k, (bm25 != NULL) ? BM25_SCALE : 1 };
+  for (int s = 0; s < nSegments; s++) {
+    index_t* index = segments_get(segments, s);
+    for (int t = 0; t < nTerms; t++) {
+      counters_t* ctrs = matches[t * nSegments + s];
+      pruning.cursors[t] = (ctrs == NULL) ? index_cursor(index, terms[t])
+                         : (counters_size(ctrs) > 0) ? index_cursorOver(index, ctrs) : NULL;
+    }
+    pruneSegment(&pruning, &top);
+    for (int t = 0; t < nTerms; t++) {
+      index_cursorDelete(pruning.cursors[t]);
+    }
+  }
 
-  /* index pages */
-  for (int i=0; ; i++) {
+  /* the k best, with their scores, for query_index() to order */
+  for (int i = 0; i < top.size; i++) {
+    counters_set(query->ctrs, top.docIDs[i], top.scores[i]);
+  }
+  query->scale = top.scale;
+  query->top = k;
 
-    /* at ZERO key (end of items), save it and break the loop. */
-    if (keys[i] == 0) {
-      query->numPages = i;
-      break;
+  for (int i = 0; i < nTerms * nSegments; i++) {
+    if (matches[i] != NULL) {
+      counters_delete(matches[i]);
     }
+  }
+  for (int g = 0; g < pruning.nGroups; g++) {
+    mem_free(pruning.groups[g]);
+  }
+  mem_free(top.docIDs);
+  mem_free(top.scores);
+  mem_free(pruning.counts);
+  mem_free(pruning.docs);
+  mem_free(pruning.order);
+  mem_free(pruning.bounds);
+  mem_free(pruning.credits);
+  mem_free(pruning.cursors);
+  mem_free(pruning.idf);
+  mem_free(pruning.groups);
+  mem_free(matches);
+  mem_free(terms);
+  return query;
+}
 
-    /* load current page and save it to query */
-    char filepath[strlen(pageDirectory) + 10];
-    if (pageDirectory[strlen(pageDirectory)-1] == '/') {
-      sprintf(filepath, "%s%d", pageDirectory, keys[i]);
+
+
+
+
+/**
+ * @brief: merge the query results with data from the index and pages.
+ * The documents are ranked first: gathered, in docID order, into a heap
+ * of the best so far, as big as the query keeps -- all, unless from
+ * query_top() -- then taken out of it, worst first, to fill the ranking
+ * from the end; O(n log k) for n documents kept to k, whatever their number.
+ * 
+ * @param query: pointer to a query struct.
+ * @param segments: the index, whose document tables hold the URLs.
+ * @param pageDirectory: file directory wherein pages are saved.
+ */
+void
+query_index(query_t* query, segments_t* segments, char* pageDirectory, threadpool_t* pool)
+{
+  if (query == NULL || query->ctrs == NULL) {
+    return;
+  }
+
+  /* rank the documents: the higher score first, and of equal scores the lower docID */
+  int n = counters_size(query->ctrs);
+  int k = (query->top > 0 && query->top < n) ? query->top : n;
+  topk_t top = { mem_malloc_assert((k + 1) * sizeof(int), "Error allocating memory in query_index."),
+                 mem_malloc_assert((k + 1) * sizeof(int), "Error allocating memory in query_index."),
+                 0, k, query->scale };
+  counters_iterate(query->ctrs, &top, rankCount);
+  topSort(&top);
+  query->docIDs = top.docIDs;
+  query->scores = top.scores;
+  query->numPages = top.size;
+  query->urls = mem_calloc_assert(query->numPages + 1, sizeof(char*), "Error allocating memory in query_index");
+
+  /*
+   * look the URLs up in the document tables: an entry each, whatever the page's size;
+   * load the pages the tables lack -- all, for a text index -- in parallel, each into its own slot
+   */
+  bool missing = false;
+  for (int i = 0; i < query->numPages; i++) {
+    index_doc_t doc;
+    if (segments != NULL && segments_getDoc(segments, query->docIDs[i], &doc)) {
+      query->urls[i] = mem_malloc_assert(strlen(doc.url) + 1, "Error allocating memory in query_index.");
+      strcpy(query->urls[i], doc.url);
     }
     else {
-      sprintf(filepath, "%s/%d", pageDirectory, keys[i]);
+      missing = true;
     }
-    webpage_t* page = pagedir_load(filepath);
-    
-    // query->pages = NULL;
-    query->pages[i] = page;
-    query->docIDs[i] = keys[i];
   }
-
-  /* add in values in the new order */
-  for (int i=0; i<query->numPages; i++) {
-    counters_set(sorted, keys[i], counts[i]);
+  query->pageDirectory = pageDirectory;
+  if (missing) {
+    threadpool_parallel_for(pool, 0, query->numPages, 1, loadPages, query);
   }
+}
+
 
-  /* delete old counters */
-  counters_delete(query->ctrs);
 
-  /* save new counters */
-  query->ctrs = sorted;
 
-  /* free the buffer */
-  mem_free(keys);
-  mem_free(counts);
-  mem_free(buffer);
+/**
+ * @brief: loads the pages of the query's docIDs [lo, hi) whose URLs
+ * are not yet known from its page directory, and keeps their URLs
+ * in the matching slots of its urls array;
+ * runs in parallel over disjoint ranges.
+ * 
+ * @param arg: pointer to a query struct.
+ * @param lo: first index to load.
+ * @param hi: one past the last index to load.
+ */
+static void
+loadPages(void* arg, const int lo, const int hi)
+{
+  query_t* query = (query_t*) arg;
+  char* pageDirectory = query->pageDirectory;
+  const char* slash = (pageDirectory[strlen(pageDirectory)-1] == '/') ? "" : "/";
+
+  for (int i = lo; i < hi; i++) {
+    if (query->urls[i] != NULL) {
+      continue;
+    }
+    char filepath[strlen(pageDirectory) + 20];
+    sprintf(filepath, "%s%s%d", pageDirectory, slash, query->docIDs[i]);
+    webpage_t* page = pagedir_load(filepath);
+    if (page != NULL) {
+      char* url = webpage_getURL(page);
+      query->urls[i] = mem_malloc_assert(strlen(url) + 1, "Error allocating memory in loadPages.");
+      strcpy(query->urls[i], url);
+      webpage_delete(page);
+    }
+  }
 }
 
 
@@ -400,10 +726,11 @@ query_print(query_t* query, FILE* fp)
   /* make sure query and file pointers are valid */
   if (query != NULL && fp != NULL) {
 
-    /* get array of pages, docIDs */
-    webpage_t** pages = query->pages;
+    /* get array of URLs, docIDs, scores */
+    char** urls = query->urls;
     int* docIDs = query->docIDs;
-    if (pages != NULL && docIDs != NULL) {
+    int* scores = query->scores;
+    if (urls != NULL && docIDs != NULL && scores != NULL) {
 
       /* if no pages matched, print no pages */
       if (query->numPages == 0) {
@@ -414,13 +741,22 @@ query_print(query_t* query, FILE* fp)
        and each page's number of matches, 
        document ID, URL */
       else{
-        fprintf(fp, "Matches %d documents (ranked):\n", query->numPages);
+        if (query->top > 0) {
+          fprintf(fp, "Top %d documents (ranked):\n", query->numPages);
+        }
+        else {
+          fprintf(fp, "Matches %d documents (ranked):\n", query->numPages);
+        }
         for (int i = 0; i<query->numPages; i++) {
           int docID = docIDs[i];
           if (docID > 0) {
-            int score = counters_get(query->ctrs, docID);
-            char* url = webpage_getURL(pages[i]);
-            fprintf(fp, "score %3d doc %3d: %s\n", score, docID, url);
+            int score = scores[i];
+            if (query->scale == 1) {
+              fprintf(fp, "score %3d doc %3d: %s\n", score, docID, urls[i] != NULL ? urls[i] : "");
+            }
+            else {
+              fprintf(fp, "score %7.3f doc %3d: %s\n", (double) score / query->scale, docID, urls[i] != NULL ? urls[i] : "");
+            }
           }
         }
       }
@@ -432,98 +768,470 @@ query_print(query_t* query, FILE* fp)
 
 
 /**
- * @brief: sorts a duo of arrays containing key-value pairs
+ * @brief: compares two words of a subquery by how many documents
+ * hold them, for qsort: the rarer first.
+ * 
+ * @param a: pointer to a queryword_t.
+ * @param b: pointer to a queryword_t.
+ * @return int: negative, zero or positive as a is rarer, as rare, or less rare than b.
+ */
+static int
+compareRarity(const void* a, const void* b)
+{
+  int countA = ((const queryword_t*) a)->count;
+  int countB = ((const queryword_t*) b)->count;
+  return (countA > countB) - (countA < countB);
+}
+
+
+
+
+/**
+ * @brief: the union of the counters of the words a pattern matches,
+ * with each docID's counts summed, as if the words were one.
+ * The counters are united pairwise, then the unions pairwise,
+ * and so on, so each posting is merged about log2(words) times,
+ * not once per word.
+ * 
+ * @param index: pointer to valid index object.
+ * @param pattern: a word with a '*' (see index_expand()).
+ * @return counters_t*: new counters, empty if no word matches;
+ * the caller must counters_delete() them.
+ */
+static counters_t*
+expandPattern(index_t* index, char* pattern)
+{
+  matches_t matches = { NULL, 0, 0 };
+  index_expand(index, pattern, &matches, collectMatch);
+  if (matches.n == 0) {
+    if (matches.ctrs != NULL) {
+      mem_free(matches.ctrs);
+    }
+    return counters_new();
+  }
+
+  /* the first round copies the index's counters; later ones free their inputs */
+  counters_t* empty = counters_new();
+  int n = 0;
+  for (int i = 0; i < matches.n; i += 2) {
+    counters_t* other = (i + 1 < matches.n) ? matches.ctrs[i + 1] : empty;
+    matches.ctrs[n++] = counters_union(matches.ctrs[i], other);
+  }
+  counters_delete(empty);
+  while (n > 1) {
+    int m = 0;
+    for (int i = 0; i < n; i += 2) {
+      if (i + 1 < n) {
+        counters_t* both = counters_union(matches.ctrs[i], matches.ctrs[i + 1]);
+        counters_delete(matches.ctrs[i]);
+        counters_delete(matches.ctrs[i + 1]);
+        matches.ctrs[m++] = both;
+      }
+      else {
+        matches.ctrs[m++] = matches.ctrs[i];
+      }
+    }
+    n = m;
+  }
+
+  counters_t* result = matches.ctrs[0];
+  mem_free(matches.ctrs);
+  return result;
+}
+
+
+
+
+/**
+ * @brief: helper for expandPattern, used by index_expand:
+ * keeps a matching word's counters, growing the array as it fills.
  * 
- * @param arg: pointer to two coupled arrays.
- * @param docID: document ID (key)
- * @param count: count
+ * @param arg: pointer to the matches_t.
+ * @param key: the word.
+ * @param item: its counters.
  */
 static void
-sort(void* arg, int docID, int count)
+collectMatch(void* arg, const char* key, void* item)
 {
-  if (arg != NULL) {
+  matches_t* matches = (matches_t*) arg;
+  if (matches->n == matches->size) {
+    matches->size = (matches->size == 0) ? 16 : 2 * matches->size;
+    counters_t** ctrs = mem_malloc_assert(matches->size * sizeof(counters_t*), "Error allocating memory in collectMatch.");
+    if (matches->ctrs != NULL) {
+      memcpy(ctrs, matches->ctrs, matches->n * sizeof(counters_t*));
+      mem_free(matches->ctrs);
+    }
+    matches->ctrs = ctrs;
+  }
+  matches->ctrs[matches->n++] = (counters_t*) item;
+}
 
-    /* convert back to 2D array */
-    int** buffer = (int**) arg;
-    int* keys = buffer[0];
-    int* counts = buffer[1];
 
-    /* find size of array */
-    int size = 0;
-    for (int i=0; ; i++) {
-      if (counts[i] == 0) {
-        break;
+
+
+/**
+ * @brief: intersects the query's results with a pattern's matches,
+ * as query_intersection() does with a word's counters.
+ * 
+ * @param query: pointer to a valid query_t* object.
+ * @param matches: the pattern's matches (expandPattern()); unchanged.
+ */
+static void
+intersectMatches(query_t* query, counters_t* matches)
+{
+  counters_t* result = (query->numWords == 0)
+    ? counters_union(query->ctrs, matches)
+    : counters_intersect(query->ctrs, matches);
+  counters_delete(query->ctrs);
+  query->ctrs = result;
+  query->numWords++;
+}
+
+
+
+
+/**
+ * @brief: the documents holding a phrase, each counted by how many
+ * times it does: the places where the phrase's words stand
+ * at the same distances apart as in the phrase.
+ * As the indexer, the phrase skips words under three letters:
+ * those at either end are dropped, and those within match any word.
+ * The candidates are the documents holding all its words
+ * (query_build()); their positions (index_positions()) are then
+ * walked in step, forward only, in docID order.
+ * An index without positions cannot tell where words stand:
+ * the phrase then matches the documents holding all its words.
+ * 
+ * @param index: pointer to valid index object.
+ * @param phrase: a phrase, in quotes, of words separated by single spaces.
+ * @return counters_t*: new counters, empty if no document holds the phrase;
+ * the caller must counters_delete() them.
+ */
+static counters_t*
+matchPhrase(index_t* index, char* phrase)
+{
+  /* split the words out of the quotes: each stands one place after the one before */
+  size_t len = strlen(phrase);
+  char* text = mem_malloc_assert(len + 1, "Error allocating memory in matchPhrase.");
+  strcpy(text, phrase + 1);
+  if (len > 1 && text[len - 2] == '"') {
+    text[len - 2] = '\0';
+  }
+  char** words = mem_malloc_assert((len / 2 + 2) * sizeof(char*), "Error allocating memory in matchPhrase.");
+  phrase_t match = { 0 };
+  match.offsets = mem_malloc_assert((len / 2 + 2) * sizeof(int), "Error allocating memory in matchPhrase.");
+  int place = 0;
+  for (char* word = text; word != NULL; place++) {
+    char* space = strchr(word, ' ');
+    if (space != NULL) {
+      *space = '\0';
+    }
+    if (strlen(word) > 2) {
+      words[match.n] = word;
+      match.offsets[match.n++] = place;
+    }
+    word = (space != NULL) ? space + 1 : NULL;
+  }
+  words[match.n] = NULL;
+
+  /* the candidates: the documents holding every word */
+  counters_t* candidates = counters_new();
+  if (match.n > 0) {
+    query_t* all = query_build(index, words);
+    counters_delete(candidates);
+    candidates = all->ctrs;
+    all->ctrs = NULL;
+    query_delete(all);
+  }
+
+  /* one word is its own phrase; more must stand in their places */
+  counters_t* result = candidates;
+  if (match.n > 1 && counters_size(candidates) > 0) {
+    match.walks = mem_calloc_assert(match.n, sizeof(index_positions_t*), "Error allocating memory in matchPhrase.");
+    bool positional = true;
+    for (int i = match.n - 1; i >= 0; i--) {
+      match.offsets[i] -= match.offsets[0];
+      if ( (match.walks[i] = index_positions(index, words[i])) == NULL) {
+        positional = false;
       }
-      size = i+1;
     }
+    if (positional) {
+      match.places = mem_malloc_assert(match.n * sizeof(int*), "Error allocating memory in matchPhrase.");
+      match.sizes = mem_malloc_assert(match.n * sizeof(int), "Error allocating memory in matchPhrase.");
+      match.at = mem_malloc_assert(match.n * sizeof(int), "Error allocating memory in matchPhrase.");
+      match.found = counters_new();
+      counters_iterate(candidates, &match, matchPlaces);
+      counters_delete(candidates);
+      result = match.found;
+      mem_free(match.places);
+      mem_free(match.sizes);
+      mem_free(match.at);
+    }
+    for (int i = 0; i < match.n; i++) {
+      index_positionsDelete(match.walks[i]);
+    }
+    mem_free(match.walks);
+  }
 
-    /* loop through array to find point where values fit in. */
-    for (int i=0; i<=size+1; i++) {
-      if (count > counts[i]) {
+  mem_free(match.offsets);
+  mem_free(words);
+  mem_free(text);
+  return result;
+}
 
-        /* shift values after index by 1 to the right. */
-        for (int j=size+1; j>i; j--) {
-          keys[j] = keys[j-1];
-          counts[j] = counts[j-1];
-        }
 
-        /* save in the values */
-        keys[i] = docID;
-        counts[i] = count;
-        break;
+
+
+/**
+ * @brief: helper for matchPhrase, used by counters_iterate:
+ * counts the places in a document where the phrase starts,
+ * each word at its offset from the first. The first word's positions
+ * are taken in turn; every other word's, as they only climb with it,
+ * are each passed over once.
+ * 
+ * @param arg: pointer to the phrase_t.
+ * @param docID: a document holding all the phrase's words.
+ * @param count: unused.
+ */
+static void
+matchPlaces(void* arg, int docID, int count)
+{
+  phrase_t* match = (phrase_t*) arg;
+  for (int i = 0; i < match->n; i++) {
+    if ( (match->places[i] = index_positionsIn(match->walks[i], docID, &match->sizes[i])) == NULL) {
+      return;
+    }
+  }
+
+  /* each start of the first word: is every other word at its offset from it? */
+  int found = 0;
+  for (int i = 1; i < match->n; i++) {
+    match->at[i] = 0;
+  }
+  for (int s = 0; s < match->sizes[0]; s++) {
+    bool all = true;
+    for (int i = 1; i < match->n && all; i++) {
+      long place = (long) match->places[0][s] + match->offsets[i];
+      while (match->at[i] < match->sizes[i] && match->places[i][match->at[i]] < place) {
+        match->at[i]++;
       }
+      all = match->at[i] < match->sizes[i] && match->places[i][match->at[i]] == place;
+    }
+    if (all) {
+      found++;
     }
   }
+  if (found > 0) {
+    counters_set(match->found, docID, found);
+  }
 }
 
 
 
 
 /**
- * @brief: create a union of two counters sets.
- * receives key-value pairs from one counters set
- * and compounds them into the other counters set.
+ * @brief: helper for query_rank, used by counters_iterate:
+ * sums a document's BM25 scores over the query's terms,
+ * and keeps the sum, in thousandths -- at least one,
+ * as a document the query matched scores above nothing.
  * 
- * @param arg: pointer to a counters struct
- * @param docID: document ID (key)
- * @param count: count
+ * @param arg: pointer to the ranking_t.
+ * @param docID: a document the query matched.
+ * @param count: unused.
  */
 static void
-unite(void* arg, int docID, int count)
+rankDoc(void* arg, int docID, int count)
 {
-  /* check all parameters are valid */
-  if (arg != NULL) {
-    counters_t* ctrs = (counters_t*) arg;
+  ranking_t* ranking = (ranking_t*) arg;
+  double score = 0;
+  for (int t = 0; t < ranking->nTerms; t++) {
+    for (int s = 0; s < ranking->nSegments; s++) {
+      counters_t* ctrs = ranking->ctrs[t * ranking->nSegments + s];
+      if (ctrs != NULL) {
+        score += bm25_term(ranking->bm25, ranking->idf[t], docID, counters_get(ctrs, docID));
+      }
+    }
+  }
+  long scaled = lround(score * BM25_SCALE);
+  counters_set(ranking->scores, docID, scaled < 1 ? 1 : (scaled > INT_MAX ? INT_MAX : (int) scaled));
+}
+
 
-    /* get current count of docID in counters */
-    int currentCount = counters_get(ctrs, docID);
 
-    /* save max to counters */
-    int total = currentCount + count;
-    counters_set(ctrs, docID, total);
+
+/**
+ * @brief: the distinct terms of a query's sub-queries,
+ * in the order they first appear.
+ * 
+ * @param subQueries: the sub-queries, NULL-terminated, each of terms.
+ * @param nTerms: where to save how many there are.
+ * @return char**: the terms, still the caller's; the array must be mem_free()d.
+ */
+static char**
+distinctTerms(char*** subQueries, int* nTerms)
+{
+  int n = 0;
+  for (int i = 0; subQueries[i] != NULL; i++) {
+    for (int j = 0; subQueries[i][j] != NULL; j++) {
+      n++;
+    }
+  }
+  char** terms = mem_malloc_assert((n + 1) * sizeof(char*), "Error allocating memory in distinctTerms.");
+  n = 0;
+  for (int i = 0; subQueries[i] != NULL; i++) {
+    for (int j = 0; subQueries[i][j] != NULL; j++) {
+      bool seen = false;
+      for (int t = 0; t < n && !seen; t++) {
+        seen = strcmp(terms[t], subQueries[i][j]) == 0;
+      }
+      if (!seen) {
+        terms[n++] = subQueries[i][j];
+      }
+    }
   }
+  *nTerms = n;
+  return terms;
 }
 
 
 
 
 /**
- * @brief: create a copy of a counters:
- * Receives key-value pairs and saves them in the counter.
+ * @brief: helper for query_top: walks the terms' cursors through one
+ * segment, putting each document that can rank, scored, in the heap.
+ * The cursors stand at the first posting of their terms not yet passed,
+ * so a document can hold only the terms whose cursors stand at or before it.
+ * Each step takes the first document that might both match the query --
+ * no earlier than the latest term of the sub-query whose terms are
+ * all soonest -- and, once the heap is full, outscore its worst:
+ * where the bounds of the terms at or before it first add up to enough
+ * (the WAND pivot). If the bounds of those terms' blocks holding it
+ * add up to enough too, it is scored; if not, no document is that ends
+ * before the first of the blocks does, or before the next term's posting,
+ * and the cursors skip past them all.
  * 
- * @param arg: pointer to a counters
- * @param docID: document ID (key)
- * @param count: count
+ * @param pruning: the terms, and their cursors in the segment.
+ * @param top: the heap of the best documents so far.
  */
 static void
-dubCounters(void* arg, int docID, int count)
+pruneSegment(pruning_t* pruning, topk_t* top)
 {
-  if(arg != NULL) {
-    /* convert back to counters_t* */
-    counters_t* copy = (counters_t*) arg;
+  /* what each term can add to a score: by counts, each sub-query's least count, bounded by its likeliest-least term */
+  for (int t = 0; t < pruning->nTerms; t++) {
+    pruning->credits[t] = 0;
+  }
+  for (int g = 0; g < pruning->nGroups && pruning->bm25 == NULL; g++) {
+    int least = -1, leastMax = 0;
+    for (int j = 0; pruning->groups[g][j] >= 0; j++) {
+      int t = pruning->groups[g][j], minTokens;
+      if (pruning->cursors[t] == NULL) {
+        least = -1;                   // the sub-query matches nothing here
+        break;
+      }
+      int max = index_cursorMax(pruning->cursors[t], &minTokens);
+      if (least < 0 || max < leastMax) {
+        least = t;
+        leastMax = max;
+      }
+    }
+    if (least >= 0) {
+      pruning->credits[least]++;
+    }
+  }
+  for (int t = 0; t < pruning->nTerms; t++) {
+    int max, minTokens;
+    if (pruning->cursors[t] != NULL) {
+      max = index_cursorMax(pruning->cursors[t], &minTokens);
+      pruning->bounds[t] = termBound(pruning, t, max, minTokens);
+    }
+  }
 
-    /* insert docID-count pair into the copy */
-    counters_set(copy, docID, count);
+  while (true) {
+    /* the terms' current postings, in docID order */
+    int n = 0;
+    for (int t = 0; t < pruning->nTerms; t++) {
+      if (pruning->cursors[t] != NULL) {
+        pruning->docs[t] = index_cursorDoc(pruning->cursors[t], &pruning->counts[t]);
+        int i = n++;
+        while (i > 0 && pruning->docs[pruning->order[i - 1]] > pruning->docs[t]) {
+          pruning->order[i] = pruning->order[i - 1];
+          i--;
+        }
+        pruning->order[i] = t;
+      }
+    }
+
+    /* the first document that could match: the soonest of each sub-query's last term */
+    int pivot = INT_MAX;
+    for (int g = 0; g < pruning->nGroups; g++) {
+      int last = 0;
+      for (int j = 0; pruning->groups[g][j] >= 0 && last < INT_MAX; j++) {
+        int t = pruning->groups[g][j];
+        last = (pruning->cursors[t] == NULL) ? INT_MAX
+             : (pruning->docs[t] > last) ? pruning->docs[t] : last;
+      }
+      pivot = (last < pivot) ? last : pivot;
+    }
+    if (pivot == INT_MAX) {
+      return;
+    }
+
+    if (top->size == top->k) {
+      /* the first document whose terms could outscore the worst of the heap */
+      double bound = 0;
+      int i = 0;
+      for ( ; i < n && pruning->docs[pruning->order[i]] < INT_MAX; i++) {
+        bound += pruning->bounds[pruning->order[i]];
+        if (!cannotRank(top, bound)) {
+          break;
+        }
+      }
+      if (i == n || pruning->docs[pruning->order[i]] == INT_MAX) {
+        return;
+      }
+      pivot = (pruning->docs[pruning->order[i]] > pivot) ? pruning->docs[pruning->order[i]] : pivot;
+
+      /* the blocks holding it: could they? if not, skip the documents up to where one ends */
+      double blockBound = 0;
+      long next = LONG_MAX;
+      for (i = 0; i < n; i++) {
+        int t = pruning->order[i];
+        if (pruning->docs[t] <= pivot) {
+          int maxCount, minTokens;
+          long last = index_cursorBlock(pruning->cursors[t], pivot, &maxCount, &minTokens);
+          blockBound += termBound(pruning, t, maxCount, minTokens);
+          next = (last + 1 < next) ? last + 1 : next;
+        }
+        else {
+          next = (pruning->docs[t] < next) ? pruning->docs[t] : next;
+        }
+      }
+      if (cannotRank(top, blockBound)) {
+        if (next >= INT_MAX) {
+          return;
+        }
+        for (i = 0; i < n && pruning->docs[pruning->order[i]] <= pivot; i++) {
+          index_cursorSeek(pruning->cursors[pruning->order[i]], (int) next);
+        }
+        continue;
+      }
+    }
+
+    /* score it, from every term: those that stand before it move up to it */
+    for (int i = 0; i < n; i++) {
+      int t = pruning->order[i];
+      if (pruning->docs[t] < pivot) {
+        index_cursorSeek(pruning->cursors[t], pivot);
+        pruning->docs[t] = index_cursorDoc(pruning->cursors[t], &pruning->counts[t]);
+      }
+    }
+    scoreDoc(pruning, top, pivot);
+    for (int i = 0; i < n; i++) {
+      int t = pruning->order[i];
+      if (pruning->docs[t] == pivot) {
+        index_cursorSeek(pruning->cursors[t], pivot + 1);
+      }
+    }
   }
 }
 
@@ -531,54 +1239,220 @@ dubCounters(void* arg, int docID, int count)
 
 
 /**
- * @brief: reset values in counters to zero
+ * @brief: helper for pruneSegment: the most a term can add to the
+ * score of a document, given the maxima of its postings there:
+ * by BM25, its bound (bm25_bound()); by counts, its largest count,
+ * for each sub-query it bounds.
+ * 
+ * @param pruning: the terms.
+ * @param t: the term.
+ * @param maxCount: the largest count of its postings in question.
+ * @param minTokens: the fewest words indexed from any of their documents.
+ * @return double: the bound, in points of score.
+ */
+static double
+termBound(pruning_t* pruning, const int t, const int maxCount, const int minTokens)
+{
+  if (pruning->bm25 != NULL) {
+    return bm25_bound(pruning->bm25, pruning->idf[t], maxCount, minTokens);
+  }
+  return (double) pruning->credits[t] * maxCount;
+}
+
+
+
+
+/**
+ * @brief: helper for pruneSegment: whether a document can score no more
+ * than a bound and still outrank the worst of a full heap --
+ * it cannot, should it round to no more than the worst's score,
+ * as a later docID loses ties; the bound is padded for the rounding
+ * of sums taken in another order.
+ * 
+ * @param top: the heap.
+ * @param bound: the most the document can score, in points.
+ * @return bool: true if the heap is full, and the document cannot outrank its worst.
+ */
+static bool
+cannotRank(topk_t* top, const double bound)
+{
+  return top->size == top->k
+         && bound * top->scale * (1 + 1e-9) + 1e-9 < top->scores[0] + 0.5;
+}
+
+
+
+
+/**
+ * @brief: helper for pruneSegment: scores a document, whose terms'
+ * cursors stand at it or beyond, if it matches the query
+ * -- holds every term of a sub-query -- and puts it in the heap,
+ * if it outranks the worst there, or the heap has room.
+ * By counts, it scores each sub-query's least count, summed over
+ * the sub-queries it matches, as query_build() and query_union();
+ * by BM25, the score of query_rank(), summed in the same order.
  * 
- * @param arg: pointer to a valid counters struct
- * @param docID: document ID (key)
- * @param count: count
+ * @param pruning: the terms, and their cursors.
+ * @param top: the heap.
+ * @param docID: the document.
  */
 static void
-setZero(void* arg, int docID, int count)
+scoreDoc(pruning_t* pruning, topk_t* top, const int docID)
 {
-  if(arg != NULL) {
-    /* convert back to counters_t* */
-    counters_t* ctrs = (counters_t*) arg;
+  bool matched = false;
+  long count = 0;
+  for (int g = 0; g < pruning->nGroups; g++) {
+    int least = INT_MAX;
+    for (int j = 0; pruning->groups[g][j] >= 0 && least > 0; j++) {
+      int t = pruning->groups[g][j];
+      int tf = (pruning->cursors[t] != NULL && pruning->docs[t] == docID) ? pruning->counts[t] : 0;
+      least = (tf < least) ? tf : least;
+    }
+    if (least > 0) {
+      matched = true;
+      count += least;
+    }
+  }
+  if (!matched) {
+    return;
+  }
 
-    /* insert docID-count pair into the copy */
-    counters_set(ctrs, docID, 0);
+  long score = count;
+  if (pruning->bm25 != NULL) {
+    double sum = 0;
+    for (int t = 0; t < pruning->nTerms; t++) {
+      int tf = (pruning->cursors[t] != NULL && pruning->docs[t] == docID) ? pruning->counts[t] : 0;
+      sum += bm25_term(pruning->bm25, pruning->idf[t], docID, tf);
+    }
+    score = lround(sum * BM25_SCALE);
+    score = (score < 1) ? 1 : score;
   }
+  topPush(top, docID, (score > INT_MAX) ? INT_MAX : (int) score);
 }
 
 
 
 
 /**
- * @brief: builds an intersection of two counts.
- * Compares occurence of keys and values from one counters
- * with occurrences in the other. 
+ * @brief: helper for scoreDoc and rankCount: puts a document in the heap
+ * of the best, whose root is the worst: the lowest score, and of those
+ * the highest docID. The documents come in docID order, so a document
+ * outranks the worst only by outscoring it.
  * 
- * Inputs:
- * @param arg: array of two counters
- * @param docID: document ID (key)
- * @param count: count
+ * @param top: the heap.
+ * @param docID: the document, beyond any in the heap.
+ * @param score: its score.
  */
 static void
-intersect(void* arg, int docID, int count) {
-  if(arg != NULL) {
-    /* convert back to counters_t* */
-    counters_t** buffer = (counters_t**) arg;
+topPush(topk_t* top, const int docID, const int score)
+{
+  if (top->size < top->k) {
+    /* room: up from the bottom, past the better */
+    int i = top->size++;
+    while (i > 0 && !topWorse(top, (i - 1) / 2, docID, score)) {
+      top->docIDs[i] = top->docIDs[(i - 1) / 2];
+      top->scores[i] = top->scores[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+    top->docIDs[i] = docID;
+    top->scores[i] = score;
+  }
+  else if (top->size > 0 && score > top->scores[0]) {
+    topDown(top, docID, score);
+  }
+}
 
-    counters_t* next = buffer[0];
-    counters_t* intersection = buffer[1];
 
-    int nextCount = counters_get(next, docID);
 
-    if (nextCount > 0) {
-      /* find minimum value of the two */
-      int min = (nextCount < count) ? nextCount : count;
 
-      /* save to intersection */
-      counters_set(intersection, docID, min);
+/**
+ * @brief: helper for topPush and topSort: puts a document in place of
+ * the heap's root, and down from there, past the worse.
+ * 
+ * @param top: the heap, not empty.
+ * @param docID: the document ...
+ * @param score: ... and its score.
+ */
+static void
+topDown(topk_t* top, const int docID, const int score)
+{
+  int i = 0;
+  while (true) {
+    int child = 2 * i + 1;
+    if (child >= top->size) {
+      break;
+    }
+    if (child + 1 < top->size && topWorse(top, child + 1, top->docIDs[child], top->scores[child])) {
+      child++;
+    }
+    if (!topWorse(top, child, docID, score)) {
+      break;
     }
+    top->docIDs[i] = top->docIDs[child];
+    top->scores[i] = top->scores[child];
+    i = child;
   }
+  top->docIDs[i] = docID;
+  top->scores[i] = score;
+}
+
+
+
+
+/**
+ * @brief: helper for query_index: sorts the heap's documents in place,
+ * best first, by taking out its root -- the worst left -- to the end,
+ * one at a time.
+ * 
+ * @param top: the heap; its arrays then hold the ranking.
+ */
+static void
+topSort(topk_t* top)
+{
+  int size = top->size;
+  while (top->size > 1) {
+    int docID = top->docIDs[0], score = top->scores[0];
+    int last = --top->size;
+    topDown(top, top->docIDs[last], top->scores[last]);
+    top->docIDs[last] = docID;
+    top->scores[last] = score;
+  }
+  top->size = size;
+}
+
+
+
+
+/**
+ * @brief: helper for query_index, used by counters_iterate:
+ * puts a document the query matched in the heap of the best.
+ * 
+ * @param arg: pointer to the topk_t.
+ * @param docID: the document.
+ * @param count: its score; counters hold none below one.
+ */
+static void
+rankCount(void* arg, int docID, int count)
+{
+  if (count > 0) {
+    topPush((topk_t*) arg, docID, count);
+  }
+}
+
+
+
+
+/**
+ * @brief: helper for topPush: whether entry i of the heap ranks below a document.
+ * 
+ * @param top: the heap.
+ * @param i: the entry.
+ * @param docID: the document ...
+ * @param score: ... and its score.
+ * @return bool: true if entry i scores less, or as much with a higher docID.
+ */
+static bool
+topWorse(topk_t* top, const int i, const int docID, const int score)
+{
+  return top->scores[i] < score || (top->scores[i] == score && top->docIDs[i] > docID);
 }
@@ -16,7 +16,10 @@
 #include "webpage.h"
 
 #include "index.h"
+#include "segments.h"
 #include "counters.h"
+#include "threadpool.h"
+#include "bm25.h"
 
 typedef struct query query_t;
 
@@ -37,7 +40,8 @@ void query_delete(query_t* query);
 /**
  * @brief: assembles the results of a specific word's occurrence in the index.
  * Returns NULL in case of error or non-existence.
- * Also frees the passed in word. 
+ * The words remain the caller's (typically, in the per-query arena).
+ * They are intersected rarest first (by index_count()).
  * 
  * @param index: pointer to valid index object.
  * @param subQuery: the sequence of words to be checked in the index.
@@ -65,12 +69,52 @@ void query_intersection(index_t* index, query_t* query, char* nextWord);
 query_t* query_union(query_t* subQuery1, query_t* subQuery2);
 
 /**
- * @brief: merge the query results with data from the index and pages.
+ * @brief: scores the query's documents by BM25 (see bm25.h), in place of
+ * their counts: for each distinct term -- word, pattern, or phrase --
+ * of all the sub-queries, the term's IDF, from its documents in all
+ * segments, is computed once; each document then sums its terms' scores.
+ * query_print() prints the scores to three decimals.
+ * 
+ * @param query: pointer to a query struct, with the documents matched.
+ * @param segments: the index's segments.
+ * @param subQueries: the query's sub-queries, NULL-terminated, each of terms.
+ * @param bm25: the index's scorer (bm25_new()).
+ */
+void query_rank(query_t* query, segments_t* segments, char*** subQueries, bm25_t* bm25);
+
+/**
+ * @brief: finds the k best documents of a query -- by BM25, or else by
+ * count -- without scoring every document it matches (Block-Max WAND):
+ * the terms' postings are walked together (index_cursor()), and, once
+ * k documents are found, those whose terms' maxima cannot add up to
+ * the worst of their scores are skipped, whole blocks of postings unread.
+ * The k, their scores, and their order are those the whole ranking
+ * -- query_build() and query_union() of every sub-query, on every
+ * segment, and query_rank() -- starts with.
+ * query_print() prints them as the top k, not as all the matches.
+ * 
+ * @param segments: the index's segments.
+ * @param subQueries: the query's sub-queries, NULL-terminated, each of terms.
+ * @param bm25: the index's scorer (bm25_new()); NULL to rank by counts.
+ * @param k: how many documents to find; at least one.
+ * @return query_t*: a query struct holding them, with their scores
+ * -- fewer, if fewer match; NULL if k is not positive.
+ */
+query_t* query_top(segments_t* segments, char*** subQueries, bm25_t* bm25, const int k);
+
+/**
+ * @brief: merge the query results with data from the index and pages:
+ * each result's URL comes from the document table of the index
+ * (see segments_getDoc()), without reading the page -- or, where the
+ * table lacks it, as a text index's does, from the page itself.
  * 
  * @param query: pointer to a query struct.
+ * @param segments: the index's segments (NULL loads every page).
  * @param pageDirectory: file directory wherein pages are saved.
+ * @param pool: worker threads wherein to load the pages
+ * (NULL loads them in the calling thread).
  */
-void query_index(query_t* query, char* pageDirectory);
+void query_index(query_t* query, segments_t* segments, char* pageDirectory, threadpool_t* pool);
 
 /**
  * @brief: prints the results held in a query struct.
@@ -49,6 +49,12 @@ fi;
 # invalid output directory (wherein to output create file)
 ./querier ../data/output/wikipedia-1 ../data/outputDUMMY/wikipedia-1.index
 
+# a misspelt option
+./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --bm
+
+# only the best, K of 0
+./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --top 0
+
 
 # VALID TESTS:
 
@@ -70,3 +76,22 @@ fi;
 # wikipedia, maxDepth = 1
 ./fuzztest ../data/output/wikipedia-1.index 25 2021 | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.index
 
+# wikipedia, maxDepth = 1, from the binary index written by the indexer tests (mapped)
+./fuzztest ../data/output/wikipedia-1.index 25 2021 | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin
+
+# patterns: prefixes, an inner '*', and one that starts with '*' (invalid), on both formats
+printf "comput*\ncomput* and sci*\nal*ing or hom*\n*ing\n" | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.index
+printf "comput*\ncomput* and sci*\nal*ing or hom*\n*ing\n" | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin
+
+# phrases: with positions, then without (all the words, unplaced); a short inner word;
+# unclosed, empty, and holding a pattern (invalid)
+printf "\"computer science\"\n\"the computer science department\" or home\n\"department of computer science\"\n\"computer science\n\"\"\n\"comput* science\"\n" | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.pos
+printf "\"computer science\"\n\"the computer science department\" or home\n" | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin
+
+# ranked by BM25: with document tables (binary), without (text)
+printf "computer science\ncomputer or science\ncomput* and \"computer science\"\n" | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --bm25
+printf "computer science\ncomputer or science\n" | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.index --threads 2 --bm25
+
+# only the best: by BM25 and by count, binary and text, the same as the whole ranking starts
+printf "computer or science or home\ncomput* or \"computer science\"\n" | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.bin --bm25 --top 5
+printf "computer or science or home\n" | ./querier ../data/output/wikipedia-1 ../data/output/wikipedia-1.index --top 3
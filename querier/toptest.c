@@ -0,0 +1,374 @@
+/*
+ * toptest - behaviour test for query_top, against the whole ranking
+ *
+ * usage:
+ *   toptest [nDocs]
+ *
+ * Indexes nDocs synthetic documents, of words drawn from a small
+ * vocabulary -- some words in many of them, so scores often tie --
+ * and saves the index four ways, under /tmp: as a text index, and as a
+ * binary one, each alone and as a base with three segments after it.
+ *
+ * For each, random queries -- sub-queries of words and patterns,
+ * joined by "or" -- are run both as the querier runs them in full,
+ * query_build() and query_union() on every segment, then query_rank(),
+ * and by query_top(), for k of 1, 3, every match, and more; ranked by
+ * BM25, and by counts. The top k must print as the first k lines
+ * of the whole ranking: the same documents, scores and order.
+ *
+ * `make toptest` builds it with -fsanitize=address,undefined.
+ * Prints PASS or FAIL lines; exits non-zero on any failure.
+ *
+ * Amittai J. Wekesa, May 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "mem.h"
+#include "index.h"
+#include "segments.h"
+#include "bm25.h"
+#include "query.h"
+
+/**************** file-local global types ****************/
+/* one way of saving the index */
+typedef struct layout {
+  const char* name;
+  bool binary;                  // the base is binary, else text
+  int nSegments;                // segments after the base
+} layout_t;
+
+/**************** file-local global variables ****************/
+static int nDocs = 300;
+static const int nWords = 200;          // the vocabulary
+static const int nQueries = 100;
+static char dir[] = "/tmp/toptest.XXXXXX";
+
+static const layout_t layouts[] = {
+  { "text", false, 0 },
+  { "binary", true, 0 },
+  { "text and segments", false, 3 },
+  { "binary and segments", true, 3 },
+};
+
+/**************** local functions ****************/
+static bool testLayout(const layout_t* layout);
+static bool testQuery(segments_t* segments, char*** subQueries, bm25_t* bm25, const char* what);
+static char* rankAll(segments_t* segments, char*** subQueries, bm25_t* bm25, int* nMatches);
+static char* rankTop(segments_t* segments, char*** subQueries, bm25_t* bm25, const int k);
+static char* printQuery(query_t* query);
+static const char* skipLines(const char* text, const int n);
+static index_t* indexDocs(const int first, const int last);
+static bool saveIndex(index_t* index, const char* name, const bool binary);
+static void makeWord(const int i, char* word);
+static void makeQuery(char terms[][12], char** words, char*** subQueries);
+static void queryText(char*** subQueries, char* text);
+static void removeIndex(const char* indexFileName);
+
+/**************** main ****************/
+int
+main(const int argc, char* argv[])
+{
+  if (argc > 2 || (argc > 1 && sscanf(argv[1], "%d", &nDocs) != 1)
+      || nDocs < 20) {
+    fprintf(stderr, "usage: %s [nDocs>=20]\n", argv[0]);
+    exit(1);
+  }
+
+  if (mkdtemp(dir) == NULL) {
+    fprintf(stderr, "FAIL: cannot make a directory under /tmp\n");
+    exit(2);
+  }
+
+  bool ok = true;
+  for (int i = 0; i < (int) (sizeof(layouts) / sizeof(layouts[0])); i++) {
+    ok = testLayout(&layouts[i]) && ok;
+  }
+  rmdir(dir);
+
+  if (mem_net() != 0 || mem_bytes() != 0) {
+    mem_report(stdout, "FAIL: leaked");
+    ok = false;
+  }
+  return ok ? 0 : 2;
+}
+
+/**************** testLayout ****************/
+/* Save the index as layout says, and run the queries over it. */
+static bool
+testLayout(const layout_t* layout)
+{
+  char name[sizeof(dir) + 20];
+  sprintf(name, "%s/index", dir);
+  srand(2021);                  // the same documents and queries each time
+  bool ok = true;
+
+  /* the base, then the segments: a quarter of the documents each */
+  int last = (layout->nSegments > 0) ? nDocs / (layout->nSegments + 1) : nDocs;
+  index_t* base = indexDocs(1, last);
+  ok = saveIndex(base, name, layout->binary);
+  index_delete(base);
+  for (int s = 1; s <= layout->nSegments && ok; s++) {
+    int first = last + 1;
+    last = (s == layout->nSegments) ? nDocs : nDocs * (s + 1) / (layout->nSegments + 1);
+    index_t* segment = indexDocs(first, last);
+    ok = segments_add(name, segment);
+    index_delete(segment);
+  }
+  segments_t* segments = ok ? segments_open(name) : NULL;
+  if (segments == NULL || segments_size(segments) != layout->nSegments + 1) {
+    printf("FAIL: %s: cannot save and open the index\n", layout->name);
+    segments_delete(segments);
+    removeIndex(name);
+    return false;
+  }
+  bm25_t* bm25 = bm25_new(segments);
+
+  /* random queries, by BM25 and by counts */
+  for (int q = 0; q < nQueries && ok; q++) {
+    char terms[9][12];
+    char* words[12];
+    char** subQueries[4];
+    makeQuery(terms, words, subQueries);
+    ok = testQuery(segments, subQueries, bm25, layout->name)
+      && testQuery(segments, subQueries, NULL, layout->name);
+  }
+  if (ok) {
+    printf("PASS: %s, %d segments, %d queries\n", layout->name, layout->nSegments + 1, nQueries);
+  }
+
+  bm25_delete(bm25);
+  segments_delete(segments);
+  removeIndex(name);
+  return ok;
+}
+
+/**************** testQuery ****************/
+/* query_top, for k of 1, 3, every match and more, must print the whole ranking's first k. */
+static bool
+testQuery(segments_t* segments, char*** subQueries, bm25_t* bm25, const char* what)
+{
+  int nMatches;
+  char* all = rankAll(segments, subQueries, bm25, &nMatches);
+  int ks[] = { 1, 3, nMatches, nMatches + 2 };
+  bool ok = true;
+
+  for (int i = 0; i < 4 && ok; i++) {
+    int k = ks[i];
+    if (k < 1) {
+      continue;
+    }
+    char* top = rankTop(segments, subQueries, bm25, k);
+    int n = (k < nMatches) ? k : nMatches;
+
+    /* the header, then the first n lines of the ranking, and no more */
+    char header[40];
+    if (n == 0) {
+      sprintf(header, "Matches 0 documents.\n");
+    }
+    else {
+      sprintf(header, "Top %d documents (ranked):\n", n);
+    }
+    const char* rest = skipLines(all, 1);
+    size_t len = skipLines(rest, n) - rest;
+    if (strncmp(top, header, strlen(header)) != 0
+        || strlen(top) != strlen(header) + len
+        || strncmp(top + strlen(header), rest, len) != 0) {
+      char text[200];
+      queryText(subQueries, text);
+      printf("FAIL: %s: query '%s', by %s, top %d of %d:\n%s-- not the start of --\n%s",
+             what, text, bm25 != NULL ? "BM25" : "counts", k, nMatches, top, all);
+      ok = false;
+    }
+    mem_free(top);
+  }
+  mem_free(all);
+  return ok;
+}
+
+/* The whole ranking, as the querier makes it without --top; printed. */
+static char*
+rankAll(segments_t* segments, char*** subQueries, bm25_t* bm25, int* nMatches)
+{
+  query_t* query = query_build(segments_get(segments, 0), subQueries[0]);
+  for (int s = 0; s < segments_size(segments); s++) {
+    for (int i = (s == 0) ? 1 : 0; subQueries[i] != NULL; i++) {
+      query = query_union(query, query_build(segments_get(segments, s), subQueries[i]));
+    }
+  }
+  if (bm25 != NULL) {
+    query_rank(query, segments, subQueries, bm25);
+  }
+  query_index(query, segments, dir, NULL);
+  *nMatches = counters_size(query_getCounters(query));
+  char* text = printQuery(query);
+  query_delete(query);
+  return text;
+}
+
+/* The top k, by query_top; printed. */
+static char*
+rankTop(segments_t* segments, char*** subQueries, bm25_t* bm25, const int k)
+{
+  query_t* query = mem_assert(query_top(segments, subQueries, bm25, k), "query_top");
+  query_index(query, segments, dir, NULL);
+  char* text = printQuery(query);
+  query_delete(query);
+  return text;
+}
+
+/*
+ * Print a query to a string; caller must mem_free() it.
+ * The directory holds no pages: documents the index has no table for,
+ * a text index's, print without URLs, in either ranking alike.
+ */
+static char*
+printQuery(query_t* query)
+{
+  FILE* fp = mem_assert(tmpfile(), "tmpfile");
+  query_print(query, fp);
+  long size = ftell(fp);
+  rewind(fp);
+  char* text = mem_malloc_assert(size + 1, "text");
+  text[fread(text, 1, size, fp)] = '\0';
+  fclose(fp);
+  return text;
+}
+
+/* The text after its first n lines. */
+static const char*
+skipLines(const char* text, const int n)
+{
+  for (int i = 0; i < n && *text != '\0'; i++) {
+    const char* newline = strchr(text, '\n');
+    text = (newline != NULL) ? newline + 1 : text + strlen(text);
+  }
+  return text;
+}
+
+/**************** indexDocs ****************/
+/*
+ * Index documents first..last: each of 10 to 150 words, skewed to the
+ * first words of the vocabulary, with an entry in the document table.
+ * The same docID always gets the same words.
+ */
+static index_t*
+indexDocs(const int first, const int last)
+{
+  index_t* index = mem_assert(index_new(), "index");
+  for (int docID = first; docID <= last; docID++) {
+    unsigned int seed = docID;
+    int nTokens = 10 + rand_r(&seed) % 141;
+    for (int i = 0; i < nTokens; i++) {
+      char word[12];
+      makeWord(rand_r(&seed) % (1 + rand_r(&seed) % nWords), word);
+      index_insert(index, word, docID);
+    }
+    char url[40];
+    sprintf(url, "http://toptest/%d.html", docID);
+    index_doc_t doc = { url, docID % 3, nTokens, 20 * nTokens };
+    index_setDoc(index, docID, &doc);
+  }
+  return index;
+}
+
+/* Save an index, in binary or as text, to a file. */
+static bool
+saveIndex(index_t* index, const char* name, const bool binary)
+{
+  FILE* fp = fopen(name, "w");
+  if (fp == NULL) {
+    return false;
+  }
+  bool ok = true;
+  if (binary) {
+    ok = index_save(index, fp);
+  }
+  else {
+    index_print(index, fp);
+  }
+  return (fclose(fp) == 0) && ok;
+}
+
+/* Word i of the vocabulary: "top", then i in base 26. */
+static void
+makeWord(const int i, char* word)
+{
+  char* end = word + sprintf(word, "top");
+  int rest = i;
+  do {
+    *end++ = 'a' + rest % 26;
+    rest /= 26;
+  } while (rest > 0);
+  *end = '\0';
+}
+
+/**************** makeQuery ****************/
+/*
+ * A random query: one to three sub-queries, of one to three terms each
+ * -- words, mostly common ones, now and then one in no document,
+ * or a pattern; terms, words and subQueries are filled in.
+ */
+static void
+makeQuery(char terms[][12], char** words, char*** subQueries)
+{
+  int nSubQueries = 1 + rand() % 3;
+  int t = 0, w = 0;
+  for (int s = 0; s < nSubQueries; s++) {
+    subQueries[s] = &words[w];
+    int n = 1 + rand() % 3;
+    for (int i = 0; i < n; i++, t++) {
+      int kind = rand() % 10;
+      if (kind == 0) {
+        sprintf(terms[t], "topzzz");                            // in no document
+      }
+      else if (kind == 1) {
+        sprintf(terms[t], "top%c*", 'a' + rand() % 26);        // a pattern
+      }
+      else {
+        makeWord(rand() % (1 + rand() % (nWords / 4)), terms[t]);
+      }
+      words[w++] = terms[t];
+    }
+    words[w++] = NULL;
+  }
+  subQueries[nSubQueries] = NULL;
+}
+
+/* The query as a user would type it. */
+static void
+queryText(char*** subQueries, char* text)
+{
+  text[0] = '\0';
+  for (int s = 0; subQueries[s] != NULL; s++) {
+    if (s > 0) {
+      strcat(text, " or");
+    }
+    for (int i = 0; subQueries[s][i] != NULL; i++) {
+      strcat(text, (s > 0 || i > 0) ? " " : "");
+      strcat(text, subQueries[s][i]);
+    }
+  }
+}
+
+/**************** removeIndex ****************/
+/* Remove an index, its manifest and segments, and any lock file. */
+static void
+removeIndex(const char* indexFileName)
+{
+  char name[strlen(indexFileName) + 40];
+  for (int gen = 1; gen <= 8; gen++) {
+    sprintf(name, "%s.seg%d", indexFileName, gen);
+    remove(name);
+  }
+  const char* suffixes[] = { ".segments", ".lock", "" };
+  for (int i = 0; i < 3; i++) {
+    sprintf(name, "%s%s", indexFileName, suffixes[i]);
+    remove(name);
+  }
+}